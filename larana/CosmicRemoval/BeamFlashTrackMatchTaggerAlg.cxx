@@ -10,7 +10,6 @@
 */
 
 #include "BeamFlashTrackMatchTaggerAlg.h"
-#include "larcorealg/Geometry/OpDetGeo.h"
 
 #include <limits>
 
@@ -125,6 +124,7 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::RunHypothesisComparison(unsigned int
 								   opdet::OpDigiProperties const& opdigip){
 
   auto const& geom = *(providers.get<geo::GeometryCore>());
+  if(fGeometryCache.Empty()) UpdateGeometry(geom);
 
   cFlashComparison_p.run = run;
   cFlashComparison_p.event = event;
@@ -166,7 +166,7 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::RunHypothesisComparison(unsigned int
 			cFlashComparison_p.hyp_totalPE,
 			cFlashComparison_p.hyp_y,cFlashComparison_p.hyp_sigmay,
 			cFlashComparison_p.hyp_z,cFlashComparison_p.hyp_sigmaz,
-			geom);
+			fGeometryCache);
 
     for(auto flash : flashesOnBeamTime){
       cOpDetVector_flash = std::vector<float>(geom.NOpDets(),0);
@@ -207,6 +207,7 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::RunHypothesisComparison(unsigned int
 								   opdet::OpDigiProperties const& opdigip){
 
   auto const& geom = *(providers.get<geo::GeometryCore>());
+  if(fGeometryCache.Empty()) UpdateGeometry(geom);
 
   cFlashComparison_p.run = run;
   cFlashComparison_p.event = event;
@@ -256,7 +257,7 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::RunHypothesisComparison(unsigned int
 			cFlashComparison_p.hyp_totalPE,
 			cFlashComparison_p.hyp_y,cFlashComparison_p.hyp_sigmay,
 			cFlashComparison_p.hyp_z,cFlashComparison_p.hyp_sigmaz,
-			geom);
+			fGeometryCache);
 
     for(auto flash : flashesOnBeamTime){
       cOpDetVector_flash = std::vector<float>(geom.NOpDets(),0);
@@ -301,16 +302,19 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::RunHypothesisComparison(unsigned int
 
 }
 
+void cosmic::BeamFlashTrackMatchTaggerAlg::UpdateGeometry(geo::GeometryCore const& geom){
+  fGeometryCache.Update(geom);
+}
+
 void cosmic::BeamFlashTrackMatchTaggerAlg::FillFlashProperties(std::vector<float> const& opdetVector,
 							       float& sum,
 							       float& y, float& sigmay,
 							       float& z, float& sigmaz,
-							       geo::GeometryCore const& geom){
+							       opdet::OpDetGeometryCache const& geometry){
   y=0; sigmay=0; z=0; sigmaz=0; sum=0;
-  double xyz[3];
   for(unsigned int opdet=0; opdet<opdetVector.size(); opdet++){
     sum+=opdetVector[opdet];
-    geom.Cryostat(0).OpDet(opdet).GetCenter(xyz);
+    double const* xyz = geometry.OpDetCenter(opdet);
     y += opdetVector[opdet]*xyz[1];
     z += opdetVector[opdet]*xyz[2];
   }
@@ -318,7 +322,7 @@ void cosmic::BeamFlashTrackMatchTaggerAlg::FillFlashProperties(std::vector<float
   y /= sum; z /= sum;
 
   for(unsigned int opdet=0; opdet<opdetVector.size(); opdet++){
-    geom.Cryostat(0).OpDet(opdet).GetCenter(xyz);
+    double const* xyz = geometry.OpDetCenter(opdet);
     sigmay += (opdetVector[opdet]*xyz[1]-y)*(opdetVector[opdet]*xyz[1]-y);
     sigmaz += (opdetVector[opdet]*xyz[2]-y)*(opdetVector[opdet]*xyz[2]-y);
   }
@@ -25,6 +25,7 @@
 #include "larsim/PhotonPropagation/PhotonVisibilityService.h"
 #include "lardata/DetectorInfoServices/LArPropertiesService.h"
 #include "larana/OpticalDetector/OpDigiProperties.h"
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
 
 #include "TVector3.h"
 class TH1F;
@@ -70,6 +71,10 @@ class cosmic::BeamFlashTrackMatchTaggerAlg{
 			       phot::PhotonVisibilityService const&,
 			       opdet::OpDigiProperties const&);
 
+  //refresh the optical detector positions; owning modules call it at begin
+  //of run, otherwise they are looked up on the first hypothesis comparison
+  void UpdateGeometry(geo::GeometryCore const&);
+
  private:
 
   const anab::CosmicTagID_t COSMIC_TYPE_FLASHMATCH;
@@ -88,6 +93,8 @@ class cosmic::BeamFlashTrackMatchTaggerAlg{
   bool fMakeOutsideDriftTags;
   bool fNormalizeHypothesisToFlash;
 
+  opdet::OpDetGeometryCache fGeometryCache;
+
 
   TTree*             cTree;
 
@@ -179,7 +186,7 @@ class cosmic::BeamFlashTrackMatchTaggerAlg{
 			   float&,
 			   float&, float&,
 			   float&, float&,
-			   geo::GeometryCore const& geom);
+			   opdet::OpDetGeometryCache const& geometry);
 
   float CalculateChi2(std::vector<float> const&,std::vector<float> const&);
 
@@ -18,6 +18,7 @@
 #include "art/Framework/Core/ModuleMacros.h"
 #include "art/Framework/Principal/Event.h"
 #include "art/Framework/Principal/Handle.h"
+#include "art/Framework/Principal/Run.h"
 #include "fhiclcpp/ParameterSet.h"
 
 #include <memory>
@@ -46,6 +47,7 @@ public:
   BeamFlashTrackMatchTagger & operator = (BeamFlashTrackMatchTagger const &) = delete;
   BeamFlashTrackMatchTagger & operator = (BeamFlashTrackMatchTagger &&) = delete;
   void produce(art::Event & e) override;
+  void beginRun(art::Run & r) override;
 
 
 private:
@@ -76,6 +78,12 @@ cosmic::BeamFlashTrackMatchTagger::BeamFlashTrackMatchTagger(fhicl::ParameterSet
   if(fMakeHitTagAssns) produces< art::Assns<recob::Hit, anab::CosmicTag> >();
 }
 
+void cosmic::BeamFlashTrackMatchTagger::beginRun(art::Run &)
+{
+  art::ServiceHandle<geo::Geometry const> geoHandle;
+  fAlg.UpdateGeometry(*geoHandle);
+}
+
 void cosmic::BeamFlashTrackMatchTagger::produce(art::Event & evt)
 {
   // services and providers we'll be using
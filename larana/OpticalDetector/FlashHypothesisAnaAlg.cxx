@@ -15,9 +15,7 @@
 #include "larana/OpticalDetector/FlashHypothesisCreator.h"
 #include "larana/OpticalDetector/SimPhotonCounterAlg.h"
 #include "larcore/Geometry/Geometry.h"
-#include "larcorealg/Geometry/CryostatGeo.h"
 #include "larcorealg/Geometry/GeometryCore.h"
-#include "larcorealg/Geometry/OpDetGeo.h"
 #include "lardataobj/MCBase/MCTrack.h"
 
 #include "TTree.h"
@@ -41,17 +39,7 @@ void opdet::FlashHypothesisAnaAlg::SetOutputObjects(TTree *tree,
 
 void opdet::FlashHypothesisAnaAlg::FillOpDetPositions(geo::Geometry const& geom)
 {
-
-  fOpDetPositions_Y.resize(geom.NOpDets());
-  fOpDetPositions_Z.resize(geom.NOpDets());
-
-  double xyz[3];
-  for(size_t i_opdet=0; i_opdet<geom.NOpDets(); i_opdet++){
-    geom.Cryostat(0).OpDet(i_opdet).GetCenter(xyz);
-    fOpDetPositions_Y[i_opdet] = (float)xyz[1];
-    fOpDetPositions_Z[i_opdet] = (float)xyz[2];
-  }
-
+  fGeometry.Update(geom);
 }
 
 void opdet::FlashHypothesisAnaAlg::RunComparison(const unsigned int run,
@@ -81,7 +69,7 @@ void opdet::FlashHypothesisAnaAlg::RunComparison(const unsigned int run,
 
   fFHCompare.RunComparison(run,event,
 			   fhc,fSPCAlg.GetSimPhotonCounter(fCounterIndex),
-			   fOpDetPositions_Y,fOpDetPositions_Z);
+			   fGeometry);
 
   fMCTAlg.FillTree(run,event,mctrackVec);
 
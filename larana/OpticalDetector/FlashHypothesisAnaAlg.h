@@ -24,6 +24,7 @@
 #include "FlashHypothesisCreator.h"
 #include "SimPhotonCounterAlg.h"
 #include "FlashHypothesisComparison.h"
+#include "OpDetGeometryCache.h"
 
 class TH1F;
 class TTree;
@@ -77,8 +78,7 @@ namespace opdet{
     FlashHypothesisComparison    fFHCompare;
     sim::MCTrackCollectionAnaAlg fMCTAlg;
 
-    std::vector<float> fOpDetPositions_Y;
-    std::vector<float> fOpDetPositions_Z;
+    OpDetGeometryCache           fGeometry;
 
   };
 
@@ -153,63 +153,97 @@ void opdet::FlashHypothesisComparison::RunComparison(const unsigned int run,
   fRun = run;
   fEvent = event;
 
-  FillFlashHypothesisInfo(fhc,posY,posZ);
-  FillSimPhotonCounterInfo(spc,posY,posZ);
+  fPosY = &posY;
+  fPosZ = &posZ;
+  fGeometry = nullptr;
+
+  FillFlashHypothesisInfo(fhc);
+  FillSimPhotonCounterInfo(spc);
+  FillComparisonInfo(fhc,spc);
+
+  if(fFillTree) fTree->Fill();
+}
+
+void opdet::FlashHypothesisComparison::RunComparison(const unsigned int run,
+						     const unsigned int event,
+						     const FlashHypothesisCollection& fhc,
+						     const SimPhotonCounter& spc,
+						     const OpDetGeometryCache& geometry)
+{
+  if(fhc.GetVectorSize() != (unsigned int)fHypHist_p->GetNbinsX() ||
+     fhc.GetVectorSize() != spc.PromptPhotonVector().size() ||
+     fhc.GetVectorSize() != geometry.NOpDets() ){
+    std::cout << (unsigned int)fHypHist_p->GetNbinsX() << " " << spc.PromptPhotonVector().size() << " " << geometry.NOpDets() << std::endl;
+    throw std::runtime_error("ERROR in FlashHypothesisComparison: Mismatch in vector sizes.");
+  }
+  fRun = run;
+  fEvent = event;
+
+  fPosY = nullptr;
+  fPosZ = nullptr;
+  fGeometry = &geometry;
+
+  FillFlashHypothesisInfo(fhc);
+  FillSimPhotonCounterInfo(spc);
   FillComparisonInfo(fhc,spc);
 
   if(fFillTree) fTree->Fill();
 }
 
-void opdet::FlashHypothesisComparison::FillFlashHypothesisInfo(const FlashHypothesisCollection& fhc,
-							       const std::vector<float>& posY,
-							       const std::vector<float>& posZ)
+void opdet::FlashHypothesisComparison::GetPositionYZ(const std::vector<float>& pe_vector,
+						     float& y, float& rms_y,
+						     float& z, float& rms_z)
+{
+  if(fGeometry){
+    fUtil.GetPosition(pe_vector,*fGeometry,1,y,rms_y);
+    fUtil.GetPosition(pe_vector,*fGeometry,2,z,rms_z);
+  }
+  else{
+    fUtil.GetPosition(pe_vector,*fPosY,y,rms_y);
+    fUtil.GetPosition(pe_vector,*fPosZ,z,rms_z);
+  }
+}
+
+void opdet::FlashHypothesisComparison::FillFlashHypothesisInfo(const FlashHypothesisCollection& fhc)
 {
   fHypPEs_p = fhc.GetPromptHypothesis().GetTotalPEs();
   fHypPEsError_p = fhc.GetPromptHypothesis().GetTotalPEsError();
-  fUtil.GetPosition(fhc.GetPromptHypothesis().GetHypothesisVector(),posY,fHypY_p,fHypRMSY_p);
-  fUtil.GetPosition(fhc.GetPromptHypothesis().GetHypothesisVector(),posZ,fHypZ_p,fHypRMSZ_p);
+  GetPositionYZ(fhc.GetPromptHypothesis().GetHypothesisVector(),fHypY_p,fHypRMSY_p,fHypZ_p,fHypRMSZ_p);
 
   for(size_t i=0; i<fhc.GetVectorSize(); i++)
     fHypHist_p->SetBinContent(i+1,fhc.GetPromptHypothesis().GetHypothesis(i));
 
   fHypPEs_l = fhc.GetLateHypothesis().GetTotalPEs();
   fHypPEsError_l = fhc.GetLateHypothesis().GetTotalPEsError();
-  fUtil.GetPosition(fhc.GetLateHypothesis().GetHypothesisVector(),posY,fHypY_l,fHypRMSY_l);
-  fUtil.GetPosition(fhc.GetLateHypothesis().GetHypothesisVector(),posZ,fHypZ_l,fHypRMSZ_l);
+  GetPositionYZ(fhc.GetLateHypothesis().GetHypothesisVector(),fHypY_l,fHypRMSY_l,fHypZ_l,fHypRMSZ_l);
 
   for(size_t i=0; i<fhc.GetVectorSize(); i++)
     fHypHist_l->SetBinContent(i+1,fhc.GetLateHypothesis().GetHypothesis(i));
 
   fHypPEs_t = fhc.GetTotalHypothesis().GetTotalPEs();
   fHypPEsError_t = fhc.GetTotalHypothesis().GetTotalPEsError();
-  fUtil.GetPosition(fhc.GetTotalHypothesis().GetHypothesisVector(),posY,fHypY_t,fHypRMSY_t);
-  fUtil.GetPosition(fhc.GetTotalHypothesis().GetHypothesisVector(),posZ,fHypZ_t,fHypRMSZ_t);
+  GetPositionYZ(fhc.GetTotalHypothesis().GetHypothesisVector(),fHypY_t,fHypRMSY_t,fHypZ_t,fHypRMSZ_t);
 
   for(size_t i=0; i<fhc.GetVectorSize(); i++)
     fHypHist_t->SetBinContent(i+1,fhc.GetLateHypothesis().GetHypothesis(i));
 }
 
-void opdet::FlashHypothesisComparison::FillSimPhotonCounterInfo(const SimPhotonCounter& spc,
-								const std::vector<float>& posY,
-								const std::vector<float>& posZ)
+void opdet::FlashHypothesisComparison::FillSimPhotonCounterInfo(const SimPhotonCounter& spc)
 {
   fSimPEs_p = spc.PromptPhotonTotal();
-  fUtil.GetPosition(spc.PromptPhotonVector(),posY,fSimY_p,fSimRMSY_p);
-  fUtil.GetPosition(spc.PromptPhotonVector(),posZ,fSimZ_p,fSimRMSZ_p);
+  GetPositionYZ(spc.PromptPhotonVector(),fSimY_p,fSimRMSY_p,fSimZ_p,fSimRMSZ_p);
 
   for(size_t i=0; i<spc.PromptPhotonVector().size(); i++)
     fSimHist_p->SetBinContent(i+1,spc.PromptPhotonVector()[i]);
 
   fSimPEs_l = spc.LatePhotonTotal();
-  fUtil.GetPosition(spc.LatePhotonVector(),posY,fSimY_l,fSimRMSY_l);
-  fUtil.GetPosition(spc.LatePhotonVector(),posZ,fSimZ_l,fSimRMSZ_l);
+  GetPositionYZ(spc.LatePhotonVector(),fSimY_l,fSimRMSY_l,fSimZ_l,fSimRMSZ_l);
 
   for(size_t i=0; i<spc.LatePhotonVector().size(); i++)
     fSimHist_l->SetBinContent(i+1,spc.LatePhotonVector()[i]);
 
   fSimPEs_t = fSimPEs_p+fSimPEs_l;
-  fUtil.GetPosition(spc.TotalPhotonVector(),posY,fSimY_t,fSimRMSY_t);
-  fUtil.GetPosition(spc.TotalPhotonVector(),posZ,fSimZ_t,fSimRMSZ_t);
+  GetPositionYZ(spc.TotalPhotonVector(),fSimY_t,fSimRMSY_t,fSimZ_t,fSimRMSZ_t);
 
   for(size_t i=0; i<spc.GetVectorSize(); i++)
     fSimHist_t->SetBinContent(i+1,spc.TotalPhotonVector(i));
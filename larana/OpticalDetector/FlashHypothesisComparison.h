@@ -41,17 +41,29 @@ namespace opdet{
 		       const std::vector<float>&,
 		       const std::vector<float>&);
 
+    //same, with the optical detector positions read from the geometry cache
+    void RunComparison(const unsigned int,
+		       const unsigned int,
+		       const FlashHypothesisCollection&,
+		       const SimPhotonCounter&,
+		       const OpDetGeometryCache&);
+
   private:
 
     FlashUtilities fUtil;
 
-    void FillFlashHypothesisInfo(const FlashHypothesisCollection&,
-				 const std::vector<float>&,
-				 const std::vector<float>&);
+    //positions of the current comparison: either y and z vectors, or the cache
+    const std::vector<float>* fPosY = nullptr;
+    const std::vector<float>* fPosZ = nullptr;
+    const OpDetGeometryCache* fGeometry = nullptr;
+
+    void GetPositionYZ(const std::vector<float>&,
+		       float&, float&,
+		       float&, float&);
+
+    void FillFlashHypothesisInfo(const FlashHypothesisCollection&);
 
-    void FillSimPhotonCounterInfo(const SimPhotonCounter&,
-				  const std::vector<float>&,
-				  const std::vector<float>&);
+    void FillSimPhotonCounterInfo(const SimPhotonCounter&);
 
     void FillComparisonInfo(const FlashHypothesisCollection&,
 			    const SimPhotonCounter&);
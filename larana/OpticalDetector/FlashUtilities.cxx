@@ -127,3 +127,33 @@ void opdet::FlashUtilities::GetPosition(const std::vector<float>& pe_vector,
   mean = double(fmean);
   rms = double(frms);
 }
+
+void opdet::FlashUtilities::GetPosition(const std::vector<float>& pe_vector,
+					const OpDetGeometryCache& geometry,
+					unsigned int axis,
+					float& mean, float& rms)
+{
+  if(pe_vector.size()>geometry.NOpDets())
+    throw std::runtime_error("ERROR in FlashUtilities GetPosition: More PE entries than optical detectors.");
+  if(axis>2)
+    throw std::runtime_error("ERROR in FlashUtilities GetPosition: Invalid coordinate.");
+
+  float sum = std::accumulate(pe_vector.begin(),pe_vector.end(),0.0);
+
+  if(sum < std::numeric_limits<float>::epsilon()){
+    mean=0; rms=0; return;
+  }
+
+  double weighted = 0;
+  for(size_t i=0; i<pe_vector.size(); i++)
+    weighted += pe_vector[i]*(float)geometry.OpDetCenter(i)[axis];
+  mean = weighted / sum;
+
+  rms=0;
+  for(size_t i=0; i<pe_vector.size(); i++){
+    float pos = geometry.OpDetCenter(i)[axis];
+    rms += pe_vector[i]*(pos - mean)*(pos - mean);
+  }
+
+  rms = std::sqrt(rms)/sum;
+}
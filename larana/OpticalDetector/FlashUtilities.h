@@ -15,6 +15,7 @@
 
 #include <vector>
 #include "FlashHypothesis.h"
+#include "OpDetGeometryCache.h"
 
 namespace opdet{
 
@@ -40,6 +41,13 @@ namespace opdet{
 		     const std::vector<float>&,
 		     double&, double&);
 
+    //PE-weighted mean and rms of one coordinate (0,1,2 for x,y,z) of the
+    //optical detector centers, with pe_vector indexed by optical detector
+    void GetPosition(const std::vector<float>&,
+		     const OpDetGeometryCache&,
+		     unsigned int,
+		     float&, float&);
+
   private:
 
   };
@@ -0,0 +1,149 @@
+// -*- mode: c++; c-basic-offset: 2; -*-
+/*!
+ * Title:   OpDetGeometryCache
+ *
+ * Description:
+ * Geometry of the optical channels and detectors used by the flash
+ * algorithms, looked up once per geometry.
+ */
+
+#include "OpDetGeometryCache.h"
+
+#include "cetlib_except/exception.h"
+
+#include "larcorealg/Geometry/Exceptions.h"
+#include "larcorealg/Geometry/GeometryCore.h"
+#include "larcorealg/Geometry/OpDetGeo.h"
+#include "larcoreobj/SimpleTypesAndConstants/geo_types.h"
+
+#include <algorithm>
+
+namespace opdet{
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::Update(geo::GeometryCore const& geom) {
+
+    ResetFromGeometry(geom);
+
+    for (unsigned int channel = 0; channel != fChannelValid.size(); ++channel)
+      FillChannel(geom, channel);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::Update(geo::GeometryCore const&           geom,
+                                  std::vector< unsigned int > const& Channels) {
+
+    ResetFromGeometry(geom);
+
+    for (unsigned int const channel : Channels)
+      if (channel < fChannelValid.size() && !fChannelValid[channel])
+        FillChannel(geom, channel);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::Reset(unsigned int MaxOpChannel,
+                                 size_t       NOpDets,
+                                 unsigned int Nplanes,
+                                 unsigned int Ncryostats) {
+
+    fNplanes    = Nplanes;
+    fNcryostats = Ncryostats;
+
+    unsigned int const NChannels = MaxOpChannel + 1;
+    fChannelValid    .assign(NChannels, false);
+    fChannelInTPC    .assign(NChannels, false);
+    fChannelCryostats.assign(NChannels, 0);
+    fChannelCenters  .assign(3*NChannels, 0.0);
+    fNearestWires    .assign(NChannels*fNplanes, InvalidWire);
+    fOpDetCenters    .assign(3*NOpDets, 0.0);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::SetChannel(unsigned int                       channel,
+                                      double const*                      xyz,
+                                      unsigned int                       cryostat,
+                                      std::vector< unsigned int > const&
+                                                                NearestWires) {
+
+    if (channel >= fChannelValid.size())
+      throw cet::exception("OpDetGeometryCache")
+        << "Optical channel " << channel << " is beyond the cache (up to "
+        << MaxOpChannel() << ")\n";
+    if (!NearestWires.empty() && NearestWires.size() != fNplanes)
+      throw cet::exception("OpDetGeometryCache")
+        << NearestWires.size() << " nearest wires for optical channel "
+        << channel << ", with " << fNplanes << " planes\n";
+
+    fChannelValid[channel]     = true;
+    fChannelInTPC[channel]     = !NearestWires.empty();
+    fChannelCryostats[channel] = cryostat;
+    std::copy(xyz, xyz + 3, &fChannelCenters[3*channel]);
+    std::copy(NearestWires.begin(), NearestWires.end(),
+              &fNearestWires[channel*fNplanes]);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::SetOpDetCenter(unsigned int  opdet,
+                                          double const* xyz) {
+
+    if (opdet >= NOpDets())
+      throw cet::exception("OpDetGeometryCache")
+        << "Optical detector " << opdet << " is beyond the cache ("
+        << NOpDets() << " detectors)\n";
+    std::copy(xyz, xyz + 3, &fOpDetCenters[3*opdet]);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::ResetFromGeometry(geo::GeometryCore const& geom) {
+
+    Reset(geom.MaxOpChannel(), geom.NOpDets(), geom.Nplanes(),
+          geom.Ncryostats());
+
+    double xyz[3];
+    for (unsigned int o = 0; o != geom.NOpDets(); ++o) {
+      geom.OpDetGeoFromOpDet(o).GetCenter(xyz);
+      SetOpDetCenter(o, xyz);
+    }
+
+  }
+
+  //----------------------------------------------------------------------------
+  void OpDetGeometryCache::FillChannel(geo::GeometryCore const& geom,
+                                       unsigned int             channel) {
+
+    if (!geom.IsValidOpChannel(channel)) return;
+
+    double xyz[3];
+    geom.OpDetGeoFromOpChannel(channel).GetCenter(xyz);
+
+    // The cryostat partitions the flash finding, so a channel must have one
+    geo::CryostatID const cryostat = geom.PositionToCryostatID(xyz);
+    if (!cryostat.isValid)
+      throw cet::exception("OpDetGeometryCache")
+        << "Optical channel " << channel << " at (" << xyz[0] << ", "
+        << xyz[1] << ", " << xyz[2] << ") is in no cryostat\n";
+
+    // A center beyond the wires of a plane is only an error if a flash
+    // ever uses this channel, so the failure is kept rather than thrown
+    std::vector< unsigned int > NearestWires;
+    geo::TPCID tpc = geom.FindTPCAtPosition(xyz);
+    if (tpc.isValid) {
+      NearestWires.assign(fNplanes, InvalidWire);
+      for (unsigned int p = 0; p != fNplanes; ++p) {
+        try {
+          NearestWires[p] = geom.NearestWire(xyz, geo::PlaneID(tpc, p));
+        }
+        catch (geo::InvalidWireError const&) {}
+      }
+    }
+
+    SetChannel(channel, xyz, cryostat.Cryostat, NearestWires);
+
+  }
+
+} // End opdet namespace
@@ -0,0 +1,123 @@
+// -*- mode: c++; c-basic-offset: 2; -*-
+#ifndef OPDETGEOMETRYCACHE_H
+#define OPDETGEOMETRYCACHE_H
+/*!
+ * Title:   OpDetGeometryCache
+ *
+ * Description:
+ * Geometry of the optical channels and detectors used by the flash
+ * algorithms: center, cryostat, owning TPC and nearest wire on each plane,
+ * looked up once per geometry (e.g. at begin of run) and kept in flat
+ * arrays, so that building a flash does not query the geometry service for
+ * every hit.
+ */
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace geo { class GeometryCore; }
+
+namespace opdet{
+
+  class OpDetGeometryCache {
+
+  public:
+
+    /// Value of NearestWire() when the geometry has no wire close to the
+    /// channel on that plane
+    static constexpr unsigned int InvalidWire =
+      std::numeric_limits< unsigned int >::max();
+
+    OpDetGeometryCache() = default;
+    explicit OpDetGeometryCache(geo::GeometryCore const& geom)
+      { Update(geom); }
+
+    /// Refills the cache from the geometry; call when the geometry changes.
+    /// Throws if the center of a channel is in no cryostat
+    void Update(geo::GeometryCore const& geom);
+
+    /// Refills the cache with only the listed channels looked up (e.g. those
+    /// with hits in one event); other channels are left invalid
+    void Update(geo::GeometryCore const&          geom,
+                std::vector< unsigned int > const& Channels);
+
+    /// Empties the cache and sizes it for channels up to MaxOpChannel (all
+    /// invalid), NOpDets optical detectors (centered at the origin), Nplanes
+    /// planes and Ncryostats cryostats. Update does this from the geometry;
+    /// SetChannel and SetOpDetCenter then fill a cache made by hand (tests)
+    void Reset(unsigned int MaxOpChannel,
+               size_t       NOpDets,
+               unsigned int Nplanes,
+               unsigned int Ncryostats);
+
+    /// Makes a channel valid, with its center, cryostat and nearest wire on
+    /// each plane (NearestWires empty if the center is not in a TPC)
+    void SetChannel(unsigned int                       channel,
+                    double const*                      xyz,
+                    unsigned int                       cryostat,
+                    std::vector< unsigned int > const& NearestWires);
+
+    void SetOpDetCenter(unsigned int opdet, double const* xyz);
+
+    /// Whether the cache has been filled
+    bool Empty() const { return fChannelValid.empty(); }
+
+    /// Number of planes, as geo::GeometryCore::Nplanes()
+    unsigned int Nplanes() const { return fNplanes; }
+
+    /// Highest optical channel number, as geo::GeometryCore::MaxOpChannel()
+    unsigned int MaxOpChannel() const { return fChannelValid.size() - 1; }
+
+    /// Number of optical detectors
+    size_t NOpDets() const { return fOpDetCenters.size()/3; }
+
+    bool IsValidOpChannel(unsigned int channel) const
+      { return channel < fChannelValid.size() && fChannelValid[channel]; }
+
+    /// Center (x, y, z) of the optical detector of a channel
+    double const* Center(unsigned int channel) const
+      { return &fChannelCenters[3*channel]; }
+
+    /// Cryostat of the optical detector of a channel
+    unsigned int Cryostat(unsigned int channel) const
+      { return fChannelCryostats[channel]; }
+
+    /// Number of cryostats
+    unsigned int Ncryostats() const { return fNcryostats; }
+
+    /// Whether the channel center is inside a TPC
+    bool InTPC(unsigned int channel) const
+      { return fChannelInTPC[channel]; }
+
+    /// Wire nearest to the channel center on a plane of its TPC
+    /// (only meaningful if InTPC(channel))
+    unsigned int NearestWire(unsigned int channel, unsigned int plane) const
+      { return fNearestWires[channel*fNplanes + plane]; }
+
+    /// Center (x, y, z) of an optical detector
+    double const* OpDetCenter(unsigned int opdet) const
+      { return &fOpDetCenters[3*opdet]; }
+
+  private:
+
+    /// Reset for the geometry, with the optical detector centers filled
+    void ResetFromGeometry(geo::GeometryCore const& geom);
+
+    /// Looks up one channel; throws if its center is in no cryostat
+    void FillChannel(geo::GeometryCore const& geom, unsigned int channel);
+
+    unsigned int                fNplanes = 0;
+    unsigned int                fNcryostats = 0;
+    std::vector< bool >         fChannelValid;
+    std::vector< bool >         fChannelInTPC;
+    std::vector< unsigned int > fChannelCryostats;
+    std::vector< double >       fChannelCenters; ///< 3 per channel
+    std::vector< unsigned int > fNearestWires;   ///< Nplanes per channel
+    std::vector< double >       fOpDetCenters;   ///< 3 per optical detector
+
+  };
+
+} // End opdet namespace
+
+#endif
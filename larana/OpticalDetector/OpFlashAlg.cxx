@@ -15,6 +15,7 @@
 #include "TFile.h"
 #include "TH1.h"
 
+#include "cetlib_except/exception.h"
 #include "larcorealg/Geometry/OpDetGeo.h"
 #include "larcoreobj/SimpleTypesAndConstants/geo_types.h"
 #include "lardataalg/DetectorInfo/DetectorClocks.h"
@@ -22,9 +23,14 @@
 #include "lardataobj/RecoBase/OpFlash.h"
 #include "lardataobj/RecoBase/OpHit.h"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <numeric> // std::iota()
 
 namespace opdet{
@@ -66,81 +72,220 @@ namespace opdet{
                       detinfo::DetectorClocks const&     ts,
                       float const&                       TrigCoinc) {
 
-    // Initial size for accumulators - will be automatically extended if needed
-    int initialsize = 6400;
-
-    // These are the accumulators which will hold broad-binned light yields
-    std::vector< double > Binned1(initialsize);
-    std::vector< double > Binned2(initialsize);
+    // Only the channels with hits are looked up; callers running on many
+    // events should hold a cache filled once per run instead
+    std::vector< unsigned int > Channels;
+    Channels.reserve(HitVector.size());
+    for (auto const& hit : HitVector) Channels.push_back(hit.OpChannel());
+
+    OpDetGeometryCache geometry;
+    geometry.Update(geom, Channels);
+
+    RunFlashFinder(HitVector,
+                   FlashVector,
+                   AssocList,
+                   BinWidth,
+                   geometry,
+                   FlashThreshold,
+                   WidthTolerance,
+                   ts,
+                   TrigCoinc);
 
-    // These will keep track of which pulses put activity in each bin
-    std::vector< std::vector< int > > Contributors1(initialsize);
-    std::vector< std::vector< int > > Contributors2(initialsize);
+  }
 
-    // These will keep track of where we have met the flash condition
-    // (in order to prevent second pointless loop)
-    std::vector< int > FlashesInAccumulator1;
-    std::vector< int > FlashesInAccumulator2;
+  //----------------------------------------------------------------------------
+  void RunFlashFinder(std::vector< recob::OpHit > const& HitVector,
+                      std::vector< recob::OpFlash >&     FlashVector,
+                      std::vector< std::vector< int > >& AssocList,
+                      double const&                      BinWidth,
+                      OpDetGeometryCache const&          geometry,
+                      float const&                       FlashThreshold,
+                      float const&                       WidthTolerance,
+                      detinfo::DetectorClocks const&     ts,
+                      float const&                       TrigCoinc) {
 
     double minTime = std::numeric_limits< float >::max();
     for (auto const& hit : HitVector)
       if (hit.PeakTime() < minTime) minTime = hit.PeakTime();
 
-    for (auto const& hit : HitVector) {
+    std::vector< std::vector< int > > RefinedHitsPerFlash;
+    FindFlashes(HitVector,
+                FlashVector,
+                RefinedHitsPerFlash,
+                minTime,
+                BinWidth,
+                geometry,
+                FlashThreshold,
+                WidthTolerance,
+                ts,
+                TrigCoinc);
 
-      double peakTime = hit.PeakTime();
+    RemoveLateLight(FlashVector,
+                    RefinedHitsPerFlash);
 
-      unsigned int AccumIndex1 = GetAccumIndex(peakTime,
-                                               minTime,
-                                               BinWidth,
-                                               0.0);
+    //checkOnBeamFlash(FlashVector);
 
-      unsigned int AccumIndex2 = GetAccumIndex(peakTime,
-                                               minTime,
-                                               BinWidth,
-                                               BinWidth/2.0);
+    // Finally, write the association list.
+    // back_inserter tacks the result onto the end of AssocList
+    for (auto& HitIndicesThisFlash : RefinedHitsPerFlash)
+      AssocList.push_back(HitIndicesThisFlash);
 
-      // Extend accumulators if needed (2 always larger than 1)
-      if (AccumIndex2 >= Binned1.size()) {
-        std::cout << "Extending vectors to " << AccumIndex2*1.2 << std::endl;
-        Binned1.resize(AccumIndex2*1.2);
-        Binned2.resize(AccumIndex2*1.2);
-        Contributors1.resize(AccumIndex2*1.2);
-        Contributors2.resize(AccumIndex2*1.2);
-      }
+  } // End RunFlashFinder
 
-      size_t const hitIndex = &hit - &HitVector[0];
+  //----------------------------------------------------------------------------
+  void RunFlashFinderPartitioned(std::vector< recob::OpHit > const&
+                                                                  HitVector,
+                                 std::vector< recob::OpFlash >& FlashVector,
+                                 std::vector< std::vector< int > >&
+                                                                  AssocList,
+                                 double const&                  BinWidth,
+                                 OpDetGeometryCache const&      geometry,
+                                 float const&                   FlashThreshold,
+                                 float const&                   WidthTolerance,
+                                 detinfo::DetectorClocks const& ts,
+                                 float const&                   TrigCoinc,
+                                 std::vector< unsigned int > const&
+                                                          ChannelPartitions) {
+
+    unsigned int NPartitions = 0;
+    for (unsigned int const Partition : ChannelPartitions)
+      NPartitions = std::max(NPartitions, Partition + 1);
+
+    std::vector< unsigned int > HitPartitions(HitVector.size());
+    std::vector< size_t >       PartitionSizes(NPartitions, 0);
+    for (size_t i = 0; i != HitVector.size(); ++i) {
+      int const Channel = HitVector[i].OpChannel();
+      if (Channel < 0 ||
+          static_cast< size_t >(Channel) >= ChannelPartitions.size())
+        throw cet::exception("OpFlashAlg")
+          << "Optical channel " << Channel << " has no flash-finding "
+          << "partition\n";
+      HitPartitions[i] = ChannelPartitions[Channel];
+      ++PartitionSizes[HitPartitions[i]];
+    }
 
-      FillAccumulator(AccumIndex1,
-                      hitIndex,
-                      hit.PE(),
-                      FlashThreshold,
-                      Binned1,
-                      Contributors1,
-                      FlashesInAccumulator1);
+    // All hits in one partition: nothing to split or merge
+    size_t const NUsed = NPartitions -
+      std::count(PartitionSizes.begin(), PartitionSizes.end(), 0);
+    if (NUsed == 1) {
+      std::vector< recob::OpFlash >     Flashes;
+      std::vector< std::vector< int > > Assoc;
+      RunFlashFinder(HitVector, Flashes, Assoc, BinWidth, geometry,
+                     FlashThreshold, WidthTolerance, ts, TrigCoinc);
+      std::move(Flashes.begin(), Flashes.end(),
+                std::back_inserter(FlashVector));
+      std::move(Assoc.begin(), Assoc.end(), std::back_inserter(AssocList));
+      return;
+    }
 
-      FillAccumulator(AccumIndex2,
-                      hitIndex,
-                      hit.PE(),
-                      FlashThreshold,
-                      Binned2,
-                      Contributors2,
-                      FlashesInAccumulator2);
+    // Hits of each partition, keeping their order in HitVector
+    std::vector< std::vector< recob::OpHit > > PartitionHits(NPartitions);
+    std::vector< std::vector< int > >          PartitionHitIndices(NPartitions);
+    for (unsigned int p = 0; p != NPartitions; ++p) {
+      PartitionHits[p].reserve(PartitionSizes[p]);
+      PartitionHitIndices[p].reserve(PartitionSizes[p]);
+    }
+    for (size_t i = 0; i != HitVector.size(); ++i) {
+      PartitionHits[HitPartitions[i]].push_back(HitVector[i]);
+      PartitionHitIndices[HitPartitions[i]].push_back(i);
+    }
 
-    } // End loop over hits
+    std::vector< std::vector< recob::OpFlash > >
+                                          PartitionFlashes(NPartitions);
+    std::vector< std::vector< std::vector< int > > >
+                                          PartitionAssoc(NPartitions);
+
+    // Partitions share nothing but the read-only geometry and clocks
+    tbb::parallel_for(tbb::blocked_range< unsigned int >(0, NPartitions, 1),
+      [&](tbb::blocked_range< unsigned int > const& range) {
+        for (unsigned int p = range.begin(); p != range.end(); ++p) {
+          if (PartitionHits[p].empty()) continue;
+          RunFlashFinder(PartitionHits[p],
+                         PartitionFlashes[p],
+                         PartitionAssoc[p],
+                         BinWidth,
+                         geometry,
+                         FlashThreshold,
+                         WidthTolerance,
+                         ts,
+                         TrigCoinc);
+        }
+      });
+
+    // Each partition comes out in time order, so a stable sort of the
+    // partitions one after the other merges them independently of the
+    // scheduling
+    std::vector< std::pair< unsigned int, size_t > > Merged;
+    for (unsigned int p = 0; p != NPartitions; ++p)
+      for (size_t f = 0; f != PartitionFlashes[p].size(); ++f)
+        Merged.emplace_back(p, f);
+
+    std::stable_sort(Merged.begin(), Merged.end(),
+      [&](std::pair< unsigned int, size_t > const& a,
+          std::pair< unsigned int, size_t > const& b)
+      { return PartitionFlashes[a.first][a.second].Time() <
+               PartitionFlashes[b.first][b.second].Time(); });
+
+    FlashVector.reserve(FlashVector.size() + Merged.size());
+    AssocList.reserve(AssocList.size() + Merged.size());
+    for (auto const& Flash : Merged) {
+      FlashVector.push_back(
+        std::move(PartitionFlashes[Flash.first][Flash.second]));
+      AssocList.emplace_back();
+      for (int const HitIndex : PartitionAssoc[Flash.first][Flash.second])
+        AssocList.back().push_back(
+          PartitionHitIndices[Flash.first][HitIndex]);
+    }
+
+  } // End RunFlashFinderPartitioned
+
+  //----------------------------------------------------------------------------
+  void FindFlashes(std::vector< recob::OpHit > const& HitVector,
+                   std::vector< recob::OpFlash >&     FlashVector,
+                   std::vector< std::vector< int > >& RefinedHitsPerFlash,
+                   double const&                      MinTime,
+                   double const&                      BinWidth,
+                   OpDetGeometryCache const&          geometry,
+                   float const&                       FlashThreshold,
+                   float const&                       WidthTolerance,
+                   detinfo::DetectorClocks const&     ts,
+                   float const&                       TrigCoinc) {
+
+    // Hits sorted by time; bins of both accumulators are runs in this order
+    std::vector< int > HitsByTime(HitVector.size());
+    std::iota(HitsByTime.begin(), HitsByTime.end(), 0);
+    std::sort(HitsByTime.begin(), HitsByTime.end(),
+              [&](int i, int j){ return HitVector[i].PeakTime() <
+                                        HitVector[j].PeakTime(); });
+
+    // These are the accumulators which will hold broad-binned light yields,
+    // the pulses that put activity in each bin, and where we have met the
+    // flash condition (in order to prevent second pointless loop)
+    SparseAccumulator Accumulator1;
+    SparseAccumulator Accumulator2;
+
+    FillSparseAccumulator(HitVector,
+                          HitsByTime,
+                          MinTime,
+                          BinWidth,
+                          0.0,
+                          FlashThreshold,
+                          Accumulator1);
+
+    FillSparseAccumulator(HitVector,
+                          HitsByTime,
+                          MinTime,
+                          BinWidth,
+                          BinWidth/2.0,
+                          FlashThreshold,
+                          Accumulator2);
 
     // Now start to create flashes.
     // First, need vector to keep track of which hits belong to which flashes
     std::vector< std::vector< int > > HitsPerFlash;
 
-    //if (Frame == 1) writeHistogram(Binned1);
-
-    AssignHitsToFlash(FlashesInAccumulator1,
-                      FlashesInAccumulator2,
-                      Binned1,
-                      Binned2,
-                      Contributors1,
-                      Contributors2,
+    AssignHitsToFlash(Accumulator1,
+                      Accumulator2,
                       HitVector,
                       HitsPerFlash,
                       FlashThreshold);
@@ -148,7 +293,7 @@ namespace opdet{
     // Now we do the fine grained part.
     // Subdivide each flash into sub-flashes with overlaps within hit widths
     // (assumed wider than photon travel time)
-    std::vector< std::vector< int > > RefinedHitsPerFlash;
+    size_t const BeginFlash = RefinedHitsPerFlash.size();
     for (auto const& HitsThisFlash : HitsPerFlash)
       RefineHitsInFlash(HitsThisFlash,
                         HitVector,
@@ -158,25 +303,16 @@ namespace opdet{
 
     // Now we have all our hits assigned to a flash.
     // Make the recob::OpFlash objects
-    for (auto const& HitsPerFlashVec : RefinedHitsPerFlash)
-      ConstructFlash(HitsPerFlashVec,
+    for (size_t iFlash = BeginFlash; iFlash != RefinedHitsPerFlash.size();
+         ++iFlash)
+      ConstructFlash(RefinedHitsPerFlash[iFlash],
                      HitVector,
                      FlashVector,
-                     geom,
+                     geometry,
                      ts,
                      TrigCoinc);
 
-    RemoveLateLight(FlashVector,
-                    RefinedHitsPerFlash);
-
-    //checkOnBeamFlash(FlashVector);
-
-    // Finally, write the association list.
-    // back_inserter tacks the result onto the end of AssocList
-    for (auto& HitIndicesThisFlash : RefinedHitsPerFlash)
-      AssocList.push_back(HitIndicesThisFlash);
-
-  } // End RunFlashFinder
+  } // End FindFlashes
 
   //----------------------------------------------------------------------------
   unsigned int GetAccumIndex(double const& PeakTime,
@@ -208,6 +344,66 @@ namespace opdet{
 
   }
 
+  //----------------------------------------------------------------------------
+  void FillSparseAccumulator(std::vector< recob::OpHit > const& HitVector,
+                             std::vector< int > const&          HitsByTime,
+                             double const&                      MinTime,
+                             double const&                      BinWidth,
+                             double const&                      BinOffset,
+                             float const&                       FlashThreshold,
+                             SparseAccumulator&                 Accumulator) {
+
+    Accumulator.Bins.clear();
+    Accumulator.Offsets.assign(1, 0);
+    Accumulator.HitIndices.assign(HitsByTime.begin(), HitsByTime.end());
+    Accumulator.BinnedPE.clear();
+    Accumulator.FlashRows.clear();
+
+    // Rows where the flash threshold was met, with the hit that met it
+    std::vector< std::pair< int, int > > Crossings;
+
+    size_t const NHits = HitsByTime.size();
+    size_t RowBegin = 0;
+
+    while (RowBegin < NHits) {
+
+      // The index is monotonic in time, so a bin is a run of sorted hits
+      unsigned int const Bin =
+        GetAccumIndex(HitVector[HitsByTime[RowBegin]].PeakTime(),
+                      MinTime, BinWidth, BinOffset);
+      size_t RowEnd = RowBegin + 1;
+      while (RowEnd < NHits &&
+             GetAccumIndex(HitVector[HitsByTime[RowEnd]].PeakTime(),
+                           MinTime, BinWidth, BinOffset) == Bin)
+        ++RowEnd;
+
+      auto const RowHits = Accumulator.HitIndices.begin();
+      std::sort(RowHits + RowBegin, RowHits + RowEnd);
+
+      // Sum in hit order, flagging the crossing as FillAccumulator does
+      int const Row = Accumulator.Bins.size();
+      double Binned = 0;
+      for (size_t i = RowBegin; i != RowEnd; ++i) {
+        double const PE = HitVector[Accumulator.HitIndices[i]].PE();
+        Binned += PE;
+        if (Binned >= FlashThreshold && (Binned - PE) < FlashThreshold)
+          Crossings.emplace_back(Accumulator.HitIndices[i], Row);
+      }
+
+      Accumulator.Bins.push_back(Bin);
+      Accumulator.Offsets.push_back(RowEnd);
+      Accumulator.BinnedPE.push_back(Binned);
+
+      RowBegin = RowEnd;
+    }
+
+    // Flash rows in the order the threshold was met going through the hits
+    std::sort(Crossings.begin(), Crossings.end());
+    for (auto const& Crossing : Crossings)
+      Accumulator.FlashRows.push_back(Crossing.second);
+
+  }
+
   //----------------------------------------------------------------------------
   void FillFlashesBySizeMap(std::vector< int > const&     FlashesInAccumulator,
                             std::vector< double > const&  BinnedPE,
@@ -260,6 +456,59 @@ namespace opdet{
 
   }
 
+  //----------------------------------------------------------------------------
+  void AssignHitsToFlash(SparseAccumulator const&           Accumulator1,
+                         SparseAccumulator const&           Accumulator2,
+                         std::vector< recob::OpHit > const& HitVector,
+                         std::vector< std::vector< int > >& HitsPerFlash,
+                         float const&                       FlashThreshold) {
+
+    // Sort all the flashes found by size. The structure is:
+    // FlashesBySize[flash size][accumulator_num] = [flash_row1, flash_row2...]
+    std::map< double,
+      std::map< int, std::vector< int > >,
+        std::greater< double > > FlashesBySize;
+
+    FillFlashesBySizeMap(Accumulator1.FlashRows,
+                         Accumulator1.BinnedPE,
+                         1,
+                         FlashesBySize);
+    FillFlashesBySizeMap(Accumulator2.FlashRows,
+                         Accumulator2.BinnedPE,
+                         2,
+                         FlashesBySize);
+
+    // This keeps track of which hits are claimed by which flash
+    std::vector< int > HitClaimedByFlash(HitVector.size(), -1);
+
+    // Walk from largest to smallest, claiming hits
+    std::vector< int > HitsThisFlash;
+    for (auto const& itFlash : FlashesBySize)
+      for (auto const& itAcc : itFlash.second) {
+
+        SparseAccumulator const& Accumulator =
+          (itAcc.first == 1) ? Accumulator1 : Accumulator2;
+
+        for (auto const& Row : itAcc.second) {
+
+          HitsThisFlash.clear();
+          for (size_t i = Accumulator.Offsets[Row];
+               i != Accumulator.Offsets[Row + 1]; ++i)
+            if (HitClaimedByFlash[Accumulator.HitIndices[i]] == -1)
+              HitsThisFlash.push_back(Accumulator.HitIndices[i]);
+
+          ClaimHits(HitVector,
+                    HitsThisFlash,
+                    FlashThreshold,
+                    HitsPerFlash,
+                    HitClaimedByFlash);
+
+        }
+
+      }
+
+  } // End AssignHitsToFlash
+
   //----------------------------------------------------------------------------
   void AssignHitsToFlash(std::vector< int > const&        FlashesInAccumulator1,
                          std::vector< int > const&        FlashesInAccumulator2,
@@ -360,6 +609,43 @@ namespace opdet{
 
   } // End FindSeedHit
 
+  namespace {
+
+    //--------------------------------------------------------------------------
+    // Whether the hit is within the width tolerance of the flash time window
+    bool HitInFlashWindow(recob::OpHit const& currentHit,
+                          double const&       WidthTolerance,
+                          double const&       FlashMaxTime,
+                          double const&       FlashMinTime) {
+
+      double HitTime    = currentHit.PeakTime();
+      double HitWidth   = 0.5*currentHit.Width();
+      double FlashTime  = 0.5*(FlashMaxTime + FlashMinTime);
+      double FlashWidth = 0.5*(FlashMaxTime - FlashMinTime);
+
+      return !(std::abs(HitTime - FlashTime) >
+               WidthTolerance*(HitWidth + FlashWidth));
+
+    }
+
+    //--------------------------------------------------------------------------
+    // Widens the flash time window to include the hit, and adds its light
+    void ExtendFlash(recob::OpHit const& currentHit,
+                     double&             PEAccumulated,
+                     double&             FlashMaxTime,
+                     double&             FlashMinTime) {
+
+      double HitTime  = currentHit.PeakTime();
+      double HitWidth = 0.5*currentHit.Width();
+
+      FlashMaxTime    = std::max(FlashMaxTime, HitTime + HitWidth);
+      FlashMinTime    = std::min(FlashMinTime, HitTime - HitWidth);
+      PEAccumulated  += currentHit.PE();
+
+    }
+
+  } // End anonymous namespace
+
   //----------------------------------------------------------------------------
   void AddHitToFlash(int const&           HitID,
                      std::vector< bool >& HitsUsed,
@@ -372,18 +658,13 @@ namespace opdet{
 
     if (HitsUsed.at(HitID)) return;
 
-    double HitTime    = currentHit.PeakTime();
-    double HitWidth   = 0.5*currentHit.Width();
-    double FlashTime  = 0.5*(FlashMaxTime + FlashMinTime);
-    double FlashWidth = 0.5*(FlashMaxTime - FlashMinTime);
-
-    if (std::abs(HitTime - FlashTime) >
-        WidthTolerance*(HitWidth + FlashWidth)) return;
+    if (!HitInFlashWindow(currentHit,
+                          WidthTolerance,
+                          FlashMaxTime,
+                          FlashMinTime)) return;
 
     HitsThisRefinedFlash.push_back(HitID);
-    FlashMaxTime    = std::max(FlashMaxTime, HitTime + HitWidth);
-    FlashMinTime    = std::min(FlashMinTime, HitTime - HitWidth);
-    PEAccumulated  += currentHit.PE();
+    ExtendFlash(currentHit, PEAccumulated, FlashMaxTime, FlashMinTime);
     HitsUsed[HitID] = true;
 
   } // End AddHitToFlash
@@ -420,12 +701,6 @@ namespace opdet{
                          float const&                       WidthTolerance,
                          float const&                       FlashThreshold) {
 
-    // Sort the hits by their size using map
-    // HitsBySize[HitSize] = [hit1, hit2 ...]
-    std::map< double, std::vector< int >, std::greater< double > > HitsBySize;
-    for (auto const& HitID : HitsThisFlash)
-      HitsBySize[HitVector.at(HitID).PE()].push_back(HitID);
-
     // Heres what we do:
     //  1.Start with the biggest remaining hit
     //  2.Look for any within one width of this hit
@@ -433,53 +708,135 @@ namespace opdet{
     //  4.Collect again
     //  5.Repeat until no new hits collected
     //  6.Remove these hits from consideration and repeat
+    //
+    // Each collecting pass tests the hits by decreasing size against the
+    // bounds of the moment, as the outcome depends on that order. A pass only
+    // visits the hits close enough in time to pass the width test, looked up
+    // in the hits sorted by time, so it does not go through the whole flash.
+
+    size_t const NHits = HitsThisFlash.size();
+    if (NHits == 0) return;
+
+    // Hits by size, biggest first (equal sizes in input order);
+    // hits are identified by their position here (rank)
+    std::vector< int > HitsBySize(HitsThisFlash);
+    std::stable_sort(HitsBySize.begin(), HitsBySize.end(),
+                     [&](int i, int j){ return HitVector.at(i).PE() >
+                                               HitVector.at(j).PE(); });
+
+    // Ranks sorted by time, with their times
+    std::vector< size_t > RanksByTime(NHits);
+    std::iota(RanksByTime.begin(), RanksByTime.end(), 0);
+    std::sort(RanksByTime.begin(), RanksByTime.end(),
+              [&](size_t i, size_t j){
+                return HitVector[HitsBySize[i]].PeakTime() <
+                       HitVector[HitsBySize[j]].PeakTime(); });
+
+    std::vector< double > Times(NHits);
+    double MaxHalfWidth = -std::numeric_limits< double >::max();
+    for (size_t i = 0; i != NHits; ++i) {
+      recob::OpHit const& hit = HitVector[HitsBySize[RanksByTime[i]]];
+      Times[i]     = hit.PeakTime();
+      MaxHalfWidth = std::max(MaxHalfWidth, 0.5*hit.Width());
+    }
 
-    std::vector< bool > HitsUsed(HitVector.size(),false);
-    double PEAccumulated, FlashMaxTime, FlashMinTime;
-    std::vector< int > HitsThisRefinedFlash;
+    // Range of RanksByTime which may pass the width test of the flash window
+    // (with some slack for rounding: the test itself decides)
+    auto TimeRange = [&](double FlashMaxTime, double FlashMinTime) {
+      if (!(WidthTolerance >= 0)) return std::make_pair(size_t(0), NHits);
+      double const FlashTime  = 0.5*(FlashMaxTime + FlashMinTime);
+      double const FlashWidth = 0.5*(FlashMaxTime - FlashMinTime);
+      double const Reach  = WidthTolerance*std::max(0., FlashWidth + MaxHalfWidth);
+      double const Margin = 1e-9*(std::abs(FlashTime) + Reach);
+      return std::make_pair(
+        static_cast< size_t >(std::lower_bound(Times.begin(), Times.end(),
+                                FlashTime - Reach - Margin) - Times.begin()),
+        static_cast< size_t >(std::upper_bound(Times.begin(), Times.end(),
+                                FlashTime + Reach + Margin) - Times.begin()));
+    };
+
+    // Flash-local scratch
+    std::vector< bool >   HitsUsed(NHits, false);
+    std::vector< size_t > RanksThisRefinedFlash;
+    std::vector< size_t > Candidates; // Min-heap of ranks for this pass
+    std::vector< int >    HitsThisRefinedFlash;
+    std::greater< size_t > const later;
+
+    size_t Seed = 0;
 
     while (true) {
 
-      HitsThisRefinedFlash.clear();
-      PEAccumulated = 0; FlashMaxTime = 0; FlashMinTime = 0;
-
-      FindSeedHit(HitsBySize,
-                  HitsUsed,
-                  HitVector,
-                  HitsThisRefinedFlash,
-                  PEAccumulated,
-                  FlashMaxTime,
-                  FlashMinTime);
-
-      if (HitsThisRefinedFlash.size() == 0) return;
-
-      // Start this at zero to do the while at least once
-      size_t NHitsThisRefinedFlash = 0;
-
-      // If size of HitsThisRefinedFlash is same size,
-      // that means we're not adding anymore
-      while (NHitsThisRefinedFlash < HitsThisRefinedFlash.size()) {
-        NHitsThisRefinedFlash = HitsThisRefinedFlash.size();
-
-        for (auto const& itHit : HitsBySize)
-          for (auto const& HitID : itHit.second)
-            AddHitToFlash(HitID,
-                          HitsUsed,
-                          HitVector.at(HitID),
-                          WidthTolerance,
-                          HitsThisRefinedFlash,
-                          PEAccumulated,
-                          FlashMaxTime,
-                          FlashMinTime);
+      // Biggest hit not used yet
+      while (Seed < NHits && HitsUsed[Seed]) ++Seed;
+      if (Seed == NHits) return;
+
+      recob::OpHit const& seedHit = HitVector.at(HitsBySize[Seed]);
+      double PEAccumulated = seedHit.PE();
+      double FlashMaxTime  = seedHit.PeakTime() + 0.5*seedHit.Width();
+      double FlashMinTime  = seedHit.PeakTime() - 0.5*seedHit.Width();
+
+      HitsThisRefinedFlash.assign(1, HitsBySize[Seed]);
+      RanksThisRefinedFlash.assign(1, Seed);
+      HitsUsed[Seed] = true;
+
+      // Passes until no hit is added
+      bool Added = true;
+      while (Added) {
+        Added = false;
+
+        auto Range = TimeRange(FlashMaxTime, FlashMinTime);
+        Candidates.clear();
+        for (size_t i = Range.first; i < Range.second; ++i)
+          if (!HitsUsed[RanksByTime[i]]) Candidates.push_back(RanksByTime[i]);
+        std::make_heap(Candidates.begin(), Candidates.end(), later);
+
+        while (!Candidates.empty()) {
+
+          std::pop_heap(Candidates.begin(), Candidates.end(), later);
+          size_t const Rank = Candidates.back();
+          Candidates.pop_back();
+
+          recob::OpHit const& currentHit = HitVector[HitsBySize[Rank]];
+
+          if (!HitInFlashWindow(currentHit,
+                                WidthTolerance,
+                                FlashMaxTime,
+                                FlashMinTime)) continue;
+
+          HitsThisRefinedFlash.push_back(HitsBySize[Rank]);
+          RanksThisRefinedFlash.push_back(Rank);
+          ExtendFlash(currentHit, PEAccumulated, FlashMaxTime, FlashMinTime);
+          HitsUsed[Rank] = true;
+          Added = true;
+
+          // Smaller hits which the wider window brings within reach
+          // are still to be tested in this pass
+          auto NewRange = TimeRange(FlashMaxTime, FlashMinTime);
+          for (size_t i = NewRange.first; i < Range.first; ++i)
+            if (RanksByTime[i] > Rank && !HitsUsed[RanksByTime[i]]) {
+              Candidates.push_back(RanksByTime[i]);
+              std::push_heap(Candidates.begin(), Candidates.end(), later);
+            }
+          for (size_t i = Range.second; i < NewRange.second; ++i)
+            if (RanksByTime[i] > Rank && !HitsUsed[RanksByTime[i]]) {
+              Candidates.push_back(RanksByTime[i]);
+              std::push_heap(Candidates.begin(), Candidates.end(), later);
+            }
+          Range.first  = std::min(Range.first,  NewRange.first);
+          Range.second = std::max(Range.second, NewRange.second);
+        }
       }
 
       // We did our collecting, now check if the flash is
       // still good and push back
-      CheckAndStoreFlash(RefinedHitsPerFlash,
-                         HitsThisRefinedFlash,
-                         PEAccumulated,
-                         FlashThreshold,
-                         HitsUsed);
+      if (PEAccumulated >= FlashThreshold) {
+        RefinedHitsPerFlash.push_back(HitsThisRefinedFlash);
+        continue;
+      }
+
+      // Release all the hits but the seed (allow possible reuse)
+      for (size_t i = 1; i < RanksThisRefinedFlash.size(); ++i)
+        HitsUsed[RanksThisRefinedFlash[i]] = false;
 
     } // End while there are hits left
 
@@ -544,6 +901,40 @@ namespace opdet{
 
   }
 
+  //----------------------------------------------------------------------------
+  void GetHitGeometryInfo(recob::OpHit const&        currentHit,
+                          OpDetGeometryCache const&  geometry,
+                          std::vector< double >&     sumw,
+                          std::vector< double >&     sumw2,
+                          double&                    sumy,
+                          double&                    sumy2,
+                          double&                    sumz,
+                          double&                    sumz2) {
+
+    unsigned int const channel = currentHit.OpChannel();
+    double const* xyz = geometry.Center(channel);
+    double PEThisHit = currentHit.PE();
+
+    // if the point does not fall into any TPC,
+    // it does not contribute to the average wire position
+    if (geometry.InTPC(channel)) {
+      for (size_t p = 0; p != geometry.Nplanes(); ++p) {
+        unsigned int w = geometry.NearestWire(channel, p);
+        if (w == OpDetGeometryCache::InvalidWire)
+          throw cet::exception("OpFlashAlg")
+            << "No wire of plane " << p
+            << " is close to optical channel " << channel << "\n";
+        sumw.at(p)  += PEThisHit*w;
+        sumw2.at(p) += PEThisHit*w*w;
+      }
+    } // if we found the TPC
+    sumy  += PEThisHit*xyz[1];
+    sumy2 += PEThisHit*xyz[1]*xyz[1];
+    sumz  += PEThisHit*xyz[2];
+    sumz2 += PEThisHit*xyz[2]*xyz[2];
+
+  }
+
   //----------------------------------------------------------------------------
   double CalculateWidth(double const& sum,
                         double const& sum_squared,
@@ -555,12 +946,14 @@ namespace opdet{
   }
 
   //----------------------------------------------------------------------------
-  void ConstructFlash(std::vector< int > const&          HitsPerFlashVec,
-                      std::vector< recob::OpHit > const& HitVector,
-                      std::vector< recob::OpFlash >&     FlashVector,
-                      geo::GeometryCore const&           geom,
-                      detinfo::DetectorClocks const&     ts,
-                      float const&                       TrigCoinc) {
+  // Geometry is either geo::GeometryCore or OpDetGeometryCache
+  template < typename Geometry >
+  void ConstructFlashImpl(std::vector< int > const&          HitsPerFlashVec,
+                          std::vector< recob::OpHit > const& HitVector,
+                          std::vector< recob::OpFlash >&     FlashVector,
+                          Geometry const&                    geom,
+                          detinfo::DetectorClocks const&     ts,
+                          float const&                       TrigCoinc) {
 
     double MaxTime = -std::numeric_limits<double>::max();
     double MinTime = std::numeric_limits<double>::max();
@@ -647,6 +1040,32 @@ namespace opdet{
 
   }
 
+  //----------------------------------------------------------------------------
+  void ConstructFlash(std::vector< int > const&          HitsPerFlashVec,
+                      std::vector< recob::OpHit > const& HitVector,
+                      std::vector< recob::OpFlash >&     FlashVector,
+                      geo::GeometryCore const&           geom,
+                      detinfo::DetectorClocks const&     ts,
+                      float const&                       TrigCoinc) {
+
+    ConstructFlashImpl(HitsPerFlashVec, HitVector, FlashVector,
+                       geom, ts, TrigCoinc);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void ConstructFlash(std::vector< int > const&          HitsPerFlashVec,
+                      std::vector< recob::OpHit > const& HitVector,
+                      std::vector< recob::OpFlash >&     FlashVector,
+                      OpDetGeometryCache const&          geometry,
+                      detinfo::DetectorClocks const&     ts,
+                      float const&                       TrigCoinc) {
+
+    ConstructFlashImpl(HitsPerFlashVec, HitVector, FlashVector,
+                       geometry, ts, TrigCoinc);
+
+  }
+
   //----------------------------------------------------------------------------
   double GetLikelihoodLateLight(double const& iPE,
                                 double const& iTime,
@@ -665,22 +1084,63 @@ namespace opdet{
 
   }
 
+  //----------------------------------------------------------------------------
+  double MinLateLightHypothesis(double const& PE) {
+
+    // (PE - H)/sqrt(H) < 3 for H > h^2, where h^2 + 3h - PE = 0
+    if (!(PE > 0)) return 0;
+    double h = 0.5*(std::sqrt(9 + 4*PE) - 3);
+    return h*h;
+
+  }
+
   //----------------------------------------------------------------------------
   void MarkFlashesForRemoval(std::vector< recob::OpFlash > const& FlashVector,
                              size_t const&                        BeginFlash,
                              std::vector< bool >&            MarkedForRemoval) {
 
-    for (size_t iFlash = BeginFlash; iFlash != FlashVector.size(); ++iFlash) {
+    size_t NFlashes = FlashVector.size();
+    if (BeginFlash >= NFlashes) return;
+
+    // Flashes are sorted by time, so the hypothesis of flash i for the
+    // later flashes is at most iPE*MaxWidth/iWidth*exp(-(jTime - iTime)/1.6),
+    // and they all pass the 3 sigma cut once that is below MinHypothesis:
+    // there is no need to look further than a time window
+    std::vector< double > MaxWidth(NFlashes + 1, 0.0);
+    std::vector< double > MinHypothesis(NFlashes + 1,
+                                 std::numeric_limits< double >::infinity());
+    for (size_t jFlash = NFlashes; jFlash-- != BeginFlash; ) {
+      double jWidth = FlashVector[jFlash].TimeWidth();
+      double jHypothesis =
+        MinLateLightHypothesis(FlashVector[jFlash].TotalPE());
+      MaxWidth[jFlash] = MaxWidth[jFlash + 1];
+      if (jWidth > MaxWidth[jFlash]) MaxWidth[jFlash] = jWidth;
+      MinHypothesis[jFlash] = std::min(MinHypothesis[jFlash + 1], jHypothesis);
+    }
+
+    for (size_t iFlash = BeginFlash; iFlash != NFlashes; ++iFlash) {
 
       double iTime  = FlashVector.at(iFlash).Time();
       double iPE    = FlashVector.at(iFlash).TotalPE();
       double iWidth = FlashVector.at(iFlash).TimeWidth();
 
-      for (size_t jFlash = iFlash + 1; jFlash != FlashVector.size(); ++jFlash) {
+      // The hypothesis of a flash without width is never a number
+      if (iWidth == 0 || iWidth != iWidth) continue;
 
-        if (MarkedForRemoval.at(jFlash - BeginFlash)) continue;
+      // Factor 2 is a margin for rounding in GetLikelihoodLateLight;
+      // a NaN ratio (zero widths or hypotheses) never ends the window
+      double Ratio = 2*iPE*MaxWidth[iFlash + 1]/
+        (iWidth*MinHypothesis[iFlash + 1]);
+      double EndTime = std::numeric_limits< double >::infinity();
+      if (Ratio == Ratio) EndTime = iTime + 1.6*std::log(Ratio);
+
+      for (size_t jFlash = iFlash + 1; jFlash != NFlashes; ++jFlash) {
 
         double jTime  = FlashVector.at(jFlash).Time();
+        if (jTime > EndTime) break;
+
+        if (MarkedForRemoval.at(jFlash - BeginFlash)) continue;
+
         double jPE    = FlashVector.at(jFlash).TotalPE();
         double jWidth = FlashVector.at(jFlash).TimeWidth();
 
@@ -704,11 +1164,25 @@ namespace opdet{
                                 std::vector< std::vector< int > >&
                                                        RefinedHitsPerFlash) {
 
-    for (int iFlash = MarkedForRemoval.size() - 1; iFlash != -1; --iFlash)
-      if (MarkedForRemoval.at(iFlash)) {
-        RefinedHitsPerFlash.erase(RefinedHitsPerFlash.begin() + iFlash);
-        FlashVector.erase(FlashVector.begin() + BeginFlash + iFlash);
+    // Keep the order of the surviving flashes, moving each once
+    size_t NKept = 0;
+    for (size_t iFlash = 0; iFlash != MarkedForRemoval.size(); ++iFlash) {
+      if (MarkedForRemoval[iFlash]) continue;
+      if (NKept != iFlash) {
+        RefinedHitsPerFlash.at(NKept) =
+          std::move(RefinedHitsPerFlash.at(iFlash));
+        FlashVector.at(BeginFlash + NKept) =
+          std::move(FlashVector.at(BeginFlash + iFlash));
       }
+      ++NKept;
+    }
+
+    RefinedHitsPerFlash.erase(RefinedHitsPerFlash.begin() + NKept,
+                              RefinedHitsPerFlash.begin() +
+                                MarkedForRemoval.size());
+    FlashVector.erase(FlashVector.begin() + BeginFlash + NKept,
+                      FlashVector.begin() + BeginFlash +
+                        MarkedForRemoval.size());
 
   }
 
@@ -726,12 +1200,9 @@ namespace opdet{
     auto sort_order = sort_permutation(FlashVector, BeginFlash,
                                             sort_flash_by_time);
 
-    // Sort the RefinedHitsPerFlash in the same way as tail end of FlashVector
+    // Sort the RefinedHitsPerFlash and the tail end of FlashVector
     apply_permutation(RefinedHitsPerFlash, sort_order);
-
-    std::sort(FlashVector.begin() + BeginFlash,
-              FlashVector.end(),
-              sort_flash_by_time);
+    apply_permutation(FlashVector, sort_order, BeginFlash);
 
     MarkFlashesForRemoval(FlashVector,
                           BeginFlash,
@@ -760,12 +1231,13 @@ namespace opdet{
 
   //----------------------------------------------------------------------------
   template < typename T >
-    void apply_permutation(std::vector< T >& vec, std::vector< int > const& p) {
+    void apply_permutation(std::vector< T >& vec, std::vector< int > const& p,
+                           int offset) {
 
-    std::vector< T > sorted_vec(p.size());
-    std::transform(p.begin(), p.end(), sorted_vec.begin(),
-                   [&](int i){ return vec[i]; });
-    vec = sorted_vec;
+    std::vector< T > sorted_vec;
+    sorted_vec.reserve(p.size());
+    for (int i : p) sorted_vec.push_back(std::move(vec[i + offset]));
+    std::move(sorted_vec.begin(), sorted_vec.end(), vec.begin() + offset);
 
   }
 
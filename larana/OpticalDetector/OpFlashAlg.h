@@ -12,6 +12,7 @@
 #include "lardataobj/RecoBase/OpHit.h"
 #include "lardataobj/RecoBase/OpFlash.h"
 #include "larcorealg/Geometry/GeometryCore.h"
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
 namespace detinfo { class DetectorClocks; }
 
 #include <functional>
@@ -20,6 +21,19 @@ namespace detinfo { class DetectorClocks; }
 
 namespace opdet{
 
+  /// Hits of one flash-finding accumulator by occupied time bin, in
+  /// compressed sparse rows: the hits of row r (bin Bins[r]) are
+  /// HitIndices[Offsets[r]] to HitIndices[Offsets[r + 1] - 1], in hit order
+  struct SparseAccumulator {
+    std::vector< unsigned int > Bins;       ///< Occupied bins, increasing
+    std::vector< size_t >       Offsets;    ///< Bins.size() + 1 entries
+    std::vector< int >          HitIndices; ///< Hits of all rows
+    std::vector< double >       BinnedPE;   ///< Light of each row
+    std::vector< int >          FlashRows;  ///< Rows that met the flash
+                                            ///< threshold, in hit order
+  };
+
+  /// Looks up the geometry of the channels with hits on every call
   void RunFlashFinder(std::vector< recob::OpHit > const&,
                       std::vector< recob::OpFlash >&,
                       std::vector< std::vector< int > >&,
@@ -30,6 +44,49 @@ namespace opdet{
                       detinfo::DetectorClocks const&,
                       float const&);
 
+  /// Same as above, with the channel geometry looked up once (e.g. per run)
+  /// instead of for every event
+  void RunFlashFinder(std::vector< recob::OpHit > const&,
+                      std::vector< recob::OpFlash >&,
+                      std::vector< std::vector< int > >&,
+                      double const&,
+                      OpDetGeometryCache const&,
+                      float const&,
+                      float const&,
+                      detinfo::DetectorClocks const&,
+                      float const&);
+
+  /// Same as above, with the hits split by the partition of their channel
+  /// (ChannelPartitions[channel], e.g. OpDetGeometryCache::Cryostat()) and
+  /// the partitions flash-found independently and concurrently. The flashes
+  /// of all partitions are merged by time (ties in partition order), with
+  /// associations to the hit indices in the full HitVector.
+  void RunFlashFinderPartitioned(std::vector< recob::OpHit > const&,
+                                 std::vector< recob::OpFlash >&,
+                                 std::vector< std::vector< int > >&,
+                                 double const&,
+                                 OpDetGeometryCache const&,
+                                 float const&,
+                                 float const&,
+                                 detinfo::DetectorClocks const&,
+                                 float const&,
+                                 std::vector< unsigned int > const&
+                                                          ChannelPartitions);
+
+  /// Flashes of the hits with accumulator bins starting at MinTime, before
+  /// late-light removal: each flash is appended to FlashVector, and the
+  /// indices of its hits to RefinedHitsPerFlash
+  void FindFlashes(std::vector< recob::OpHit > const& HitVector,
+                   std::vector< recob::OpFlash >&     FlashVector,
+                   std::vector< std::vector< int > >& RefinedHitsPerFlash,
+                   double const&                      MinTime,
+                   double const&                      BinWidth,
+                   OpDetGeometryCache const&          geometry,
+                   float const&                       FlashThreshold,
+                   float const&                       WidthTolerance,
+                   detinfo::DetectorClocks const&     ts,
+                   float const&                       TrigCoinc);
+
   unsigned int GetAccumIndex(double const& PeakTime,
                              double const& MinTime,
                              double const& BinWidth,
@@ -43,6 +100,24 @@ namespace opdet{
                        std::vector< std::vector< int > >& Contributors,
                        std::vector< int >&        FlashesInAccumulator);
 
+  /// Fills the accumulator with offset BinOffset from the hits sorted by
+  /// peak time (bins are contiguous in that order); same bins, light and
+  /// flash rows as FillAccumulator over the hits in order
+  void FillSparseAccumulator(std::vector< recob::OpHit > const& HitVector,
+                             std::vector< int > const&          HitsByTime,
+                             double const&                      MinTime,
+                             double const&                      BinWidth,
+                             double const&                      BinOffset,
+                             float const&                       FlashThreshold,
+                             SparseAccumulator&                 Accumulator);
+
+  /// Same as below, with the sparse accumulators
+  void AssignHitsToFlash(SparseAccumulator const&,
+                         SparseAccumulator const&,
+                         std::vector< recob::OpHit > const&,
+                         std::vector< std::vector< int > >&,
+                         float const&);
+
   void AssignHitsToFlash(std::vector< int > const&,
                          std::vector< int > const&,
                          std::vector< double > const&,
@@ -111,6 +186,13 @@ namespace opdet{
                       detinfo::DetectorClocks const&     ts,
                       float const&                       TrigCoinc);
 
+  void ConstructFlash(std::vector< int > const&          HitsPerFlashVec,
+                      std::vector< recob::OpHit > const& HitVector,
+                      std::vector< recob::OpFlash >&     FlashVector,
+                      OpDetGeometryCache const&          geometry,
+                      detinfo::DetectorClocks const&     ts,
+                      float const&                       TrigCoinc);
+
   void AddHitContribution(recob::OpHit const&    currentHit,
                           double&                MaxTime,
                           double&                MinTime,
@@ -129,6 +211,15 @@ namespace opdet{
                           double&                  sumz,
                           double&                  sumz2);
 
+  void GetHitGeometryInfo(recob::OpHit const&        currentHit,
+                          OpDetGeometryCache const&  geometry,
+                          std::vector< double >&     sumw,
+                          std::vector< double >&     sumw2,
+                          double&                    sumy,
+                          double&                    sumy2,
+                          double&                    sumz,
+                          double&                    sumz2);
+
   void RemoveLateLight(std::vector< recob::OpFlash >&,
                        std::vector< std::vector< int > >&);
 
@@ -139,6 +230,10 @@ namespace opdet{
                                 double const& jTime,
                                 double const& jWidth);
 
+  /// Smallest hypothesis from GetLikelihoodLateLight that makes a flash of
+  /// this PE late light (below 3 sigma)
+  double MinLateLightHypothesis(double const& PE);
+
   void MarkFlashesForRemoval(std::vector< recob::OpFlash > const& FlashVector,
                              size_t const&                        BeginFlash,
                              std::vector< bool >&            MarkedForRemoval);
@@ -154,8 +249,10 @@ namespace opdet{
     std::vector< int > sort_permutation(std::vector< T > const& vec,
                                         int offset, Compare compare);
 
+  /// Reorders vec[offset], vec[offset + 1]... as p (moving the elements)
   template < typename T >
-    void apply_permutation(std::vector< T >& vec, std::vector< int > const& p);
+    void apply_permutation(std::vector< T >& vec, std::vector< int > const& p,
+                           int offset = 0);
 
 } // End opdet namespace
 
@@ -20,16 +20,19 @@
 #include "art/Framework/Core/EDProducer.h"
 #include "art/Framework/Core/ModuleMacros.h"
 #include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Run.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "art/Framework/Principal/Handle.h"
 #include "canvas/Persistency/Common/Ptr.h"
 #include "canvas/Persistency/Common/PtrVector.h"
+#include "cetlib_except/exception.h"
 
 // ROOT includes
 
 // C++ Includes
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace opdet {
 
@@ -42,6 +45,9 @@ namespace opdet {
     // The producer routine, called once per event.
     void produce(art::Event&);
 
+    // Refreshes the optical channel geometry, called once per run.
+    void beginRun(art::Run&);
+
   private:
 
     // The parameters we'll read from the .fcl file.
@@ -52,6 +58,15 @@ namespace opdet {
     Float_t  fWidthTolerance;
     Double_t fTrigCoinc;
 
+    // Flash-finding partitions: "none", "cryostat" or "channels"
+    std::string fPartitionBy;
+    std::vector< std::vector< unsigned int > > fChannelGroups;
+
+    OpDetGeometryCache fGeometryCache;
+
+    // Partition of each optical channel, filled at begin of run
+    std::vector< unsigned int > fChannelPartitions;
+
   };
 
 }
@@ -76,11 +91,64 @@ namespace opdet {
     fWidthTolerance = pset.get< float > ("WidthTolerance");
     fTrigCoinc      = pset.get< double >("TrigCoinc");
 
+    fPartitionBy    = pset.get< std::string >("PartitionBy", "none");
+    fChannelGroups  = pset.get< std::vector< std::vector< unsigned int > > >
+                                                        ("ChannelGroups", {});
+
+    if (fPartitionBy != "none" && fPartitionBy != "cryostat" &&
+        fPartitionBy != "channels")
+      throw cet::exception("OpFlashFinder")
+        << "PartitionBy must be \"none\", \"cryostat\" or \"channels\", not \""
+        << fPartitionBy << "\"\n";
+
     produces< std::vector< recob::OpFlash > >();
     produces< art::Assns< recob::OpFlash, recob::OpHit > >();
 
   }
 
+  //----------------------------------------------------------------------------
+  void OpFlashFinder::beginRun(art::Run&)
+  {
+
+    fGeometryCache.Update(*lar::providerFrom< geo::Geometry >());
+
+    fChannelPartitions.clear();
+    if (fPartitionBy == "none") return;
+
+    unsigned int const NChannels = fGeometryCache.MaxOpChannel() + 1;
+
+    if (fPartitionBy == "cryostat") {
+      fChannelPartitions.resize(NChannels);
+      for (unsigned int channel = 0; channel != NChannels; ++channel)
+        fChannelPartitions[channel] = fGeometryCache.Cryostat(channel);
+      return;
+    }
+
+    // Every valid channel must be in exactly one group
+    unsigned int const NoGroup = fChannelGroups.size();
+    fChannelPartitions.assign(NChannels, NoGroup);
+    for (unsigned int group = 0; group != fChannelGroups.size(); ++group)
+      for (unsigned int channel : fChannelGroups[group]) {
+        if (channel >= NChannels)
+          throw cet::exception("OpFlashFinder")
+            << "ChannelGroups: optical channel " << channel
+            << " does not exist\n";
+        if (fChannelPartitions[channel] != NoGroup)
+          throw cet::exception("OpFlashFinder")
+            << "ChannelGroups: optical channel " << channel
+            << " is in more than one group\n";
+        fChannelPartitions[channel] = group;
+      }
+
+    for (unsigned int channel = 0; channel != NChannels; ++channel)
+      if (fGeometryCache.IsValidOpChannel(channel) &&
+          fChannelPartitions[channel] == NoGroup)
+        throw cet::exception("OpFlashFinder")
+          << "ChannelGroups: optical channel " << channel
+          << " is in no group\n";
+
+  }
+
   //----------------------------------------------------------------------------
   void OpFlashFinder::produce(art::Event& evt)
   {
@@ -95,8 +163,6 @@ namespace opdet {
     // at the end of processing
     std::vector< std::vector< int > > assocList;
 
-    auto const& geometry(*lar::providerFrom< geo::Geometry >());
-
     auto const& detectorClocks
        (*lar::providerFrom< detinfo::DetectorClocksService >());
 
@@ -104,15 +170,27 @@ namespace opdet {
     art::Handle< std::vector< recob::OpHit > > opHitHandle;
     evt.getByLabel(fInputModule, opHitHandle);
 
-    RunFlashFinder(*opHitHandle,
-                   *flashPtr,
-                   assocList,
-                   fBinWidth,
-                   geometry,
-                   fFlashThreshold,
-                   fWidthTolerance,
-                   detectorClocks,
-                   fTrigCoinc);
+    if (fChannelPartitions.empty())
+      RunFlashFinder(*opHitHandle,
+                     *flashPtr,
+                     assocList,
+                     fBinWidth,
+                     fGeometryCache,
+                     fFlashThreshold,
+                     fWidthTolerance,
+                     detectorClocks,
+                     fTrigCoinc);
+    else
+      RunFlashFinderPartitioned(*opHitHandle,
+                                *flashPtr,
+                                assocList,
+                                fBinWidth,
+                                fGeometryCache,
+                                fFlashThreshold,
+                                fWidthTolerance,
+                                detectorClocks,
+                                fTrigCoinc,
+                                fChannelPartitions);
 
     // Make the associations which we noted we need
     for (size_t i = 0; i != assocList.size(); ++i)
@@ -6,10 +6,11 @@
 
 #include "AlgoCFD.h"
 #include "UtilFunc.h"
+#include "WaveformKernels.h"
+#include "OpticalRecoException.h"
 
 #include "fhiclcpp/ParameterSet.h"
 
-#include <unordered_map>
 
 namespace pmtana{
 
@@ -30,6 +31,8 @@ namespace pmtana{
     _F = pset.get<float>("Fraction");
     _D = pset.get<int>  ("Delay");
 
+    if(_D < 0) throw OpticalRecoException("CFD Delay must not be negative");
+
     //_number_presample = pset.get<int>   ("BaselinePreSample");
     _peak_thresh      = pset.get<double>("PeakThresh");
     _start_thresh     = pset.get<double>("StartThresh");
@@ -49,45 +52,53 @@ namespace pmtana{
   //***************************************************************
   bool AlgoCFD::RecoPulse(const pmtana::Waveform_t& wf,
 			  const pmtana::PedestalMean_t& mean_v,
-			  const pmtana::PedestalSigma_t& sigma_v)
+			  const pmtana::PedestalSigma_t& sigma_v,
+			  pmtana::pulse_param_array& pulses) const
   //***************************************************************
   {
+    RecoScratch scratch;
+    return RecoPulseWithScratch(wf, mean_v, sigma_v, pulses, scratch);
+  }
 
-    Reset();
-
-    std::vector<double> cfd; cfd.reserve(wf.size());
-
-    // follow cfd procedure: invert waveform, multiply by constant fraction
-    // add to delayed waveform.
-    for (unsigned int k = 0; k < wf.size(); ++k)  {
+  //***************************************************************
+  bool AlgoCFD::RecoPulseWithScratch(const pmtana::Waveform_t& wf,
+				     const pmtana::PedestalMean_t& mean_v,
+				     const pmtana::PedestalSigma_t& sigma_v,
+				     pmtana::pulse_param_array& pulses,
+				     pmtana::RecoScratch& scratch) const
+  //***************************************************************
+  {
 
-      auto delayed = -1.0 * _F *  ( (float) wf.at(k) - mean_v.at(k) );
+    pulses.clear();
 
-      if ((int)k < _D)
+    pulse_param pulse;
 
-	cfd.push_back( delayed );
+    // Caller-owned buffers, reused from one waveform to the next
+    auto& cfd       = scratch.cfd;
+    auto& crossings = scratch.crossings;
 
-      else
+    cfd.resize(wf.size());
 
-	cfd.push_back(delayed +  ( (float) wf.at(k - _D) - mean_v.at(k) ) );
-    }
+    // follow cfd procedure: invert waveform, multiply by constant fraction
+    // add to delayed waveform.
+    ConstantFraction(wf.data(), mean_v.data(), wf.size(), -1.0 * _F, _D, cfd.data());
 
 
     // Get the zero point crossings, how can I tell which are meaningful?
     // go to each crossing, see if waveform is above pedestal (high above pedestal)
 
-    auto crossings = LinearZeroPointX(cfd);
+    LinearZeroPointX(cfd, crossings);
 
     // lambda criteria to determine if inside pulse
 
     auto in_peak = [&wf,&sigma_v,&mean_v](int i, float thresh) -> bool
-      { return wf.at(i) > sigma_v.at(i) * thresh +  mean_v.at(i); };
+      { return wf[i] > sigma_v[i] * thresh +  mean_v[i]; };
 
     // loop over CFD crossings
     for(const auto& cross : crossings) {
 
       if( in_peak( cross.first, _peak_thresh) ) {
-	_pulse.reset_param();
+	pulse.reset_param();
 
 	int i = cross.first;
 
@@ -96,22 +107,26 @@ namespace pmtana{
 	  i--;
 	  if ( i < 0 ) { i = 0; break; }
 	}
-	_pulse.t_start = i;
+	pulse.t_start = i;
+
+	// Crossings are visited in increasing order and t_start never decreases with them:
+	// a crossing giving the same t_start as the previous pulse is the same pulse
+	if( !pulses.empty() && pulses.back().t_start == pulse.t_start ) continue;
 
 	//walk a little further backwards to see if we can get 5 low RMS
 	// while ( !in_peak(i,_start_thresh) ) {
-	//   if (i == ( _pulse.t_start - _number_presample ) ) break;
+	//   if (i == ( pulse.t_start - _number_presample ) ) break;
 	//   i--;
 	//   if ( i < 0 ) { i = 0; break; }
 	// }
 
 	// auto before_mean = double{0.0};
 
-	// if ( _pulse.t_start - i > 0 )
+	// if ( pulse.t_start - i > 0 )
 	//   before_mean = std::accumulate(std::begin(mean_v) + i,
-	// 				std::begin(mean_v) + _pulse.t_start, 0.0) / ((double) (_pulse.t_start - i));
+	// 				std::begin(mean_v) + pulse.t_start, 0.0) / ((double) (pulse.t_start - i));
 
-	i = _pulse.t_start + 1;
+	i = pulse.t_start + 1;
 
 	//forwards
 	while ( in_peak(i,_end_thresh) ) {
@@ -119,20 +134,23 @@ namespace pmtana{
 	  if ( i > (int)(wf.size()) - 1 ) { i = (int)(wf.size()) - 1; break; }
 	}
 
-	_pulse.t_end = i;
+	pulse.t_end = i;
+
+	// Likewise t_end never decreases: keep only the first (widest) pulse ending here
+	if( !pulses.empty() && pulses.back().t_end == pulse.t_end ) continue;
 
 	// //walk a little further forwards to see if we can get 5 low RMS
 	// while ( !in_peak(i,_end_thresh) ) {
-	//   if (i == ( _pulse.t_end + _number_presample ) ) break;
+	//   if (i == ( pulse.t_end + _number_presample ) ) break;
 	//   i++;
 	//   if ( i > wf.size() - 1 ) { i = wf.size() - 1; break; }
 	// }
 
 	// auto after_mean = double{0.0};
 
-	// if( i - _pulse.t_end > 0)
-	//   after_mean = std::accumulate(std::begin(mean_v) + _pulse.t_end + 1,
-	// 			       std::begin(mean_v) + i + 1, 0.0) / ((double) (i - _pulse.t_end));
+	// if( i - pulse.t_end > 0)
+	//   after_mean = std::accumulate(std::begin(mean_v) + pulse.t_end + 1,
+	// 			       std::begin(mean_v) + i + 1, 0.0) / ((double) (i - pulse.t_end));
 
 
 	//how to decide before or after? set before for now
@@ -147,26 +165,26 @@ namespace pmtana{
 
 	//x
 
-	auto start_ped = mean_v.at(_pulse.t_start);
-	auto end_ped   = mean_v.at(_pulse.t_end);
+	auto start_ped = mean_v[pulse.t_start];
+	auto end_ped   = mean_v[pulse.t_end];
 
 	//just take the "smaller one"
-	_pulse.ped_mean = start_ped <= end_ped ? start_ped : end_ped;
+	pulse.ped_mean = start_ped <= end_ped ? start_ped : end_ped;
 
-	if(wf.size() < 50) _pulse.ped_mean = mean_v.front(); //is COSMIC DISCRIMINATOR
+	if(wf.size() < 50) pulse.ped_mean = mean_v.front(); //is COSMIC DISCRIMINATOR
 
-	auto it = std::max_element(std::begin(wf) + _pulse.t_start, std::begin(wf) + _pulse.t_end);
+	size_t max_index = pulse.t_start + ArgMax(wf.data() + (size_t)pulse.t_start, pulse.t_end - pulse.t_start);
 
-	_pulse.t_max      =  it - std::begin(wf);
-	_pulse.peak       = *it - _pulse.ped_mean;
-	_pulse.t_cfdcross =  cross.second;
+	pulse.t_max      =  max_index;
+	pulse.peak       =  wf[max_index] - pulse.ped_mean;
+	pulse.t_cfdcross =  cross.second;
 
-	for(auto k = _pulse.t_start; k <= _pulse.t_end; ++k) {
-	  auto a = wf.at(k) - _pulse.ped_mean;
-	  if ( a > 0 ) _pulse.area += a;
+	for(auto k = pulse.t_start; k <= pulse.t_end; ++k) {
+	  auto a = wf[k] - pulse.ped_mean;
+	  if ( a > 0 ) pulse.area += a;
 	}
 
-	_pulse_v.push_back(_pulse);
+	pulses.push_back(pulse);
       }
 
     }
@@ -175,54 +193,8 @@ namespace pmtana{
     // Very close in time pulses have multiple CFD
     // crossing points. Should we check that pulses now have
     // some multiplicity? No lets just delete them.
-
-    auto pulses_copy = _pulse_v;
-    _pulse_v.clear();
-
-    std::unordered_map<unsigned,pulse_param> delta;
-
-    //unsigned width = 0;
-    for( const auto& p : pulses_copy )  {
-
-      if ( delta.count(p.t_start) )  {
-    	if (  (p.t_end - p.t_start) > (delta[p.t_start].t_end - delta[p.t_start].t_start) )
-    	  delta[p.t_start] = p;
-    	else
-    	  continue;
-      }
-      else {
-    	delta[p.t_start] = p;
-      }
-    }
-
-    for(const auto & p : delta)
-      _pulse_v.push_back(p.second);
-
-
-    //do the same now ensure t_final's are all unique
-    //width = 0;
-
-    pulses_copy.clear();
-    pulses_copy = _pulse_v;
-
-    _pulse_v.clear();
-    delta.clear();
-
-    for( const auto& p : pulses_copy )  {
-
-      if ( delta.count(p.t_end) )  {
-    	if (  (p.t_end - p.t_start) > (delta[p.t_end].t_end - delta[p.t_end].t_start) )
-    	  delta[p.t_end] = p;
-    	else
-    	  continue;
-      }
-      else {
-    	delta[p.t_end] = p;
-      }
-    }
-
-    for(const auto & p : delta)
-      _pulse_v.push_back(p.second);
+    // (done above: pulses sharing t_start or t_end with the previous one are skipped,
+    //  which keeps the widest pulse of each group, ordered by t_start)
 
     //there should be no overlapping pulses now...
 
@@ -231,15 +203,16 @@ namespace pmtana{
   }
 
   // currently returns ALL zero point crossings, we really just want ones associated with peak...
-  const std::map<unsigned,double> AlgoCFD::LinearZeroPointX(const std::vector<double>& trace) {
+  void AlgoCFD::LinearZeroPointX(const std::vector<double>& trace,
+				 std::vector<std::pair<unsigned,double> >& crossings) const {
 
-    std::map<unsigned,double> crossing;
+    crossings.clear();
 
     //step through the trace and find where slope is POSITIVE across zero
-    for ( unsigned i = 0; i < trace.size() - 1; ++i) {
+    for ( unsigned i = 0; i + 1 < trace.size(); ++i) {
 
-      auto si = ::pmtana::sign(trace.at(i));
-      auto sf = ::pmtana::sign(trace.at(i+1));
+      auto si = ::pmtana::sign(trace[i]);
+      auto sf = ::pmtana::sign(trace[i+1]);
 
       if ( si == sf ) //no sign flip, no zero cross
 	continue;
@@ -249,13 +222,10 @@ namespace pmtana{
 
       //calculate the crossing X based on linear interpolation bt two pts
 
-      crossing[i] = (double) i - trace.at(i) * ( 1.0 / ( trace.at(i+1) - trace.at(i) ) );
+      crossings.emplace_back(i, (double) i - trace[i] * ( 1.0 / ( trace[i+1] - trace[i] ) ));
 
     }
 
-
-    return crossing;
-
   }
 
 
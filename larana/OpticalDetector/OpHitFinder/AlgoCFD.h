@@ -19,7 +19,6 @@
 #include "fhiclcpp/fwd.h"
 #include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
 
-#include <map>
 #include <string>
 #include <vector>
 
@@ -44,15 +43,27 @@ namespace pmtana
     /// Implementation of AlgoCFD::reset() method
     void Reset();
 
+    /// Peaks are samples minus the pedestal mean at the pulse edges
+    bool PeakWithinSampleSpread() const { return true; }
+
   protected:
 
     /// Implementation of AlgoCFD::reco() method
     bool RecoPulse(const pmtana::Waveform_t&,
 		   const pmtana::PedestalMean_t&,
-		   const pmtana::PedestalSigma_t&);
-
-
-    const std::map<unsigned,double> LinearZeroPointX(const std::vector<double>& trace);
+		   const pmtana::PedestalSigma_t&,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Same as above; the CFD signal and its crossings are kept in the scratch
+    bool RecoPulseWithScratch(const pmtana::Waveform_t&,
+			      const pmtana::PedestalMean_t&,
+			      const pmtana::PedestalSigma_t&,
+			      pmtana::pulse_param_array& pulses,
+			      pmtana::RecoScratch& scratch) const;
+
+    /// Fills the positive slope zero crossings of the trace (sample index, interpolated position), in increasing order
+    void LinearZeroPointX(const std::vector<double>& trace,
+			  std::vector<std::pair<unsigned,double> >& crossings) const;
 
   private:
     float _F;
@@ -0,0 +1,333 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  AlgoDeconvolution source
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "fhiclcpp/ParameterSet.h"
+#include "cetlib/search_path.h"
+
+#include "AlgoDeconvolution.h"
+#include "OpticalRecoException.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace pmtana{
+
+  //*********************************************************************
+  AlgoDeconvolution::AlgoDeconvolution(const fhicl::ParameterSet &pset,
+				       const std::string name)
+    : PMTPulseRecoBase(name)
+  //*********************************************************************
+  {
+    for(auto& plan : _plan_table) plan.store(nullptr);
+
+    _positive     = pset.get<bool>  ("PositivePolarity", true);
+    _noise_ratio  = pset.get<double>("NoiseRatio",       0.01);
+    _filter_sigma = pset.get<double>("FilterSigma",      1.0);
+    _start_thres  = pset.get<double>("StartThreshold",   0.2);
+    _end_thres    = pset.get<double>("EndThreshold",     0.05);
+
+    if(_noise_ratio <= 0)
+      throw OpticalRecoException("AlgoDeconvolution received invalid \"NoiseRatio\" parameter value!");
+    if(_filter_sigma < 0)
+      throw OpticalRecoException("AlgoDeconvolution received invalid \"FilterSigma\" parameter value!");
+    if(_start_thres <= _end_thres)
+      throw OpticalRecoException("AlgoDeconvolution \"StartThreshold\" must be larger than \"EndThreshold\"!");
+
+    auto spe = pset.get<std::vector<double> >("SPETemplate", std::vector<double>());
+
+    auto const file_name = pset.get<std::string>("SPETemplateFile", "");
+    if(!file_name.empty()) {
+      cet::search_path sp("FW_SEARCH_PATH");
+      std::string path;
+      if(!sp.find_file(file_name, path))
+	throw OpticalRecoException("AlgoDeconvolution cannot find SPE template file " + file_name);
+      std::ifstream file(path);
+      spe.clear();
+      double value;
+      while(file >> value) spe.push_back(value);
+    }
+
+    // The template may also be set later (SetSPETemplate)
+    if(!spe.empty()) SetSPETemplate(spe);
+  }
+
+  //***************************************************************
+  void AlgoDeconvolution::SetSPETemplate(const std::vector<double>& spe)
+  //***************************************************************
+  {
+    std::vector<double> shape(spe);
+
+    // Trailing zeros only lengthen the FFT
+    while(!shape.empty() && shape.back() == 0) shape.pop_back();
+
+    if(shape.empty())
+      throw OpticalRecoException("AlgoDeconvolution received an empty SPE template!");
+
+    if(std::accumulate(shape.begin(), shape.end(), 0.) <= 0 ||
+       *std::max_element(shape.begin(), shape.end()) <= 0)
+      throw OpticalRecoException("AlgoDeconvolution SPE template must be a positive pulse!");
+
+    std::lock_guard<std::mutex> lock(_plan_mutex);
+    _spe.swap(shape);
+    for(auto& plan : _plan_table) plan.store(nullptr);
+    for(auto& plan : _plans) plan.reset();
+  }
+
+  //***************************************************************
+  std::vector<double> AlgoDeconvolution::SPETemplate() const
+  //***************************************************************
+  {
+    std::lock_guard<std::mutex> lock(_plan_mutex);
+    return _spe;
+  }
+
+  //***************************************************************
+  bool AlgoDeconvolution::RecoPulse(const pmtana::Waveform_t& wf,
+				    const pmtana::PedestalMean_t& mean_v,
+				    const pmtana::PedestalSigma_t& sigma_v,
+				    pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    RecoScratch scratch;
+    return RecoPulseWithScratch(wf, mean_v, sigma_v, pulses, scratch);
+  }
+
+  //***************************************************************
+  bool AlgoDeconvolution::RecoPulseWithScratch(const pmtana::Waveform_t& wf,
+					       const pmtana::PedestalMean_t& mean_v,
+					       const pmtana::PedestalSigma_t& sigma_v,
+					       pmtana::pulse_param_array& pulses,
+					       pmtana::RecoScratch& scratch) const
+  //***************************************************************
+  {
+    pulses.clear();
+
+    if(wf.empty()) return true;
+
+    auto const& plan = Plan(wf.size());
+
+    const double sign = _positive ? 1. : -1.;
+
+    auto& buffer = scratch.fft_buffer;
+    buffer.assign(plan.size, 0.);
+    for(size_t i=0; i<wf.size(); ++i) buffer[i] = sign * ((double)(wf[i]) - mean_v[i]);
+
+    return FindPulses(buffer, plan, wf.size(), mean_v.front(), sigma_v.front(), pulses);
+  }
+
+  //***************************************************************
+  bool AlgoDeconvolution::RecoPulseConstantPedestal(const pmtana::Waveform_t& wf,
+						    double ped_mean,
+						    double ped_sigma,
+						    pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    RecoScratch scratch;
+    return RecoPulseConstantPedestalWithScratch(wf, ped_mean, ped_sigma, pulses, scratch);
+  }
+
+  //***************************************************************
+  bool AlgoDeconvolution::RecoPulseConstantPedestalWithScratch(const pmtana::Waveform_t& wf,
+							       double ped_mean,
+							       double ped_sigma,
+							       pmtana::pulse_param_array& pulses,
+							       pmtana::RecoScratch& scratch) const
+  //***************************************************************
+  {
+    pulses.clear();
+
+    if(wf.empty()) return true;
+
+    auto const& plan = Plan(wf.size());
+
+    const double sign = _positive ? 1. : -1.;
+
+    auto& buffer = scratch.fft_buffer;
+    buffer.assign(plan.size, 0.);
+    for(size_t i=0; i<wf.size(); ++i) buffer[i] = sign * ((double)(wf[i]) - ped_mean);
+
+    return FindPulses(buffer, plan, wf.size(), ped_mean, ped_sigma, pulses);
+  }
+
+  //***************************************************************
+  const AlgoDeconvolution::FilterPlan& AlgoDeconvolution::Plan(size_t nsample) const
+  //***************************************************************
+  {
+    if(_spe.empty())
+      throw OpticalRecoException("AlgoDeconvolution has no SPE template!");
+
+    // Zero padding by the template length keeps late pulses from wrapping around
+    size_t log2size = 1;
+    while(((size_t)1 << log2size) < nsample + _spe.size()) ++log2size;
+
+    // A plan, once published, never changes: only building one takes the lock
+    const FilterPlan* plan = _plan_table[log2size].load(std::memory_order_acquire);
+    if(plan) return *plan;
+
+    std::lock_guard<std::mutex> lock(_plan_mutex);
+
+    auto& owned = _plans[log2size];
+    if(!owned) {
+      owned = MakePlan((size_t)1 << log2size);
+      _plan_table[log2size].store(owned.get(), std::memory_order_release);
+    }
+
+    return *owned;
+  }
+
+  //***************************************************************
+  std::unique_ptr<const AlgoDeconvolution::FilterPlan>
+  AlgoDeconvolution::MakePlan(size_t size) const
+  //***************************************************************
+  {
+    auto plan = std::make_unique<FilterPlan>();
+
+    plan->size = size;
+    plan->spe_area = std::accumulate(_spe.begin(), _spe.end(), 0.);
+    plan->spe_peak = *std::max_element(_spe.begin(), _spe.end());
+
+    plan->bitrev.resize(size);
+    size_t nbits = 0;
+    while(((size_t)1 << nbits) < size) ++nbits;
+    for(size_t i=0; i<size; ++i) {
+      size_t r = 0;
+      for(size_t b=0; b<nbits; ++b) if(i & ((size_t)1 << b)) r |= (size_t)1 << (nbits - 1 - b);
+      plan->bitrev[i] = r;
+    }
+
+    plan->twiddle.resize(size/2);
+    for(size_t k=0; k<size/2; ++k)
+      plan->twiddle[k] = std::polar(1., -2. * M_PI * k / size);
+
+    // Wiener filter conj(H) / (|H|^2 + noise_ratio * max|H|^2), times a Gaussian low pass
+    std::vector<Complex_t> response(size);
+    std::copy(_spe.begin(), _spe.end(), response.begin());
+    FFT(*plan, response, false);
+
+    double max_power = 0;
+    for(auto const& h : response) max_power = std::max(max_power, std::norm(h));
+
+    const double noise_power = _noise_ratio * max_power;
+
+    plan->kernel.resize(size);
+    for(size_t k=0; k<size; ++k) {
+      const double omega = 2. * M_PI * std::min(k, size - k) / size;
+      const double smooth = std::exp(-0.5 * omega * omega * _filter_sigma * _filter_sigma);
+      plan->kernel[k] = std::conj(response[k]) * smooth / (std::norm(response[k]) + noise_power);
+    }
+
+    return plan;
+  }
+
+  //***************************************************************
+  void AlgoDeconvolution::FFT(const FilterPlan& plan,
+			      std::vector<Complex_t>& data,
+			      bool inverse)
+  //***************************************************************
+  {
+    const size_t size = plan.size;
+
+    for(size_t i=0; i<size; ++i)
+      if(i < plan.bitrev[i]) std::swap(data[i], data[plan.bitrev[i]]);
+
+    for(size_t len=2; len<=size; len <<= 1) {
+
+      const size_t half = len / 2;
+      const size_t step = size / len;
+
+      for(size_t begin=0; begin<size; begin += len) {
+
+	for(size_t j=0; j<half; ++j) {
+
+	  const Complex_t w = inverse ? std::conj(plan.twiddle[j*step]) : plan.twiddle[j*step];
+	  const Complex_t u = data[begin+j];
+	  const Complex_t v = data[begin+j+half] * w;
+
+	  data[begin+j]      = u + v;
+	  data[begin+j+half] = u - v;
+	}
+      }
+    }
+
+    if(inverse) for(auto& x : data) x /= (double)size;
+  }
+
+  //***************************************************************
+  bool AlgoDeconvolution::FindPulses(std::vector<Complex_t>& buffer,
+				     const FilterPlan& plan,
+				     size_t nsample,
+				     double ped_mean,
+				     double ped_sigma,
+				     pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    FFT(plan, buffer, false);
+    for(size_t k=0; k<plan.size; ++k) buffer[k] *= plan.kernel[k];
+    FFT(plan, buffer, true);
+
+    bool fire = false;
+    double npe = 0;
+    double max_value = 0;
+    pulse_param pulse;
+
+    for(size_t index=0; index<nsample; ++index) {
+
+      const double value = buffer[index].real();
+
+      if(!fire && value >= _start_thres) {
+
+	// Found a new pulse
+
+	fire = true;
+	npe = 0;
+	max_value = value;
+
+	pulse.ped_mean  = ped_mean;
+	pulse.ped_sigma = ped_sigma;
+	pulse.t_start   = index;
+	pulse.t_max     = index;
+      }
+
+      if(fire && value < _end_thres) {
+
+	// Found the end of a pulse
+
+	fire = false;
+
+	pulse.t_end = index - 1;
+	pulse.area  = npe * plan.spe_area;
+	pulse.peak  = npe * plan.spe_peak;
+
+	pulses.push_back(pulse);
+
+	pulse.reset_param();
+      }
+
+      if(fire) {
+
+	npe += value;
+
+	if(value > max_value) { max_value = value; pulse.t_max = index; }
+      }
+    }
+
+    if(fire) {
+
+      // Take care of a pulse that did not finish within the readout window
+
+      pulse.t_end = nsample - 1;
+      pulse.area  = npe * plan.spe_area;
+      pulse.peak  = npe * plan.spe_peak;
+
+      pulses.push_back(pulse);
+    }
+
+    return true;
+  }
+
+}
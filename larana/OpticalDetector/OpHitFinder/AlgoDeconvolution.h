@@ -0,0 +1,142 @@
+/**
+ * \file AlgoDeconvolution.h
+ *
+ * \ingroup PulseReco
+ *
+ * \brief Class definition file of AlgoDeconvolution
+ */
+
+/** \addtogroup PulseReco
+
+@{*/
+
+#ifndef larana_OPTICALDETECTOR_ALGODECONVOLUTION_H
+#define larana_OPTICALDETECTOR_ALGODECONVOLUTION_H
+
+#include "PMTPulseRecoBase.h"
+#include "fhiclcpp/fwd.h"
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
+
+#include <array>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pmtana
+{
+
+  /**
+   \class AlgoDeconvolution
+   Deconvolves the baseline-subtracted waveform with the single photoelectron (SPE) response
+   using a Wiener filter, optionally smoothed by a Gaussian, and finds pulses with a start/end
+   threshold on the deconvolved signal, which is in photoelectrons per tick. Overlapping pulses
+   which a threshold on the raw waveform would merge are resolved as separate pulses.
+
+   The SPE template is given in ADC counts per tick with the polarity of the pulses, either in
+   the configuration (SPETemplate), in a text file with one value per line (SPETemplateFile,
+   looked up in FW_SEARCH_PATH) or with SetSPETemplate. A pulse of N photoelectrons gets
+   area = N * (template integral) and peak = N * (template maximum), so the usual area or
+   amplitude SPE calibration gives the deconvolved photoelectron count. Pulse times refer to the
+   start of the template, i.e. the photon arrival tick.
+
+   FFT plans and filter kernels depend only on the FFT length (a power of 2). Each is computed the
+   first time a waveform needs it, then shared by all (possibly concurrent) calls, which find it
+   without locking. The zero-padded waveform goes in the caller's RecoScratch.
+  */
+  class AlgoDeconvolution : public PMTPulseRecoBase {
+
+  public:
+
+    /// Alternative ctor
+    AlgoDeconvolution(const fhicl::ParameterSet &pset,const std::string name="Deconvolution");
+
+    /// Replaces the SPE template (ADC per tick); cached filters are dropped. Not to be called
+    /// while waveforms are reconstructed.
+    void SetSPETemplate(const std::vector<double>& spe);
+
+    /// The SPE template in use
+    std::vector<double> SPETemplate() const;
+
+  protected:
+
+    /// Deconvolution of the waveform minus the per-sample pedestal
+    bool RecoPulse(const pmtana::Waveform_t&,
+		   const pmtana::PedestalMean_t&,
+		   const pmtana::PedestalSigma_t&,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Same as above, with the FFT buffer in the scratch
+    bool RecoPulseWithScratch(const pmtana::Waveform_t&,
+			      const pmtana::PedestalMean_t&,
+			      const pmtana::PedestalSigma_t&,
+			      pmtana::pulse_param_array& pulses,
+			      pmtana::RecoScratch& scratch) const;
+
+    /// Deconvolution of the waveform minus a constant pedestal, without pedestal arrays
+    bool RecoPulseConstantPedestal(const pmtana::Waveform_t&,
+				   double ped_mean,
+				   double ped_sigma,
+				   pmtana::pulse_param_array& pulses) const;
+
+    /// Same as above, with the FFT buffer in the scratch
+    bool RecoPulseConstantPedestalWithScratch(const pmtana::Waveform_t&,
+					      double ped_mean,
+					      double ped_sigma,
+					      pmtana::pulse_param_array& pulses,
+					      pmtana::RecoScratch& scratch) const;
+
+  private:
+
+    typedef std::complex<double> Complex_t;
+
+    /// FFT tables and filter kernel for one FFT length
+    struct FilterPlan {
+      size_t size = 0;                 ///< FFT length: power of 2 covering waveform and template
+      std::vector<size_t>    bitrev;   ///< Bit-reversal permutation
+      std::vector<Complex_t> twiddle;  ///< exp(-2 pi i k / size), k < size/2
+      std::vector<Complex_t> kernel;   ///< Wiener filter times the Gaussian smoothing
+      double spe_area = 0;             ///< Template integral
+      double spe_peak = 0;             ///< Template maximum
+    };
+
+    /// Plan for waveforms of nsample samples, computed on first use of its FFT length
+    const FilterPlan& Plan(size_t nsample) const;
+
+    /// Builds the plan of an FFT length for the current template
+    std::unique_ptr<const FilterPlan> MakePlan(size_t size) const;
+
+    /// In-place FFT (inverse includes the 1/size normalization)
+    static void FFT(const FilterPlan& plan, std::vector<Complex_t>& data, bool inverse);
+
+    /// Deconvolves buffer (baseline-subtracted waveform, zero padded) and finds pulses on it
+    bool FindPulses(std::vector<Complex_t>& buffer,
+		    const FilterPlan& plan,
+		    size_t nsample,
+		    double ped_mean,
+		    double ped_sigma,
+		    pmtana::pulse_param_array& pulses) const;
+
+    bool   _positive;        ///< Pulse polarity
+    double _noise_ratio;     ///< Wiener noise-to-signal power ratio, relative to the template peak power
+    double _filter_sigma;    ///< Gaussian smoothing width [ticks] (0: none)
+    double _start_thres;     ///< Deconvolved signal [PE/tick] starting a pulse
+    double _end_thres;       ///< Deconvolved signal [PE/tick] below which a pulse ends
+
+    static constexpr size_t kMaxLog2Size = 64; ///< Bound on log2 of the FFT length
+
+    std::vector<double> _spe;        ///< SPE template [ADC/tick]
+
+    mutable std::mutex _plan_mutex;  ///< Serializes building the plans
+    /// Plans by log2 of the FFT length, owned here; built under the mutex
+    mutable std::array<std::unique_ptr<const FilterPlan>, kMaxLog2Size> _plans;
+    /// The plans once built, read without locking
+    mutable std::array<std::atomic<const FilterPlan*>, kMaxLog2Size> _plan_table;
+  };
+
+}
+#endif
+
+/** @} */ // end of doxygen group
@@ -41,7 +41,7 @@ namespace pmtana{
   {
     if(!(_pulse_v.size()))
 
-      _pulse_v.push_back(_pulse);
+      _pulse_v.push_back(pulse_param());
 
     _pulse_v[0].reset_param();
 
@@ -50,38 +50,56 @@ namespace pmtana{
   //***************************************************************
   bool AlgoFixedWindow::RecoPulse(const Waveform_t& wf,
 				  const PedestalMean_t& mean_v,
-				  const PedestalSigma_t& sigma_v)
+				  const PedestalSigma_t& sigma_v,
+				  pulse_param_array& pulses) const
   //***************************************************************
   {
-    this->Reset();
+    return RecoPulseConstantPedestal(wf,
+				     mean_v.empty()  ? 0. : mean_v.front(),
+				     sigma_v.empty() ? 0. : sigma_v.front(),
+				     pulses);
+  }
+
+  //***************************************************************
+  bool AlgoFixedWindow::RecoPulseConstantPedestal(const Waveform_t& wf,
+						  double ped_mean,
+						  double ped_sigma,
+						  pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    pulses.clear();
+
+    pulses.push_back(pulse_param());
 
     if( _index_start >= wf.size() ) return true;
 
-    _pulse_v[0].t_start = (double)(_index_start);
+    auto& pulse = pulses[0];
+
+    pulse.t_start = (double)(_index_start);
 
-    _pulse_v[0].ped_mean  = mean_v.front();
+    pulse.ped_mean  = ped_mean;
 
-    _pulse_v[0].ped_sigma = sigma_v.front();
+    pulse.ped_sigma = ped_sigma;
 
     if(!_index_end)
 
-      _pulse_v[0].t_end = (double)(wf.size() - 1);
+      pulse.t_end = (double)(wf.size() - 1);
 
     else if(_index_end < wf.size())
 
-      _pulse_v[0].t_end = (double)_index_end;
+      pulse.t_end = (double)_index_end;
 
     else
 
-      _pulse_v[0].t_end = wf.size() - 1;
+      pulse.t_end = wf.size() - 1;
 
-    _pulse_v[0].t_max = PMTPulseRecoBase::Max(wf, _pulse_v[0].peak, _index_start, _pulse_v[0].t_end);
+    pulse.t_max = PMTPulseRecoBase::Max(wf, pulse.peak, _index_start, pulse.t_end);
 
-    _pulse_v[0].peak -= mean_v.front();
+    pulse.peak -= ped_mean;
 
-    PMTPulseRecoBase::Integral(wf, _pulse_v[0].area, _index_start, _pulse_v[0].t_end);
+    PMTPulseRecoBase::Integral(wf, pulse.area, _index_start, pulse.t_end);
 
-    _pulse_v[0].area = _pulse_v[0].area - ( _pulse_v[0].t_end - _pulse_v[0].t_start + 1) * mean_v.front();
+    pulse.area = pulse.area - ( pulse.t_end - pulse.t_start + 1) * ped_mean;
 
     return true;
 
@@ -31,6 +31,8 @@ namespace pmtana
    A typical usage is to set the beginning of the window to be 0 (= start of the waveform)
    and integrate over the time of interest. By default, the ending is set to index=0, in
    which case it uses the ending index of the input waveform (i.e. full integration).
+   It is not PeakWithinSampleSpread: it gives a pulse for every waveform, and the window
+   maximum is floored at 0 so the peak of a waveform below 0 is not bounded by the samples.
   */
   class AlgoFixedWindow : public PMTPulseRecoBase {
 
@@ -51,7 +53,14 @@ namespace pmtana
     /// Implementation of AlgoFixedWindow::reco() method
     bool RecoPulse(const pmtana::Waveform_t&,
 		   const pmtana::PedestalMean_t&,
-		   const pmtana::PedestalSigma_t&);
+		   const pmtana::PedestalSigma_t&,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Single-pass implementation for a constant pedestal (the array version uses the first entry only)
+    bool RecoPulseConstantPedestal(const pmtana::Waveform_t&,
+				   double ped_mean,
+				   double ped_sigma,
+				   pmtana::pulse_param_array& pulses) const;
 
     size_t _index_start; ///< index marker for the beginning of the pulse time window
     size_t _index_end;   ///< index marker for the end of pulse time window
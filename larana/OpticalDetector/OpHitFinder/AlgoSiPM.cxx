@@ -3,6 +3,7 @@
 //=======================
 
 #include "AlgoSiPM.h"
+#include "WaveformKernels.h"
 
 #include "fhiclcpp/ParameterSet.h"
 
@@ -35,26 +36,64 @@ namespace pmtana {
   //---------------------------------------------------------------------------
   bool AlgoSiPM::RecoPulse( const pmtana::Waveform_t& wf,
 			    const pmtana::PedestalMean_t& ped_mean,
-			    const pmtana::PedestalSigma_t& ped_rms )
+			    const pmtana::PedestalSigma_t& ped_rms,
+			    pmtana::pulse_param_array& pulses ) const
   {
+    return RecoPulseConstantPedestal(wf, ped_mean.front(), ped_rms.front(), pulses);
+  }
+
+  //---------------------------------------------------------------------------
+  bool AlgoSiPM::RecoPulseConstantPedestal( const pmtana::Waveform_t& wf,
+					    double ped_mean,
+					    double ped_rms,
+					    pmtana::pulse_param_array& pulses ) const
+  {
+
+    pulses.clear();
+
+    PulseChunkState state;
+    BeginChunks(ped_mean, ped_rms, state);
+    ReconstructChunk(wf.data(), wf.size(), state, pulses);
+    EndChunks(state, pulses);
+
+    return true;
 
-    bool   fire          = false;
-    bool   first_found   = false;
-    bool   record_hit    = false;
+  }
+
+  //---------------------------------------------------------------------------
+  bool AlgoSiPM::RecoChunk( const short* samples, size_t n,
+			    pmtana::PulseChunkState& state,
+			    pmtana::pulse_param_array& pulses ) const
+  {
+
+    bool&  fire          = state.fire;
+    bool&  first_found   = state.first_found;
+    bool&  record_hit    = state.record_hit;
     int    counter       = 0;
     //    double threshold   = (_2nd_thres > (_nsigma*_ped_rms) ? _2nd_thres
     //                                                    : (_nsigma*_ped_rms));
     //double pedestal      = _pedestal;
-    double pedestal = ped_mean.front();  //Switch pedestal definition to incoroprate pedestal finder - K.S. 04/18/2019
+    double pedestal = state.ped_mean;  //Switch pedestal definition to incoroprate pedestal finder - K.S. 04/18/2019
 
     double threshold     = _adc_thres;
     threshold           += pedestal;
     double pre_threshold = _2nd_thres;
     pre_threshold       += pedestal;
 
-    Reset();
+    pulse_param& pulse = state.pulse;
 
-    for (short const &value : wf) {
+    for (size_t index = 0; index < n; ++index) {
+
+      // Samples below the pre-threshold are ignored while no pulse is open
+      if (!fire) {
+        index += FindFirstAtOrAbove(samples + index, n - index, pre_threshold);
+        if (index == n) break;
+      }
+
+      short const &value = samples[index];
+
+      // Position in the whole waveform
+      counter = state.offset + index;
 
       if (!fire && (double(value) >= pre_threshold)) {
 
@@ -62,7 +101,7 @@ namespace pmtana {
         fire           = true;
         first_found    = false;
         record_hit     = false;
-        _pulse.t_start = counter;
+        pulse.t_start  = counter;
 
       }
 
@@ -70,13 +109,13 @@ namespace pmtana {
 
         // Found the end of a pulse
         fire = false;
-        _pulse.t_end = counter - 1;
-        if (record_hit && ((_pulse.t_end - _pulse.t_start) >= _min_width))
+        pulse.t_end = counter - 1;
+        if (record_hit && ((pulse.t_end - pulse.t_start) >= _min_width))
         {
-          _pulse_v.push_back(_pulse);
+          pulses.push_back(pulse);
           record_hit = false;
         }
-        _pulse.reset_param();
+        pulse.reset_param();
 
       }
 
@@ -86,14 +125,14 @@ namespace pmtana {
         if (!record_hit && (double(value) >= threshold)) record_hit = true;
 
         // Add this ADC count to the integral
-        _pulse.area += (double(value) - double(pedestal));
+        pulse.area += (double(value) - double(pedestal));
 
         if (!first_found &&
-            (_pulse.peak < (double(value) - double(pedestal)))) {
+            (pulse.peak < (double(value) - double(pedestal)))) {
 
           // Found a new maximum
-          _pulse.peak  = (double(value) - double(pedestal));
-          _pulse.t_max = counter; 
+          pulse.peak  = (double(value) - double(pedestal));
+          pulse.t_max = counter; 
 
         }
         else if (!first_found)
@@ -102,26 +141,34 @@ namespace pmtana {
 
       }
 
-      counter++;
-
     }
 
-    if (fire) {
+    return true;
+
+  }
+
+  //---------------------------------------------------------------------------
+  void AlgoSiPM::CloseChunks( pmtana::PulseChunkState& state,
+			      pmtana::pulse_param_array& pulses ) const
+  {
+
+    // state.offset is now the waveform length
+    int counter = state.offset;
+
+    if (state.fire) {
 
       // Take care of a pulse that did not finish within the readout window
-      fire = false;
-      _pulse.t_end = counter - 1;
-      if (record_hit && ((_pulse.t_end - _pulse.t_start) >= _min_width))
+      state.fire = false;
+      state.pulse.t_end = counter - 1;
+      if (state.record_hit && ((state.pulse.t_end - state.pulse.t_start) >= _min_width))
       {
-        _pulse_v.push_back(_pulse);
-        record_hit = false;
+        pulses.push_back(state.pulse);
+        state.record_hit = false;
       }
-      _pulse.reset_param();
+      state.pulse.reset_param();
 
     }
 
-    return true;
-
   }
 
 }
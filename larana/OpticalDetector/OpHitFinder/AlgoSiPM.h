@@ -28,6 +28,12 @@ namespace pmtana {
     // Implementation of PMTPulseRecoBase::Reset() method
     void Reset();
 
+    /// Peaks are samples minus the pedestal mean
+    bool PeakWithinSampleSpread() const { return true; }
+
+    /// The search is a sample-by-sample state machine
+    bool SupportsChunks() const { return true; }
+
     // A method to set user-defined ADC threshold value
     //      void SetADCThreshold(double v) {_adc_thres = v;};
 
@@ -39,7 +45,23 @@ namespace pmtana {
 
     bool RecoPulse( const pmtana::Waveform_t&,
 		    const pmtana::PedestalMean_t&,
-		    const pmtana::PedestalSigma_t&     );
+		    const pmtana::PedestalSigma_t&,
+		    pmtana::pulse_param_array& pulses ) const;
+
+    // Single-pass implementation for a constant pedestal (the array version uses the first entry only)
+    bool RecoPulseConstantPedestal( const pmtana::Waveform_t& wf,
+				    double ped_mean,
+				    double ped_sigma,
+				    pmtana::pulse_param_array& pulses ) const;
+
+    // Pulse search over the next chunk of samples (RecoPulseConstantPedestal runs it on the whole waveform)
+    bool RecoChunk( const short* samples, size_t n,
+		    pmtana::PulseChunkState& state,
+		    pmtana::pulse_param_array& pulses ) const;
+
+    // Records a pulse which did not finish within the readout window
+    void CloseChunks( pmtana::PulseChunkState& state,
+		      pmtana::pulse_param_array& pulses ) const;
 
     // A variable holder for a user-defined absolute ADC threshold value
     double _adc_thres;
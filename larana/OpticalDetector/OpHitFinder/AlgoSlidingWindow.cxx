@@ -7,6 +7,7 @@
 #include "fhiclcpp/ParameterSet.h"
 
 #include "AlgoSlidingWindow.h"
+#include "WaveformKernels.h"
 
 namespace pmtana{
 
@@ -56,10 +57,100 @@ namespace pmtana{
     PMTPulseRecoBase::Reset();
   }
 
+  namespace {
+
+    /// Per-sample pedestal arrays; the baseline-subtracted waveform is computed up front
+    /// into a caller-owned buffer
+    class PedestalArrays {
+    public:
+      PedestalArrays(const Waveform_t& wf, const PedestalMean_t& mean_v, const PedestalSigma_t& sigma_v,
+		     std::vector<double>& diff_v)
+	: _mean_v(mean_v), _sigma_v(sigma_v), _diff_v(diff_v)
+      {
+	diff_v.resize(wf.size());
+	SubtractBaseline(wf.data(), mean_v.data(), wf.size(), diff_v.data());
+      }
+      double mean (size_t i) const { return _mean_v[i];  }
+      double sigma(size_t i) const { return _sigma_v[i]; }
+      double diff (size_t i) const { return _diff_v[i];  }
+    private:
+      const PedestalMean_t&      _mean_v;
+      const PedestalSigma_t&     _sigma_v;
+      const std::vector<double>& _diff_v;
+    };
+
+    /// Single pedestal value for the whole waveform: samples are read once, nothing is stored
+    class ConstantPedestal {
+    public:
+      ConstantPedestal(const Waveform_t& wf, double ped_mean, double ped_sigma)
+	: _wf(wf), _mean(ped_mean), _sigma(ped_sigma) {}
+      double mean (size_t) const { return _mean;  }
+      double sigma(size_t) const { return _sigma; }
+      double diff (size_t i) const { return ((double)(_wf[i])) - _mean; }
+    private:
+      const Waveform_t& _wf;
+      double _mean;
+      double _sigma;
+    };
+
+  }
+
   //***************************************************************
   bool AlgoSlidingWindow::RecoPulse(const pmtana::Waveform_t& wf,
 				    const pmtana::PedestalMean_t& mean_v,
-				    const pmtana::PedestalSigma_t& sigma_v)
+				    const pmtana::PedestalSigma_t& sigma_v,
+				    pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    RecoScratch scratch;
+    return RecoPulseWithScratch(wf, mean_v, sigma_v, pulses, scratch);
+  }
+
+  //***************************************************************
+  bool AlgoSlidingWindow::RecoPulseWithScratch(const pmtana::Waveform_t& wf,
+					       const pmtana::PedestalMean_t& mean_v,
+					       const pmtana::PedestalSigma_t& sigma_v,
+					       pmtana::pulse_param_array& pulses,
+					       pmtana::RecoScratch& scratch) const
+  //***************************************************************
+  {
+    assert(wf.size()==mean_v.size() && wf.size()==sigma_v.size());
+
+    return FindPulses(wf, PedestalArrays(wf, mean_v, sigma_v, scratch.baseline_diff), pulses);
+  }
+
+  //***************************************************************
+  bool AlgoSlidingWindow::RecoPulseConstantPedestal(const pmtana::Waveform_t& wf,
+						    double ped_mean,
+						    double ped_sigma,
+						    pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    return FindPulses(wf, ConstantPedestal(wf, ped_mean, ped_sigma), pulses);
+  }
+
+  //***************************************************************
+  template <class Pedestal>
+  bool AlgoSlidingWindow::FindPulses(const pmtana::Waveform_t& wf,
+				     const Pedestal& ped,
+				     pmtana::pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    if(_positive)
+      return _verbose ?
+	ScanWaveform<true, true >(wf, ped, pulses) :
+	ScanWaveform<true, false>(wf, ped, pulses);
+    else
+      return _verbose ?
+	ScanWaveform<false,true >(wf, ped, pulses) :
+	ScanWaveform<false,false>(wf, ped, pulses);
+  }
+
+  //***************************************************************
+  template <bool Positive, bool Verbose, class Pedestal>
+  bool AlgoSlidingWindow::ScanWaveform(const pmtana::Waveform_t& wf,
+				       const Pedestal& ped,
+				       pmtana::pulse_param_array& pulses) const
   //***************************************************************
   {
 
@@ -77,44 +168,43 @@ namespace pmtana{
 
     int post_integration = 0;
 
-    assert(wf.size()==mean_v.size() && wf.size()==sigma_v.size());
-
     //double threshold = ( _adc_thres > (_nsigma * _ped_rms) ? _adc_thres : (_nsigma * _ped_rms) );
 
     //threshold += _ped_mean;
 
-    Reset();
-    
+    pulses.clear();
+
+    pulse_param pulse;
+
     for(size_t i=0; i<wf.size(); ++i) {
 
-      double value = 0.;
-      if(_positive) value = ((double)(wf[i])) -  mean_v[i];
-      else value = mean_v[i] - ((double)(wf[i]));
+      // Baseline-subtracted sample; the sign is flipped for negative polarity
+      double value = Positive ? ped.diff(i) : -ped.diff(i);
 
       float start_threshold = 0.;
       float tail_threshold  = 0.;
-      if(sigma_v[i] * _nsigma < _adc_thres) start_threshold = _adc_thres;
-      else start_threshold = sigma_v[i] * _nsigma;
+      if(ped.sigma(i) * _nsigma < _adc_thres) start_threshold = _adc_thres;
+      else start_threshold = ped.sigma(i) * _nsigma;
 
-      if(sigma_v[i] * _tail_nsigma < _tail_adc_thres) tail_threshold = _tail_adc_thres;
-      else tail_threshold = sigma_v[i] * _tail_nsigma;
+      if(ped.sigma(i) * _tail_nsigma < _tail_adc_thres) tail_threshold = _tail_adc_thres;
+      else tail_threshold = ped.sigma(i) * _tail_nsigma;
 
       // End pulse if significantly high peak found (new pulse)
       if( (!fire || in_tail || in_post) && ((double)value > start_threshold) ) {
 
 	// If there's a pulse, end it
 	if(in_tail) {
-	  _pulse.t_end = i - 1;
+	  pulse.t_end = i - 1;
 
 	  // Register if width is acceptable
-	  if( (_pulse.t_end - _pulse.t_start) >= _min_width )
-	    _pulse_v.push_back(_pulse);
+	  if( (pulse.t_end - pulse.t_start) >= _min_width )
+	    pulses.push_back(pulse);
 
-	  _pulse.reset_param();
+	  pulse.reset_param();
 
-	  if(_verbose)
+	  if(Verbose)
 	    std::cout << "\033[93mPulse End\033[00m: "
-		      << "baseline: " << mean_v[i] << " ... " << " ... adc above: " << value << " T=" << i << std::endl;
+		      << "baseline: " << ped.mean(i) << " ... " << " ... adc above: " << value << " T=" << i << std::endl;
 	}
 
 	//
@@ -122,15 +212,15 @@ namespace pmtana{
 	//
 
 	pulse_tail_threshold  = tail_threshold;
-	pulse_start_baseline  = mean_v[i];
+	pulse_start_baseline  = ped.mean(i);
 
 	pulse_end_threshold = 0.;
-	if(sigma_v[i] * _end_nsigma < _end_adc_thres) pulse_end_threshold = _end_adc_thres;
-	else pulse_end_threshold = sigma_v[i] * _end_nsigma;
+	if(ped.sigma(i) * _end_nsigma < _end_adc_thres) pulse_end_threshold = _end_adc_thres;
+	else pulse_end_threshold = ped.sigma(i) * _end_nsigma;
 
 	int buffer_num_index = 0;
-	if(_pulse_v.size())
-	  buffer_num_index = (int)i - _pulse_v.back().t_end -1;
+	if(pulses.size())
+	  buffer_num_index = (int)i - pulses.back().t_end -1;
 	else
 	  buffer_num_index = std::min(_num_presample,i);
 
@@ -141,25 +231,25 @@ namespace pmtana{
 	  throw std::exception();
 	}
 
-	_pulse.t_start   = i - buffer_num_index;
-	_pulse.ped_mean  = pulse_start_baseline;
-	_pulse.ped_sigma = sigma_v[i];
+	pulse.t_start   = i - buffer_num_index;
+	pulse.ped_mean  = pulse_start_baseline;
+	pulse.ped_sigma = ped.sigma(i);
 
-	for(size_t pre_index=_pulse.t_start; pre_index<i; ++pre_index) {
+	for(size_t pre_index=pulse.t_start; pre_index<i; ++pre_index) {
 
 	  double pre_adc = wf[pre_index];
-	  if(_positive) pre_adc -= pulse_start_baseline;
+	  if(Positive) pre_adc -= pulse_start_baseline;
 	  else pre_adc = pulse_start_baseline - pre_adc;
 
-	  if(pre_adc > 0.) _pulse.area += pre_adc;
+	  if(pre_adc > 0.) pulse.area += pre_adc;
 	}
 
-	if(_verbose)
+	if(Verbose)
 	  std::cout << "\033[93mPulse Start\033[00m: "
-		    << "baseline: " << mean_v[i]
+		    << "baseline: " << ped.mean(i)
 		    << " ... threshold: " << start_threshold
 		    << " ... adc above baseline: " << value
-		    << " ... pre-adc sum: " << _pulse.area
+		    << " ... pre-adc sum: " << pulse.area
 		    << " T=" << i << std::endl;
 
 	fire = true;
@@ -173,10 +263,10 @@ namespace pmtana{
 	in_post = false;
       }
 
-      if( (fire || in_tail || in_post) && _verbose ) {
+      if( (fire || in_tail || in_post) && Verbose ) {
 	std::cout << (fire ? "\033[93mPulsing\033[00m: " : "\033[93mIn-tail\033[00m: ")
-		  << "baseline: " << mean_v[i]
-		  << " std: " << sigma_v[i]
+		  << "baseline: " << ped.mean(i)
+		  << " std: " << ped.sigma(i)
 		  << " ... adc above baseline " << value
 		  << " T=" << i << std::endl;
 
@@ -193,17 +283,17 @@ namespace pmtana{
 
       if( in_post && post_integration<1 ) {
 	// Found the end of a pulse
-	_pulse.t_end = i - 1;
+	pulse.t_end = i - 1;
 
 	// Register if width is acceptable
-	if( (_pulse.t_end - _pulse.t_start) >= _min_width )
-	  _pulse_v.push_back(_pulse);
+	if( (pulse.t_end - pulse.t_start) >= _min_width )
+	  pulses.push_back(pulse);
 
-	if(_verbose)
+	if(Verbose)
 	  std::cout << "\033[93mPulse End\033[00m: "
-		    << "baseline: " << mean_v[i] << " ... adc: " << value << " T=" << i << " ... area sum " << _pulse.area << std::endl;
+		    << "baseline: " << ped.mean(i) << " ... adc: " << value << " T=" << i << " ... area sum " << pulse.area << std::endl;
 
-	_pulse.reset_param();
+	pulse.reset_param();
 
 	fire = false;
 	in_tail = false;
@@ -212,15 +302,15 @@ namespace pmtana{
       
       if(fire || in_tail || in_post){
 
-	//_pulse.area += ((double)value - (double)mean_v[i]);
-	_pulse.area += value;
+	//pulse.area += ((double)value - (double)ped.mean(i));
+	pulse.area += value;
 
-	if(_pulse.peak < value) {
+	if(pulse.peak < value) {
 
 	  // Found a new maximum
-	  _pulse.peak = value;
+	  pulse.peak = value;
 
-	  _pulse.t_max = i;
+	  pulse.t_max = i;
 
 	}
 
@@ -237,13 +327,13 @@ namespace pmtana{
       fire = false;
       in_tail = false;
 
-      _pulse.t_end = wf.size() - 1;
+      pulse.t_end = wf.size() - 1;
 
       // Register if width is acceptable
-      if( (_pulse.t_end - _pulse.t_start) >= _min_width )
-	_pulse_v.push_back(_pulse);
+      if( (pulse.t_end - pulse.t_start) >= _min_width )
+	pulses.push_back(pulse);
 
-      _pulse.reset_param();
+      pulse.reset_param();
 
     }
 
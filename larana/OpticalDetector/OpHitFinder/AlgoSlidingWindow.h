@@ -42,12 +42,42 @@ namespace pmtana
     /// Implementation of AlgoSlidingWindow::reset() method
     void Reset();
 
+    /// Peaks are baseline-subtracted samples (sign flipped for negative polarity)
+    bool PeakWithinSampleSpread() const { return true; }
+
   protected:
 
     /// Implementation of AlgoSlidingWindow::reco() method
     bool RecoPulse(const pmtana::Waveform_t&,
 		   const pmtana::PedestalMean_t&,
-		   const pmtana::PedestalSigma_t&);
+		   const pmtana::PedestalSigma_t&,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Same as above; the baseline-subtracted waveform is kept in the scratch
+    bool RecoPulseWithScratch(const pmtana::Waveform_t&,
+			      const pmtana::PedestalMean_t&,
+			      const pmtana::PedestalSigma_t&,
+			      pmtana::pulse_param_array& pulses,
+			      pmtana::RecoScratch& scratch) const;
+
+    /// Single-pass implementation for a constant pedestal
+    bool RecoPulseConstantPedestal(const pmtana::Waveform_t&,
+				   double ped_mean,
+				   double ped_sigma,
+				   pmtana::pulse_param_array& pulses) const;
+
+    /// Pulse finding for per-sample or constant pedestal accessors: runs the ScanWaveform
+    /// instance matching the configured polarity and verbosity
+    template <class Pedestal>
+    bool FindPulses(const pmtana::Waveform_t& wf,
+		    const Pedestal& ped,
+		    pmtana::pulse_param_array& pulses) const;
+
+    /// Pulse finding loop, with polarity and verbosity fixed at compile time
+    template <bool Positive, bool Verbose, class Pedestal>
+    bool ScanWaveform(const pmtana::Waveform_t& wf,
+		      const Pedestal& ped,
+		      pmtana::pulse_param_array& pulses) const;
 
     /// A boolean to set waveform positive/negative polarity
     bool _positive;
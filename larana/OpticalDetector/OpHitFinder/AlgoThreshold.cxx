@@ -7,6 +7,11 @@
 #include "fhiclcpp/ParameterSet.h"
 
 #include "AlgoThreshold.h"
+#include "WaveformKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 namespace pmtana{
 
@@ -49,95 +54,287 @@ namespace pmtana{
   //***************************************************************
   bool AlgoThreshold::RecoPulse(const Waveform_t&wf,
 				const PedestalMean_t& mean_v,
-				const PedestalSigma_t& sigma_v)
+				const PedestalSigma_t& sigma_v,
+				pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    return RecoPulseConstantPedestal(wf, mean_v.front(), sigma_v.front(), pulses);
+  }
+
+  //***************************************************************
+  bool AlgoThreshold::RecoPulseConstantPedestal(const Waveform_t& wf,
+						double ped_mean,
+						double ped_rms,
+						pulse_param_array& pulses) const
   //***************************************************************
   {
-    bool fire = false;
+    pulses.clear();
 
-    double counter=0;
+    PulseChunkState state;
+    BeginChunks(ped_mean, ped_rms, state);
+    ReconstructChunk(wf.data(), wf.size(), state, pulses);
+    EndChunks(state, pulses);
 
-    double ped_mean = mean_v.front();
-    double ped_rms  = sigma_v.front();
+    return true;
+
+  }
+
+  //***************************************************************
+  void AlgoThreshold::Thresholds(const PulseChunkState& state,
+				 double& start_threshold,
+				 double& end_threshold) const
+  //***************************************************************
+  {
+    const double ped_mean = state.ped_mean;
+    const double ped_rms  = state.ped_sigma;
 
     //double threshold = ( _adc_thres > (_nsigma * ped_rms) ? _adc_thres : (_nsigma * ped_rms) );
-    auto start_threshold = ( _start_adc_thres > (_nsigma_start * ped_rms) ? _start_adc_thres : (_nsigma_start * ped_rms) );
-    auto end_threshold   = ( _end_adc_thres   > (_nsigma_end   * ped_rms) ? _end_adc_thres   : (_nsigma_end * ped_rms) );
+    start_threshold = ( _start_adc_thres > (_nsigma_start * ped_rms) ? _start_adc_thres : (_nsigma_start * ped_rms) );
+    end_threshold   = ( _end_adc_thres   > (_nsigma_end   * ped_rms) ? _end_adc_thres   : (_nsigma_end * ped_rms) );
 
     //    threshold += ped_mean
 
     start_threshold += ped_mean;
     end_threshold   += ped_mean;
+  }
 
-    Reset();
+  //***************************************************************
+  template <class Pulses>
+  void AlgoThreshold::Step(short value, double counter,
+			   double start_threshold, double end_threshold,
+			   PulseChunkState& state,
+			   Pulses& pulses) const
+  //***************************************************************
+  {
+    const double ped_mean = state.ped_mean;
+    const double ped_rms  = state.ped_sigma;
 
-    for(auto const &value : wf){
+    bool& fire = state.fire;
+    pulse_param& pulse = state.pulse;
 
-      if( !fire && ((double)value) >= start_threshold ){
+    if( !fire && ((double)value) >= start_threshold ){
 
-	// Found a new pulse
+      // Found a new pulse
 
-	fire = true;
+      fire = true;
 
-	_pulse.ped_mean  = ped_mean;
-	_pulse.ped_sigma = ped_rms;
+      pulse.ped_mean  = ped_mean;
+      pulse.ped_sigma = ped_rms;
 
-	//vic: i move t_start back one, this helps with porch
+      //vic: i move t_start back one, this helps with porch
 
-	_pulse.t_start = counter - 1 > 0 ? counter - 1 : counter;
-	//std::cout << "counter: " << counter << " tstart : " << _pulse.t_start << "\n";
+      pulse.t_start = counter - 1 > 0 ? counter - 1 : counter;
+      //std::cout << "counter: " << counter << " tstart : " << pulse.t_start << "\n";
 
-      }
+    }
 
-      if( fire && ((double)value) < end_threshold ){
+    if( fire && ((double)value) < end_threshold ){
 
-	// Found the end of a pulse
+      // Found the end of a pulse
 
-	fire = false;
+      fire = false;
 
-	//vic: i move t_start forward one, this helps with tail
-	_pulse.t_end = counter < wf.size()  ? counter : counter - 1;
+      //vic: i move t_start forward one, this helps with tail
+      pulse.t_end = counter;
 
-	_pulse_v.push_back(_pulse);
+      pulses.push_back(pulse);
 
-	_pulse.reset_param();
+      pulse.reset_param();
 
-      }
+    }
 
 
-      //std::cout << "\tFire=" << fire << std::endl;
+    //std::cout << "\tFire=" << fire << std::endl;
 
-      if(fire){
+    if(fire){
 
-	// Add this adc count to the integral
+      // Add this adc count to the integral
 
-	_pulse.area += ((double)value - (double)ped_mean);
+      pulse.area += ((double)value - (double)ped_mean);
 
-	if(_pulse.peak < ((double)value - (double)ped_mean)) {
+      if(pulse.peak < ((double)value - (double)ped_mean)) {
 
-	  // Found a new maximum
+	// Found a new maximum
 
-	  _pulse.peak = ((double)value - (double)ped_mean);
+	pulse.peak = ((double)value - (double)ped_mean);
 
-	  _pulse.t_max = counter;
+	pulse.t_max = counter;
 
-	}
+      }
+
+    }
+
+  }
+
+  //***************************************************************
+  template <class Pulses>
+  void AlgoThreshold::Scan(const short* samples, size_t n,
+			   PulseChunkState& state,
+			   Pulses& pulses) const
+  //***************************************************************
+  {
+    double start_threshold, end_threshold;
+    Thresholds(state, start_threshold, end_threshold);
 
+    for(size_t index = 0; index < n; ++index){
+
+      // Nothing happens below the start threshold while no pulse is open,
+      // so jump straight to the next sample that can start one
+      if( !state.fire ) {
+	index += FindFirstAtOrAbove(samples + index, n - index, start_threshold);
+	if( index == n ) break;
       }
 
-      counter++;
+      // Position in the whole waveform
+      Step(samples[index], state.offset + index, start_threshold, end_threshold, state, pulses);
+
     }
 
-    if(fire){
+  }
+
+  //***************************************************************
+  template <class Pulses>
+  void AlgoThreshold::Close(PulseChunkState& state,
+			    Pulses& pulses) const
+  //***************************************************************
+  {
+    // state.offset is now the waveform length
+    double counter = state.offset;
+
+    if(state.fire){
 
       // Take care of a pulse that did not finish within the readout window.
 
-      fire = false;
+      state.fire = false;
+
+      state.pulse.t_end = counter - 1;
 
-      _pulse.t_end = counter - 1;
+      pulses.push_back(state.pulse);
 
-      _pulse_v.push_back(_pulse);
+      state.pulse.reset_param();
 
-      _pulse.reset_param();
+    }
+
+  }
+
+  //***************************************************************
+  bool AlgoThreshold::RecoChunk(const short* samples, size_t n,
+				PulseChunkState& state,
+				pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    Scan(samples, n, state, pulses);
+    return true;
+  }
+
+  //***************************************************************
+  bool AlgoThreshold::RecoPulseTable(const Waveform_t& wf,
+				     double ped_mean,
+				     double ped_rms,
+				     pulse_table& pulses) const
+  //***************************************************************
+  {
+    pulses.clear();
+
+    PulseChunkState state;
+    BeginChunks(ped_mean, ped_rms, state);
+    Scan(wf.data(), wf.size(), state, pulses);
+    state.offset = wf.size();
+    Close(state, pulses);
+
+    return true;
+
+  }
+
+  //***************************************************************
+  bool AlgoThreshold::RecoBatch(const std::vector<const Waveform_t*>& wfs,
+				const std::vector<double>& ped_mean,
+				const std::vector<double>& ped_sigma,
+				const std::vector<pulse_param_array*>& pulses,
+				std::vector<short>& scratch) const
+  //***************************************************************
+  {
+    if(wfs.empty()) return true;
+
+    const size_t n = wfs.front()->size();
+
+    scratch.resize(n * NumBatchLanes);
+    const short* rows = scratch.data();
+
+    for(size_t first = 0; first < wfs.size(); first += NumBatchLanes) {
+
+      const size_t nlanes = std::min(NumBatchLanes, wfs.size() - first);
+
+      const short* samples[NumBatchLanes];
+      for(size_t lane = 0; lane < nlanes; ++lane) samples[lane] = wfs[first+lane]->data();
+
+      InterleaveWaveforms(samples, nlanes, n, scratch.data());
+
+      PulseChunkState state[NumBatchLanes];
+      double start_threshold[NumBatchLanes], end_threshold[NumBatchLanes];
+
+      // Rows where every lane is below these are skipped; they may be lower than the
+      // exact thresholds (rounding, out of range), as the Step test decides anyway
+      short row_threshold[NumBatchLanes];
+      std::fill(row_threshold, row_threshold + NumBatchLanes, (short)INT16_MAX);
+
+      for(size_t lane = 0; lane < nlanes; ++lane) {
+	pulses[first+lane]->clear();
+	BeginChunks(ped_mean[first+lane], ped_sigma[first+lane], state[lane]);
+	Thresholds(state[lane], start_threshold[lane], end_threshold[lane]);
+	const double t = start_threshold[lane];
+	row_threshold[lane] = !(t > INT16_MIN) ? (short)INT16_MIN :
+	  ( t > INT16_MAX ? (short)INT16_MAX : (short)std::ceil(t) );
+      }
+
+      // Lanes are independent: the rows are searched for a pulse start in any lane, then each lane
+      // where one can start is stepped alone until its pulse closes. A lane is left out of the
+      // search until the row where it was left (resume); closed lanes below their row threshold
+      // are skipped, as Step is a no-op for them
+      size_t resume[NumBatchLanes] = {};
+      short search_threshold[NumBatchLanes];
+
+      size_t index = 0;
+
+      while(index < n) {
+
+	// Rows before the next lane to resume, searched with the lanes still ahead left out
+	size_t limit = n;
+	unsigned ahead_mask = 0;
+	for(size_t lane = 0; lane < NumBatchLanes; ++lane) {
+	  if(resume[lane] > index) {
+	    search_threshold[lane] = (short)INT16_MAX;
+	    limit = std::min(limit, resume[lane]);
+	    ahead_mask |= 1u << lane;
+	  }
+	  else search_threshold[lane] = row_threshold[lane];
+	}
+
+	index += FindFirstRowAtOrAbove(rows + index*NumBatchLanes, limit - index, search_threshold);
+	if(index == limit) continue;
+
+	// (a lane ahead may still match at INT16_MAX)
+	const unsigned start_mask =
+	  RowLanesAtOrAbove(rows + index*NumBatchLanes, search_threshold) & ~ahead_mask;
+
+	for(size_t lane = 0; lane < nlanes; ++lane) {
+	  if( !(start_mask & (1u << lane)) ) continue;
+	  size_t i = index;
+	  do {
+	    Step(rows[i*NumBatchLanes + lane], i, start_threshold[lane], end_threshold[lane],
+		 state[lane], *pulses[first+lane]);
+	    ++i;
+	  } while(i < n && state[lane].fire);
+	  resume[lane] = i;
+	}
+
+	++index;
+      }
+
+      for(size_t lane = 0; lane < nlanes; ++lane) {
+	state[lane].offset = n;
+	CloseChunks(state[lane], *pulses[first+lane]);
+      }
 
     }
 
@@ -145,4 +342,12 @@ namespace pmtana{
 
   }
 
+  //***************************************************************
+  void AlgoThreshold::CloseChunks(PulseChunkState& state,
+				  pulse_param_array& pulses) const
+  //***************************************************************
+  {
+    Close(state, pulses);
+  }
+
 }
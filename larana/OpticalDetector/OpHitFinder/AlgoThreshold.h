@@ -46,12 +46,75 @@ namespace pmtana
     /// Implementation of AlgoThreshold::reset() method
     void Reset();
 
+    /// Peaks are samples minus the pedestal mean
+    bool PeakWithinSampleSpread() const { return true; }
+
+    /// The search is a sample-by-sample state machine
+    bool SupportsChunks() const { return true; }
+
+    /// Waveforms of equal length are searched side by side, one per lane
+    bool SupportsBatch() const { return true; }
+
   protected:
 
     /// Implementation of AlgoThreshold::reco() method
     bool RecoPulse(const pmtana::Waveform_t& wf,
 		   const pmtana::PedestalMean_t& mean_v,
-		   const pmtana::PedestalSigma_t& sigma_v);
+		   const pmtana::PedestalSigma_t& sigma_v,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Single-pass implementation for a constant pedestal (the array version uses the first entry only)
+    bool RecoPulseConstantPedestal(const pmtana::Waveform_t& wf,
+				   double ped_mean,
+				   double ped_sigma,
+				   pmtana::pulse_param_array& pulses) const;
+
+    /// Pulse search over the next chunk of samples (RecoPulseConstantPedestal runs it on the whole waveform)
+    bool RecoChunk(const short* samples, size_t n,
+		   pmtana::PulseChunkState& state,
+		   pmtana::pulse_param_array& pulses) const;
+
+    /// Closes a pulse which did not finish within the readout window
+    void CloseChunks(pmtana::PulseChunkState& state,
+		     pmtana::pulse_param_array& pulses) const;
+
+    /// Lane-parallel search: quiet rows of all lanes are skipped together, and each lane
+    /// where a pulse can start goes through the same per-sample steps as RecoChunk alone
+    /// until the pulse closes
+    bool RecoBatch(const std::vector<const pmtana::Waveform_t*>& wfs,
+		   const std::vector<double>& ped_mean,
+		   const std::vector<double>& ped_sigma,
+		   const std::vector<pmtana::pulse_param_array*>& pulses,
+		   std::vector<short>& scratch) const;
+
+    /// Start and end thresholds for the pedestal of the state
+    void Thresholds(const pmtana::PulseChunkState& state,
+		    double& start_threshold,
+		    double& end_threshold) const;
+
+    /// Single-pass implementation appending the pulses to the table as they are found
+    bool RecoPulseTable(const pmtana::Waveform_t& wf,
+			double ped_mean,
+			double ped_sigma,
+			pmtana::pulse_table& pulses) const;
+
+    /// Processes the sample at waveform index counter (Pulses: pulse_param_array or pulse_table)
+    template <class Pulses>
+    void Step(short value, double counter,
+	      double start_threshold, double end_threshold,
+	      pmtana::PulseChunkState& state,
+	      Pulses& pulses) const;
+
+    /// Pulse search over n samples starting at waveform index state.offset
+    template <class Pulses>
+    void Scan(const short* samples, size_t n,
+	      pmtana::PulseChunkState& state,
+	      Pulses& pulses) const;
+
+    /// Closes the pulse still open at the end of the waveform
+    template <class Pulses>
+    void Close(pmtana::PulseChunkState& state,
+	       Pulses& pulses) const;
 
     /// A variable holder for a user-defined absolute ADC threshold value
     //double _adc_thres;
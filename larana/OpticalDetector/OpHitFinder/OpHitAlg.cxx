@@ -13,7 +13,9 @@
 
 #include "OpHitAlg.h"
 
+#include "cetlib_except/exception.h"
 #include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+#include "larana/OpticalDetector/OpHitFinder/WaveformKernels.h"
 #include "lardataalg/DetectorInfo/DetectorClocks.h"
 #include "lardataalg/DetectorInfo/ElecClock.h"
 #include "lardataobj/RawData/OpDetWaveform.h"
@@ -21,9 +23,197 @@
 #include "larreco/Calibrator/IPhotonCalibrator.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
+#include "tbb/blocked_range.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/parallel_for.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <vector>
 
 namespace opdet{
+
+  namespace {
+
+    raw::OpDetWaveform const& Waveform(raw::OpDetWaveform const& waveform)
+    { return waveform; }
+
+    raw::OpDetWaveform const& Waveform(raw::OpDetWaveform const* waveform)
+    { return *waveform; }
+
+    // Scratch buffers of one thread
+    struct HitFinderScratch {
+      pmtana::PulseRecoContext      context; // Single waveforms
+      pmtana::PulseRecoBatchContext batch;   // Batches of waveforms
+      std::vector< raw::OpDetWaveform const* > waveforms;
+      std::vector< pmtana::Waveform_t const* > samples;
+    };
+
+    // Hit finding over waveforms [first, last), appending hits in waveform
+    // order; in batch mode, runs of up to NumBatchLanes consecutive waveforms
+    // of equal length are reconstructed together
+    template < class Waveforms >
+    void FindHitsInWaveforms(Waveforms const&                opDetWaveforms,
+                             size_t                          first,
+                             size_t                          last,
+                             std::vector< recob::OpHit >&    hitVector,
+                             HitFinderScratch&               scratch,
+                             pmtana::PulseRecoManager const& pulseRecoMgr,
+                             size_t                          algoIndex,
+                             geo::GeometryCore const&        geometry,
+                             float                           hitThreshold,
+                             HitConstructor const&           hitConstructor) {
+
+      size_t iWaveform = first;
+
+      while (iWaveform < last) {
+
+        auto const& waveform = Waveform(opDetWaveforms[iWaveform]);
+
+        size_t end = iWaveform + 1;
+        if (pulseRecoMgr.BatchMode())
+          while (end < last && end - iWaveform < pmtana::NumBatchLanes &&
+                 Waveform(opDetWaveforms[end]).size() == waveform.size())
+            ++end;
+
+        if (end - iWaveform == 1) {
+          FindHitsInWaveform(waveform,
+                             hitVector,
+                             scratch.context,
+                             pulseRecoMgr,
+                             algoIndex,
+                             geometry,
+                             hitThreshold,
+                             hitConstructor);
+          iWaveform = end;
+          continue;
+        }
+
+        scratch.waveforms.clear();
+        for (; iWaveform < end; ++iWaveform) {
+          auto const& batchWaveform = Waveform(opDetWaveforms[iWaveform]);
+          const int channel = static_cast< int >(batchWaveform.ChannelNumber());
+          if (!geometry.IsValidOpChannel(channel)) {
+            mf::LogError("OpHitFinder") << "Error! unrecognized channel number "
+                             << channel << ". Ignoring pulse";
+            continue;
+          }
+          scratch.waveforms.push_back(&batchWaveform);
+        }
+
+        scratch.samples.assign(scratch.waveforms.begin(), scratch.waveforms.end());
+        scratch.batch.contexts.resize(scratch.waveforms.size());
+        for (size_t i = 0; i < scratch.waveforms.size(); ++i)
+          scratch.batch.contexts[i].channel =
+            static_cast< int >(scratch.waveforms[i]->ChannelNumber());
+
+        pulseRecoMgr.Reconstruct(scratch.samples, scratch.batch);
+
+        for (size_t i = 0; i < scratch.waveforms.size(); ++i) {
+          auto const& context = scratch.batch.contexts[i];
+          if (pulseRecoMgr.PulseTableMode())
+            hitConstructor.ConstructHits(hitThreshold,
+                                         context.channel,
+                                         scratch.waveforms[i]->TimeStamp(),
+                                         context.table_v[algoIndex],
+                                         hitVector);
+          else
+            hitConstructor.ConstructHits(hitThreshold,
+                                         context.channel,
+                                         scratch.waveforms[i]->TimeStamp(),
+                                         context.pulse_v[algoIndex],
+                                         hitVector);
+        }
+      }
+    }
+
+    // Serial hit finding over a vector of waveforms or of waveform pointers
+    template < class Waveforms >
+    void RunHitFinderImpl(Waveforms const&                opDetWaveforms,
+                          std::vector< recob::OpHit >&    hitVector,
+                          pmtana::PulseRecoManager const& pulseRecoMgr,
+                          pmtana::PMTPulseRecoBase const& threshAlg,
+                          geo::GeometryCore const&        geometry,
+                          float                           hitThreshold,
+                          HitConstructor const&           hitConstructor) {
+
+      // Scratch buffers for pedestal and pulses, reused for all waveforms
+      HitFinderScratch scratch;
+      size_t const algoIndex = pulseRecoMgr.AlgoIndex(threshAlg);
+
+      FindHitsInWaveforms(opDetWaveforms,
+                          0,
+                          opDetWaveforms.size(),
+                          hitVector,
+                          scratch,
+                          pulseRecoMgr,
+                          algoIndex,
+                          geometry,
+                          hitThreshold,
+                          hitConstructor);
+    }
+
+    // Parallel hit finding over a vector of waveforms or of waveform pointers
+    template < class Waveforms >
+    void RunHitFinderParallelImpl(Waveforms const&                opDetWaveforms,
+                                  std::vector< recob::OpHit >&    hitVector,
+                                  pmtana::PulseRecoManager const& pulseRecoMgr,
+                                  pmtana::PMTPulseRecoBase const& threshAlg,
+                                  geo::GeometryCore const&        geometry,
+                                  float                           hitThreshold,
+                                  HitConstructor const&           hitConstructor,
+                                  size_t                          waveformsPerTask) {
+
+      size_t const algoIndex = pulseRecoMgr.AlgoIndex(threshAlg);
+
+      if (waveformsPerTask == 0) waveformsPerTask = 1;
+      size_t const nWaveforms = opDetWaveforms.size();
+      size_t const nBlocks = (nWaveforms + waveformsPerTask - 1)/waveformsPerTask;
+
+      // Each block of consecutive waveforms fills its own hit buffer;
+      // block boundaries do not depend on the scheduling, so concatenating
+      // the buffers in block order reproduces the serial output exactly
+      std::vector< std::vector< recob::OpHit > > hitsPerBlock(nBlocks);
+
+      // One set of scratch buffers per worker thread
+      tbb::enumerable_thread_specific< HitFinderScratch > scratches;
+
+      tbb::parallel_for(tbb::blocked_range< size_t >(0, nBlocks),
+        [&](tbb::blocked_range< size_t > const& range) {
+
+          auto& scratch = scratches.local();
+
+          for (size_t block = range.begin(); block != range.end(); ++block) {
+
+            size_t const first = block*waveformsPerTask;
+            size_t const last  = std::min(first + waveformsPerTask, nWaveforms);
+
+            FindHitsInWaveforms(opDetWaveforms,
+                                first,
+                                last,
+                                hitsPerBlock[block],
+                                scratch,
+                                pulseRecoMgr,
+                                algoIndex,
+                                geometry,
+                                hitThreshold,
+                                hitConstructor);
+          }
+        });
+
+      size_t nHits = hitVector.size();
+      for (auto const& blockHits : hitsPerBlock) nHits += blockHits.size();
+      hitVector.reserve(nHits);
+
+      for (auto& blockHits : hitsPerBlock)
+        hitVector.insert(hitVector.end(),
+                         std::make_move_iterator(blockHits.begin()),
+                         std::make_move_iterator(blockHits.end()));
+    }
+
+  } // anonymous namespace
+
   //----------------------------------------------------------------------------
   void RunHitFinder(std::vector< raw::OpDetWaveform > const&
                                                     opDetWaveformVector,
@@ -33,35 +223,387 @@ namespace opdet{
                     geo::GeometryCore const&        geometry,
                     float                           hitThreshold,
                     detinfo::DetectorClocks const&  detectorClocks,
-                    calib::IPhotonCalibrator const& calibrator) {
+                    calib::IPhotonCalibrator const& calibrator,
+                    bool                            affineCalibrator) {
+
+    RunHitFinderImpl(opDetWaveformVector, hitVector, pulseRecoMgr, threshAlg,
+                     geometry, hitThreshold,
+                     HitConstructor(geometry, detectorClocks, calibrator,
+                                    affineCalibrator));
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinder(OpDetWaveformPtrs_t const&      opDetWaveforms,
+                    std::vector< recob::OpHit >&    hitVector,
+                    pmtana::PulseRecoManager const& pulseRecoMgr,
+                    pmtana::PMTPulseRecoBase const& threshAlg,
+                    geo::GeometryCore const&        geometry,
+                    float                           hitThreshold,
+                    detinfo::DetectorClocks const&  detectorClocks,
+                    calib::IPhotonCalibrator const& calibrator,
+                    bool                            affineCalibrator) {
+
+    RunHitFinderImpl(opDetWaveforms, hitVector, pulseRecoMgr, threshAlg,
+                     geometry, hitThreshold,
+                     HitConstructor(geometry, detectorClocks, calibrator,
+                                    affineCalibrator));
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinderParallel(std::vector< raw::OpDetWaveform > const&
+                                                            opDetWaveformVector,
+                            std::vector< recob::OpHit >&    hitVector,
+                            pmtana::PulseRecoManager const& pulseRecoMgr,
+                            pmtana::PMTPulseRecoBase const& threshAlg,
+                            geo::GeometryCore const&        geometry,
+                            float                           hitThreshold,
+                            detinfo::DetectorClocks const&  detectorClocks,
+                            calib::IPhotonCalibrator const& calibrator,
+                            size_t                          waveformsPerTask,
+                            bool                            affineCalibrator) {
+
+    RunHitFinderParallelImpl(opDetWaveformVector, hitVector, pulseRecoMgr,
+                             threshAlg, geometry, hitThreshold,
+                             HitConstructor(geometry, detectorClocks,
+                                            calibrator, affineCalibrator),
+                             waveformsPerTask);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinderParallel(OpDetWaveformPtrs_t const&      opDetWaveforms,
+                            std::vector< recob::OpHit >&    hitVector,
+                            pmtana::PulseRecoManager const& pulseRecoMgr,
+                            pmtana::PMTPulseRecoBase const& threshAlg,
+                            geo::GeometryCore const&        geometry,
+                            float                           hitThreshold,
+                            detinfo::DetectorClocks const&  detectorClocks,
+                            calib::IPhotonCalibrator const& calibrator,
+                            size_t                          waveformsPerTask,
+                            bool                            affineCalibrator) {
+
+    RunHitFinderParallelImpl(opDetWaveforms, hitVector, pulseRecoMgr,
+                             threshAlg, geometry, hitThreshold,
+                             HitConstructor(geometry, detectorClocks,
+                                            calibrator, affineCalibrator),
+                             waveformsPerTask);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinder(std::vector< raw::OpDetWaveform > const&
+                                                    opDetWaveformVector,
+                    std::vector< recob::OpHit >&    hitVector,
+                    pmtana::PulseRecoManager const& pulseRecoMgr,
+                    pmtana::PMTPulseRecoBase const& threshAlg,
+                    geo::GeometryCore const&        geometry,
+                    float                           hitThreshold,
+                    HitConstructor const&           hitConstructor) {
+
+    RunHitFinderImpl(opDetWaveformVector, hitVector, pulseRecoMgr, threshAlg,
+                     geometry, hitThreshold, hitConstructor);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinder(OpDetWaveformPtrs_t const&      opDetWaveforms,
+                    std::vector< recob::OpHit >&    hitVector,
+                    pmtana::PulseRecoManager const& pulseRecoMgr,
+                    pmtana::PMTPulseRecoBase const& threshAlg,
+                    geo::GeometryCore const&        geometry,
+                    float                           hitThreshold,
+                    HitConstructor const&           hitConstructor) {
+
+    RunHitFinderImpl(opDetWaveforms, hitVector, pulseRecoMgr, threshAlg,
+                     geometry, hitThreshold, hitConstructor);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void RunHitFinderParallel(std::vector< raw::OpDetWaveform > const&
+                                                            opDetWaveformVector,
+                            std::vector< recob::OpHit >&    hitVector,
+                            pmtana::PulseRecoManager const& pulseRecoMgr,
+                            pmtana::PMTPulseRecoBase const& threshAlg,
+                            geo::GeometryCore const&        geometry,
+                            float                           hitThreshold,
+                            HitConstructor const&           hitConstructor,
+                            size_t                          waveformsPerTask) {
+
+    RunHitFinderParallelImpl(opDetWaveformVector, hitVector, pulseRecoMgr,
+                             threshAlg, geometry, hitThreshold,
+                             hitConstructor, waveformsPerTask);
+  }
+
 
-    for (auto const& waveform : opDetWaveformVector) {
+  //----------------------------------------------------------------------------
+  void RunHitFinderParallel(OpDetWaveformPtrs_t const&      opDetWaveforms,
+                            std::vector< recob::OpHit >&    hitVector,
+                            pmtana::PulseRecoManager const& pulseRecoMgr,
+                            pmtana::PMTPulseRecoBase const& threshAlg,
+                            geo::GeometryCore const&        geometry,
+                            float                           hitThreshold,
+                            HitConstructor const&           hitConstructor,
+                            size_t                          waveformsPerTask) {
+
+    RunHitFinderParallelImpl(opDetWaveforms, hitVector, pulseRecoMgr,
+                             threshAlg, geometry, hitThreshold,
+                             hitConstructor, waveformsPerTask);
+  }
+
+
+  //----------------------------------------------------------------------------
+  OpDetWaveformPtrs_t SelectWaveforms(
+      std::vector< std::vector< raw::OpDetWaveform > const* > const& collections,
+      std::vector< bool > const&                                  channelMask) {
+
+    size_t nWaveforms = 0;
+    for (auto const* collection : collections) nWaveforms += collection->size();
 
-      const int channel = static_cast< int >(waveform.ChannelNumber());
+    OpDetWaveformPtrs_t waveforms;
+    waveforms.reserve(nWaveforms);
 
-      if (!geometry.IsValidOpChannel(channel)) {
-        mf::LogError("OpHitFinder") << "Error! unrecognized channel number "
-                         << channel << ". Ignoring pulse";
-        continue;
+    for (auto const* collection : collections)
+      for (auto const& waveform : *collection) {
+        size_t const channel = waveform.ChannelNumber();
+        if (channel < channelMask.size() && channelMask[channel]) continue;
+        waveforms.push_back(&waveform);
       }
 
-      pulseRecoMgr.Reconstruct(waveform);
+    return waveforms;
+  }
+
+
+  //----------------------------------------------------------------------------
+  std::vector< raw::OpDetWaveform > CropWaveforms(
+      OpDetWaveformPtrs_t const& opDetWaveforms,
+      TimeWindows_t              windows,
+      double                     tickPeriod) {
+
+    std::vector< raw::OpDetWaveform > segments;
+    if (windows.empty() || tickPeriod <= 0.) return segments;
+
+    // Sorted, non-overlapping windows
+    std::sort(windows.begin(), windows.end());
+    TimeWindows_t merged;
+    for (auto const& window : windows) {
+      if (window.second <= window.first) continue;
+      if (!merged.empty() && window.first <= merged.back().second)
+        merged.back().second = std::max(merged.back().second, window.second);
+      else
+        merged.push_back(window);
+    }
+
+    for (auto const* waveform : opDetWaveforms) {
+
+      const double timeStamp = waveform->TimeStamp();
+      const double nSamples  = static_cast< double >(waveform->size());
+
+      for (auto const& window : merged) {
+
+        // Samples whose time is within [start, end)
+        const double first = std::max(0.,
+                               std::ceil((window.first  - timeStamp)/tickPeriod));
+        const double last  = std::min(nSamples,
+                               std::ceil((window.second - timeStamp)/tickPeriod));
+        if (first >= last) continue;
+
+        const size_t begin = static_cast< size_t >(first);
+        const size_t end   = static_cast< size_t >(last);
+
+        segments.emplace_back(timeStamp + begin*tickPeriod,
+                              waveform->ChannelNumber(),
+                              end - begin);
+        std::copy(waveform->begin() + begin, waveform->begin() + end,
+                  segments.back().begin());
+      }
+    }
+
+    return segments;
+  }
+
+
+  //----------------------------------------------------------------------------
+  void FindHitsInWaveform(raw::OpDetWaveform const&       waveform,
+                          std::vector< recob::OpHit >&    hitVector,
+                          pmtana::PulseRecoContext&       context,
+                          pmtana::PulseRecoManager const& pulseRecoMgr,
+                          size_t                          algoIndex,
+                          geo::GeometryCore const&        geometry,
+                          float                           hitThreshold,
+                          HitConstructor const&           hitConstructor) {
+
+    const int channel = static_cast< int >(waveform.ChannelNumber());
+
+    if (!geometry.IsValidOpChannel(channel)) {
+      mf::LogError("OpHitFinder") << "Error! unrecognized channel number "
+                       << channel << ". Ignoring pulse";
+      return;
+    }
+
+    context.channel = channel;
+    pulseRecoMgr.Reconstruct(waveform, context);
+
+    if (pulseRecoMgr.PulseTableMode())
+      hitConstructor.ConstructHits(hitThreshold,
+                                   channel,
+                                   waveform.TimeStamp(),
+                                   context.table_v[algoIndex],
+                                   hitVector);
+    else
+      hitConstructor.ConstructHits(hitThreshold,
+                                   channel,
+                                   waveform.TimeStamp(),
+                                   context.pulse_v[algoIndex],
+                                   hitVector);
+  }
+
+
+  //----------------------------------------------------------------------------
+  HitConstructor::HitConstructor(geo::GeometryCore const&        geometry,
+                                 detinfo::DetectorClocks const&  detectorClocks,
+                                 calib::IPhotonCalibrator const& calibrator,
+                                 bool                            affineCalibrator)
+    : HitConstructor(geometry.MaxOpChannel() + 1,
+                     detectorClocks.OpticalClock(),
+                     detectorClocks.TriggerTime(),
+                     calibrator,
+                     affineCalibrator)
+  {}
+
+
+  //----------------------------------------------------------------------------
+  HitConstructor::HitConstructor(size_t                          nChannels,
+                                 detinfo::ElecClock const&       opticalClock,
+                                 double                          triggerTime,
+                                 calib::IPhotonCalibrator const& calibrator,
+                                 bool                            affineCalibrator)
+    : fOpticalClock(opticalClock)
+    , fTickPeriod(opticalClock.TickPeriod())
+    , fTriggerTime(triggerTime)
+    , fCalibrator(&calibrator)
+    , fUseArea(calibrator.UseArea())
+    , fUseTable(affineCalibrator)
+  {
+    if (!fUseTable) return;
+
+    // Sample the conversion at 0 and 1 ADC, and check the declaration at a
+    // typical pulse size
+    const double probe = 1000.;
+
+    fPEScale.resize(nChannels);
+    fPEShift.resize(nChannels);
+
+    for (size_t channel = 0; channel < nChannels; ++channel) {
+      const int ch = static_cast< int >(channel);
+      fPEShift[channel] = calibrator.PE(0., ch);
+      fPEScale[channel] = calibrator.PE(1., ch) - fPEShift[channel];
+
+      const double expected = fPEScale[channel]*probe + fPEShift[channel];
+      const double actual   = calibrator.PE(probe, ch);
+      if (std::abs(actual - expected) > 1e-9*std::max(1., std::abs(actual)))
+        throw cet::exception("OpHitFinder")
+          << "Photon calibrator declared affine, but it gives " << actual
+          << " PE for " << probe << " ADC on channel " << channel
+          << " instead of " << expected << "\n";
+    }
+  }
+
+
+  //----------------------------------------------------------------------------
+  void HitConstructor::ConstructHits(float                             hitThreshold,
+                                     int                               channel,
+                                     double                            timeStamp,
+                                     pmtana::pulse_param_array const&  pulses,
+                                     std::vector< recob::OpHit >&      hitVector) const {
+
+    if (pulses.empty()) return;
+
+    // Constant over the waveform
+    const int frame = fOpticalClock.Frame(timeStamp);
+
+    const bool useTable = fUseTable
+                       && static_cast< size_t >(channel) < fPEScale.size();
+    const double scale = useTable ? fPEScale[channel] : 0.;
+    const double shift = useTable ? fPEShift[channel] : 0.;
+
+    hitVector.reserve(hitVector.size() + pulses.size());
+
+    for (auto const& pulse : pulses) {
+
+      if (pulse.peak < hitThreshold) continue;
+
+      const double adc = fUseArea ? pulse.area : pulse.peak;
+      const double PE  = useTable ? scale*adc + shift
+                                  : fCalibrator->PE(adc, channel);
+
+      const double absTime = timeStamp + pulse.t_max*fTickPeriod;
+
+      hitVector.emplace_back(channel,
+                             absTime - fTriggerTime,
+                             absTime,
+                             frame,
+                             (pulse.t_end - pulse.t_start)*fTickPeriod,
+                             pulse.area,
+                             pulse.peak,
+                             PE,
+                             0.0);
+    }
+  }
+
+
+  //----------------------------------------------------------------------------
+  void HitConstructor::ConstructHits(float                         hitThreshold,
+                                     int                           channel,
+                                     double                        timeStamp,
+                                     pmtana::pulse_table const&    pulses,
+                                     std::vector< recob::OpHit >&  hitVector) const {
+
+    const size_t nPulses = pulses.size();
+    if (nPulses == 0) return;
+
+    // Constant over the waveform
+    const int frame = fOpticalClock.Frame(timeStamp);
+
+    const bool useTable = fUseTable
+                       && static_cast< size_t >(channel) < fPEScale.size();
+    const double scale = useTable ? fPEScale[channel] : 0.;
+    const double shift = useTable ? fPEShift[channel] : 0.;
+
+    float const*   peak   = pulses.peak.data();
+    float const*   area   = pulses.area.data();
+    int32_t const* tStart = pulses.t_start.data();
+    int32_t const* tMax   = pulses.t_max.data();
+    int32_t const* tEnd   = pulses.t_end.data();
+
+    // Pulses above threshold, from the peak column alone
+    size_t nHits = 0;
+    for (size_t i = 0; i < nPulses; ++i) nHits += (peak[i] >= hitThreshold);
+    if (nHits == 0) return;
+
+    hitVector.reserve(hitVector.size() + nHits);
 
-      // Get the result
-      auto const& pulses = threshAlg.GetPulses();
+    for (size_t i = 0; i < nPulses; ++i) {
 
-      const double timeStamp = waveform.TimeStamp();
+      if (peak[i] < hitThreshold) continue;
 
+      const double adc = fUseArea ? area[i] : peak[i];
+      const double PE  = useTable ? scale*adc + shift
+                                  : fCalibrator->PE(adc, channel);
 
-      for (auto const& pulse : pulses)
-        ConstructHit(hitThreshold,
-                     channel,
-                     timeStamp,
-                     pulse,
-                     hitVector,
-                     detectorClocks,
-                     calibrator);
+      const double absTime = timeStamp + tMax[i]*fTickPeriod;
 
+      hitVector.emplace_back(channel,
+                             absTime - fTriggerTime,
+                             absTime,
+                             frame,
+                             (tEnd[i] - tStart[i])*fTickPeriod,
+                             area[i],
+                             peak[i],
+                             PE,
+                             0.0);
     }
   }
 
@@ -14,17 +14,23 @@
 #include "lardataobj/RawData/OpDetWaveform.h"
 #include "lardataobj/RecoBase/OpHit.h"
 #include "lardataalg/DetectorInfo/DetectorClocks.h"
+#include "lardataalg/DetectorInfo/ElecClock.h"
 #include "larreco/Calibrator/IPhotonCalibrator.h"
 #include "larana/OpticalDetector/OpHitFinder/PMTPulseRecoBase.h"
 
+#include <utility>
 #include <vector>
 
 namespace calib { class IPhotonCalibrator; }
 namespace detinfo { class DetectorClocks; }
-namespace pmtana { class PulseRecoManager; }
+namespace pmtana { class PulseRecoManager; struct PulseRecoContext; }
 
 namespace opdet{
 
+  class HitConstructor;
+
+  /// Appends the hits of the waveforms; affineCalibrator declares the
+  /// calibrator affine in ADC on every channel (see HitConstructor)
   void RunHitFinder(std::vector< raw::OpDetWaveform > const&,
                     std::vector< recob::OpHit >&,
                     pmtana::PulseRecoManager const&,
@@ -32,7 +38,169 @@ namespace opdet{
                     geo::GeometryCore const&,
                     float,
                     detinfo::DetectorClocks const&,
-                    calib::IPhotonCalibrator const&);
+                    calib::IPhotonCalibrator const&,
+                    bool affineCalibrator = false);
+
+  /// Waveforms referenced by pointer, e.g. from several collections, without copying them
+  using OpDetWaveformPtrs_t = std::vector< raw::OpDetWaveform const* >;
+
+  /// Same as above, for waveforms referenced by pointer
+  void RunHitFinder(OpDetWaveformPtrs_t const&,
+                    std::vector< recob::OpHit >&,
+                    pmtana::PulseRecoManager const&,
+                    pmtana::PMTPulseRecoBase const&,
+                    geo::GeometryCore const&,
+                    float,
+                    detinfo::DetectorClocks const&,
+                    calib::IPhotonCalibrator const&,
+                    bool affineCalibrator = false);
+
+  /// Same output as RunHitFinder, with blocks of waveformsPerTask waveforms
+  /// reconstructed concurrently; hits are merged back in waveform order
+  void RunHitFinderParallel(std::vector< raw::OpDetWaveform > const&,
+                            std::vector< recob::OpHit >&,
+                            pmtana::PulseRecoManager const&,
+                            pmtana::PMTPulseRecoBase const&,
+                            geo::GeometryCore const&,
+                            float,
+                            detinfo::DetectorClocks const&,
+                            calib::IPhotonCalibrator const&,
+                            size_t waveformsPerTask = 16,
+                            bool affineCalibrator = false);
+
+  /// Same as above, for waveforms referenced by pointer
+  void RunHitFinderParallel(OpDetWaveformPtrs_t const&,
+                            std::vector< recob::OpHit >&,
+                            pmtana::PulseRecoManager const&,
+                            pmtana::PMTPulseRecoBase const&,
+                            geo::GeometryCore const&,
+                            float,
+                            detinfo::DetectorClocks const&,
+                            calib::IPhotonCalibrator const&,
+                            size_t waveformsPerTask = 16,
+                            bool affineCalibrator = false);
+
+  /// Same as the above, with the hits made by the given constructor instead
+  /// of one made from the clocks and the calibrator; the constructor can be
+  /// built once for several calls (e.g. once per run)
+  void RunHitFinder(std::vector< raw::OpDetWaveform > const&,
+                    std::vector< recob::OpHit >&,
+                    pmtana::PulseRecoManager const&,
+                    pmtana::PMTPulseRecoBase const&,
+                    geo::GeometryCore const&,
+                    float,
+                    HitConstructor const&);
+
+  void RunHitFinder(OpDetWaveformPtrs_t const&,
+                    std::vector< recob::OpHit >&,
+                    pmtana::PulseRecoManager const&,
+                    pmtana::PMTPulseRecoBase const&,
+                    geo::GeometryCore const&,
+                    float,
+                    HitConstructor const&);
+
+  void RunHitFinderParallel(std::vector< raw::OpDetWaveform > const&,
+                            std::vector< recob::OpHit >&,
+                            pmtana::PulseRecoManager const&,
+                            pmtana::PMTPulseRecoBase const&,
+                            geo::GeometryCore const&,
+                            float,
+                            HitConstructor const&,
+                            size_t waveformsPerTask = 16);
+
+  void RunHitFinderParallel(OpDetWaveformPtrs_t const&,
+                            std::vector< recob::OpHit >&,
+                            pmtana::PulseRecoManager const&,
+                            pmtana::PMTPulseRecoBase const&,
+                            geo::GeometryCore const&,
+                            float,
+                            HitConstructor const&,
+                            size_t waveformsPerTask = 16);
+
+  /// Pointers to the waveforms of all the collections, in order, except those
+  /// on channels set in channelMask (indexed by channel number)
+  OpDetWaveformPtrs_t SelectWaveforms(
+      std::vector< std::vector< raw::OpDetWaveform > const* > const& collections,
+      std::vector< bool > const&                                  channelMask);
+
+  /// Constructs the hits of whole pulse arrays with the clock constants of
+  /// the event, instead of querying the clocks for each pulse. A calibrator
+  /// declared affine (PE = scale * ADC + shift on every channel) is sampled
+  /// into a per-channel table; any other is called for each pulse.
+  class HitConstructor {
+  public:
+
+    /// Throws if affineCalibrator is set but the calibrator is not affine
+    HitConstructor(geo::GeometryCore const&,
+                   detinfo::DetectorClocks const&,
+                   calib::IPhotonCalibrator const&,
+                   bool affineCalibrator = false);
+
+    /// Same as above, for channels [0, nChannels) and the given optical
+    /// clock and trigger time
+    HitConstructor(size_t nChannels,
+                   detinfo::ElecClock const&,
+                   double triggerTime,
+                   calib::IPhotonCalibrator const&,
+                   bool affineCalibrator = false);
+
+    /// Appends a hit for each pulse at or above hitThreshold (same hits as
+    /// ConstructHit, up to rounding of the PE conversion)
+    void ConstructHits(float,
+                       int,
+                       double,
+                       pmtana::pulse_param_array const&,
+                       std::vector< recob::OpHit >&) const;
+
+    /// Same as above for a compact pulse table, read column by column
+    /// (same hits, up to the single precision of the table amplitudes)
+    void ConstructHits(float,
+                       int,
+                       double,
+                       pmtana::pulse_table const&,
+                       std::vector< recob::OpHit >&) const;
+
+    /// Whether the calibrator was declared affine in ADC on every channel,
+    /// so that the table is used instead of calling it
+    bool UseTable() const { return fUseTable; }
+
+  private:
+
+    detinfo::ElecClock fOpticalClock;
+    double fTickPeriod;
+    double fTriggerTime;
+
+    calib::IPhotonCalibrator const* fCalibrator;
+    bool fUseArea;
+    bool fUseTable;
+    std::vector< double > fPEScale; ///< PE per ADC (or ADC x tick), by channel
+    std::vector< double > fPEShift; ///< PE at zero ADC, by channel
+  };
+
+  /// Time windows [start, end) in electronics time [us]
+  using TimeWindows_t = std::vector< std::pair< double, double > >;
+
+  /// Copies of the parts of the waveforms inside the time windows (overlapping
+  /// windows are merged), in waveform order; waveforms outside all windows are
+  /// dropped. Each part is time-stamped with the time of its first sample.
+  /// Unlike SelectWaveforms, this copies: the pedestal and pulse algorithms
+  /// take whole sample vectors (pmtana::Waveform_t) and the hits are timed
+  /// from the waveform time stamp, so a part cannot be a view of the original.
+  /// Only the samples inside the windows are copied.
+  std::vector< raw::OpDetWaveform > CropWaveforms(OpDetWaveformPtrs_t const&,
+                                                  TimeWindows_t,
+                                                  double tickPeriod);
+
+  /// Reconstructs one waveform using the scratch buffers in the context
+  /// and appends its hits to the hit vector
+  void FindHitsInWaveform(raw::OpDetWaveform const&,
+                          std::vector< recob::OpHit >&,
+                          pmtana::PulseRecoContext&,
+                          pmtana::PulseRecoManager const&,
+                          size_t,
+                          geo::GeometryCore const&,
+                          float,
+                          HitConstructor const&);
 
   void ConstructHit(float,
                     int,
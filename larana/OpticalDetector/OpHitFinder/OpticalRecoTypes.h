@@ -1,6 +1,9 @@
 #ifndef larana_OPTICALDETECTOR_OPTICALRECOTYPES_H
 #define larana_OPTICALDETECTOR_OPTICALRECOTYPES_H
 
+#include <complex>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 namespace pmtana {
@@ -9,5 +12,19 @@ namespace pmtana {
   typedef std::vector<double> PedestalMean_t;
   typedef std::vector<double> PedestalSigma_t;
 
+  /**
+   \struct RecoScratch
+   Caller-owned work buffers of the pulse and pedestal algorithms, kept in the PulseRecoContext
+   so that their capacity is reused from one waveform to the next. Like the context, a scratch
+   must not be shared between concurrent calls.
+  */
+  struct RecoScratch {
+    std::vector<double> baseline_diff; ///< Baseline-subtracted samples (AlgoSlidingWindow)
+    std::vector<double> cfd;           ///< Constant fraction signal (AlgoCFD)
+    std::vector<std::pair<unsigned,double> > crossings; ///< CFD zero crossings (AlgoCFD)
+    std::vector<size_t> histogram;     ///< Mode-finding histogram (PedAlgoRollingMean)
+    std::vector<std::complex<double> > fft_buffer; ///< Zero-padded waveform (AlgoDeconvolution)
+  };
+
 }
 #endif
@@ -30,22 +30,122 @@ namespace pmtana{
   bool PMTPedestalBase::Evaluate(const ::pmtana::Waveform_t& wf)
   //************************************************************
   {
-    _mean_v.resize(wf.size(),0);
-    _sigma_v.resize(wf.size(),0);
+    return Evaluate(wf, _mean_v, _sigma_v);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::Evaluate(const ::pmtana::Waveform_t& wf,
+				 ::pmtana::PedestalMean_t&   mean_v,
+				 ::pmtana::PedestalSigma_t&  sigma_v) const
+  //**********************************************************************
+  {
+    return Evaluate(wf, -1, mean_v, sigma_v);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::Evaluate(const ::pmtana::Waveform_t& wf,
+				 int channel,
+				 ::pmtana::PedestalMean_t&   mean_v,
+				 ::pmtana::PedestalSigma_t&  sigma_v) const
+  //**********************************************************************
+  {
+    RecoScratch scratch;
+    return Evaluate(wf, channel, mean_v, sigma_v, scratch);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::Evaluate(const ::pmtana::Waveform_t& wf,
+				 int channel,
+				 ::pmtana::PedestalMean_t&   mean_v,
+				 ::pmtana::PedestalSigma_t&  sigma_v,
+				 ::pmtana::RecoScratch&      scratch) const
+  //**********************************************************************
+  {
+    mean_v.resize(wf.size(),0);
+    sigma_v.resize(wf.size(),0);
 
     for(size_t i=0; i<wf.size(); ++i)
-      _mean_v[i] = _sigma_v[i] = 0;
+      mean_v[i] = sigma_v[i] = 0;
 
-    const bool res = ComputePedestal(wf, _mean_v, _sigma_v);
+    const bool res = ComputeChannelPedestal(wf, channel, mean_v, sigma_v, scratch);
 
-    if(wf.size() != _mean_v.size())
+    if(wf.size() != mean_v.size())
       throw OpticalRecoException("Internal error: computed pedestal mean array length changed!");
-    if(wf.size() != _sigma_v.size())
+    if(wf.size() != sigma_v.size())
       throw OpticalRecoException("Internal error: computed pedestal sigma array length changed!");
 
     return res;
   }
 
+  //**********************************************************************
+  bool PMTPedestalBase::EvaluateConstant(const ::pmtana::Waveform_t& wf,
+					 double& ped_mean,
+					 double& ped_sigma) const
+  //**********************************************************************
+  {
+    if(!IsConstant(wf)) {
+      std::stringstream ss;
+      ss << "Pedestal algorithm " << Name() << " does not support a constant pedestal";
+      throw OpticalRecoException(ss.str());
+    }
+
+    ped_mean = ped_sigma = 0;
+
+    return ComputeConstantPedestal(wf, ped_mean, ped_sigma);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::ComputePedestalWithScratch(const ::pmtana::Waveform_t& wf,
+						   ::pmtana::PedestalMean_t&   mean_v,
+						   ::pmtana::PedestalSigma_t&  sigma_v,
+						   ::pmtana::RecoScratch&) const
+  //**********************************************************************
+  {
+    return ComputePedestal(wf, mean_v, sigma_v);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::ComputeChannelPedestal(const ::pmtana::Waveform_t& wf,
+					       int,
+					       ::pmtana::PedestalMean_t&   mean_v,
+					       ::pmtana::PedestalSigma_t&  sigma_v,
+					       ::pmtana::RecoScratch&      scratch) const
+  //**********************************************************************
+  {
+    return ComputePedestalWithScratch(wf, mean_v, sigma_v, scratch);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::ComputeConstantPedestal(const ::pmtana::Waveform_t&,
+						double&,
+						double&) const
+  //**********************************************************************
+  {
+    std::stringstream ss;
+    ss << "Pedestal algorithm " << Name() << " does not implement ComputeConstantPedestal";
+    throw OpticalRecoException(ss.str());
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::EvaluateChunk(const short* samples, size_t n,
+				      ::pmtana::PedestalChunkState& state) const
+  //**********************************************************************
+  {
+    if(state.ready) return true;
+
+    return ComputeChunk(samples, n, state);
+  }
+
+  //**********************************************************************
+  bool PMTPedestalBase::ComputeChunk(const short*, size_t,
+				     ::pmtana::PedestalChunkState&) const
+  //**********************************************************************
+  {
+    std::stringstream ss;
+    ss << "Pedestal algorithm " << Name() << " does not support a chunked pedestal";
+    throw OpticalRecoException(ss.str());
+  }
+
   //*******************************************
   double PMTPedestalBase::Mean(size_t i) const
   //*******************************************
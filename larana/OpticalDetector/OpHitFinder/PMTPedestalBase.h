@@ -16,11 +16,27 @@
 
 // STL
 #include "OpticalRecoTypes.h"
+#include <cstdint>
 #include <string>
 
 namespace pmtana
 {
 
+  /**
+   \struct PedestalChunkState
+   State of the constant pedestal of a waveform delivered in consecutive chunks
+   (see PMTPedestalBase::EvaluateChunk): running sums of the samples used so far,
+   and the pedestal once all of them are in.
+  */
+  struct PedestalChunkState {
+    size_t  nsample   = 0;      ///< Samples used so far
+    int64_t sum       = 0;      ///< Sum of the samples used
+    int64_t sum2      = 0;      ///< Sum of their squares
+    bool    ready     = false;  ///< The pedestal is known
+    double  ped_mean  = 0;
+    double  ped_sigma = 0;
+  };
+
   /**
    \class PMTPedestalBase
    A base class for pedestal calculation
@@ -41,6 +57,59 @@ namespace pmtana
     /// Method to compute a pedestal
     bool Evaluate(const pmtana::Waveform_t& wf);
 
+    /**
+       Re-entrant version of Evaluate: the pedestal is computed into the caller-owned arrays,
+       which are resized to the waveform length. The algorithm object is not modified.
+    */
+    bool Evaluate(const pmtana::Waveform_t& wf,
+		  pmtana::PedestalMean_t&   mean_v,
+		  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /**
+       Re-entrant Evaluate for a waveform from a known readout channel (negative if unknown),
+       for algorithms which keep per-channel state across waveforms.
+    */
+    bool Evaluate(const pmtana::Waveform_t& wf,
+		  int channel,
+		  pmtana::PedestalMean_t&   mean_v,
+		  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /// Same as above, with the algorithm work buffers in a caller-owned scratch
+    bool Evaluate(const pmtana::Waveform_t& wf,
+		  int channel,
+		  pmtana::PedestalMean_t&   mean_v,
+		  pmtana::PedestalSigma_t&  sigma_v,
+		  pmtana::RecoScratch&      scratch) const;
+
+    /// True if the algorithm finds a single pedestal value for this waveform (see EvaluateConstant)
+    virtual bool IsConstant(const pmtana::Waveform_t&) const { return false; }
+
+    /**
+       True if the pedestal mean always lies between the smallest and the largest sample of the
+       waveform (up to rounding), e.g. because it is an average or an interpolation of samples.
+       Used by the PulseRecoManager prefilter.
+    */
+    virtual bool MeanWithinSampleRange() const { return false; }
+
+    /**
+       Streaming version of Evaluate for waveforms which are IsConstant(): the pedestal mean
+       and sigma of the whole waveform are computed without any per-sample array.
+    */
+    bool EvaluateConstant(const pmtana::Waveform_t& wf,
+			  double& ped_mean,
+			  double& ped_sigma) const;
+
+    /// True if the algorithm implements the chunked constant pedestal (EvaluateChunk)
+    virtual bool SupportsChunks() const { return false; }
+
+    /**
+       Chunked version of EvaluateConstant, for waveforms which are not held whole: the next n
+       samples are added to the running sums of the state, starting from a default state. Returns
+       true once the pedestal is known (state.ready), the same as EvaluateConstant would give;
+       samples after that are not needed.
+    */
+    bool EvaluateChunk(const short* samples, size_t n, pmtana::PedestalChunkState& state) const;
+
     /// Getter of the pedestal mean value
     double Mean(size_t i) const;
 
@@ -58,10 +127,45 @@ namespace pmtana
     /**
        Method to compute pedestal: mean and sigma array should be filled per ADC.
        The length of each array is guaranteed to be same.
+       Must not modify the algorithm state (see re-entrant Evaluate).
     */
     virtual bool ComputePedestal( const ::pmtana::Waveform_t& wf,
 				  pmtana::PedestalMean_t&   mean_v,
-				  pmtana::PedestalSigma_t&  sigma_v) = 0;
+				  pmtana::PedestalSigma_t&  sigma_v) const = 0;
+
+    /**
+       Version of ComputePedestal with caller-owned work buffers, same requirements. The default
+       ignores the scratch: algorithms which need work buffers should override it, and implement
+       ComputePedestal with a local scratch. It has its own name so that overriding one does not
+       hide the other.
+    */
+    virtual bool ComputePedestalWithScratch( const ::pmtana::Waveform_t& wf,
+					     pmtana::PedestalMean_t&   mean_v,
+					     pmtana::PedestalSigma_t&  sigma_v,
+					     pmtana::RecoScratch&      scratch) const;
+
+    /**
+       Channel-aware version of ComputePedestal, same requirements.
+       The default implementation ignores the channel.
+    */
+    virtual bool ComputeChannelPedestal( const ::pmtana::Waveform_t& wf,
+					 int channel,
+					 pmtana::PedestalMean_t&   mean_v,
+					 pmtana::PedestalSigma_t&  sigma_v,
+					 pmtana::RecoScratch&      scratch) const;
+
+    /**
+       Method to compute a single pedestal mean and sigma for the whole waveform.
+       Must be implemented by algorithms which can be IsConstant(), and give the same
+       values as ComputePedestal for those waveforms.
+    */
+    virtual bool ComputeConstantPedestal( const ::pmtana::Waveform_t& wf,
+					  double& ped_mean,
+					  double& ped_sigma) const;
+
+    /// Chunked implementation (see EvaluateChunk) for algorithms which SupportsChunks
+    virtual bool ComputeChunk( const short* samples, size_t n,
+			       pmtana::PedestalChunkState& state) const;
 
   private:
 
@@ -5,9 +5,10 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "PMTPulseRecoBase.h"
+#include "WaveformKernels.h"
+#include "OpticalRecoException.h"
 
 #include <iostream>
-#include <numeric>
 
 namespace pmtana{
 
@@ -33,10 +34,193 @@ namespace pmtana{
 				      const PedestalSigma_t& sigma_v )
   //******************************************************************
   {
-    _status = this->RecoPulse(wf,mean_v,sigma_v);
+    _status = this->RecoPulse(wf,mean_v,sigma_v,_pulse_v);
     return _status;
   }
 
+  //******************************************************************
+  bool PMTPulseRecoBase::Reconstruct( const Waveform_t& wf,
+				      const PedestalMean_t& mean_v,
+				      const PedestalSigma_t& sigma_v,
+				      pulse_param_array& pulses ) const
+  //******************************************************************
+  {
+    return this->RecoPulse(wf,mean_v,sigma_v,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::Reconstruct( const Waveform_t& wf,
+				      const PedestalMean_t& mean_v,
+				      const PedestalSigma_t& sigma_v,
+				      pulse_param_array& pulses,
+				      RecoScratch& scratch ) const
+  //******************************************************************
+  {
+    return this->RecoPulseWithScratch(wf,mean_v,sigma_v,pulses,scratch);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoPulseWithScratch( const Waveform_t& wf,
+					       const PedestalMean_t& mean_v,
+					       const PedestalSigma_t& sigma_v,
+					       pulse_param_array& pulses,
+					       RecoScratch& ) const
+  //******************************************************************
+  {
+    return this->RecoPulse(wf,mean_v,sigma_v,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::Reconstruct( const Waveform_t& wf,
+				      double ped_mean,
+				      double ped_sigma,
+				      pulse_param_array& pulses ) const
+  //******************************************************************
+  {
+    return this->RecoPulseConstantPedestal(wf,ped_mean,ped_sigma,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::Reconstruct( const Waveform_t& wf,
+				      double ped_mean,
+				      double ped_sigma,
+				      pulse_param_array& pulses,
+				      RecoScratch& scratch ) const
+  //******************************************************************
+  {
+    return this->RecoPulseConstantPedestalWithScratch(wf,ped_mean,ped_sigma,pulses,scratch);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoPulseConstantPedestalWithScratch( const Waveform_t& wf,
+							       double ped_mean,
+							       double ped_sigma,
+							       pulse_param_array& pulses,
+							       RecoScratch& ) const
+  //******************************************************************
+  {
+    return this->RecoPulseConstantPedestal(wf,ped_mean,ped_sigma,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoPulseConstantPedestal( const Waveform_t& wf,
+						    double ped_mean,
+						    double ped_sigma,
+						    pulse_param_array& pulses ) const
+  //******************************************************************
+  {
+    const PedestalMean_t  mean_v (wf.size(), ped_mean);
+    const PedestalSigma_t sigma_v(wf.size(), ped_sigma);
+
+    return this->RecoPulse(wf,mean_v,sigma_v,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::Reconstruct( const Waveform_t& wf,
+				      double ped_mean,
+				      double ped_sigma,
+				      pulse_table& pulses ) const
+  //******************************************************************
+  {
+    return this->RecoPulseTable(wf,ped_mean,ped_sigma,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoPulseTable( const Waveform_t& wf,
+					 double ped_mean,
+					 double ped_sigma,
+					 pulse_table& pulses ) const
+  //******************************************************************
+  {
+    pulse_param_array array;
+    const bool res = this->RecoPulseConstantPedestal(wf,ped_mean,ped_sigma,array);
+    pulses.assign(array);
+    return res;
+  }
+
+  //******************************************************************
+  void PMTPulseRecoBase::BeginChunks( double ped_mean,
+				      double ped_sigma,
+				      PulseChunkState& state ) const
+  //******************************************************************
+  {
+    state = PulseChunkState();
+    state.ped_mean  = ped_mean;
+    state.ped_sigma = ped_sigma;
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::ReconstructChunk( const short* samples, size_t n,
+					   PulseChunkState& state,
+					   pulse_param_array& pulses ) const
+  //******************************************************************
+  {
+    const bool res = this->RecoChunk(samples,n,state,pulses);
+    state.offset += n;
+    return res;
+  }
+
+  //******************************************************************
+  void PMTPulseRecoBase::EndChunks( PulseChunkState& state,
+				    pulse_param_array& pulses ) const
+  //******************************************************************
+  {
+    this->CloseChunks(state,pulses);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoChunk( const short*, size_t,
+				    PulseChunkState&,
+				    pulse_param_array& ) const
+  //******************************************************************
+  {
+    throw OpticalRecoException("Pulse algorithm " + _name + " does not support chunked reconstruction");
+  }
+
+  //******************************************************************
+  void PMTPulseRecoBase::CloseChunks( PulseChunkState&,
+				      pulse_param_array& ) const
+  //******************************************************************
+  {
+    throw OpticalRecoException("Pulse algorithm " + _name + " does not support chunked reconstruction");
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::ReconstructBatch( const std::vector<const Waveform_t*>& wfs,
+					   const std::vector<double>& ped_mean,
+					   const std::vector<double>& ped_sigma,
+					   const std::vector<pulse_param_array*>& pulses,
+					   std::vector<short>& scratch ) const
+  //******************************************************************
+  {
+    if(ped_mean.size() != wfs.size() || ped_sigma.size() != wfs.size() || pulses.size() != wfs.size())
+      throw OpticalRecoException("Batch reconstruction needs one pedestal and pulse array per waveform");
+
+    bool equal_length = true;
+    for(auto const* wf : wfs) equal_length = equal_length && wf->size() == wfs.front()->size();
+
+    if(equal_length && this->SupportsBatch())
+      return this->RecoBatch(wfs,ped_mean,ped_sigma,pulses,scratch);
+
+    return PMTPulseRecoBase::RecoBatch(wfs,ped_mean,ped_sigma,pulses,scratch);
+  }
+
+  //******************************************************************
+  bool PMTPulseRecoBase::RecoBatch( const std::vector<const Waveform_t*>& wfs,
+				    const std::vector<double>& ped_mean,
+				    const std::vector<double>& ped_sigma,
+				    const std::vector<pulse_param_array*>& pulses,
+				    std::vector<short>& ) const
+  //******************************************************************
+  {
+    bool status = true;
+
+    for(size_t i=0; i<wfs.size(); ++i)
+      status = this->RecoPulseConstantPedestal(*wfs[i],ped_mean[i],ped_sigma[i],*pulses[i]) && status;
+
+    return status;
+  }
+
   //*****************************************************************************
   bool CheckIndex(const std::vector<short> &wf, const size_t &begin, size_t &end)
   //*****************************************************************************
@@ -57,8 +241,6 @@ namespace pmtana{
   void PMTPulseRecoBase::Reset()
   //***************************************************************
   {
-    _pulse.reset_param();
-
     _pulse_v.clear();
 
     _pulse_v.reserve(3);
@@ -100,15 +282,11 @@ namespace pmtana{
 
     if(!CheckIndex(wf,begin,end)) return false;
 
-    std::vector<short>::const_iterator begin_iter(wf.begin());
-
-    std::vector<short>::const_iterator end_iter(wf.begin());
-
-    begin_iter = begin_iter + begin;
+    int64_t sum, sum2;
 
-    end_iter = end_iter + end + 1;
+    WindowSums(wf.data() + begin, end - begin + 1, sum, sum2);
 
-    result = (double)(std::accumulate(begin_iter, end_iter, 0));
+    result = (double)sum;
 
     return true;
   }
@@ -151,9 +329,9 @@ namespace pmtana{
 
     if(CheckIndex(wf,begin,end)) {
 
-      for(size_t index = begin; index <= end; ++index)
+      size_t index = begin + ArgMax(wf.data() + begin, end - begin + 1);
 
-	if( result < wf.at(index)) { target_index = index; result = (double)(wf.at(index)); }
+      if( result < wf[index]) { target_index = index; result = (double)(wf[index]); }
 
     }
 
@@ -175,9 +353,9 @@ namespace pmtana{
 
     if(CheckIndex(wf,begin,end)) {
 
-      for(size_t index = begin; index <= end; ++index)
+      size_t index = begin + ArgMin(wf.data() + begin, end - begin + 1);
 
-	if( result > wf.at(index)) { target_index = index; result = (double)(wf.at(index)); }
+      if( result > wf[index]) { target_index = index; result = (double)(wf[index]); }
 
     }
 
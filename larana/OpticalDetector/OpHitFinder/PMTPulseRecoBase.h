@@ -16,6 +16,7 @@
 #define PMTPULSERECOBASE_H
 
 // STL
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -48,6 +49,65 @@ namespace pmtana
 
   typedef std::vector<pmtana::pulse_param> pulse_param_array;
 
+  /**
+   \struct pulse_table
+   Compact structure-of-arrays alternative to pulse_param_array holding the pulse parameters used
+   to make hits, one column per parameter: tick indices as integers and amplitudes in single
+   precision. Pedestal and CFD crossing are not kept (the pedestal is known per waveform).
+  */
+  struct pulse_table{
+  public:
+    std::vector<int32_t> t_start, t_max, t_end;
+    std::vector<float>   peak, area;
+
+    size_t size() const { return peak.size(); }
+
+    bool empty() const { return peak.empty(); }
+
+    void clear(){
+      t_start.clear(); t_max.clear(); t_end.clear();
+      peak.clear(); area.clear();
+    }
+
+    void reserve(size_t n){
+      t_start.reserve(n); t_max.reserve(n); t_end.reserve(n);
+      peak.reserve(n); area.reserve(n);
+    }
+
+    /// Appends a pulse (ticks are whole numbers for all the algorithms)
+    void push_back(const pulse_param& pulse){
+      t_start.push_back((int32_t)pulse.t_start);
+      t_max  .push_back((int32_t)pulse.t_max);
+      t_end  .push_back((int32_t)pulse.t_end);
+      peak   .push_back((float)pulse.peak);
+      area   .push_back((float)pulse.area);
+    }
+
+    /// Replaces the content with the pulses of an array
+    void assign(const pulse_param_array& pulses){
+      clear();
+      reserve(pulses.size());
+      for(auto const& pulse : pulses) push_back(pulse);
+    }
+
+  };
+
+  /**
+   \struct PulseChunkState
+   State of the reconstruction of a waveform delivered in consecutive chunks
+   (see PMTPulseRecoBase::ReconstructChunk): the pedestal, the position in the
+   waveform and the pulse still open at the end of the last chunk.
+  */
+  struct PulseChunkState {
+    double ped_mean  = 0;
+    double ped_sigma = 0;
+    size_t offset    = 0;      ///< Waveform index of the first sample of the next chunk
+    bool   fire      = false;  ///< A pulse is open
+    bool   first_found = false; ///< The first peak of the open pulse was found (AlgoSiPM)
+    bool   record_hit  = false; ///< The open pulse passed the hit threshold (AlgoSiPM)
+    pulse_param pulse;         ///< Open pulse
+  };
+
   /**
    \class PMTPulseRecoBase
    The base class of pulse reconstruction algorithms. All algorithms should inherit from this calss
@@ -89,6 +149,84 @@ namespace pmtana
 		      const pmtana::PedestalMean_t&,
 		      const pmtana::PedestalSigma_t& );
 
+    /** Re-entrant version of Reconstruct: reconstructed pulses are stored in the caller-owned
+      pulse_param_array instead of the algorithm. The algorithm object is not modified, so one
+      instance can serve any number of waveforms concurrently as long as each call uses its own array.
+    */
+    bool Reconstruct( const pmtana::Waveform_t&,
+		      const pmtana::PedestalMean_t&,
+		      const pmtana::PedestalSigma_t&,
+		      pmtana::pulse_param_array& ) const;
+
+    /// Same as above, with the algorithm work buffers in a caller-owned scratch
+    bool Reconstruct( const pmtana::Waveform_t&,
+		      const pmtana::PedestalMean_t&,
+		      const pmtana::PedestalSigma_t&,
+		      pmtana::pulse_param_array&,
+		      pmtana::RecoScratch& ) const;
+
+    /** Streaming version of the re-entrant Reconstruct for a pedestal which is constant over the
+      waveform (see PMTPedestalBase::IsConstant): no per-sample pedestal array is needed.
+    */
+    bool Reconstruct( const pmtana::Waveform_t&,
+		      double ped_mean,
+		      double ped_sigma,
+		      pmtana::pulse_param_array& ) const;
+
+    /// Same as above, with the algorithm work buffers in a caller-owned scratch
+    bool Reconstruct( const pmtana::Waveform_t&,
+		      double ped_mean,
+		      double ped_sigma,
+		      pmtana::pulse_param_array&,
+		      pmtana::RecoScratch& ) const;
+
+    /** Version of the streaming Reconstruct filling a compact pulse_table, which is cleared first.
+      The pulses are the same as the ones of the streaming Reconstruct, up to the table precision.
+    */
+    bool Reconstruct( const pmtana::Waveform_t&,
+		      double ped_mean,
+		      double ped_sigma,
+		      pmtana::pulse_table& ) const;
+
+    /// True if the algorithm implements the chunked reconstruction (ReconstructChunk)
+    virtual bool SupportsChunks() const { return false; }
+
+    /// Starts the chunked reconstruction of a waveform with a constant pedestal
+    void BeginChunks( double ped_mean, double ped_sigma, pmtana::PulseChunkState& ) const;
+
+    /** Chunked version of the streaming Reconstruct: the next n samples of the waveform are
+      processed and the pulses they complete are appended to the array. A pulse open at the end of
+      the chunk is carried in the state. After the last chunk, EndChunks must be called. The pulses
+      are the same as the ones of the streaming Reconstruct of the whole waveform.
+    */
+    bool ReconstructChunk( const short* samples, size_t n,
+			   pmtana::PulseChunkState&,
+			   pmtana::pulse_param_array& ) const;
+
+    /// Ends the chunked reconstruction: a pulse still open is closed at the last sample
+    void EndChunks( pmtana::PulseChunkState&, pmtana::pulse_param_array& ) const;
+
+    /// True if the algorithm reconstructs batches of waveforms side by side (ReconstructBatch)
+    virtual bool SupportsBatch() const { return false; }
+
+    /** Batched version of the streaming Reconstruct: waveform i, with constant pedestal
+      ped_mean[i] and ped_sigma[i], gets its pulses in *pulses[i]. If all the waveforms have the
+      same length, algorithms which SupportsBatch process up to NumBatchLanes of them at once in
+      the lanes of a sample-interleaved copy kept in scratch; otherwise they are reconstructed one
+      by one. The pulses are the same as the ones of the streaming Reconstruct.
+    */
+    bool ReconstructBatch( const std::vector<const pmtana::Waveform_t*>& wfs,
+			   const std::vector<double>& ped_mean,
+			   const std::vector<double>& ped_sigma,
+			   const std::vector<pmtana::pulse_param_array*>& pulses,
+			   std::vector<short>& scratch ) const;
+
+    /** True if pulse peaks are measured from the pedestal mean (sample minus mean, or the opposite
+      for negative polarity), so no peak exceeds the max-min spread of the waveform samples when the
+      pedestal lies within them. Used by the PulseRecoManager prefilter.
+    */
+    virtual bool PeakWithinSampleSpread() const { return false; }
+
     /** A getter for the pulse_param struct object.
       Reconstruction algorithm may have more than one pulse reconstructed from an input waveform.
       Note you must, accordingly, provide an index key to specify which pulse_param object to be retrieved.
@@ -111,16 +249,73 @@ namespace pmtana
 
   protected:
 
+    /**
+     Algorithm implementation: reconstructed pulses must be appended to the output array, which is
+     cleared by the implementation first. Must not modify the algorithm state (see re-entrant Reconstruct).
+    */
     virtual bool RecoPulse( const pmtana::Waveform_t&,
 			    const pmtana::PedestalMean_t&,
-			    const pmtana::PedestalSigma_t&     ) = 0;
+			    const pmtana::PedestalSigma_t&,
+			    pmtana::pulse_param_array& ) const = 0;
+
+    /**
+     Version of RecoPulse with caller-owned work buffers, same requirements. The default ignores
+     the scratch: algorithms which need work buffers should override it, and implement RecoPulse
+     with a local scratch. It has its own name so that overriding one does not hide the other.
+    */
+    virtual bool RecoPulseWithScratch( const pmtana::Waveform_t&,
+				       const pmtana::PedestalMean_t&,
+				       const pmtana::PedestalSigma_t&,
+				       pmtana::pulse_param_array&,
+				       pmtana::RecoScratch& ) const;
+
+    /**
+     Algorithm implementation for a constant pedestal, with the same output as RecoPulse.
+     The default fills per-sample pedestal arrays and calls RecoPulse: algorithms which can
+     process the waveform in a single pass without them should override it.
+    */
+    virtual bool RecoPulseConstantPedestal( const pmtana::Waveform_t&,
+					    double ped_mean,
+					    double ped_sigma,
+					    pmtana::pulse_param_array& ) const;
+
+    /// Version of RecoPulseConstantPedestal with caller-owned work buffers, same requirements.
+    /// The default ignores the scratch, as for RecoPulseWithScratch.
+    virtual bool RecoPulseConstantPedestalWithScratch( const pmtana::Waveform_t&,
+						       double ped_mean,
+						       double ped_sigma,
+						       pmtana::pulse_param_array&,
+						       pmtana::RecoScratch& ) const;
+
+    /**
+     Algorithm implementation for a constant pedestal filling a pulse_table. The default calls
+     RecoPulseConstantPedestal and copies the pulses: algorithms should override it to append
+     pulses to the table as they find them.
+    */
+    virtual bool RecoPulseTable( const pmtana::Waveform_t&,
+				 double ped_mean,
+				 double ped_sigma,
+				 pmtana::pulse_table& ) const;
+
+    /// Chunked implementation (see ReconstructChunk) for algorithms which SupportsChunks
+    virtual bool RecoChunk( const short* samples, size_t n,
+			    pmtana::PulseChunkState&,
+			    pmtana::pulse_param_array& ) const;
+
+    /// Closes the pulse open at the end of the waveform, for algorithms which SupportsChunks
+    virtual void CloseChunks( pmtana::PulseChunkState&, pmtana::pulse_param_array& ) const;
+
+    /// Batched implementation (see ReconstructBatch) for waveforms of equal length, for
+    /// algorithms which SupportsBatch. The default reconstructs the waveforms one by one.
+    virtual bool RecoBatch( const std::vector<const pmtana::Waveform_t*>& wfs,
+			    const std::vector<double>& ped_mean,
+			    const std::vector<double>& ped_sigma,
+			    const std::vector<pmtana::pulse_param_array*>& pulses,
+			    std::vector<short>& scratch ) const;
 
     /// A container array of pulse_param struct objects to store (possibly multiple) reconstructed pulse(s).
     pulse_param_array _pulse_v;
 
-    /// A subject pulse_param object to be filled with the last reconstructed pulse parameters
-    pulse_param _pulse;
-
   protected:
 
     /**
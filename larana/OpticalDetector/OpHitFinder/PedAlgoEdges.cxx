@@ -7,9 +7,13 @@
 #include "PedAlgoEdges.h"
 #include "UtilFunc.h"
 #include "OpticalRecoException.h"
+#include "WaveformKernels.h"
 
 #include "fhiclcpp/ParameterSet.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace pmtana{
 
   //************************************************
@@ -43,30 +47,40 @@ namespace pmtana{
   //*********************************************************************
   bool PedAlgoEdges::ComputePedestal( const pmtana::Waveform_t& wf,
 				      pmtana::PedestalMean_t&   mean_v,
-				      pmtana::PedestalSigma_t&  sigma_v)
+				      pmtana::PedestalSigma_t&  sigma_v) const
   //*********************************************************************
   {
 
     double ped_mean=0;
     double ped_sigma=0;
+
+    const bool res = ComputeConstantPedestal(wf, ped_mean, ped_sigma);
+
+    for( auto &v : mean_v  ) v = ped_mean;
+    for( auto &v : sigma_v ) v = ped_sigma;
+
+    return res;
+
+  }
+
+  //*********************************************************************
+  bool PedAlgoEdges::ComputeConstantPedestal( const pmtana::Waveform_t& wf,
+					      double& ped_mean,
+					      double& ped_sigma) const
+  //*********************************************************************
+  {
+
     switch(_method) {
     case kHEAD:
-      ped_mean  = mean ( wf, 0, _nsample_front);
-      ped_sigma = std  ( wf, ped_mean, 0, _nsample_front);
-      for( auto &v : mean_v  ) v = ped_mean;
-      for( auto &v : sigma_v ) v = ped_sigma;
+      mean_std ( wf, ped_mean, ped_sigma, 0, _nsample_front);
       break;
     case kTAIL:
-      ped_mean  = mean ( wf, (wf.size() - _nsample_tail), _nsample_tail);
-      ped_sigma = std  ( wf, ped_mean, (wf.size() - _nsample_tail), _nsample_tail);
-      for( auto &v : mean_v  ) v = ped_mean;
-      for( auto &v : sigma_v ) v = ped_sigma;
+      mean_std ( wf, ped_mean, ped_sigma, (wf.size() - _nsample_tail), _nsample_tail);
       break;
     case kBOTH:
-      double ped_mean_head  = mean ( wf, 0, _nsample_front);
-      double ped_sigma_head = std  ( wf, ped_mean_head, 0, _nsample_front);
-      double ped_mean_tail  = mean ( wf, (wf.size() - _nsample_tail), _nsample_tail);
-      double ped_sigma_tail = std  ( wf, ped_mean_tail, (wf.size() - _nsample_tail), _nsample_tail);
+      double ped_mean_head, ped_sigma_head, ped_mean_tail, ped_sigma_tail;
+      mean_std ( wf, ped_mean_head, ped_sigma_head, 0, _nsample_front);
+      mean_std ( wf, ped_mean_tail, ped_sigma_tail, (wf.size() - _nsample_tail), _nsample_tail);
 
       ped_mean  = ped_mean_head;
       ped_sigma = ped_sigma_head;
@@ -74,12 +88,37 @@ namespace pmtana{
 	ped_mean  = ped_mean_tail;
 	ped_sigma = ped_sigma_tail;
       }
-      for( auto &v : mean_v  ) v = ped_mean;
-      for( auto &v : sigma_v ) v = ped_sigma;
       break;
     }
     return true;
 
   }
 
+  //*********************************************************************
+  bool PedAlgoEdges::ComputeChunk( const short* samples, size_t n,
+				   pmtana::PedestalChunkState& state) const
+  //*********************************************************************
+  {
+    if(!SupportsChunks()) throw OpticalRecoException("PedAlgoEdges supports a chunked pedestal only with the head method");
+
+    const size_t nused = std::min(n, _nsample_front - state.nsample);
+
+    int64_t sum, sum2;
+    WindowSums(samples, nused, sum, sum2);
+
+    state.sum     += sum;
+    state.sum2    += sum2;
+    state.nsample += nused;
+
+    if(state.nsample < _nsample_front) return false;
+
+    // Same as mean_std over the head samples
+    const double nd = state.nsample;
+    state.ped_mean  = state.sum / nd;
+    state.ped_sigma = sqrt((double)((int64_t)state.nsample*state.sum2 - state.sum*state.sum) / (nd*nd));
+    state.ready     = true;
+
+    return true;
+  }
+
 }
@@ -46,12 +46,31 @@ namespace pmtana
       kTAIL,     ///< Use last N samples
       kBOTH      ///< Calculate both and use the one with smaller RMS
     };
+
+    /// The pedestal is always one value per waveform
+    bool IsConstant(const pmtana::Waveform_t&) const { return true; }
+
+    /// The pedestal is the mean of head and/or tail samples
+    bool MeanWithinSampleRange() const { return true; }
+
+    /// With the head method, the pedestal is known after the first NumSampleFront samples
+    bool SupportsChunks() const { return _method == kHEAD && _nsample_front; }
+
   protected:
 
     /// Method to compute a pedestal of the input waveform using "nsample" ADC samples from "start" index.
     bool ComputePedestal( const pmtana::Waveform_t& wf,
 			  pmtana::PedestalMean_t&   mean_v,
-			  pmtana::PedestalSigma_t&  sigma_v);
+			  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /// Method to compute the single pedestal value used for the whole waveform
+    bool ComputeConstantPedestal( const pmtana::Waveform_t& wf,
+				  double& ped_mean,
+				  double& ped_sigma) const;
+
+    /// Running sums of the head samples
+    bool ComputeChunk( const short* samples, size_t n,
+		       pmtana::PedestalChunkState& state) const;
 
   private:
     size_t _nsample_front; ///< # ADC sample in front to be used
@@ -5,13 +5,11 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "PedAlgoRmsSlider.h"
-#include "OpticalRecoException.h"
 #include "UtilFunc.h"
 #include "fhiclcpp/ParameterSet.h"
 
 #include <iostream>
 #include <fstream>
-#include <numeric>
 
 namespace pmtana{
 
@@ -48,7 +46,7 @@ namespace pmtana{
   }
 
   //*******************************************
-  void PedAlgoRmsSlider::PrintInfo()
+  void PedAlgoRmsSlider::PrintInfo() const
   //*******************************************
   {
     std::cout << "PedAlgoRmsSlider setting:"
@@ -58,44 +56,10 @@ namespace pmtana{
               << "\n\t NWaveformsToFile: " << _n_wf_to_csvfile << std::endl;
   }
 
-  //****************************************************************************
-  double PedAlgoRmsSlider::CalcMean(const std::vector<double>& wf, size_t start, size_t nsample)
-  //****************************************************************************
-  {
-    if(!nsample) nsample = wf.size();
-    if(start > wf.size() || (start+nsample) > wf.size())
-      throw OpticalRecoException("Invalid start/end index!");
-
-    double sum = std::accumulate(wf.begin()+start,wf.begin()+start+nsample,0.0);
-
-    sum /= ((double)nsample);
-
-    return sum;
-  }
-
-  //****************************************************************************
-  double PedAlgoRmsSlider::CalcStd(const std::vector<double>& wf, const double ped_mean, size_t start, size_t nsample)
-  //****************************************************************************
-  {
-    if(!nsample) nsample = wf.size();
-    if(start > wf.size() || (start+nsample) > wf.size())
-      throw OpticalRecoException("Invalid start/end index!");
-
-    double sigma = 0;
-
-    for(size_t index=start; index < (start+nsample); ++index){
-      sigma += pow( (wf[index] - ped_mean), 2 );
-    }
-
-    sigma = sqrt(sigma/((double)(nsample)));
-
-    return sigma;
-  }
-
   //****************************************************************************
   bool PedAlgoRmsSlider::ComputePedestal( const pmtana::Waveform_t& wf,
 					    pmtana::PedestalMean_t&   mean_v,
-					    pmtana::PedestalSigma_t&  sigma_v)
+					    pmtana::PedestalSigma_t&  sigma_v) const
   //****************************************************************************
   {
 
@@ -138,10 +102,15 @@ namespace pmtana{
     std::vector<double> local_mean_v(wf.size(),-1.);
     std::vector<double> local_sigma_v(wf.size(),-1.);
 
+    // Mean and rms of every window of _sample_size samples, indexed by first sample
+    std::vector<double> window_mean_v;
+    std::vector<double> window_sigma_v;
+    windowed_mean_std(wf, _sample_size, window_mean_v, window_sigma_v);
+
     for (size_t i = 0; i < wf.size() - _sample_size; i++) {
 
-      local_mean = mean(wf, i, _sample_size);
-      local_rms  = std(wf, local_mean, i, _sample_size);
+      local_mean = window_mean_v[i];
+      local_rms  = window_sigma_v[i];
 
       if(_verbose) std::cout << "\033[93mPedAlgoRmsSlider\033[00m: i " << i 
 			     << "  local_mean: " << local_mean 
@@ -277,15 +246,15 @@ namespace pmtana{
 
     bool end_found = false;
 
-    local_mean = mean(wf, 0, _sample_size);
-    local_rms  = std(wf, local_mean, 0, _sample_size);
+    local_mean = window_mean_v[0];
+    local_rms  = window_sigma_v[0];
 
     if (local_rms >= _threshold) {
 
       for (size_t i = 1; i < wf.size() - _sample_size; i++) {
 
-        local_mean = mean(wf, i, _sample_size);
-        local_rms  = std(wf, local_mean, i, _sample_size);
+        local_mean = window_mean_v[i];
+        local_rms  = window_sigma_v[i];
 
         if (local_rms < _threshold) {
 
@@ -313,15 +282,15 @@ namespace pmtana{
 
     bool start_found = false;
 
-    local_mean = mean(wf, wf.size()-1-_sample_size, _sample_size);
-    local_rms  = std(wf, local_mean, wf.size()-1-_sample_size, _sample_size);
+    local_mean = window_mean_v[wf.size()-1-_sample_size];
+    local_rms  = window_sigma_v[wf.size()-1-_sample_size];
 
     if (local_rms >= _threshold) {
 
       size_t i = wf.size() - 1 - _sample_size;
       while (i-- > 0) {
-        local_mean = mean(wf, i, _sample_size);
-        local_rms  = std(wf, local_mean, i, _sample_size);
+        local_mean = window_mean_v[i];
+        local_rms  = window_sigma_v[i];
 
         if (local_rms < _threshold) {
 
@@ -356,14 +325,14 @@ namespace pmtana{
 
     const size_t window_size = _sample_size*2;
 
-    // middle mean
-    for(size_t i=0; i< mean_temp_v.size(); ++i) {
+    // middle mean: window centered on each sample
+    windowed_mean_std(mean_temp_v, window_size, window_mean_v, window_sigma_v, _sample_size);
 
-      if( i < _sample_size || i >= (wf.size() - _sample_size) ) continue;
+    for(size_t i=_sample_size; i < wf.size() - _sample_size; ++i) {
 
-      mean_v[i]  = this->CalcMean (mean_temp_v,i - _sample_size,window_size);
+      mean_v[i]  = window_mean_v[i];
       if(!ped_interapolated[i]){
-        sigma_v[i] = this->CalcStd  (mean_temp_v,mean_v[i],i - _sample_size,window_size);
+        sigma_v[i] = window_sigma_v[i];
       }
     }
 
@@ -389,10 +358,13 @@ namespace pmtana{
 
 
     // Save to file
-    if (_wf_saved + 1 <= _n_wf_to_csvfile) {
-      _wf_saved ++;
-      for (size_t i = 0; i < wf.size(); i++) {
-        _csvfile << _wf_saved-1 << "," << i << "," << wf[i] << "," << mean_v[i] << "," << sigma_v[i] << std::endl;
+    if (_n_wf_to_csvfile > 0) {
+      std::lock_guard<std::mutex> lock(_csvfile_mutex);
+      if (_wf_saved + 1 <= _n_wf_to_csvfile) {
+        _wf_saved ++;
+        for (size_t i = 0; i < wf.size(); i++) {
+          _csvfile << _wf_saved-1 << "," << i << "," << wf[i] << "," << mean_v[i] << "," << sigma_v[i] << std::endl;
+        }
       }
     }
 
@@ -408,7 +380,7 @@ namespace pmtana{
 
 
   //*******************************************
-  bool PedAlgoRmsSlider::CheckSanity(pmtana::PedestalMean_t& mean_v, pmtana::PedestalSigma_t& sigma_v)
+  bool PedAlgoRmsSlider::CheckSanity(pmtana::PedestalMean_t& mean_v, pmtana::PedestalSigma_t& sigma_v) const
   //*******************************************
   {
 
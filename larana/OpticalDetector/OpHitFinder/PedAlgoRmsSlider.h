@@ -21,6 +21,7 @@
 #include "fhiclcpp/fwd.h"
 
 #include <fstream>
+#include <mutex>
 
 namespace pmtana
 {
@@ -40,7 +41,10 @@ namespace pmtana
     PedAlgoRmsSlider(const fhicl::ParameterSet &pset,const std::string name="PedRmsSlider");
 
     /// Print settings
-    void PrintInfo();
+    void PrintInfo() const;
+
+    /// The pedestal is made of window means and interpolations between them
+    bool MeanWithinSampleRange() const { return true; }
 
 
   protected:
@@ -48,7 +52,7 @@ namespace pmtana
     /// Method to compute a pedestal of the input waveform using "nsample" ADC samples from "start" index.
     bool ComputePedestal( const pmtana::Waveform_t& wf,
 			  pmtana::PedestalMean_t&   mean_v,
-			  pmtana::PedestalSigma_t&  sigma_v);
+			  pmtana::PedestalSigma_t&  sigma_v) const;
 
   private:
 
@@ -61,19 +65,14 @@ namespace pmtana
 
     bool _verbose;        ///< For debugging
     int _n_wf_to_csvfile; ///< If greater than zero saves firsts waveforms with pedestal to csv file
-    int _wf_saved = 0;
+    mutable int _wf_saved = 0;
     int _num_presample;   ///< number of ADCs to sample before the gap
     int _num_postsample;  ///< number of ADCs to sample after the gap
-    std::ofstream _csvfile;
-
-    /// Returns the mean of the elements of the vector from start to start+nsample
-    double CalcMean(const std::vector<double>& wf, size_t start, size_t nsample);
-
-    /// Returns the std of the elements of the vector from start to start+nsample
-    double CalcStd(const std::vector<double>& wf, const double ped_mean, size_t start, size_t nsample);
+    mutable std::ofstream _csvfile;
+    mutable std::mutex _csvfile_mutex; ///< Serializes csv dumps from concurrent ComputePedestal calls
 
     /// Checks the sanity of the estimated pedestal, returns false if not sane
-    bool CheckSanity(pmtana::PedestalMean_t& mean_v, pmtana::PedestalSigma_t& sigma_v);
+    bool CheckSanity(pmtana::PedestalMean_t& mean_v, pmtana::PedestalSigma_t& sigma_v) const;
   };
 }
 #endif
@@ -49,7 +49,18 @@ namespace pmtana{
   //****************************************************************************
   bool PedAlgoRollingMean::ComputePedestal( const pmtana::Waveform_t& wf,
 					    pmtana::PedestalMean_t&   mean_v,
-					    pmtana::PedestalSigma_t&  sigma_v)
+					    pmtana::PedestalSigma_t&  sigma_v) const
+  //****************************************************************************
+  {
+    RecoScratch scratch;
+    return ComputePedestalWithScratch(wf, mean_v, sigma_v, scratch);
+  }
+
+  //****************************************************************************
+  bool PedAlgoRollingMean::ComputePedestalWithScratch( const pmtana::Waveform_t& wf,
+						       pmtana::PedestalMean_t&   mean_v,
+						       pmtana::PedestalSigma_t&  sigma_v,
+						       pmtana::RecoScratch&      scratch) const
   //****************************************************************************
   {
 
@@ -59,17 +70,8 @@ namespace pmtana{
 
     const size_t window_size = _sample_size*2;
 
-    // middle mean
-    for(size_t i=0; i< wf.size(); ++i) {
-
-      mean_v[i]  = 0;
-      sigma_v[i] = 0;
-
-      if( i < _sample_size || i >= (wf.size() - _sample_size) ) continue;
-
-      mean_v[i]  = mean (wf,i - _sample_size,window_size);
-      sigma_v[i] = std  (wf,mean_v[i],i - _sample_size,window_size);
-    }
+    // middle mean: window centered on each sample, edges are filled below
+    windowed_mean_std(wf,window_size,mean_v,sigma_v,_sample_size);
 
     // front mean
     for(size_t i=0; i<_sample_size; ++i) {
@@ -127,17 +129,20 @@ namespace pmtana{
     unsigned nbins = 1000;
 
     //////////////////seg faulting...
-    const auto mode_mean  = BinnedMaxOccurrence(mean_v ,nbins);
-    const auto mode_sigma = BinnedMaxOccurrence(sigma_v,nbins);
+    // Histogram buffer reused from one waveform to the next (caller-owned).
+    // The means are averages of window_size ADC counts: exact integer histogram.
+    auto& ctr_v = scratch.histogram;
+    const auto mode_mean  = BinnedMaxOccurrence(mean_v ,nbins,window_size,ctr_v);
+    const auto mode_sigma = BinnedMaxOccurrence(sigma_v,nbins,ctr_v);
 
     //auto mode_mean  = BinnedMaxTH1D(mean_v ,nbins);
     //auto mode_sigma = BinnedMaxTH1D(sigma_v,nbins);
 
     //std::cout<<mode_mean<<" +/- "<<mode_sigma<<std::endl;
 
-    _diff_threshold *= mode_sigma;
+    const double diff_threshold = _diff_threshold * mode_sigma;
 
-    double diff_cutoff = _diff_threshold < _diff_adc_count ? _diff_adc_count : _diff_threshold;
+    double diff_cutoff = diff_threshold < _diff_adc_count ? _diff_adc_count : diff_threshold;
 
     int last_good_index = -1;
 
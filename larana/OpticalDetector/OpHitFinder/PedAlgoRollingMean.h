@@ -44,7 +44,13 @@ namespace pmtana
     /// Method to compute a pedestal of the input waveform using "nsample" ADC samples from "start" index.
     bool ComputePedestal( const pmtana::Waveform_t& wf,
 			  pmtana::PedestalMean_t&   mean_v,
-			  pmtana::PedestalSigma_t&  sigma_v);
+			  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /// Same as above; the mode-finding histogram is kept in the scratch
+    bool ComputePedestalWithScratch( const pmtana::Waveform_t& wf,
+				     pmtana::PedestalMean_t&   mean_v,
+				     pmtana::PedestalSigma_t&  sigma_v,
+				     pmtana::RecoScratch&      scratch) const;
 
   private:
 
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  PedAlgoTracker source
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "PedAlgoTracker.h"
+#include "PulseRecoAlgoFactory.h"
+#include "WaveformKernels.h"
+#include "OpticalRecoException.h"
+
+#include "fhiclcpp/ParameterSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace pmtana{
+
+  //**************************************************************************
+  PedAlgoTracker::PedAlgoTracker(const fhicl::ParameterSet &pset,
+				 const std::string name)
+    : PMTPedestalBase(name)
+    , _n_tracked(0)
+    , _n_full(0)
+  //**************************************************************************
+  {
+    _nsample_check   = pset.get<size_t>("NumCheckSamples", 8    );
+    _drift_threshold = pset.get<double>("DriftThreshold",  2.0  );
+    _max_sigma       = pset.get<double>("MaxSigma",        1.0  );
+    _weight          = pset.get<double>("Weight",          0.05 );
+
+    if(_nsample_check == 0)
+      throw OpticalRecoException("PedAlgoTracker received invalid \"NumCheckSamples\" parameter value!");
+    if(_weight <= 0 || _weight > 1)
+      throw OpticalRecoException("PedAlgoTracker received invalid \"Weight\" parameter value!");
+
+    auto const full_pset = pset.get<fhicl::ParameterSet>("FullAlgoPset");
+    _full_algo = MakePedestalAlgo(full_pset);
+    if(!_full_algo) {
+      std::stringstream ss;
+      ss << "PedAlgoTracker cannot find pedestal algorithm " << full_pset.get<std::string>("Name");
+      throw OpticalRecoException(ss.str());
+    }
+  }
+
+  //****************************************************************************
+  void PedAlgoTracker::TrackedBaselines(std::vector<float>& mean_v,
+					std::vector<float>& sigma_v) const
+  //****************************************************************************
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    mean_v.resize(_baselines.size());
+    sigma_v.resize(_baselines.size());
+
+    for(size_t ch=0; ch<_baselines.size(); ++ch) {
+      mean_v[ch]  = _baselines[ch].mean;
+      sigma_v[ch] = _baselines[ch].sigma;
+    }
+  }
+
+  //****************************************************************************
+  void PedAlgoTracker::ResetBaselines()
+  //****************************************************************************
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _baselines.clear();
+  }
+
+  //****************************************************************************
+  void PedAlgoTracker::EdgeMeanStd(const pmtana::Waveform_t& wf, size_t start, size_t nsample,
+				   double& mean, double& sigma)
+  //****************************************************************************
+  {
+    int64_t sum = 0, sum2 = 0;
+    WindowSums(wf.data() + start, nsample, sum, sum2);
+
+    mean  = (double)sum / nsample;
+    sigma = std::sqrt(std::max(0., (double)sum2 / nsample - mean * mean));
+  }
+
+  //****************************************************************************
+  bool PedAlgoTracker::ComputePedestal( const pmtana::Waveform_t& wf,
+					pmtana::PedestalMean_t&   mean_v,
+					pmtana::PedestalSigma_t&  sigma_v) const
+  //****************************************************************************
+  {
+    RecoScratch scratch;
+    return ComputePedestalWithScratch(wf, mean_v, sigma_v, scratch);
+  }
+
+  //****************************************************************************
+  bool PedAlgoTracker::ComputePedestalWithScratch( const pmtana::Waveform_t& wf,
+						   pmtana::PedestalMean_t&   mean_v,
+						   pmtana::PedestalSigma_t&  sigma_v,
+						   pmtana::RecoScratch&      scratch) const
+  //****************************************************************************
+  {
+    ++_n_full;
+    return _full_algo->Evaluate(wf, -1, mean_v, sigma_v, scratch);
+  }
+
+  //****************************************************************************
+  bool PedAlgoTracker::ComputeChannelPedestal( const pmtana::Waveform_t& wf,
+					       int channel,
+					       pmtana::PedestalMean_t&   mean_v,
+					       pmtana::PedestalSigma_t&  sigma_v,
+					       pmtana::RecoScratch&      scratch) const
+  //****************************************************************************
+  {
+    if(channel < 0 || wf.size() < 2 * _nsample_check)
+
+      return ComputePedestalWithScratch(wf, mean_v, sigma_v, scratch);
+
+    const size_t tail_start = wf.size() - _nsample_check;
+
+    double head_mean, head_sigma, tail_mean, tail_sigma;
+    EdgeMeanStd(wf, 0,          _nsample_check, head_mean, head_sigma);
+    EdgeMeanStd(wf, tail_start, _nsample_check, tail_mean, tail_sigma);
+
+    // A pulse in either edge makes its rms large
+    const bool quiet_edges = head_sigma <= _max_sigma && tail_sigma <= _max_sigma;
+
+    double ped_mean  = 0;
+    double ped_sigma = 0;
+    bool   tracked   = false;
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+
+      if((size_t)channel >= _baselines.size()) _baselines.resize(channel + 1);
+      auto& baseline = _baselines[channel];
+
+      tracked = ( baseline.valid && quiet_edges &&
+		  std::abs(head_mean - baseline.mean) <= _drift_threshold &&
+		  std::abs(tail_mean - baseline.mean) <= _drift_threshold );
+
+      if(tracked) {
+	baseline.mean  += _weight * ((head_mean  + tail_mean ) / 2. - baseline.mean );
+	baseline.sigma += _weight * ((head_sigma + tail_sigma) / 2. - baseline.sigma);
+	ped_mean  = baseline.mean;
+	ped_sigma = baseline.sigma;
+      }
+    }
+
+    if(tracked) {
+      ++_n_tracked;
+      for( auto &v : mean_v  ) v = ped_mean;
+      for( auto &v : sigma_v ) v = ped_sigma;
+      return true;
+    }
+
+    // Drift, pulse at the edges or no baseline yet: full algorithm
+    if(!ComputePedestalWithScratch(wf, mean_v, sigma_v, scratch)) return false;
+
+    // Reseed from the full pedestal at the edges, unless a pulse makes them unreliable
+    if(quiet_edges) {
+
+      double seed_mean = 0, seed_sigma = 0;
+      for(size_t i=0; i<_nsample_check; ++i) {
+	seed_mean  += mean_v[i]  + mean_v[tail_start + i];
+	seed_sigma += sigma_v[i] + sigma_v[tail_start + i];
+      }
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto& baseline = _baselines[channel];
+      baseline.mean  = seed_mean  / (2 * _nsample_check);
+      baseline.sigma = seed_sigma / (2 * _nsample_check);
+      baseline.valid = true;
+    }
+
+    return true;
+  }
+
+}
@@ -0,0 +1,108 @@
+/**
+ * \file PedAlgoTracker.h
+ *
+ * \ingroup PulseReco
+ *
+ * \brief Class definition file of PedAlgoTracker
+ */
+
+/** \addtogroup PulseReco
+
+@{*/
+
+#ifndef larana_OPTICALDETECTOR_PEDALGOTRACKER_H
+#define larana_OPTICALDETECTOR_PEDALGOTRACKER_H
+
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
+
+#include "PMTPedestalBase.h"
+#include "fhiclcpp/fwd.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pmtana
+{
+
+  /**
+   \class PedAlgoTracker
+   Keeps a running pedestal mean and sigma per readout channel across waveforms and events.
+   A waveform whose first and last samples agree with the tracked baseline gets that baseline
+   as a constant pedestal. Otherwise (baseline drift, pulse at the edges, new channel or unknown
+   channel) the full pedestal algorithm configured in FullAlgoPset is run and reseeds the baseline.
+   Since the pedestal depends on the waveforms seen before, the output depends on the order of
+   the waveforms, and of the events: they must be reconstructed one at a time in a fixed order.
+   OpHitFinder rejects it with ParallelHitFinding, ConcurrentEvents or more than one schedule,
+   and calls ResetBaselines at each subrun, so the output of an event depends only on the
+   events before it in the same subrun.
+  */
+  class PedAlgoTracker : public PMTPedestalBase{
+
+  public:
+
+    /// Alternative ctor
+    PedAlgoTracker(const fhicl::ParameterSet &pset,const std::string name="PedTracker");
+
+    /// Tracked pedestal mean and sigma by channel, -1 for channels not tracked yet
+    void TrackedBaselines(std::vector<float>& mean_v, std::vector<float>& sigma_v) const;
+
+    /// Forgets the tracked baselines: the next waveform of each channel runs the full algorithm
+    void ResetBaselines();
+
+    /// Number of waveforms which used the tracked baseline
+    size_t NumTracked() const { return _n_tracked; }
+
+    /// Number of waveforms which needed the full pedestal algorithm
+    size_t NumFullEvaluations() const { return _n_full; }
+
+  protected:
+
+    /// Without a channel, the full pedestal algorithm is run
+    bool ComputePedestal( const pmtana::Waveform_t& wf,
+			  pmtana::PedestalMean_t&   mean_v,
+			  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /// Same as above, the full pedestal algorithm using the scratch
+    bool ComputePedestalWithScratch( const pmtana::Waveform_t& wf,
+				     pmtana::PedestalMean_t&   mean_v,
+				     pmtana::PedestalSigma_t&  sigma_v,
+				     pmtana::RecoScratch&      scratch) const;
+
+    /// Tracked baseline if consistent with the waveform edges, full algorithm otherwise
+    bool ComputeChannelPedestal( const pmtana::Waveform_t& wf,
+				 int channel,
+				 pmtana::PedestalMean_t&   mean_v,
+				 pmtana::PedestalSigma_t&  sigma_v,
+				 pmtana::RecoScratch&      scratch) const;
+
+  private:
+
+    struct Baseline {
+      double mean  = -1;
+      double sigma = -1;
+      bool   valid = false;
+    };
+
+    std::unique_ptr<PMTPedestalBase> _full_algo; ///< Algorithm used when the baseline is not trusted
+
+    size_t _nsample_check;    ///< # ADC samples at each end of the waveform checked against the baseline
+    double _drift_threshold;  ///< Max shift [ADC] of the edge means from the tracked baseline
+    double _max_sigma;        ///< Max rms [ADC] of the edge samples (larger means a pulse at the edge)
+    double _weight;           ///< Weight of each waveform in the running mean and sigma
+
+    mutable std::mutex _mutex;                ///< Guards the baselines
+    mutable std::vector<Baseline> _baselines; ///< By channel
+
+    mutable std::atomic<size_t> _n_tracked;
+    mutable std::atomic<size_t> _n_full;
+
+    /// Mean and rms of nsample samples from start
+    static void EdgeMeanStd(const pmtana::Waveform_t& wf, size_t start, size_t nsample,
+			    double& mean, double& sigma);
+  };
+}
+#endif
+
+/** @} */ // end of doxygen group
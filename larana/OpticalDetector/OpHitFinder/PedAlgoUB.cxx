@@ -32,15 +32,17 @@ namespace pmtana{
   //*********************************************************************
   bool PedAlgoUB::ComputePedestal( const pmtana::Waveform_t& wf,
 				   pmtana::PedestalMean_t&   mean_v,
-				   pmtana::PedestalSigma_t&  sigma_v)
+				   pmtana::PedestalSigma_t&  sigma_v) const
   //*********************************************************************
   {
 
-    if ( wf.size() < _beam_gate_samples ) {
+    if ( IsConstant(wf) ) {
 
-      double ped_mean  = wf.front(); //first sample
+      double ped_mean  = 0;
       double ped_sigma = 0;
 
+      ComputeConstantPedestal(wf, ped_mean, ped_sigma);
+
       for( auto &v : mean_v  ) v = ped_mean;
       for( auto &v : sigma_v ) v = ped_sigma;
 
@@ -50,13 +52,23 @@ namespace pmtana{
 
     else {
 
-      _beamgatealgo.Evaluate(wf);
-      mean_v  = _beamgatealgo.Mean();
-      sigma_v = _beamgatealgo.Sigma();
+      _beamgatealgo.Evaluate(wf, mean_v, sigma_v);
 
       return true;
     }
 
   }
 
+  //*********************************************************************
+  bool PedAlgoUB::ComputeConstantPedestal( const pmtana::Waveform_t& wf,
+					   double& ped_mean,
+					   double& ped_sigma) const
+  //*********************************************************************
+  {
+    ped_mean  = wf.front(); //first sample
+    ped_sigma = 0;
+
+    return true;
+  }
+
 }
@@ -40,12 +40,23 @@ namespace pmtana
     //PedAlgoUB(const ::fcllite::PSet &pset,
 	      const std::string name = "PedAlgoUB");
 
+    /// Waveforms shorter than the beam gate use their first sample as pedestal
+    bool IsConstant(const pmtana::Waveform_t& wf) const { return wf.size() < _beam_gate_samples; }
+
+    /// Either a sample or the PedAlgoRmsSlider pedestal
+    bool MeanWithinSampleRange() const { return true; }
+
   protected:
 
     /// Method to compute a pedestal of the input waveform using "nsample" ADC samples from "start" index.
     bool ComputePedestal( const pmtana::Waveform_t& wf,
 			  pmtana::PedestalMean_t&   mean_v,
-			  pmtana::PedestalSigma_t&  sigma_v);
+			  pmtana::PedestalSigma_t&  sigma_v) const;
+
+    /// Method to compute the pedestal of waveforms shorter than the beam gate
+    bool ComputeConstantPedestal( const pmtana::Waveform_t& wf,
+				  double& ped_mean,
+				  double& ped_sigma) const;
 
   private:
 
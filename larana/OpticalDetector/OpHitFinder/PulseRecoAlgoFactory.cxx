@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  PulseRecoAlgoFactory source
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "PulseRecoAlgoFactory.h"
+#include "AlgoThreshold.h"
+#include "AlgoSiPM.h"
+#include "AlgoSlidingWindow.h"
+#include "AlgoFixedWindow.h"
+#include "AlgoCFD.h"
+#include "AlgoDeconvolution.h"
+#include "PedAlgoEdges.h"
+#include "PedAlgoRollingMean.h"
+#include "PedAlgoRmsSlider.h"
+#include "PedAlgoUB.h"
+#include "PedAlgoTracker.h"
+
+#include "fhiclcpp/ParameterSet.h"
+
+#include <map>
+#include <string>
+
+namespace pmtana {
+
+  namespace {
+
+    template <class Base>
+    using Maker_t = std::unique_ptr<Base> (*)(const fhicl::ParameterSet&);
+
+    template <class Base, class Algo>
+    std::unique_ptr<Base> Make(const fhicl::ParameterSet& pset)
+    { return std::make_unique<Algo>(pset); }
+
+    /// Registered pulse reconstruction algorithms, by FHiCL Name
+    const std::map<std::string, Maker_t<PMTPulseRecoBase> > PulseRecoAlgos = {
+      { "Threshold",     Make<PMTPulseRecoBase, AlgoThreshold>     },
+      { "SiPM",          Make<PMTPulseRecoBase, AlgoSiPM>          },
+      { "SlidingWindow", Make<PMTPulseRecoBase, AlgoSlidingWindow> },
+      { "FixedWindow",   Make<PMTPulseRecoBase, AlgoFixedWindow>   },
+      { "CFD",           Make<PMTPulseRecoBase, AlgoCFD>           },
+      { "Deconvolution", Make<PMTPulseRecoBase, AlgoDeconvolution> }
+    };
+
+    /// Registered pedestal algorithms, by FHiCL Name
+    const std::map<std::string, Maker_t<PMTPedestalBase> > PedestalAlgos = {
+      { "Edges",       Make<PMTPedestalBase, PedAlgoEdges>       },
+      { "RollingMean", Make<PMTPedestalBase, PedAlgoRollingMean> },
+      { "RmsSlider",   Make<PMTPedestalBase, PedAlgoRmsSlider>   },
+      { "UB",          Make<PMTPedestalBase, PedAlgoUB>          },
+      { "Tracker",     Make<PMTPedestalBase, PedAlgoTracker>     }
+    };
+
+    template <class Base>
+    std::unique_ptr<Base> MakeAlgo(const std::map<std::string, Maker_t<Base> >& registry,
+				   const fhicl::ParameterSet& pset)
+    {
+      auto it = registry.find(pset.get<std::string>("Name"));
+      if(it == registry.end()) return nullptr;
+      return it->second(pset);
+    }
+
+  }
+
+  //*****************************************************************************
+  std::unique_ptr<PMTPulseRecoBase> MakePulseRecoAlgo(const fhicl::ParameterSet& pset)
+  //*****************************************************************************
+  {
+    return MakeAlgo(PulseRecoAlgos, pset);
+  }
+
+  //*****************************************************************************
+  std::unique_ptr<PMTPedestalBase> MakePedestalAlgo(const fhicl::ParameterSet& pset)
+  //*****************************************************************************
+  {
+    return MakeAlgo(PedestalAlgos, pset);
+  }
+
+}
@@ -0,0 +1,36 @@
+/**
+ * \file PulseRecoAlgoFactory.h
+ *
+ * \ingroup PulseReco
+ *
+ * \brief Construction of pulse and pedestal algorithms from their FHiCL Name
+ */
+
+/** \addtogroup PulseReco
+
+@{*/
+
+#ifndef larana_OPTICALDETECTOR_PULSERECOALGOFACTORY_H
+#define larana_OPTICALDETECTOR_PULSERECOALGOFACTORY_H
+
+#include "PMTPulseRecoBase.h"
+#include "PMTPedestalBase.h"
+#include "fhiclcpp/fwd.h"
+
+#include <memory>
+
+namespace pmtana {
+
+  /// Pulse reconstruction algorithm named by the "Name" key of pset, configured from pset
+  /// (nullptr if there is no algorithm of that name)
+  std::unique_ptr<PMTPulseRecoBase> MakePulseRecoAlgo(const fhicl::ParameterSet& pset);
+
+  /// Pedestal algorithm named by the "Name" key of pset, configured from pset
+  /// (nullptr if there is no algorithm of that name)
+  std::unique_ptr<PMTPedestalBase> MakePedestalAlgo(const fhicl::ParameterSet& pset);
+
+}
+
+#endif
+
+/** @} */ // end of doxygen group
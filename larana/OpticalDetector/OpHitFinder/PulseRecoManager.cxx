@@ -8,13 +8,17 @@
 #include "OpticalRecoException.h"
 #include "larana/OpticalDetector/OpHitFinder/PMTPedestalBase.h"
 #include "larana/OpticalDetector/OpHitFinder/PMTPulseRecoBase.h"
+#include "larana/OpticalDetector/OpHitFinder/WaveformKernels.h"
 
+#include <algorithm>
 #include <sstream>
 
 namespace pmtana{
 
   //*******************************************************
-  PulseRecoManager::PulseRecoManager() : _ped_algo(nullptr)
+  PulseRecoManager::PulseRecoManager()
+    : _ped_algo(nullptr), _config()
+    , _prefilter_checked(0), _prefilter_skipped(0)
   //*******************************************************
   {
     _reco_algo_v.clear();
@@ -37,6 +41,65 @@ namespace pmtana{
     _ped_algo = algo;
   }
 
+  //**************************************************************
+  void PulseRecoManager::SetConfig (const PulseRecoConfig& config)
+  //**************************************************************
+  {
+    // The other modes apply to any algorithms, falling back to the default where they cannot
+    if(config.chunk_size && !SupportsBlocks()) {
+      std::stringstream ss;
+      ss << "Chunked reconstruction needs a pedestal algorithm and pulse algorithms which run"
+	 << " in blocks (default pedestal: " << (_ped_algo ? _ped_algo->Name() : "none") << ")";
+      throw OpticalRecoException(ss.str());
+    }
+    _config = config;
+  }
+
+  //**************************************************************
+  void PulseRecoManager::SetStreamingMode (bool streaming)
+  //**************************************************************
+  {
+    PulseRecoConfig config(_config);
+    config.streaming = streaming;
+    SetConfig(config);
+  }
+
+  //**************************************************************
+  void PulseRecoManager::SetChunkSize (size_t chunk_size)
+  //**************************************************************
+  {
+    PulseRecoConfig config(_config);
+    config.chunk_size = chunk_size;
+    SetConfig(config);
+  }
+
+  //**************************************************************
+  void PulseRecoManager::SetBatchMode (bool batch)
+  //**************************************************************
+  {
+    PulseRecoConfig config(_config);
+    config.batch = batch;
+    SetConfig(config);
+  }
+
+  //**************************************************************
+  void PulseRecoManager::SetPulseTableMode (bool table)
+  //**************************************************************
+  {
+    PulseRecoConfig config(_config);
+    config.table = table;
+    SetConfig(config);
+  }
+
+  //**************************************************************
+  void PulseRecoManager::SetPrefilterThreshold (double min_peak)
+  //**************************************************************
+  {
+    PulseRecoConfig config(_config);
+    config.prefilter_threshold = min_peak;
+    SetConfig(config);
+  }
+
   //**********************************************************************
   bool PulseRecoManager::Reconstruct(const pmtana::Waveform_t &wf) const
   //**********************************************************************
@@ -85,4 +148,346 @@ namespace pmtana{
 
   }
 
+  //*******************************************************************************************
+  bool PulseRecoManager::Reconstruct(const pmtana::Waveform_t &wf, PulseRecoContext& ctx) const
+  //*******************************************************************************************
+  {
+    if(_reco_algo_v.empty() && !_ped_algo)
+
+      throw OpticalRecoException("No Pulse/Pedestal reconstruction to run!");
+
+    ctx.pulse_v.resize(_reco_algo_v.size());
+
+    for(auto& pulses : ctx.pulse_v) pulses.clear();
+
+    ctx.table_v.resize(_config.table ? _reco_algo_v.size() : 0);
+
+    for(auto& table : ctx.table_v) table.clear();
+
+    bool ped_status = true;
+
+    ctx.ped_constant = false;
+
+    if(Prefiltered(wf)) return true;
+
+    // Chunked mode: the whole reconstruction goes block by block
+    if(_config.chunk_size) {
+
+      BeginWaveform(ctx);
+
+      bool status = true;
+
+      for(size_t begin = 0; begin < wf.size(); begin += _config.chunk_size)
+
+	status = ReconstructBlock(wf.data() + begin, std::min(_config.chunk_size, wf.size() - begin), ctx) && status;
+
+      return EndWaveform(ctx) && status;
+    }
+
+    if(_ped_algo)
+
+      ped_status = EvaluatePedestal(wf, ctx.channel, *_ped_algo, ctx.ped_mean_v, ctx.ped_sigma_v,
+				    ctx.ped_constant, ctx.ped_mean, ctx.ped_sigma, ctx.scratch);
+
+    bool pulse_reco_status = ped_status;
+
+    for(size_t algo_index = 0; algo_index < _reco_algo_v.size(); ++algo_index) {
+
+      auto const& pulse_algo = _reco_algo_v[algo_index].first;
+      auto const& ped_algo   = _reco_algo_v[algo_index].second;
+      auto& pulses           = ctx.pulse_v[algo_index];
+      auto* table            = _config.table ? &ctx.table_v[algo_index] : nullptr;
+
+      if(ped_algo) {
+
+	bool   constant  = false;
+	double ped_mean  = 0;
+	double ped_sigma = 0;
+
+	ped_status = ped_status && EvaluatePedestal(wf, ctx.channel, *ped_algo, ctx.algo_mean_v, ctx.algo_sigma_v,
+						    constant, ped_mean, ped_sigma, ctx.scratch);
+
+	pulse_reco_status = ( ped_status &&
+			      pulse_reco_status &&
+			      ReconstructAlgo( wf, *pulse_algo, constant, ped_mean, ped_sigma,
+					       ctx.algo_mean_v, ctx.algo_sigma_v, pulses, table, ctx.scratch )
+			      );
+
+      } else {
+
+	if( !_ped_algo ) {
+	  std::stringstream ss;
+	  ss << "No pedestal algorithm available for pulse algo " << pulse_algo->Name();
+	  throw OpticalRecoException(ss.str());
+	}
+
+	pulse_reco_status = ( pulse_reco_status &&
+			      ReconstructAlgo( wf, *pulse_algo, ctx.ped_constant, ctx.ped_mean, ctx.ped_sigma,
+					       ctx.ped_mean_v, ctx.ped_sigma_v, pulses, table, ctx.scratch )
+			      );
+      }
+    }
+
+    return pulse_reco_status;
+
+  }
+
+  //*******************************************************************************************
+  bool PulseRecoManager::Reconstruct(const std::vector<const pmtana::Waveform_t*>& wfs,
+				     PulseRecoBatchContext& batch) const
+  //*******************************************************************************************
+  {
+    batch.contexts.resize(wfs.size());
+
+    const bool batched = ( _config.batch && _ped_algo &&
+			   _reco_algo_v.size() == 1 && !_reco_algo_v.front().second );
+
+    bool status = true;
+
+    if(!batched) {
+
+      for(size_t i = 0; i < wfs.size(); ++i)
+
+	status = Reconstruct(*wfs[i], batch.contexts[i]) && status;
+
+      return status;
+    }
+
+    auto const& pulse_algo = *(_reco_algo_v.front().first);
+
+    batch.waveforms.clear();
+    batch.ped_mean.clear();
+    batch.ped_sigma.clear();
+    batch.pulses.clear();
+
+    // Pedestals one by one; waveforms with a constant pedestal are reconstructed together
+    for(size_t i = 0; i < wfs.size(); ++i) {
+
+      auto const& wf = *wfs[i];
+      auto& ctx = batch.contexts[i];
+
+      ctx.pulse_v.resize(1);
+      ctx.pulse_v.front().clear();
+      ctx.table_v.resize(_config.table ? 1 : 0);
+      ctx.ped_constant = false;
+
+      if(Prefiltered(wf)) continue;
+
+      if(!EvaluatePedestal(wf, ctx.channel, *_ped_algo, ctx.ped_mean_v, ctx.ped_sigma_v,
+			   ctx.ped_constant, ctx.ped_mean, ctx.ped_sigma, ctx.scratch)) {
+	status = false;
+	continue;
+      }
+
+      if(!ctx.ped_constant) {
+	status = pulse_algo.Reconstruct(wf, ctx.ped_mean_v, ctx.ped_sigma_v, ctx.pulse_v.front(),
+					ctx.scratch) && status;
+	continue;
+      }
+
+      batch.waveforms.push_back(&wf);
+      batch.ped_mean.push_back(ctx.ped_mean);
+      batch.ped_sigma.push_back(ctx.ped_sigma);
+      batch.pulses.push_back(&ctx.pulse_v.front());
+    }
+
+    if(!batch.waveforms.empty())
+
+      status = pulse_algo.ReconstructBatch(batch.waveforms, batch.ped_mean, batch.ped_sigma,
+					   batch.pulses, batch.interleaved) && status;
+
+    if(_config.table)
+
+      for(auto& ctx : batch.contexts) ctx.table_v.front().assign(ctx.pulse_v.front());
+
+    return status;
+  }
+
+  //*************************************************************************
+  bool PulseRecoManager::SupportsBlocks() const
+  //*************************************************************************
+  {
+    if(!_ped_algo || !_ped_algo->SupportsChunks()) return false;
+
+    for(auto const& algo_pair : _reco_algo_v)
+
+      if(algo_pair.second || !algo_pair.first->SupportsChunks()) return false;
+
+    return true;
+  }
+
+  //*************************************************************************
+  void PulseRecoManager::BeginWaveform(PulseRecoContext& ctx) const
+  //*************************************************************************
+  {
+    if(!SupportsBlocks())
+
+      throw OpticalRecoException("Block-wise reconstruction needs chunked pedestal and pulse algorithms");
+
+    ctx.pulse_v.resize(_reco_algo_v.size());
+
+    for(auto& pulses : ctx.pulse_v) pulses.clear();
+
+    ctx.table_v.resize(_config.table ? _reco_algo_v.size() : 0);
+
+    for(auto& table : ctx.table_v) table.clear();
+
+    ctx.ped_constant = false;
+    ctx.ped_chunk = PedestalChunkState();
+    ctx.chunk_v.resize(_reco_algo_v.size());
+    ctx.pending.clear();
+  }
+
+  //*************************************************************************
+  bool PulseRecoManager::ReconstructBlock(const short* samples, size_t n, PulseRecoContext& ctx) const
+  //*************************************************************************
+  {
+    bool status = true;
+
+    if(!ctx.ped_chunk.ready) {
+
+      if(!_ped_algo->EvaluateChunk(samples, n, ctx.ped_chunk)) {
+	ctx.pending.insert(ctx.pending.end(), samples, samples + n);
+	return true;
+      }
+
+      // Pedestal known: the pulse search starts from the samples kept so far
+      ctx.ped_constant = true;
+      ctx.ped_mean     = ctx.ped_chunk.ped_mean;
+      ctx.ped_sigma    = ctx.ped_chunk.ped_sigma;
+
+      for(size_t algo_index = 0; algo_index < _reco_algo_v.size(); ++algo_index)
+
+	_reco_algo_v[algo_index].first->BeginChunks(ctx.ped_mean, ctx.ped_sigma, ctx.chunk_v[algo_index]);
+
+      if(!ctx.pending.empty()) {
+	status = ReconstructChunks(ctx.pending.data(), ctx.pending.size(), ctx);
+	ctx.pending.clear();
+      }
+    }
+
+    return ReconstructChunks(samples, n, ctx) && status;
+  }
+
+  //*************************************************************************
+  bool PulseRecoManager::EndWaveform(PulseRecoContext& ctx) const
+  //*************************************************************************
+  {
+    if(!ctx.ped_chunk.ready) {
+      std::stringstream ss;
+      ss << "Waveform ended after " << ctx.pending.size() << " samples, before its pedestal was known";
+      throw OpticalRecoException(ss.str());
+    }
+
+    for(size_t algo_index = 0; algo_index < _reco_algo_v.size(); ++algo_index) {
+
+      _reco_algo_v[algo_index].first->EndChunks(ctx.chunk_v[algo_index], ctx.pulse_v[algo_index]);
+
+      if(_config.table) ctx.table_v[algo_index].assign(ctx.pulse_v[algo_index]);
+    }
+
+    return true;
+  }
+
+  //*************************************************************************
+  bool PulseRecoManager::ReconstructChunks(const short* samples, size_t n, PulseRecoContext& ctx) const
+  //*************************************************************************
+  {
+    bool status = true;
+
+    for(size_t algo_index = 0; algo_index < _reco_algo_v.size(); ++algo_index)
+
+      status = _reco_algo_v[algo_index].first->ReconstructChunk(samples, n, ctx.chunk_v[algo_index],
+								 ctx.pulse_v[algo_index]) && status;
+
+    return status;
+  }
+
+  //*********************************************************************************
+  bool PulseRecoManager::EvaluatePedestal(const pmtana::Waveform_t& wf,
+					  int channel,
+					  const pmtana::PMTPedestalBase& ped_algo,
+					  pmtana::PedestalMean_t&  mean_v,
+					  pmtana::PedestalSigma_t& sigma_v,
+					  bool& constant,
+					  double& ped_mean,
+					  double& ped_sigma,
+					  pmtana::RecoScratch& scratch) const
+  //*********************************************************************************
+  {
+    constant = (_config.streaming || _config.chunk_size || _config.batch || _config.table) && ped_algo.IsConstant(wf);
+
+    if(constant) return ped_algo.EvaluateConstant(wf, ped_mean, ped_sigma);
+
+    return ped_algo.Evaluate(wf, channel, mean_v, sigma_v, scratch);
+  }
+
+  //*********************************************************************************
+  bool PulseRecoManager::ReconstructAlgo(const pmtana::Waveform_t& wf,
+					 const pmtana::PMTPulseRecoBase& pulse_algo,
+					 bool constant,
+					 double ped_mean,
+					 double ped_sigma,
+					 const pmtana::PedestalMean_t&  mean_v,
+					 const pmtana::PedestalSigma_t& sigma_v,
+					 pmtana::pulse_param_array& pulses,
+					 pmtana::pulse_table* table,
+					 pmtana::RecoScratch& scratch) const
+  //*********************************************************************************
+  {
+    if(table && constant)
+
+      return pulse_algo.Reconstruct(wf, ped_mean, ped_sigma, *table);
+
+    const bool status = ( constant ?
+			  pulse_algo.Reconstruct(wf, ped_mean, ped_sigma, pulses, scratch) :
+			  pulse_algo.Reconstruct(wf, mean_v, sigma_v, pulses, scratch) );
+
+    if(table) table->assign(pulses);
+
+    return status;
+  }
+
+  //*************************************************************************
+  bool PulseRecoManager::Prefiltered(const pmtana::Waveform_t& wf) const
+  //*************************************************************************
+  {
+    if(_config.prefilter_threshold < 0 || wf.empty()) return false;
+
+    if(_ped_algo && !_ped_algo->MeanWithinSampleRange()) return false;
+
+    for(auto const& algo_pair : _reco_algo_v) {
+
+      if(!algo_pair.first->PeakWithinSampleSpread()) return false;
+
+      auto const& ped_algo = algo_pair.second ? algo_pair.second : _ped_algo;
+
+      if(!ped_algo || !ped_algo->MeanWithinSampleRange()) return false;
+    }
+
+    ++_prefilter_checked;
+
+    short min = 0, max = 0;
+    MinMax(wf.data(), wf.size(), min, max);
+
+    if(((double)max - (double)min + 1.) >= _config.prefilter_threshold) return false;
+
+    ++_prefilter_skipped;
+
+    return true;
+  }
+
+  //*************************************************************************
+  size_t PulseRecoManager::AlgoIndex(const PMTPulseRecoBase& algo) const
+  //*************************************************************************
+  {
+    for(size_t algo_index = 0; algo_index < _reco_algo_v.size(); ++algo_index)
+
+      if(_reco_algo_v[algo_index].first == &algo) return algo_index;
+
+    std::stringstream ss;
+    ss << "Pulse algo " << algo.Name() << " is not registered to this PulseRecoManager";
+    throw OpticalRecoException(ss.str());
+  }
+
 }
@@ -16,14 +16,86 @@
 #define PULSERECOMANAGER_H
 
 #include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
+#include "larana/OpticalDetector/OpHitFinder/PMTPedestalBase.h"
+#include "larana/OpticalDetector/OpHitFinder/PMTPulseRecoBase.h"
 
+#include <atomic>
 #include <vector>
 
 namespace pmtana
 {
 
-  class PMTPedestalBase;
-  class PMTPulseRecoBase;
+  /**
+   \struct PulseRecoContext
+   Caller-owned scratch and output buffers for the re-entrant PulseRecoManager::Reconstruct.
+   A context must not be shared between concurrent calls, but any number of contexts can be
+   used with the same manager at once. Buffers keep their capacity from one waveform to the next.
+  */
+  struct PulseRecoContext {
+
+    /// Readout channel of the waveform, for pedestal algorithms with per-channel state
+    /// (negative if unknown); set by the caller
+    int channel = -1;
+    /// Pedestal mean computed by the default pedestal algorithm
+    pmtana::PedestalMean_t  ped_mean_v;
+    /// Pedestal sigma computed by the default pedestal algorithm
+    pmtana::PedestalSigma_t ped_sigma_v;
+    /// Pedestal mean computed by an algorithm-specific pedestal algorithm
+    pmtana::PedestalMean_t  algo_mean_v;
+    /// Pedestal sigma computed by an algorithm-specific pedestal algorithm
+    pmtana::PedestalSigma_t algo_sigma_v;
+    /// In streaming mode, whether the default pedestal is a single value and that value
+    bool   ped_constant = false;
+    double ped_mean     = 0;
+    double ped_sigma    = 0;
+    /// Reconstructed pulses, one array per pulse reconstruction algorithm (in AddRecoAlgo order)
+    std::vector<pmtana::pulse_param_array> pulse_v;
+    /// In pulse table mode, the same pulses in compact tables (pulse_v is then scratch)
+    std::vector<pmtana::pulse_table> table_v;
+    /// Work buffers of the algorithms
+    pmtana::RecoScratch scratch;
+    /// Block-wise reconstruction state: pedestal, pulses open at the end of the last block
+    /// (by algorithm) and the samples received before the pedestal was known
+    pmtana::PedestalChunkState           ped_chunk;
+    std::vector<pmtana::PulseChunkState> chunk_v;
+    std::vector<short>                   pending;
+
+  };
+
+  /**
+   \struct PulseRecoBatchContext
+   Caller-owned buffers for the batched PulseRecoManager::Reconstruct: one PulseRecoContext per
+   waveform, with the same use as in the single-waveform Reconstruct, plus the batch scratch.
+  */
+  struct PulseRecoBatchContext {
+
+    /// Contexts of the waveforms of the batch, in order; channels are set by the caller
+    std::vector<pmtana::PulseRecoContext> contexts;
+    /// Waveforms, constant pedestals and output arrays passed to the pulse algorithm
+    std::vector<const pmtana::Waveform_t*>  waveforms;
+    std::vector<double>                     ped_mean;
+    std::vector<double>                     ped_sigma;
+    std::vector<pmtana::pulse_param_array*> pulses;
+    /// Sample-interleaved copy of the waveforms
+    std::vector<short> interleaved;
+
+  };
+
+  /**
+   \struct PulseRecoConfig
+   Reconstruction modes of the PulseRecoManager, set together with PulseRecoManager::SetConfig,
+   which checks the combination. Each mode gives the same pulses as the default (all off); see the
+   setter of each for what it does.
+  */
+  struct PulseRecoConfig {
+
+    bool   streaming           = false; ///< See PulseRecoManager::SetStreamingMode
+    size_t chunk_size          = 0;     ///< See PulseRecoManager::SetChunkSize
+    bool   batch               = false; ///< See PulseRecoManager::SetBatchMode
+    bool   table               = false; ///< See PulseRecoManager::SetPulseTableMode
+    double prefilter_threshold = -1;    ///< See PulseRecoManager::SetPrefilterThreshold
+
+  };
 
   /**
    \class PulseRecoManager
@@ -41,12 +113,118 @@ namespace pmtana
     /// Implementation of ana_base::analyze method
     bool Reconstruct(const pmtana::Waveform_t&) const;
 
+    /**
+       Re-entrant version of Reconstruct: pedestals and pulses are stored in the context
+       instead of the algorithms, which are left untouched and can be shared between threads.
+       Pulses of an algorithm which could not run (e.g. failed pedestal) are left empty.
+    */
+    bool Reconstruct(const pmtana::Waveform_t&, pmtana::PulseRecoContext&) const;
+
+    /**
+       Batched version of the re-entrant Reconstruct: waveform i is reconstructed into
+       batch.contexts[i] (resized to the number of waveforms). In batch mode (SetBatchMode),
+       waveforms with a constant pedestal are passed together to PMTPulseRecoBase::ReconstructBatch;
+       otherwise they are reconstructed one by one. Results are the same as in the single-waveform
+       Reconstruct.
+    */
+    bool Reconstruct(const std::vector<const pmtana::Waveform_t*>&,
+		     pmtana::PulseRecoBatchContext&) const;
+
+    /**
+       Block-wise version of the re-entrant Reconstruct, for a waveform which is not held whole:
+       BeginWaveform, then ReconstructBlock for each block of consecutive samples, then
+       EndWaveform. The constant pedestal is accumulated block by block (see
+       PMTPedestalBase::EvaluateChunk), and the pulse search starts as soon as it is known; only
+       the samples before that are kept in the context. After EndWaveform, the pulses are in the
+       context as after Reconstruct, and the same. Needs SupportsBlocks.
+    */
+    void BeginWaveform(pmtana::PulseRecoContext&) const;
+
+    /// Next block of samples of the waveform (see BeginWaveform)
+    bool ReconstructBlock(const short* samples, size_t n, pmtana::PulseRecoContext&) const;
+
+    /// Closes the pulses still open at the end of the waveform (see BeginWaveform);
+    /// throws if the waveform ended before its pedestal was known
+    bool EndWaveform(pmtana::PulseRecoContext&) const;
+
+    /// True if the default pedestal algorithm and all pulse algorithms SupportsChunks, and no
+    /// pulse algorithm has its own pedestal algorithm: block-wise reconstruction is possible
+    bool SupportsBlocks() const;
+
+    /// Index of the pulse reconstruction algorithm in PulseRecoContext::pulse_v
+    size_t AlgoIndex(const pmtana::PMTPulseRecoBase& algo) const;
+
     /// A method to set pulse reconstruction algorithm
     void AddRecoAlgo (pmtana::PMTPulseRecoBase* algo, PMTPedestalBase* ped_algo=nullptr);
 
     /// A method to set a choice of pedestal estimation method
     void SetDefaultPedAlgo (pmtana::PMTPedestalBase* algo);
 
+    /**
+       Sets all the reconstruction modes at once. To be called after the algorithms are added:
+       throws if the modes cannot all apply to them (chunks without SupportsBlocks). The setters
+       below change one mode of the current configuration through it.
+    */
+    void SetConfig (const pmtana::PulseRecoConfig& config);
+
+    /// The reconstruction modes
+    const pmtana::PulseRecoConfig& Config() const { return _config; }
+
+    /**
+       Enables the streaming mode of the re-entrant Reconstruct: when a pedestal algorithm finds
+       a single pedestal value for the waveform (PMTPedestalBase::IsConstant), that value is passed
+       straight to the pulse algorithms and no per-sample pedestal arrays are filled in the context.
+       Pulses are the same as in the default mode.
+    */
+    void SetStreamingMode (bool streaming);
+
+    /**
+       Enables the chunked mode of the re-entrant Reconstruct (implies the streaming mode): the
+       waveform goes through the block-wise Reconstruct (BeginWaveform) in blocks of chunk_size
+       samples, so the pedestal and the open pulses are carried across blocks and no per-sample
+       array is filled. Pulses are the same as in the default mode. Zero disables it (default).
+       Only configurations which SupportsBlocks can run in blocks: of the pedestal algorithms, only
+       PedAlgoEdges with the head method. Throws otherwise (see SetConfig), instead of running on
+       whole waveforms.
+    */
+    void SetChunkSize (size_t chunk_size);
+
+    /**
+       Enables the batch mode of the batched Reconstruct (implies the streaming mode). It applies
+       when there is a single pulse algorithm, using the default pedestal algorithm; the pulse
+       algorithm reconstructs equal-length waveforms side by side if it SupportsBatch.
+    */
+    void SetBatchMode (bool batch);
+
+    /// Whether the batch mode is enabled
+    bool BatchMode() const { return _config.batch; }
+
+    /**
+       Enables the pulse table mode of the re-entrant Reconstruct (implies the streaming mode): the
+       pulses of each algorithm are delivered in PulseRecoContext::table_v (see pulse_table). With a
+       constant pedestal and no chunking, algorithms fill the tables directly; otherwise the pulse
+       arrays are copied into them.
+    */
+    void SetPulseTableMode (bool table);
+
+    /// Whether the pulse table mode is enabled
+    bool PulseTableMode() const { return _config.table; }
+
+    /**
+       Enables the prefilter of the re-entrant Reconstruct: a waveform whose max-min spread, plus
+       one ADC count for rounding, is below min_peak cannot have a pulse peak of min_peak, so it is
+       not reconstructed and gets no pulses. The prefilter only applies when every pulse algorithm
+       is PeakWithinSampleSpread and every pedestal algorithm is MeanWithinSampleRange.
+       A negative min_peak disables it (default).
+    */
+    void SetPrefilterThreshold (double min_peak);
+
+    /// Number of waveforms tested by the prefilter
+    size_t NumPrefilterChecked() const { return _prefilter_checked; }
+
+    /// Number of waveforms skipped by the prefilter
+    size_t NumPrefilterSkipped() const { return _prefilter_skipped; }
+
   private:
 
     /// pulse reconstruction algorithm pointer
@@ -55,6 +233,43 @@ namespace pmtana
     /// ped_estimator object
     PMTPedestalBase* _ped_algo;
 
+    /// Reconstruction modes
+    pmtana::PulseRecoConfig _config;
+
+    /// Prefilter statistics
+    mutable std::atomic<size_t> _prefilter_checked;
+    mutable std::atomic<size_t> _prefilter_skipped;
+
+    /// True if the prefilter rules out any pulse above threshold in this waveform
+    bool Prefiltered(const pmtana::Waveform_t& wf) const;
+
+    /// Next samples of the waveform through all pulse algorithms, once the pedestal is known
+    bool ReconstructChunks(const short* samples, size_t n, pmtana::PulseRecoContext& ctx) const;
+
+    /// Pulse reconstruction with a constant or per-sample pedestal into the array, or into the
+    /// table when given (the array is then used as scratch if needed)
+    bool ReconstructAlgo(const pmtana::Waveform_t& wf,
+			 const pmtana::PMTPulseRecoBase& pulse_algo,
+			 bool constant,
+			 double ped_mean,
+			 double ped_sigma,
+			 const pmtana::PedestalMean_t&  mean_v,
+			 const pmtana::PedestalSigma_t& sigma_v,
+			 pmtana::pulse_param_array& pulses,
+			 pmtana::pulse_table* table,
+			 pmtana::RecoScratch& scratch) const;
+
+    /// Pedestal evaluation into the context, as a single value in streaming mode
+    bool EvaluatePedestal(const pmtana::Waveform_t& wf,
+			  int channel,
+			  const pmtana::PMTPedestalBase& ped_algo,
+			  pmtana::PedestalMean_t&  mean_v,
+			  pmtana::PedestalSigma_t& sigma_v,
+			  bool& constant,
+			  double& ped_mean,
+			  double& ped_sigma,
+			  pmtana::RecoScratch& scratch) const;
+
   };
 }
 #endif
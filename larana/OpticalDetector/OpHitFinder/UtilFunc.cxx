@@ -1,5 +1,6 @@
 #include "UtilFunc.h"
 #include "OpticalRecoException.h"
+#include "WaveformKernels.h"
 #include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
 
 #include <algorithm>
@@ -16,9 +17,10 @@ namespace pmtana {
     if(start > wf.size() || (start+nsample) > wf.size())
       throw OpticalRecoException("Invalid start/end index!");
 
-    double sum = std::accumulate(wf.begin()+start,wf.begin()+start+nsample,0.0) / ((double)nsample);
+    int64_t sum, sum2;
+    WindowSums(wf.data()+start, nsample, sum, sum2);
 
-    return sum;
+    return sum / ((double)nsample);
   }
 
 
@@ -49,16 +51,114 @@ namespace pmtana {
 
     for(size_t index=start; index < (start+nsample); ++index)
 
-      sigma += pow( (wf[index] - ped_mean), 2 );
+      sigma += (wf[index] - ped_mean) * (wf[index] - ped_mean);
 
     sigma = sqrt(sigma/((double)(nsample)));
 
     return sigma;
   }
 
+  void mean_std(const std::vector<short>& wf, double& ped_mean, double& ped_sigma, size_t start, size_t nsample)
+  {
+    if(!nsample) nsample = wf.size();
+    if(start > wf.size() || (start+nsample) > wf.size())
+      throw OpticalRecoException("Invalid start/end index!");
+
+    int64_t sum, sum2;
+    WindowSums(wf.data()+start, nsample, sum, sum2);
+
+    const double n = nsample;
+    ped_mean  = sum / n;
+    ped_sigma = sqrt((double)((int64_t)nsample*sum2 - sum*sum) / (n*n));
+  }
+
+  void windowed_mean_std(const std::vector<short>& wf, size_t nsample,
+                         std::vector<double>& mean_v, std::vector<double>& sigma_v,
+                         size_t offset)
+  {
+    if(!nsample || nsample > wf.size())
+      throw OpticalRecoException("Invalid window size!");
+
+    const size_t nwindow = wf.size() - nsample + 1;
+    if(mean_v.size()  < nwindow + offset) mean_v.resize (nwindow + offset);
+    if(sigma_v.size() < nwindow + offset) sigma_v.resize(nwindow + offset);
+
+    // Integer running sums are exact, so the mean is identical to pmtana::mean
+    // and n^2*variance = n*sum(x^2) - sum(x)^2 carries no cancellation error
+    const long long n = nsample;
+    int64_t first_sum, first_sum2;
+    WindowSums(wf.data(), nsample, first_sum, first_sum2);
+    long long sum  = first_sum;
+    long long sum2 = first_sum2;
+
+    const double n2 = (double)n * (double)n;
+
+    for(size_t k=0; k<nwindow; ++k) {
+
+      if(k) {
+	const long long out = wf[k-1];
+	const long long in  = wf[k+nsample-1];
+	sum  += in - out;
+	sum2 += in*in - out*out;
+      }
+
+      mean_v [k+offset] = sum / (double)n;
+      sigma_v[k+offset] = sqrt((double)(n*sum2 - sum*sum) / n2);
+    }
+  }
+
+  void windowed_mean_std(const std::vector<double>& wf, size_t nsample,
+                         std::vector<double>& mean_v, std::vector<double>& sigma_v,
+                         size_t offset)
+  {
+    if(!nsample || nsample > wf.size())
+      throw OpticalRecoException("Invalid window size!");
+
+    const size_t nwindow = wf.size() - nsample + 1;
+    if(mean_v.size()  < nwindow + offset) mean_v.resize (nwindow + offset);
+    if(sigma_v.size() < nwindow + offset) sigma_v.resize(nwindow + offset);
+
+    // Sums are taken relative to the first sample to limit cancellation, and
+    // recomputed from scratch every nsample steps so rounding cannot build up
+    const double ref = wf.front();
+    double sum  = 0;
+    double sum2 = 0;
+
+    for(size_t k=0; k<nwindow; ++k) {
+
+      if(k % nsample == 0) {
+	sum = sum2 = 0;
+	for(size_t index=k; index<k+nsample; ++index) {
+	  const double d = wf[index] - ref;
+	  sum  += d;
+	  sum2 += d*d;
+	}
+      }
+      else {
+	const double out = wf[k-1] - ref;
+	const double in  = wf[k+nsample-1] - ref;
+	sum  += in - out;
+	sum2 += in*in - out*out;
+      }
+
+      const double m   = sum / nsample;
+      const double var = sum2 / nsample - m*m;
+
+      mean_v [k+offset] = m + ref;
+      sigma_v[k+offset] = var > 0 ? sqrt(var) : 0.;
+    }
+  }
+
   double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins)
+  {
+    std::vector<size_t> ctr_v;
+    return BinnedMaxOccurrence(mean_v,nbins,ctr_v);
+  }
+
+  double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins,std::vector<size_t>& ctr_v)
   {
     if(nbins<1) throw OpticalRecoException("Cannot have 0 binning");
+    if(mean_v.empty()) throw OpticalRecoException("Cannot find max occurrence of empty input");
 
     auto res = std::minmax_element(std::begin(mean_v),std::end(mean_v));
 
@@ -69,14 +169,16 @@ namespace pmtana {
     //std::cout<<"Min: "<<(*res.first)<<" Max: "<<(*res.second)<<" Width: "<<bin_width<<std::endl;
 
     // Construct array of nbins
-    static std::vector<size_t> ctr_v(nbins,0);
-    for(auto& v : ctr_v) v=0;
+    ctr_v.assign(nbins,0);
     for(auto const& v : mean_v) {
 
       size_t index = int((v - (*res.first))/bin_width);
       //std::cout<<"adc = "<<v<<" width = "<<bin_width<< " ... "
       //<<index<<" / "<<ctr_v.size()<<std::endl;
 
+      // the maximum falls on the upper edge of the last bin
+      if(index >= nbins) index = nbins - 1;
+
       ctr_v[index]++;
 
     }
@@ -99,6 +201,79 @@ namespace pmtana {
     return (mean_max_occurrence / num_occurrence);
   }
 
+  double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins,const size_t quantum,
+			     std::vector<size_t>& ctr_v)
+  {
+    if(nbins<1) throw OpticalRecoException("Cannot have 0 binning");
+    if(quantum<1) throw OpticalRecoException("Cannot have 0 quantum");
+    if(mean_v.empty()) throw OpticalRecoException("Cannot find max occurrence of empty input");
+
+    const double q = quantum;
+
+    // Integer value k = v * quantum of every entry, and their range
+    long long kmin = std::llround(mean_v.front() * q);
+    long long kmax = kmin;
+    for(auto const& v : mean_v) {
+      const long long k = std::llround(v * q);
+      // not a multiple of 1/quantum: no exact integer histogram
+      if(k / q != v) return BinnedMaxOccurrence(mean_v,nbins,ctr_v);
+      if(k < kmin) kmin = k;
+      if(k > kmax) kmax = k;
+    }
+
+    // Wide range: one counter per value would not be cheaper than the binned histogram
+    const size_t nvalues = kmax - kmin + 1;
+    if(nvalues > nbins) return BinnedMaxOccurrence(mean_v,nbins,ctr_v);
+
+    const double min_v = kmin / q;
+    const double max_v = kmax / q;
+
+    double bin_width = (max_v - min_v) / ((double)nbins);
+
+    if(nbins==1 || bin_width == 0) return (min_v + bin_width /2.);
+
+    // One counter per integer value
+    ctr_v.assign(nvalues,0);
+    for(auto const& v : mean_v) ctr_v[std::llround(v * q) - kmin]++;
+
+    // Merge the values into the bins of the binned histogram (values increase with the bin
+    // index, so each bin is a run of consecutive values) and average the max-occurrence bins
+    size_t max_ctr = 0;
+    double mean_max_occurrence = 0;
+    double num_occurrence = 0;
+
+    auto add_bin = [&](size_t bin, size_t ctr) {
+      if(ctr < max_ctr) return;
+      if(ctr > max_ctr) {
+	max_ctr = ctr;
+	mean_max_occurrence = 0;
+	num_occurrence = 0;
+      }
+      mean_max_occurrence += (min_v + bin_width / 2. + bin_width * bin);
+      num_occurrence += 1.0;
+    };
+
+    size_t run_bin = 0;
+    size_t run_ctr = 0;
+    for(size_t k=0; k<nvalues; ++k) {
+
+      if(!ctr_v[k]) continue;
+
+      size_t index = int(((kmin + (long long)k) / q - min_v)/bin_width);
+      if(index >= nbins) index = nbins - 1;
+
+      if(run_ctr && index != run_bin) {
+	add_bin(run_bin,run_ctr);
+	run_ctr = 0;
+      }
+      run_bin  = index;
+      run_ctr += ctr_v[k];
+    }
+    add_bin(run_bin,run_ctr);
+
+    return (mean_max_occurrence / num_occurrence);
+  }
+
 
   // template<typename W>
   int sign(double val) {
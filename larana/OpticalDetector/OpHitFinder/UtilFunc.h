@@ -14,8 +14,32 @@ namespace pmtana {
 
   double std(const std::vector<short>& wf, const double ped_mean, size_t start=0, size_t nsample=0);
 
+  /// Mean and standard deviation of nsample samples from start, from exact integer sums
+  void mean_std(const std::vector<short>& wf, double& ped_mean, double& ped_sigma, size_t start=0, size_t nsample=0);
+
+  /// Mean and standard deviation of every window of nsample consecutive samples
+  /// in a single O(N) pass. The result for the window starting at sample k is
+  /// stored at index k+offset of mean_v and sigma_v, which are grown if needed.
+  void windowed_mean_std(const std::vector<short>& wf, size_t nsample,
+                         std::vector<double>& mean_v, std::vector<double>& sigma_v,
+                         size_t offset=0);
+
+  /// Same as above for a floating point waveform
+  void windowed_mean_std(const std::vector<double>& wf, size_t nsample,
+                         std::vector<double>& mean_v, std::vector<double>& sigma_v,
+                         size_t offset=0);
+
   double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins);
 
+  /// Same as above, with a caller-owned histogram buffer that is reused between calls
+  double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins,std::vector<size_t>& ctr_v);
+
+  /// Same as above for values that are multiples of 1/quantum, such as means of quantum ADC
+  /// samples. When they span fewer than nbins distinct values the histogram is filled with
+  /// exact integer counts, one per value; the result is the same as the binned one.
+  double BinnedMaxOccurrence(const PedestalMean_t& mean_v,const size_t nbins,const size_t quantum,
+			     std::vector<size_t>& ctr_v);
+
   double BinnedMaxTH1D(const std::vector<double>& v ,int bins);
 
   int sign(double val);
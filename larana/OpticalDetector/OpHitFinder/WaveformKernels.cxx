@@ -0,0 +1,609 @@
+////////////////////////////////////////////////////////////////////////
+//
+//  WaveformKernels source
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "WaveformKernels.h"
+
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(PMTANA_NO_SIMD)
+#define PMTANA_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace pmtana {
+
+  namespace {
+
+    //
+    // Scalar reference implementations
+    //
+
+    void ConvertToFloat_scalar(const short* wf, size_t n, float* out)
+    {
+      for(size_t i=0; i<n; ++i) out[i] = wf[i];
+    }
+
+    void WindowSums_scalar(const short* wf, size_t n, int64_t& sum, int64_t& sum2)
+    {
+      sum = sum2 = 0;
+      for(size_t i=0; i<n; ++i) {
+	sum  += wf[i];
+	sum2 += (int64_t)wf[i] * wf[i];
+      }
+    }
+
+    void SubtractBaseline_scalar(const short* wf, const double* baseline, size_t n, double* out)
+    {
+      for(size_t i=0; i<n; ++i) out[i] = (double)wf[i] - baseline[i];
+    }
+
+    void SubtractConstBaseline_scalar(const short* wf, double baseline, size_t n, double* out)
+    {
+      for(size_t i=0; i<n; ++i) out[i] = (double)wf[i] - baseline;
+    }
+
+    void ConstantFraction_scalar(const short* wf, const double* baseline, size_t n,
+				 double scale, size_t delay, double* out)
+    {
+      for(size_t i=0; i<n; ++i) {
+	out[i] = scale * ((double)wf[i] - baseline[i]);
+	if(i >= delay) out[i] += ((double)wf[i-delay] - baseline[i]);
+      }
+    }
+
+    size_t ArgMax_scalar(const short* wf, size_t n)
+    {
+      size_t index = 0;
+      for(size_t i=1; i<n; ++i) if(wf[index] < wf[i]) index = i;
+      return n ? index : n;
+    }
+
+    size_t ArgMin_scalar(const short* wf, size_t n)
+    {
+      size_t index = 0;
+      for(size_t i=1; i<n; ++i) if(wf[i] < wf[index]) index = i;
+      return n ? index : n;
+    }
+
+    void MinMax_scalar(const short* wf, size_t n, short& min, short& max)
+    {
+      min = max = n ? wf[0] : 0;
+      for(size_t i=1; i<n; ++i) {
+	if(wf[i] < min) min = wf[i];
+	if(max < wf[i]) max = wf[i];
+      }
+    }
+
+    size_t FindFirstAtOrAbove_scalar(const short* wf, size_t n, short threshold)
+    {
+      for(size_t i=0; i<n; ++i) if(wf[i] >= threshold) return i;
+      return n;
+    }
+
+    size_t FindFirstRowAtOrAbove_scalar(const short* rows, size_t nrows, const short* thresholds)
+    {
+      for(size_t row=0; row<nrows; ++row, rows+=NumBatchLanes)
+	for(size_t lane=0; lane<NumBatchLanes; ++lane)
+	  if(rows[lane] >= thresholds[lane]) return row;
+      return nrows;
+    }
+
+    unsigned RowLanesAtOrAbove_scalar(const short* row, const short* thresholds)
+    {
+      unsigned mask = 0;
+      for(size_t lane=0; lane<NumBatchLanes; ++lane)
+	if(row[lane] >= thresholds[lane]) mask |= 1u << lane;
+      return mask;
+    }
+
+#ifdef PMTANA_X86_KERNELS
+
+    inline size_t FirstSetLane16(unsigned mask) { return __builtin_ctz(mask) / 2; }
+
+    //
+    // AVX2 implementations (16 samples per iteration for int16 data)
+    //
+
+    __attribute__((target("avx2")))
+    void ConvertToFloat_avx2(const short* wf, size_t n, float* out)
+    {
+      size_t i=0;
+      for(; i+16<=n; i+=16) {
+	__m256i v  = _mm256_loadu_si256((const __m256i*)(wf+i));
+	__m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+	__m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v,1));
+	_mm256_storeu_ps(out+i,   _mm256_cvtepi32_ps(lo));
+	_mm256_storeu_ps(out+i+8, _mm256_cvtepi32_ps(hi));
+      }
+      ConvertToFloat_scalar(wf+i, n-i, out+i);
+    }
+
+    __attribute__((target("avx2")))
+    void WindowSums_avx2(const short* wf, size_t n, int64_t& sum, int64_t& sum2)
+    {
+      const __m256i ones = _mm256_set1_epi16(1);
+      __m256i sum64  = _mm256_setzero_si256();
+      __m256i sum2_64 = _mm256_setzero_si256();
+
+      size_t i=0;
+      while(i+16<=n) {
+	// pairwise sums fit in int32 for up to 2^15 iterations
+	__m256i sum32 = _mm256_setzero_si256();
+	for(size_t block=0; block<4096 && i+16<=n; ++block, i+=16) {
+	  __m256i v  = _mm256_loadu_si256((const __m256i*)(wf+i));
+	  sum32      = _mm256_add_epi32(sum32, _mm256_madd_epi16(v, ones));
+	  // x0^2+x1^2 <= 2^31 fits in an unsigned 32 bit lane
+	  __m256i sq = _mm256_madd_epi16(v, v);
+	  sum2_64    = _mm256_add_epi64(sum2_64, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sq)));
+	  sum2_64    = _mm256_add_epi64(sum2_64, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sq,1)));
+	}
+	sum64 = _mm256_add_epi64(sum64, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(sum32)));
+	sum64 = _mm256_add_epi64(sum64, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(sum32,1)));
+      }
+
+      int64_t lanes[4], lanes2[4];
+      _mm256_storeu_si256((__m256i*)lanes,  sum64);
+      _mm256_storeu_si256((__m256i*)lanes2, sum2_64);
+
+      WindowSums_scalar(wf+i, n-i, sum, sum2);
+      for(size_t lane=0; lane<4; ++lane) { sum += lanes[lane]; sum2 += lanes2[lane]; }
+    }
+
+    __attribute__((target("avx2")))
+    void SubtractBaseline_avx2(const short* wf, const double* baseline, size_t n, double* out)
+    {
+      size_t i=0;
+      for(; i+4<=n; i+=4) {
+	__m256d x = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(wf+i))));
+	_mm256_storeu_pd(out+i, _mm256_sub_pd(x, _mm256_loadu_pd(baseline+i)));
+      }
+      SubtractBaseline_scalar(wf+i, baseline+i, n-i, out+i);
+    }
+
+    __attribute__((target("avx2")))
+    void SubtractConstBaseline_avx2(const short* wf, double baseline, size_t n, double* out)
+    {
+      const __m256d b = _mm256_set1_pd(baseline);
+      size_t i=0;
+      for(; i+4<=n; i+=4) {
+	__m256d x = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(wf+i))));
+	_mm256_storeu_pd(out+i, _mm256_sub_pd(x, b));
+      }
+      SubtractConstBaseline_scalar(wf+i, baseline, n-i, out+i);
+    }
+
+    __attribute__((target("avx2")))
+    void ConstantFraction_avx2(const short* wf, const double* baseline, size_t n,
+			       double scale, size_t delay, double* out)
+    {
+      size_t i = delay < n ? delay : n;
+      ConstantFraction_scalar(wf, baseline, i, scale, delay, out);
+
+      const __m256d s = _mm256_set1_pd(scale);
+      for(; i+4<=n; i+=4) {
+	__m256d b = _mm256_loadu_pd(baseline+i);
+	__m256d x = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(wf+i))));
+	__m256d y = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(wf+i-delay))));
+	_mm256_storeu_pd(out+i, _mm256_add_pd(_mm256_mul_pd(s, _mm256_sub_pd(x,b)), _mm256_sub_pd(y,b)));
+      }
+      for(; i<n; ++i)
+	out[i] = scale * ((double)wf[i] - baseline[i]) + ((double)wf[i-delay] - baseline[i]);
+    }
+
+    __attribute__((target("avx2")))
+    size_t FindFirstEqual_avx2(const short* wf, size_t n, short value)
+    {
+      const __m256i t = _mm256_set1_epi16(value);
+      size_t i=0;
+      for(; i+16<=n; i+=16) {
+	unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(wf+i)), t));
+	if(mask) return i + FirstSetLane16(mask);
+      }
+      for(; i<n; ++i) if(wf[i] == value) return i;
+      return n;
+    }
+
+    __attribute__((target("avx2")))
+    size_t ArgMax_avx2(const short* wf, size_t n)
+    {
+      if(n < 32) return ArgMax_scalar(wf, n);
+      __m256i m = _mm256_loadu_si256((const __m256i*)wf);
+      size_t i=16;
+      for(; i+16<=n; i+=16) m = _mm256_max_epi16(m, _mm256_loadu_si256((const __m256i*)(wf+i)));
+      short lanes[16];
+      _mm256_storeu_si256((__m256i*)lanes, m);
+      short max = lanes[0];
+      for(size_t lane=1; lane<16; ++lane) if(max < lanes[lane]) max = lanes[lane];
+      for(; i<n; ++i) if(max < wf[i]) max = wf[i];
+      return FindFirstEqual_avx2(wf, n, max);
+    }
+
+    __attribute__((target("avx2")))
+    size_t ArgMin_avx2(const short* wf, size_t n)
+    {
+      if(n < 32) return ArgMin_scalar(wf, n);
+      __m256i m = _mm256_loadu_si256((const __m256i*)wf);
+      size_t i=16;
+      for(; i+16<=n; i+=16) m = _mm256_min_epi16(m, _mm256_loadu_si256((const __m256i*)(wf+i)));
+      short lanes[16];
+      _mm256_storeu_si256((__m256i*)lanes, m);
+      short min = lanes[0];
+      for(size_t lane=1; lane<16; ++lane) if(lanes[lane] < min) min = lanes[lane];
+      for(; i<n; ++i) if(wf[i] < min) min = wf[i];
+      return FindFirstEqual_avx2(wf, n, min);
+    }
+
+    __attribute__((target("avx2")))
+    void MinMax_avx2(const short* wf, size_t n, short& min, short& max)
+    {
+      if(n < 32) return MinMax_scalar(wf, n, min, max);
+      __m256i lo = _mm256_loadu_si256((const __m256i*)wf);
+      __m256i hi = lo;
+      size_t i=16;
+      for(; i+16<=n; i+=16) {
+	const __m256i v = _mm256_loadu_si256((const __m256i*)(wf+i));
+	lo = _mm256_min_epi16(lo, v);
+	hi = _mm256_max_epi16(hi, v);
+      }
+      short lo_lanes[16], hi_lanes[16];
+      _mm256_storeu_si256((__m256i*)lo_lanes, lo);
+      _mm256_storeu_si256((__m256i*)hi_lanes, hi);
+      min = lo_lanes[0];
+      max = hi_lanes[0];
+      for(size_t lane=1; lane<16; ++lane) {
+	if(lo_lanes[lane] < min) min = lo_lanes[lane];
+	if(max < hi_lanes[lane]) max = hi_lanes[lane];
+      }
+      for(; i<n; ++i) {
+	if(wf[i] < min) min = wf[i];
+	if(max < wf[i]) max = wf[i];
+      }
+    }
+
+    __attribute__((target("avx2")))
+    size_t FindFirstAtOrAbove_avx2(const short* wf, size_t n, short threshold)
+    {
+      if(threshold == INT16_MIN) return 0;
+      const __m256i t = _mm256_set1_epi16(threshold - 1);
+      size_t i=0;
+      for(; i+16<=n; i+=16) {
+	unsigned mask = _mm256_movemask_epi8(_mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)(wf+i)), t));
+	if(mask) return i + FirstSetLane16(mask);
+      }
+      return i + FindFirstAtOrAbove_scalar(wf+i, n-i, threshold);
+    }
+
+    __attribute__((target("avx2")))
+    size_t FindFirstRowAtOrAbove_avx2(const short* rows, size_t nrows, const short* thresholds)
+    {
+      // A row is skipped while every lane is below its threshold
+      const __m256i t = _mm256_loadu_si256((const __m256i*)thresholds);
+      for(size_t row=0; row<nrows; ++row, rows+=NumBatchLanes) {
+	unsigned below = _mm256_movemask_epi8(_mm256_cmpgt_epi16(t, _mm256_loadu_si256((const __m256i*)rows)));
+	if(below != 0xFFFFFFFFu) return row;
+      }
+      return nrows;
+    }
+
+    __attribute__((target("avx2")))
+    unsigned RowLanesAtOrAbove_avx2(const short* row, const short* thresholds)
+    {
+      // Packing the 16-bit comparison results to bytes leaves one mask bit per lane
+      __m256i below = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i*)thresholds),
+					 _mm256_loadu_si256((const __m256i*)row));
+      __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(below),
+				       _mm256_extracti128_si256(below, 1));
+      return ~(unsigned)_mm_movemask_epi8(packed) & 0xFFFFu;
+    }
+
+    //
+    // SSE4.1 implementations (8 samples per iteration for int16 data)
+    //
+
+    __attribute__((target("sse4.1")))
+    inline __m128d LoadTwoAsDouble(const short* wf)
+    {
+      int32_t pair;
+      std::memcpy(&pair, wf, sizeof(pair));
+      return _mm_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_cvtsi32_si128(pair)));
+    }
+
+    __attribute__((target("sse4.1")))
+    void ConvertToFloat_sse41(const short* wf, size_t n, float* out)
+    {
+      size_t i=0;
+      for(; i+8<=n; i+=8) {
+	__m128i v = _mm_loadu_si128((const __m128i*)(wf+i));
+	_mm_storeu_ps(out+i,   _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)));
+	_mm_storeu_ps(out+i+4, _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v,8))));
+      }
+      ConvertToFloat_scalar(wf+i, n-i, out+i);
+    }
+
+    __attribute__((target("sse4.1")))
+    void WindowSums_sse41(const short* wf, size_t n, int64_t& sum, int64_t& sum2)
+    {
+      const __m128i ones = _mm_set1_epi16(1);
+      __m128i sum64   = _mm_setzero_si128();
+      __m128i sum2_64 = _mm_setzero_si128();
+
+      size_t i=0;
+      while(i+8<=n) {
+	__m128i sum32 = _mm_setzero_si128();
+	for(size_t block=0; block<4096 && i+8<=n; ++block, i+=8) {
+	  __m128i v  = _mm_loadu_si128((const __m128i*)(wf+i));
+	  sum32      = _mm_add_epi32(sum32, _mm_madd_epi16(v, ones));
+	  __m128i sq = _mm_madd_epi16(v, v);
+	  sum2_64    = _mm_add_epi64(sum2_64, _mm_cvtepu32_epi64(sq));
+	  sum2_64    = _mm_add_epi64(sum2_64, _mm_cvtepu32_epi64(_mm_srli_si128(sq,8)));
+	}
+	sum64 = _mm_add_epi64(sum64, _mm_cvtepi32_epi64(sum32));
+	sum64 = _mm_add_epi64(sum64, _mm_cvtepi32_epi64(_mm_srli_si128(sum32,8)));
+      }
+
+      int64_t lanes[2], lanes2[2];
+      _mm_storeu_si128((__m128i*)lanes,  sum64);
+      _mm_storeu_si128((__m128i*)lanes2, sum2_64);
+
+      WindowSums_scalar(wf+i, n-i, sum, sum2);
+      for(size_t lane=0; lane<2; ++lane) { sum += lanes[lane]; sum2 += lanes2[lane]; }
+    }
+
+    __attribute__((target("sse4.1")))
+    void SubtractBaseline_sse41(const short* wf, const double* baseline, size_t n, double* out)
+    {
+      size_t i=0;
+      for(; i+2<=n; i+=2)
+	_mm_storeu_pd(out+i, _mm_sub_pd(LoadTwoAsDouble(wf+i), _mm_loadu_pd(baseline+i)));
+      SubtractBaseline_scalar(wf+i, baseline+i, n-i, out+i);
+    }
+
+    __attribute__((target("sse4.1")))
+    void SubtractConstBaseline_sse41(const short* wf, double baseline, size_t n, double* out)
+    {
+      const __m128d b = _mm_set1_pd(baseline);
+      size_t i=0;
+      for(; i+2<=n; i+=2)
+	_mm_storeu_pd(out+i, _mm_sub_pd(LoadTwoAsDouble(wf+i), b));
+      SubtractConstBaseline_scalar(wf+i, baseline, n-i, out+i);
+    }
+
+    __attribute__((target("sse4.1")))
+    void ConstantFraction_sse41(const short* wf, const double* baseline, size_t n,
+				double scale, size_t delay, double* out)
+    {
+      size_t i = delay < n ? delay : n;
+      ConstantFraction_scalar(wf, baseline, i, scale, delay, out);
+
+      const __m128d s = _mm_set1_pd(scale);
+      for(; i+2<=n; i+=2) {
+	__m128d b = _mm_loadu_pd(baseline+i);
+	__m128d x = LoadTwoAsDouble(wf+i);
+	__m128d y = LoadTwoAsDouble(wf+i-delay);
+	_mm_storeu_pd(out+i, _mm_add_pd(_mm_mul_pd(s, _mm_sub_pd(x,b)), _mm_sub_pd(y,b)));
+      }
+      for(; i<n; ++i)
+	out[i] = scale * ((double)wf[i] - baseline[i]) + ((double)wf[i-delay] - baseline[i]);
+    }
+
+    __attribute__((target("sse4.1")))
+    size_t FindFirstEqual_sse41(const short* wf, size_t n, short value)
+    {
+      const __m128i t = _mm_set1_epi16(value);
+      size_t i=0;
+      for(; i+8<=n; i+=8) {
+	unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(wf+i)), t));
+	if(mask) return i + FirstSetLane16(mask);
+      }
+      for(; i<n; ++i) if(wf[i] == value) return i;
+      return n;
+    }
+
+    __attribute__((target("sse4.1")))
+    size_t ArgMax_sse41(const short* wf, size_t n)
+    {
+      if(n < 16) return ArgMax_scalar(wf, n);
+      __m128i m = _mm_loadu_si128((const __m128i*)wf);
+      size_t i=8;
+      for(; i+8<=n; i+=8) m = _mm_max_epi16(m, _mm_loadu_si128((const __m128i*)(wf+i)));
+      short lanes[8];
+      _mm_storeu_si128((__m128i*)lanes, m);
+      short max = lanes[0];
+      for(size_t lane=1; lane<8; ++lane) if(max < lanes[lane]) max = lanes[lane];
+      for(; i<n; ++i) if(max < wf[i]) max = wf[i];
+      return FindFirstEqual_sse41(wf, n, max);
+    }
+
+    __attribute__((target("sse4.1")))
+    size_t ArgMin_sse41(const short* wf, size_t n)
+    {
+      if(n < 16) return ArgMin_scalar(wf, n);
+      __m128i m = _mm_loadu_si128((const __m128i*)wf);
+      size_t i=8;
+      for(; i+8<=n; i+=8) m = _mm_min_epi16(m, _mm_loadu_si128((const __m128i*)(wf+i)));
+      short lanes[8];
+      _mm_storeu_si128((__m128i*)lanes, m);
+      short min = lanes[0];
+      for(size_t lane=1; lane<8; ++lane) if(lanes[lane] < min) min = lanes[lane];
+      for(; i<n; ++i) if(wf[i] < min) min = wf[i];
+      return FindFirstEqual_sse41(wf, n, min);
+    }
+
+    __attribute__((target("sse4.1")))
+    void MinMax_sse41(const short* wf, size_t n, short& min, short& max)
+    {
+      if(n < 16) return MinMax_scalar(wf, n, min, max);
+      __m128i lo = _mm_loadu_si128((const __m128i*)wf);
+      __m128i hi = lo;
+      size_t i=8;
+      for(; i+8<=n; i+=8) {
+	const __m128i v = _mm_loadu_si128((const __m128i*)(wf+i));
+	lo = _mm_min_epi16(lo, v);
+	hi = _mm_max_epi16(hi, v);
+      }
+      short lo_lanes[8], hi_lanes[8];
+      _mm_storeu_si128((__m128i*)lo_lanes, lo);
+      _mm_storeu_si128((__m128i*)hi_lanes, hi);
+      min = lo_lanes[0];
+      max = hi_lanes[0];
+      for(size_t lane=1; lane<8; ++lane) {
+	if(lo_lanes[lane] < min) min = lo_lanes[lane];
+	if(max < hi_lanes[lane]) max = hi_lanes[lane];
+      }
+      for(; i<n; ++i) {
+	if(wf[i] < min) min = wf[i];
+	if(max < wf[i]) max = wf[i];
+      }
+    }
+
+    __attribute__((target("sse4.1")))
+    size_t FindFirstAtOrAbove_sse41(const short* wf, size_t n, short threshold)
+    {
+      if(threshold == INT16_MIN) return 0;
+      const __m128i t = _mm_set1_epi16(threshold - 1);
+      size_t i=0;
+      for(; i+8<=n; i+=8) {
+	unsigned mask = _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(wf+i)), t));
+	if(mask) return i + FirstSetLane16(mask);
+      }
+      return i + FindFirstAtOrAbove_scalar(wf+i, n-i, threshold);
+    }
+
+    __attribute__((target("sse4.1")))
+    size_t FindFirstRowAtOrAbove_sse41(const short* rows, size_t nrows, const short* thresholds)
+    {
+      const __m128i t0 = _mm_loadu_si128((const __m128i*)thresholds);
+      const __m128i t1 = _mm_loadu_si128((const __m128i*)(thresholds+8));
+      for(size_t row=0; row<nrows; ++row, rows+=NumBatchLanes) {
+	__m128i below = _mm_and_si128(_mm_cmpgt_epi16(t0, _mm_loadu_si128((const __m128i*)rows)),
+				      _mm_cmpgt_epi16(t1, _mm_loadu_si128((const __m128i*)(rows+8))));
+	if(_mm_movemask_epi8(below) != 0xFFFF) return row;
+      }
+      return nrows;
+    }
+
+    __attribute__((target("sse4.1")))
+    unsigned RowLanesAtOrAbove_sse41(const short* row, const short* thresholds)
+    {
+      __m128i packed =
+	_mm_packs_epi16(_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)thresholds),
+					_mm_loadu_si128((const __m128i*)row)),
+			_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(thresholds+8)),
+					_mm_loadu_si128((const __m128i*)(row+8))));
+      return ~(unsigned)_mm_movemask_epi8(packed) & 0xFFFFu;
+    }
+
+#endif // PMTANA_X86_KERNELS
+
+    /// Implementations selected for this CPU
+    struct KernelTable {
+      const char* isa;
+      void   (*convert_to_float)(const short*, size_t, float*);
+      void   (*window_sums)(const short*, size_t, int64_t&, int64_t&);
+      void   (*subtract_baseline)(const short*, const double*, size_t, double*);
+      void   (*subtract_const_baseline)(const short*, double, size_t, double*);
+      void   (*constant_fraction)(const short*, const double*, size_t, double, size_t, double*);
+      size_t (*arg_max)(const short*, size_t);
+      size_t (*arg_min)(const short*, size_t);
+      void   (*min_max)(const short*, size_t, short&, short&);
+      size_t (*find_first_at_or_above)(const short*, size_t, short);
+      size_t (*find_first_row_at_or_above)(const short*, size_t, const short*);
+      unsigned (*row_lanes_at_or_above)(const short*, const short*);
+    };
+
+    KernelTable SelectKernels()
+    {
+#ifdef PMTANA_X86_KERNELS
+      __builtin_cpu_init();
+
+      if(__builtin_cpu_supports("avx2"))
+	return { "avx2",
+		 ConvertToFloat_avx2, WindowSums_avx2,
+		 SubtractBaseline_avx2, SubtractConstBaseline_avx2,
+		 ConstantFraction_avx2, ArgMax_avx2, ArgMin_avx2, MinMax_avx2,
+		 FindFirstAtOrAbove_avx2, FindFirstRowAtOrAbove_avx2,
+		 RowLanesAtOrAbove_avx2 };
+
+      if(__builtin_cpu_supports("sse4.1"))
+	return { "sse4.1",
+		 ConvertToFloat_sse41, WindowSums_sse41,
+		 SubtractBaseline_sse41, SubtractConstBaseline_sse41,
+		 ConstantFraction_sse41, ArgMax_sse41, ArgMin_sse41, MinMax_sse41,
+		 FindFirstAtOrAbove_sse41, FindFirstRowAtOrAbove_sse41,
+		 RowLanesAtOrAbove_sse41 };
+#endif
+      return { "scalar",
+	       ConvertToFloat_scalar, WindowSums_scalar,
+	       SubtractBaseline_scalar, SubtractConstBaseline_scalar,
+	       ConstantFraction_scalar, ArgMax_scalar, ArgMin_scalar, MinMax_scalar,
+	       FindFirstAtOrAbove_scalar, FindFirstRowAtOrAbove_scalar,
+	       RowLanesAtOrAbove_scalar };
+    }
+
+    const KernelTable& Kernels()
+    {
+      static const KernelTable table = SelectKernels();
+      return table;
+    }
+
+  } // unnamed namespace
+
+  const char* KernelISA()
+  { return Kernels().isa; }
+
+  void ConvertToFloat(const short* wf, size_t n, float* out)
+  { Kernels().convert_to_float(wf, n, out); }
+
+  void WindowSums(const short* wf, size_t n, int64_t& sum, int64_t& sum2)
+  { Kernels().window_sums(wf, n, sum, sum2); }
+
+  void SubtractBaseline(const short* wf, const double* baseline, size_t n, double* out)
+  { Kernels().subtract_baseline(wf, baseline, n, out); }
+
+  void SubtractBaseline(const short* wf, double baseline, size_t n, double* out)
+  { Kernels().subtract_const_baseline(wf, baseline, n, out); }
+
+  void ConstantFraction(const short* wf, const double* baseline, size_t n,
+			double scale, size_t delay, double* out)
+  { Kernels().constant_fraction(wf, baseline, n, scale, delay, out); }
+
+  size_t ArgMax(const short* wf, size_t n)
+  { return Kernels().arg_max(wf, n); }
+
+  size_t ArgMin(const short* wf, size_t n)
+  { return Kernels().arg_min(wf, n); }
+
+  void MinMax(const short* wf, size_t n, short& min, short& max)
+  { Kernels().min_max(wf, n, min, max); }
+
+  size_t FindFirstAtOrAbove(const short* wf, size_t n, short threshold)
+  { return Kernels().find_first_at_or_above(wf, n, threshold); }
+
+  size_t FindFirstAtOrAbove(const short* wf, size_t n, double threshold)
+  {
+    // A short compares >= threshold exactly when it is >= ceil(threshold)
+    if(!(threshold <= INT16_MAX)) return n; // also catches NaN
+    if(threshold <= INT16_MIN)    return 0;
+    return FindFirstAtOrAbove(wf, n, (short)std::ceil(threshold));
+  }
+
+  void InterleaveWaveforms(const short* const* wfs, size_t nwf, size_t n, short* out)
+  {
+    for(size_t i=0; i<n; ++i, out+=NumBatchLanes) {
+      size_t lane=0;
+      for(; lane<nwf; ++lane) out[lane] = wfs[lane][i];
+      for(; lane<NumBatchLanes; ++lane) out[lane] = INT16_MIN;
+    }
+  }
+
+  size_t FindFirstRowAtOrAbove(const short* rows, size_t nrows, const short* thresholds)
+  { return Kernels().find_first_row_at_or_above(rows, nrows, thresholds); }
+
+  unsigned RowLanesAtOrAbove(const short* row, const short* thresholds)
+  { return Kernels().row_lanes_at_or_above(row, thresholds); }
+
+}
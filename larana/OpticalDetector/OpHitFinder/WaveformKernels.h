@@ -0,0 +1,81 @@
+/**
+ * \file WaveformKernels.h
+ *
+ * \ingroup PulseReco
+ *
+ * \brief Vectorized kernels for ADC waveforms
+ *
+ * Each kernel has AVX2, SSE4.1 and scalar implementations; the fastest one
+ * supported by the CPU is selected once at run time. All implementations
+ * return bit-identical results. Define PMTANA_NO_SIMD to build the scalar
+ * versions only.
+ */
+
+/** \addtogroup PulseReco
+
+@{*/
+
+#ifndef larana_OPTICALDETECTOR_WAVEFORMKERNELS_H
+#define larana_OPTICALDETECTOR_WAVEFORMKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pmtana {
+
+  /// Name of the instruction set used by the kernels ("avx2", "sse4.1" or "scalar")
+  const char* KernelISA();
+
+  /// out[i] = (float)wf[i]
+  void ConvertToFloat(const short* wf, size_t n, float* out);
+
+  /// Exact sum and sum of squares of n samples
+  void WindowSums(const short* wf, size_t n, int64_t& sum, int64_t& sum2);
+
+  /// out[i] = wf[i] - baseline[i]
+  void SubtractBaseline(const short* wf, const double* baseline, size_t n, double* out);
+
+  /// out[i] = wf[i] - baseline
+  void SubtractBaseline(const short* wf, double baseline, size_t n, double* out);
+
+  /// Constant fraction signal:
+  /// out[i] = scale * (wf[i] - baseline[i]) + (wf[i-delay] - baseline[i]),
+  /// where the delayed term is dropped for i < delay
+  void ConstantFraction(const short* wf, const double* baseline, size_t n,
+			double scale, size_t delay, double* out);
+
+  /// Index of the first maximum of n samples (n if n==0)
+  size_t ArgMax(const short* wf, size_t n);
+
+  /// Index of the first minimum of n samples (n if n==0)
+  size_t ArgMin(const short* wf, size_t n);
+
+  /// Smallest and largest of n samples (both 0 if n==0)
+  void MinMax(const short* wf, size_t n, short& min, short& max);
+
+  /// Index of the first sample >= threshold (n if none)
+  size_t FindFirstAtOrAbove(const short* wf, size_t n, short threshold);
+
+  /// Index of the first sample whose value (as double) is >= threshold (n if none)
+  size_t FindFirstAtOrAbove(const short* wf, size_t n, double threshold);
+
+  /// Number of waveforms processed side by side in lane-interleaved (batched) kernels
+  const size_t NumBatchLanes = 16;
+
+  /// Lane-interleaved copy of nwf <= NumBatchLanes waveforms of n samples:
+  /// out[i*NumBatchLanes + lane] = wfs[lane][i]; unused lanes are filled with INT16_MIN
+  void InterleaveWaveforms(const short* const* wfs, size_t nwf, size_t n, short* out);
+
+  /// Index of the first of nrows lane-interleaved rows (NumBatchLanes samples each)
+  /// in which any lane is >= the threshold of that lane (nrows if none)
+  size_t FindFirstRowAtOrAbove(const short* rows, size_t nrows, const short* thresholds);
+
+  /// Bit mask of the lanes of one lane-interleaved row which are >= the threshold of that lane
+  /// (bit i for lane i)
+  unsigned RowLanesAtOrAbove(const short* row, const short* thresholds);
+
+}
+
+#endif
+
+/** @} */ // end of doxygen group
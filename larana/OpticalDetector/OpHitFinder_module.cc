@@ -12,18 +12,16 @@
 #include "larcore/Geometry/Geometry.h"
 #include "larcore/CoreUtils/ServiceUtil.h" // lar::providerFrom()
 #include "lardataobj/RawData/OpDetWaveform.h"
+#include "larana/OpticalDetector/OpDigiProperties.h"
+#include "larana/OpticalDetector/OpHitFinder/AlgoDeconvolution.h"
 #include "larana/OpticalDetector/OpHitFinder/PMTPulseRecoBase.h"
-#include "larana/OpticalDetector/OpHitFinder/AlgoThreshold.h"
-#include "larana/OpticalDetector/OpHitFinder/AlgoSiPM.h"
-#include "larana/OpticalDetector/OpHitFinder/AlgoSlidingWindow.h"
-#include "larana/OpticalDetector/OpHitFinder/AlgoFixedWindow.h"
-#include "larana/OpticalDetector/OpHitFinder/AlgoCFD.h"
-#include "larana/OpticalDetector/OpHitFinder/PedAlgoEdges.h"
-#include "larana/OpticalDetector/OpHitFinder/PedAlgoRollingMean.h"
-#include "larana/OpticalDetector/OpHitFinder/PedAlgoUB.h"
+#include "larana/OpticalDetector/OpHitFinder/PMTPedestalBase.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoTracker.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoAlgoFactory.h"
 #include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
 #include "lardataobj/RecoBase/OpHit.h"
 #include "lardata/DetectorInfoServices/DetectorClocksService.h"
+#include "lardataalg/DetectorInfo/DetectorClocksStandard.h"
 #include "larana/OpticalDetector/OpHitFinder/OpHitAlg.h"
 #include "lardataobj/Simulation/BeamGateInfo.h"
 #include "larreco/Calibrator/IPhotonCalibrator.h"
@@ -31,12 +29,18 @@
 #include "larreco/Calibrator/PhotonCalibratorStandard.h"
 
 // Framework includes
-#include "art/Framework/Core/EDProducer.h"
+#include "art/Framework/Core/SharedProducer.h"
 #include "art/Framework/Core/ModuleMacros.h"
 #include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Run.h"
+#include "art/Framework/Principal/SubRun.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "art/Framework/Principal/Handle.h"
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "art/Utilities/Globals.h"
 #include "canvas/Utilities/Exception.h"
+#include "canvas/Utilities/InputTag.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
 
 // ROOT includes
 
@@ -44,38 +48,89 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace opdet {
 
-  class OpHitFinder : public art::EDProducer{
+  // Shared module. By default it is serialized with the legacy resource:
+  // produce() reads the legacy Geometry and DetectorClocks services, which
+  // may change from one event to the next (e.g. the trigger time).
+  // With ConcurrentEvents, the services are read once at the start of each
+  // run instead and events are processed concurrently (async); this needs
+  // clocks which do not change within the run, a calibrator which is not
+  // called for each pulse, and no PedAlgoTracker.
+  // PedAlgoTracker baselines carry from one event to the next, so its
+  // output depends on the event order: it needs a single schedule, and the
+  // baselines are reset at each subrun. The per-event state lives in the scratch
+  // buffers of RunHitFinder, and the algorithms are only used through the
+  // const, re-entrant PulseRecoManager interface.
+  class OpHitFinder : public art::SharedProducer{
   public:
 
-    // Standard constructor and destructor for an ART module.
-    explicit OpHitFinder(const fhicl::ParameterSet&);
-    virtual ~OpHitFinder();
+    // Standard constructor for an ART module.
+    explicit OpHitFinder(const fhicl::ParameterSet&,
+                         const art::ProcessingFrame&);
 
     // The producer routine, called once per event.
-    void produce(art::Event&);
+    void produce(art::Event&, const art::ProcessingFrame&) override;
+
+    // Reads the legacy services for the run, with ConcurrentEvents
+    void beginRun(art::Run&, const art::ProcessingFrame&) override;
+
+    // Resets the tracked pedestals
+    void beginSubRun(art::SubRun&, const art::ProcessingFrame&) override;
+
+    // Prefilter statistics
+    void endJob(const art::ProcessingFrame&) override;
 
   private:
+    // What produce() needs from the legacy services; the calibrator is
+    // read through the hit constructor
+    struct ServiceSnapshot {
+      geo::GeometryCore const*                geometry = nullptr;
+      std::unique_ptr< HitConstructor const > hitConstructor;
+      double tickPeriod   = 0.; // Optical clock tick [us]
+      double g4TimeOffset = 0.; // Electronics time of G4 time 0 [us]
+    };
+
+    ServiceSnapshot ReadServices() const;
+
     std::map< int, int >  GetChannelMap();
     std::vector< double > GetSPEScales();
     std::vector< double > GetSPEShifts();
 
+    // Waveforms is either a waveform vector or an OpDetWaveformPtrs_t view
+    template < class Waveforms >
+    void FindHits(Waveforms const&             waveforms,
+                  std::vector< recob::OpHit >& hits,
+                  ServiceSnapshot const&       services) const;
+
     // The parameters we'll read from the .fcl file.
     std::string fInputModule; // Input tag for OpDetWaveform collection
     std::string fGenModule;
     std::vector< std::string > fInputLabels;
-    std::set< unsigned int > fChannelMasks;
+    std::vector< bool > fChannelMask; // Masked channels; empty if none
 
     pmtana::PulseRecoManager  fPulseRecoMgr;
-    pmtana::PMTPulseRecoBase* fThreshAlg;
-    pmtana::PMTPedestalBase*  fPedAlg;
+    std::unique_ptr< pmtana::PMTPulseRecoBase > fThreshAlg;
+    std::unique_ptr< pmtana::PMTPedestalBase >  fPedAlg;
+    pmtana::PedAlgoTracker* fPedTracker = nullptr; // fPedAlg, if tracking baselines
 
     Float_t  fHitThreshold;
     unsigned int fMaxOpChannel;
+    bool     fParallelHitFinding; // Reconstruct waveforms concurrently
+    size_t   fWaveformsPerTask;   // Waveforms per task in parallel mode
+
+    bool     fUseBeamGateROI;     // Reconstruct only around the beam gates
+    double   fROIPreWindow;       // us before each beam gate opens
+    double   fROIPostWindow;      // us after each beam gate closes
 
     calib::IPhotonCalibrator const* fCalib = nullptr;
+    std::unique_ptr< calib::IPhotonCalibrator const > fOwnedCalib; // If not from ART
+    bool     fAffineCalib;        // fCalib is PE = scale * ADC + shift
+
+    bool     fConcurrentEvents;   // Process events concurrently (async)
+    ServiceSnapshot fRunServices; // Read at beginRun with fConcurrentEvents
   };
 
 }
@@ -88,22 +143,34 @@ namespace opdet {
 
   //----------------------------------------------------------------------------
   // Constructor
-  OpHitFinder::OpHitFinder(const fhicl::ParameterSet & pset):
-    EDProducer{pset},
+  OpHitFinder::OpHitFinder(const fhicl::ParameterSet & pset,
+                           const art::ProcessingFrame&):
+    SharedProducer{pset},
     fPulseRecoMgr()
   {
     // Indicate that the Input Module comes from .fcl
     fInputModule   = pset.get< std::string >("InputModule");
     fGenModule     = pset.get< std::string >("GenModule");
     fInputLabels   = pset.get< std::vector< std::string > >("InputLabels");
+    if (fInputLabels.empty()) fInputLabels.push_back(""); // Default instance
 
     for (auto const& ch : pset.get< std::vector< unsigned int > >
-                            ("ChannelMasks", std::vector< unsigned int >()))
-      fChannelMasks.insert(ch);
+                            ("ChannelMasks", std::vector< unsigned int >())) {
+      if (ch >= fChannelMask.size()) fChannelMask.resize(ch + 1, false);
+      fChannelMask[ch] = true;
+    }
 
     fHitThreshold = pset.get< float >("HitThreshold");
     bool useCalibrator = pset.get< bool > ("UseCalibrator", false);
 
+    fParallelHitFinding = pset.get< bool >  ("ParallelHitFinding", false);
+    fWaveformsPerTask   = pset.get< size_t >("WaveformsPerTask",   16);
+    fConcurrentEvents   = pset.get< bool >  ("ConcurrentEvents",   false);
+
+    fUseBeamGateROI = pset.get< bool >  ("UseBeamGateROI", false);
+    fROIPreWindow   = pset.get< double >("ROIPreWindow",   1.);
+    fROIPostWindow  = pset.get< double >("ROIPostWindow",  10.);
+
     auto const& geometry(*lar::providerFrom< geo::Geometry >());
     fMaxOpChannel = geometry.MaxOpChannel();
 
@@ -121,62 +188,146 @@ namespace opdet {
       // Reproduce behavior from GetSPEScales()
       if (!areaToPE) SPEArea = 20;
 
-      // Delete and replace if we are reconfiguring
-      if (fCalib) {
-        delete fCalib;
-      }
-
-      fCalib = new calib::PhotonCalibratorStandard(SPEArea, SPEShift, areaToPE);
+      fOwnedCalib = std::make_unique< calib::PhotonCalibratorStandard >
+                                          (SPEArea, SPEShift, areaToPE);
+      fCalib = fOwnedCalib.get();
     }
 
+    // The internal calibrator is affine; a service one only if declared so
+    fAffineCalib = !useCalibrator || pset.get< bool >("AffineCalibrator", false);
+
+    // A calibrator which is not affine is called for each pulse, in produce()
+    if (fConcurrentEvents && !fAffineCalib)
+      throw art::Exception(art::errors::Configuration)
+                    << "ConcurrentEvents needs AffineCalibrator with the "
+                    << "UseCalibrator service.\n";
+
     // Initialize the hit finder algorithm
     auto const hit_alg_pset = pset.get< fhicl::ParameterSet >("HitAlgoPset");
-    std::string threshAlgName = hit_alg_pset.get< std::string >("Name");
-    if      (threshAlgName == "Threshold")
-      fThreshAlg = new pmtana::AlgoThreshold(hit_alg_pset);
-    else if (threshAlgName == "SiPM")
-      fThreshAlg = new pmtana::AlgoSiPM(hit_alg_pset);
-    else if (threshAlgName == "SlidingWindow")
-      fThreshAlg = new pmtana::AlgoSlidingWindow(hit_alg_pset);
-    else if (threshAlgName == "FixedWindow")
-      fThreshAlg = new pmtana::AlgoFixedWindow(hit_alg_pset);
-    else if (threshAlgName == "CFD" )
-      fThreshAlg = new pmtana::AlgoCFD(hit_alg_pset);
-    else throw art::Exception(art::errors::UnimplementedFeature)
+    fThreshAlg = pmtana::MakePulseRecoAlgo(hit_alg_pset);
+    if (!fThreshAlg)
+      throw art::Exception(art::errors::UnimplementedFeature)
                     << "Cannot find implementation for "
-                    << threshAlgName << " algorithm.\n";
+                    << hit_alg_pset.get< std::string >("Name") << " algorithm.\n";
+
+    // Deconvolution with the simulated single PE response
+    if (hit_alg_pset.get< bool >("UseOpDigiPropertiesSPE", false)) {
+      auto deconvAlg = dynamic_cast< pmtana::AlgoDeconvolution* >(fThreshAlg.get());
+      if (!deconvAlg)
+        throw art::Exception(art::errors::Configuration)
+                      << "UseOpDigiPropertiesSPE needs the Deconvolution algorithm.\n";
+      deconvAlg->SetSPETemplate
+        (art::ServiceHandle< opdet::OpDigiProperties const >()->SinglePEWaveform());
+    }
 
     auto const ped_alg_pset = pset.get< fhicl::ParameterSet >("PedAlgoPset");
-    std::string pedAlgName = ped_alg_pset.get< std::string >("Name");
-    if      (pedAlgName == "Edges")
-      fPedAlg = new pmtana::PedAlgoEdges(ped_alg_pset);
-    else if (pedAlgName == "RollingMean")
-      fPedAlg = new pmtana::PedAlgoRollingMean(ped_alg_pset);
-    else if (pedAlgName == "UB"   )
-      fPedAlg = new pmtana::PedAlgoUB(ped_alg_pset);
-    else throw art::Exception(art::errors::UnimplementedFeature)
+    fPedAlg = pmtana::MakePedestalAlgo(ped_alg_pset);
+    if (!fPedAlg)
+      throw art::Exception(art::errors::UnimplementedFeature)
                     << "Cannot find implementation for "
-                    << pedAlgName << " algorithm.\n";
+                    << ped_alg_pset.get< std::string >("Name") << " algorithm.\n";
 
     produces< std::vector< recob::OpHit > >();
 
-    fPulseRecoMgr.AddRecoAlgo(fThreshAlg);
-    fPulseRecoMgr.SetDefaultPedAlgo(fPedAlg);
+    // Tracked baselines by channel, for monitoring
+    fPedTracker = dynamic_cast< pmtana::PedAlgoTracker* >(fPedAlg.get());
+    if (fPedTracker) {
+      // The tracked pedestals depend on the order of the waveforms and of
+      // the events, which is only fixed with a single schedule
+      if (fParallelHitFinding || fConcurrentEvents)
+        throw art::Exception(art::errors::Configuration)
+                      << "The " << fPedAlg->Name() << " pedestal algorithm "
+                      << "cannot be used with ParallelHitFinding "
+                      << "or ConcurrentEvents.\n";
+      if (art::Globals::instance()->nschedules() > 1)
+        throw art::Exception(art::errors::Configuration)
+                      << "The " << fPedAlg->Name() << " pedestal algorithm "
+                      << "needs a single schedule.\n";
+      produces< std::vector< float > >("pedestalMean");
+      produces< std::vector< float > >("pedestalSigma");
+    }
 
+    for (auto const& label : fInputLabels)
+      consumes< std::vector< raw::OpDetWaveform > >
+                                  (art::InputTag(fInputModule, label));
+
+    fPulseRecoMgr.AddRecoAlgo(fThreshAlg.get());
+    fPulseRecoMgr.SetDefaultPedAlgo(fPedAlg.get());
+
+    pmtana::PulseRecoConfig recoConfig;
+    recoConfig.streaming  = pset.get< bool >  ("StreamingPulseReco", false);
+    recoConfig.chunk_size = pset.get< size_t >("PulseRecoChunkSize", 0);
+    recoConfig.batch      = pset.get< bool >  ("BatchPulseReco",     false);
+    recoConfig.table      = pset.get< bool >  ("CompactPulseTable",  false);
+    if (pset.get< bool >("PrefilterPulseReco", false))
+      recoConfig.prefilter_threshold = fHitThreshold;
+    fPulseRecoMgr.SetConfig(recoConfig);
+
+    if (fConcurrentEvents)
+      async< art::InEvent >();
+    else
+      serialize< art::InEvent >(art::LegacyResource);
   }
 
   //----------------------------------------------------------------------------
-  // Destructor
-  OpHitFinder::~OpHitFinder()
+  void OpHitFinder::beginRun(art::Run&, const art::ProcessingFrame&)
   {
+    if (!fConcurrentEvents) return;
+
+    // The standard clocks read the trigger time from each event when they
+    // have a trigger module; the snapshot would then be wrong
+    auto const* detectorClocks =
+      dynamic_cast< detinfo::DetectorClocksStandard const* >
+                  (lar::providerFrom< detinfo::DetectorClocksService >());
+    if (!detectorClocks || !detectorClocks->TrigModuleName().empty())
+      throw art::Exception(art::errors::Configuration)
+                    << "ConcurrentEvents needs the standard detector clocks "
+                    << "without a trigger module (TrigModuleName).\n";
+
+    // Run transitions are not concurrent with events
+    fRunServices = ReadServices();
+  }
 
-    delete fThreshAlg;
-    delete fPedAlg;
+  //----------------------------------------------------------------------------
+  void OpHitFinder::beginSubRun(art::SubRun&, const art::ProcessingFrame&)
+  {
+    // Each subrun starts from the full pedestal algorithm, whatever the
+    // subruns before it and the order in which they were processed
+    if (fPedTracker) fPedTracker->ResetBaselines();
+  }
 
+  //----------------------------------------------------------------------------
+  OpHitFinder::ServiceSnapshot OpHitFinder::ReadServices() const
+  {
+    auto const& detectorClocks(*lar::providerFrom< detinfo::DetectorClocksService >());
+
+    ServiceSnapshot services;
+    services.geometry       = lar::providerFrom< geo::Geometry >();
+    services.hitConstructor = std::make_unique< HitConstructor const >
+                        (*services.geometry, detectorClocks, *fCalib, fAffineCalib);
+    services.tickPeriod     = detectorClocks.OpticalClock().TickPeriod();
+    services.g4TimeOffset   = detectorClocks.G4ToElecTime(0.);
+    return services;
   }
 
   //----------------------------------------------------------------------------
-  void OpHitFinder::produce(art::Event& evt)
+  void OpHitFinder::endJob(const art::ProcessingFrame&)
+  {
+    if (fPedTracker)
+      mf::LogInfo("OpHitFinder")
+        << "Pedestal tracker used the tracked baseline for "
+        << fPedTracker->NumTracked() << " waveforms and the full algorithm for "
+        << fPedTracker->NumFullEvaluations();
+
+    if (fPulseRecoMgr.NumPrefilterChecked() == 0) return;
+
+    mf::LogInfo("OpHitFinder")
+      << "Prefilter skipped " << fPulseRecoMgr.NumPrefilterSkipped()
+      << " of " << fPulseRecoMgr.NumPrefilterChecked() << " waveforms";
+  }
+
+  //----------------------------------------------------------------------------
+  void OpHitFinder::produce(art::Event& evt, const art::ProcessingFrame&)
   {
 
     // These is the storage pointer we will put in the event
@@ -193,72 +344,97 @@ namespace opdet {
       if ( err.categoryCode() != art::errors::ProductNotFound ) throw;
     }
 
-    auto const& geometry(*lar::providerFrom< geo::Geometry >());
-    auto const& detectorClocks(*lar::providerFrom< detinfo::DetectorClocksService >());
-    auto const& calibrator(*fCalib);
+    // The legacy services, for this event or from the start of the run
+    ServiceSnapshot eventServices;
+    if (!fConcurrentEvents) eventServices = ReadServices();
+    ServiceSnapshot const& services =
+      fConcurrentEvents ? fRunServices : eventServices;
     //
     // Get the pulses from the event
     //
 
-    // Load pulses into WaveformVector
-    if(fChannelMasks.empty() && fInputLabels.size()<2) {
+    // Beam gate windows in electronics time [us], from G4 times [ns]; the
+    // rest of the readout is skipped
+    TimeWindows_t roiWindows;
+    if (fUseBeamGateROI) {
+      for (auto const* beamGate : beamGateArray) {
+        const double start = beamGate->Start()*1.e-3 + services.g4TimeOffset;
+        const double end   = start + beamGate->Width()*1.e-3;
+        roiWindows.emplace_back(start - fROIPreWindow, end + fROIPostWindow);
+      }
+    }
+
+    if(fChannelMask.empty() && fInputLabels.size()<2 && roiWindows.empty()) {
       art::Handle< std::vector< raw::OpDetWaveform > > wfHandle;
-      if(fInputLabels.empty())
-	evt.getByLabel(fInputModule, wfHandle);
-      else
-	evt.getByLabel(fInputModule, fInputLabels.front(), wfHandle);	
+      evt.getByLabel(fInputModule, fInputLabels.front(), wfHandle);
       assert(wfHandle.isValid());
-      RunHitFinder(*wfHandle,
-		   *HitPtr,
-		   fPulseRecoMgr,
-		   *fThreshAlg,
-		   geometry,
-		   fHitThreshold,
-		   detectorClocks,
-		   calibrator);
+      FindHits(*wfHandle, *HitPtr, services);
     }else{
 
-      // Reserve a large enough array
-      int totalsize = 0;
-      for (auto label : fInputLabels)
+      // Look at the waveforms of all the collections in place,
+      // skipping masked channels, instead of copying them
+      std::vector< std::vector< raw::OpDetWaveform > const* > collections;
+      collections.reserve(fInputLabels.size());
+
+      for (auto const& label : fInputLabels)
 	{
 	  art::Handle< std::vector< raw::OpDetWaveform > > wfHandle;
 	  evt.getByLabel(fInputModule, label, wfHandle);
 	  if (!wfHandle.isValid()) continue; // Skip non-existent collections
-	  totalsize += wfHandle->size();
+	  collections.push_back(wfHandle.product());
 	}
 
-      std::vector< raw::OpDetWaveform > WaveformVector;
-      WaveformVector.reserve(totalsize);
+      auto const waveforms = SelectWaveforms(collections, fChannelMask);
 
-      for (auto label : fInputLabels)
-	{
-	  art::Handle< std::vector< raw::OpDetWaveform > > wfHandle;
-	  evt.getByLabel(fInputModule, label, wfHandle);
-	  if (!wfHandle.isValid()) continue; // Skip non-existent collections
-	  
-	  //WaveformVector.insert(WaveformVector.end(),
-	  //                      wfHandle->begin(), wfHandle->end());
-	  for(auto const& wf : *wfHandle)
-	    {
-	      if (fChannelMasks.find(wf.ChannelNumber())
-		  != fChannelMasks.end()) continue;
-	      WaveformVector.push_back(wf);
-	    }
-	}
-      
-      RunHitFinder(WaveformVector,
-		   *HitPtr,
-		   fPulseRecoMgr,
-		   *fThreshAlg,
-		   geometry,
-		   fHitThreshold,
-		   detectorClocks,
-		   calibrator);
+      if (roiWindows.empty())
+        FindHits(waveforms, *HitPtr, services);
+      else
+        FindHits(CropWaveforms(waveforms, roiWindows, services.tickPeriod),
+                 *HitPtr, services);
     }
+
+    // Copy of the tracked baselines as this event left them, taken before
+    // anything else can update them
+    std::unique_ptr< std::vector< float > > pedMean, pedSigma;
+    if (fPedTracker) {
+      pedMean  = std::make_unique< std::vector< float > >();
+      pedSigma = std::make_unique< std::vector< float > >();
+      fPedTracker->TrackedBaselines(*pedMean, *pedSigma);
+    }
+
     // Store results into the event
     evt.put(std::move(HitPtr));
 
+    if (fPedTracker) {
+      evt.put(std::move(pedMean),  "pedestalMean");
+      evt.put(std::move(pedSigma), "pedestalSigma");
+    }
+
+  }
+
+  //----------------------------------------------------------------------------
+  template < class Waveforms >
+  void OpHitFinder::FindHits(Waveforms const&             waveforms,
+                             std::vector< recob::OpHit >& hits,
+                             ServiceSnapshot const&       services) const
+  {
+    if (fParallelHitFinding)
+      RunHitFinderParallel(waveforms,
+                           hits,
+                           fPulseRecoMgr,
+                           *fThreshAlg,
+                           *services.geometry,
+                           fHitThreshold,
+                           *services.hitConstructor,
+                           fWaveformsPerTask);
+    else
+      RunHitFinder(waveforms,
+                   hits,
+                   fPulseRecoMgr,
+                   *fThreshAlg,
+                   *services.geometry,
+                   fHitThreshold,
+                   *services.hitConstructor);
   }
 
 } // namespace opdet
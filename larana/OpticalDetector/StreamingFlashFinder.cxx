@@ -0,0 +1,324 @@
+// -*- mode: c++; c-basic-offset: 2; -*-
+/*!
+ * Title:   StreamingFlashFinder
+ *
+ * Description:
+ * Flash finding on a continuous stream of time-ordered OpHit batches.
+ */
+
+#include "StreamingFlashFinder.h"
+#include "OpFlashAlg.h"
+
+#include "cetlib_except/exception.h"
+#include "lardataalg/DetectorInfo/DetectorClocks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace opdet{
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::BinSums::Add(unsigned int Bin, double PE) {
+
+    if (Bins.empty()) FirstBin = Bin;
+    else if (Bin < FirstBin) {
+      // Hits of a batch come in any order
+      Bins.insert(Bins.begin(), FirstBin - Bin, BinSum());
+      FirstBin = Bin;
+    }
+    if (Bin - FirstBin >= Bins.size()) Bins.resize(Bin - FirstBin + 1);
+
+    BinSum& Sum = Bins[Bin - FirstBin];
+    Sum.PE += std::max(PE, 0.0);
+    ++Sum.NHits;
+
+  }
+
+  //----------------------------------------------------------------------------
+  bool StreamingFlashFinder::LatestSplittableBin(BinSums const&      Sums,
+                                                 unsigned int const& EndBin,
+                                                 float const&  FlashThreshold,
+                                                 unsigned int&       Bin) {
+
+    if (EndBin == 0) return false;
+    Bin = EndBin - 1;
+
+    while (true) {
+      // Empty
+      if (Bin < Sums.FirstBin || Bin - Sums.FirstBin >= Sums.Bins.size())
+        return true;
+      BinSum const& Sum = Sums.Bins[Bin - Sums.FirstBin];
+      if (Sum.NHits == 0) return true;
+      // Margin for the rounding of the sums in FillSparseAccumulator
+      if (Sum.PE*(1 + 1e-9) < FlashThreshold) return true;
+      if (Bin == 0) return false;
+      --Bin;
+    }
+
+  }
+
+  //----------------------------------------------------------------------------
+  StreamingFlashFinder::StreamingFlashFinder(double const& BinWidth,
+                                             float const&  FlashThreshold,
+                                             float const&  WidthTolerance,
+                                             float const&  TrigCoinc)
+    : fBinWidth(BinWidth)
+    , fFlashThreshold(FlashThreshold)
+    , fWidthTolerance(WidthTolerance)
+    , fTrigCoinc(TrigCoinc)
+    , fStarted(false)
+    , fMinTime(0)
+    , fLastTime(0)
+    , fNHits(0)
+    , fPendingMinTime(std::numeric_limits< double >::infinity())
+  {}
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::AddHits(std::vector< recob::OpHit > const&
+                                                                HitVector,
+                                     OpDetGeometryCache const& geometry,
+                                     detinfo::DetectorClocks const& ts,
+                                     std::vector< recob::OpFlash >&
+                                                                FlashVector,
+                                     std::vector< std::vector< int > >&
+                                                                AssocList) {
+
+    if (HitVector.empty()) return;
+
+    double BatchMinTime = std::numeric_limits< double >::max();
+    double BatchMaxTime = std::numeric_limits< double >::lowest();
+    for (auto const& hit : HitVector) {
+      BatchMinTime = std::min(BatchMinTime, hit.PeakTime());
+      BatchMaxTime = std::max(BatchMaxTime, hit.PeakTime());
+    }
+
+    if (!fStarted) {
+      fStarted  = true;
+      fMinTime  = BatchMinTime;
+      fLastTime = BatchMinTime;
+    }
+    else if (BatchMinTime < fLastTime)
+      throw cet::exception("StreamingFlashFinder")
+        << "Hit at " << BatchMinTime << " us is earlier than the previous "
+        << "hits (up to " << fLastTime << " us)\n";
+
+    fLastTime = std::max(fLastTime, BatchMaxTime);
+
+    for (auto const& hit : HitVector) {
+      double const Time = hit.PeakTime();
+      fPendingHits.push_back(hit);
+      fPendingHitIndices.push_back(fNHits++);
+      fPendingBins1.push_back(GetAccumIndex(Time, fMinTime, fBinWidth, 0.0));
+      fPendingBins2.push_back(GetAccumIndex(Time, fMinTime, fBinWidth,
+                                            fBinWidth/2.0));
+      AddToBins(fPendingHits.size() - 1);
+    }
+    fPendingMinTime = std::min(fPendingMinTime, BatchMinTime);
+
+    ProcessHits(false, geometry, ts);
+
+    // Later flashes only have later hits, so they are not earlier than these
+    double const EndTime = std::min(fLastTime, fPendingMinTime);
+
+    // One bin of margin for the rounding of the flash times
+    EmitFlashes(EndTime - fBinWidth, FlashVector, AssocList);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::Flush(OpDetGeometryCache const&      geometry,
+                                   detinfo::DetectorClocks const& ts,
+                                   std::vector< recob::OpFlash >& FlashVector,
+                                   std::vector< std::vector< int > >&
+                                                                  AssocList) {
+
+    ProcessHits(true, geometry, ts);
+    EmitFlashes(std::numeric_limits< double >::infinity(),
+                FlashVector, AssocList);
+
+    fStarted = false;
+    fNHits   = 0;
+    fSources.clear();
+
+  }
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::AddToBins(size_t PendingIndex) {
+
+    double const PE = fPendingHits[PendingIndex].PE();
+    fBinSums1.Add(fPendingBins1[PendingIndex], PE);
+    fBinSums2.Add(fPendingBins2[PendingIndex], PE);
+
+  }
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::ProcessHits(bool                      All,
+                                         OpDetGeometryCache const& geometry,
+                                         detinfo::DetectorClocks const& ts) {
+
+    if (fPendingHits.empty()) return;
+
+    // The hits before the cut are those of the bins of one accumulator
+    // before the bin of the other accumulator that is split. Cuts are
+    // counted in half bins: bin m of accumulator 2 is split at 2m, bin m of
+    // accumulator 1 at 2m + 1. Only bins no later hit can fall in qualify.
+    std::vector< unsigned int > const* CutBins = nullptr;
+    unsigned int CutBin = 0;
+
+    if (!All) {
+      unsigned int Bin = 0;
+      unsigned long Cut = 0;
+
+      if (LatestSplittableBin(fBinSums2,
+                              GetAccumIndex(fLastTime, fMinTime, fBinWidth,
+                                            fBinWidth/2.0),
+                              fFlashThreshold,
+                              Bin)) {
+        CutBins = &fPendingBins1;
+        CutBin  = Bin;
+        Cut     = 2ul*Bin;
+      }
+
+      if (LatestSplittableBin(fBinSums1,
+                              GetAccumIndex(fLastTime, fMinTime, fBinWidth,
+                                            0.0),
+                              fFlashThreshold,
+                              Bin) &&
+          (CutBins == nullptr || 2ul*Bin + 1 > Cut)) {
+        CutBins = &fPendingBins2;
+        CutBin  = Bin + 1;
+      }
+
+      if (CutBins == nullptr) return;
+    }
+
+    // Split the pending hits, keeping the stream order in both parts; the
+    // bin sums are those of the kept hits, which are few (they are after
+    // the latest split)
+    std::vector< recob::OpHit > SegmentHits;
+    std::vector< int >          SegmentHitIndices;
+    size_t const NPending = fPendingHits.size();
+    size_t NKept = 0;
+    fBinSums1.Bins.clear();
+    fBinSums2.Bins.clear();
+    fPendingMinTime = std::numeric_limits< double >::infinity();
+    for (size_t i = 0; i != NPending; ++i) {
+      if (All || (*CutBins)[i] < CutBin) {
+        SegmentHits.push_back(std::move(fPendingHits[i]));
+        SegmentHitIndices.push_back(fPendingHitIndices[i]);
+      }
+      else {
+        if (NKept != i) {
+          fPendingHits[NKept]       = std::move(fPendingHits[i]);
+          fPendingHitIndices[NKept] = fPendingHitIndices[i];
+          fPendingBins1[NKept]      = fPendingBins1[i];
+          fPendingBins2[NKept]      = fPendingBins2[i];
+        }
+        AddToBins(NKept);
+        fPendingMinTime = std::min(fPendingMinTime,
+                                   fPendingHits[NKept].PeakTime());
+        ++NKept;
+      }
+    }
+    fPendingHits.erase(fPendingHits.begin() + NKept, fPendingHits.end());
+    fPendingHitIndices.resize(NKept);
+    fPendingBins1.resize(NKept);
+    fPendingBins2.resize(NKept);
+
+    if (SegmentHits.empty()) return;
+
+    std::vector< std::vector< int > > RefinedHitsPerFlash;
+    FindFlashes(SegmentHits,
+                fPendingFlashes,
+                RefinedHitsPerFlash,
+                fMinTime,
+                fBinWidth,
+                geometry,
+                fFlashThreshold,
+                fWidthTolerance,
+                ts,
+                fTrigCoinc);
+
+    for (auto const& HitsThisFlash : RefinedHitsPerFlash) {
+      fPendingAssoc.emplace_back();
+      for (int const HitIndex : HitsThisFlash)
+        fPendingAssoc.back().push_back(SegmentHitIndices[HitIndex]);
+    }
+
+  }
+
+  //----------------------------------------------------------------------------
+  void StreamingFlashFinder::EmitFlashes(double const& EndTime,
+                                         std::vector< recob::OpFlash >&
+                                                                 FlashVector,
+                                         std::vector< std::vector< int > >&
+                                                                 AssocList) {
+
+    std::vector< int > Order(fPendingFlashes.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    std::stable_sort(Order.begin(), Order.end(), [&](int i, int j)
+                     { return fPendingFlashes[i].Time() <
+                              fPendingFlashes[j].Time(); });
+
+    // Later flashes have at most half a bin of width and the threshold PE,
+    // so a source stops mattering once its hypothesis for them is too small
+    double const MaxWidth      = fBinWidth/2.0;
+    double const MinHypothesis = MinLateLightHypothesis(fFlashThreshold);
+
+    size_t NEmitted = 0;
+    for (int const iFlash : Order) {
+
+      recob::OpFlash const& Flash = fPendingFlashes[iFlash];
+      if (!(Flash.Time() < EndTime)) break;
+      ++NEmitted;
+
+      double const Time  = Flash.Time();
+      double const PE    = Flash.TotalPE();
+      double const Width = Flash.TimeWidth();
+
+      // Factor 2 is a margin for rounding, as in MarkFlashesForRemoval
+      fSources.erase(std::remove_if(fSources.begin(), fSources.end(),
+                       [&](LateLightSource const& Source)
+                       { return 2*Source.PE*MaxWidth/Source.Width*
+                           std::exp(-(Time - Source.Time)/1.6) <
+                           MinHypothesis; }),
+                     fSources.end());
+
+      bool LateLight = false;
+      for (auto const& Source : fSources)
+        if (GetLikelihoodLateLight(Source.PE, Source.Time, Source.Width,
+                                   PE, Time, Width) < 3.0) {
+          LateLight = true;
+          break;
+        }
+
+      // Removed flashes still make later flashes late light, as in
+      // MarkFlashesForRemoval; flashes without width never do
+      if (Width != 0 && Width == Width)
+        fSources.push_back({ Time, PE, Width });
+
+      if (LateLight) continue;
+
+      FlashVector.push_back(std::move(fPendingFlashes[iFlash]));
+      AssocList.push_back(std::move(fPendingAssoc[iFlash]));
+
+    }
+
+    if (NEmitted == 0) return;
+
+    // Keep the rest, in time order
+    std::vector< recob::OpFlash >     Flashes;
+    std::vector< std::vector< int > > Assoc;
+    for (size_t i = NEmitted; i != Order.size(); ++i) {
+      Flashes.push_back(std::move(fPendingFlashes[Order[i]]));
+      Assoc.push_back(std::move(fPendingAssoc[Order[i]]));
+    }
+    fPendingFlashes = std::move(Flashes);
+    fPendingAssoc   = std::move(Assoc);
+
+  }
+
+} // End opdet namespace
@@ -0,0 +1,135 @@
+// -*- mode: c++; c-basic-offset: 2; -*-
+#ifndef STREAMINGFLASHFINDER_H
+#define STREAMINGFLASHFINDER_H
+/*!
+ * Title:   StreamingFlashFinder
+ *
+ * Description:
+ * Flash finding on a continuous stream of OpHits given in time-ordered
+ * batches. Flashes are emitted as soon as no later hit can change them, with
+ * the same result as RunFlashFinder over all the hits of the stream at once.
+ *
+ * The accumulator bins start at the first hit of the stream. Hits are kept
+ * until the stream reaches a bin of either accumulator that can never be a
+ * flash (empty, or with less light than the threshold): the hits before it
+ * are flash-found on their own. Flashes are then kept until no later flash
+ * can be earlier, and for late-light removal only the flashes that can
+ * still make a later flash late light are remembered. Memory is bounded by
+ * the longest stretch of consecutive flash bins, not by the stream length.
+ */
+
+#include "lardataobj/RecoBase/OpHit.h"
+#include "lardataobj/RecoBase/OpFlash.h"
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
+namespace detinfo { class DetectorClocks; }
+
+#include <vector>
+
+namespace opdet{
+
+  class StreamingFlashFinder {
+
+  public:
+
+    /// Same parameters as RunFlashFinder
+    StreamingFlashFinder(double const& BinWidth,
+                         float const&  FlashThreshold,
+                         float const&  WidthTolerance,
+                         float const&  TrigCoinc);
+
+    /// Adds the next hits of the stream. Their order within the batch does
+    /// not matter, but none may be earlier than the hits added before.
+    /// Finished flashes are appended to FlashVector in time order, and the
+    /// stream indices of their hits (counting from the first hit added) to
+    /// AssocList. Each call costs time in the added and pending hits only.
+    void AddHits(std::vector< recob::OpHit > const& HitVector,
+                 OpDetGeometryCache const&          geometry,
+                 detinfo::DetectorClocks const&     ts,
+                 std::vector< recob::OpFlash >&     FlashVector,
+                 std::vector< std::vector< int > >& AssocList);
+
+    /// Ends the stream, emitting all the remaining flashes; the next hits
+    /// start a new stream
+    void Flush(OpDetGeometryCache const&          geometry,
+               detinfo::DetectorClocks const&     ts,
+               std::vector< recob::OpFlash >&     FlashVector,
+               std::vector< std::vector< int > >& AssocList);
+
+    /// Hits added but not flash-found yet
+    size_t NPendingHits() const { return fPendingHits.size(); }
+
+    /// Flashes found but not emitted yet
+    size_t NPendingFlashes() const { return fPendingFlashes.size(); }
+
+  private:
+
+    /// Flash-finds the pending hits before the latest bin that can be split
+    void ProcessHits(bool                      All,
+                     OpDetGeometryCache const& geometry,
+                     detinfo::DetectorClocks const& ts);
+
+    /// Emits the pending flashes earlier than EndTime, after late-light
+    /// removal
+    void EmitFlashes(double const&                      EndTime,
+                     std::vector< recob::OpFlash >&     FlashVector,
+                     std::vector< std::vector< int > >& AssocList);
+
+    /// Light of an accumulator bin of the pending hits; only the positive
+    /// PE counts, as no running sum in the bin can exceed it
+    struct BinSum {
+      double       PE    = 0;
+      unsigned int NHits = 0;
+    };
+
+    /// Bin sums of one accumulator, for consecutive bins from FirstBin
+    struct BinSums {
+      unsigned int          FirstBin = 0;
+      std::vector< BinSum > Bins;
+
+      void Add(unsigned int Bin, double PE);
+    };
+
+    /// Adds a pending hit to the bin sums of both accumulators
+    void AddToBins(size_t PendingIndex);
+
+    /// Latest bin before EndBin that can never meet the flash threshold,
+    /// so that its hits may go to different flash-finding segments
+    static bool LatestSplittableBin(BinSums const&      Sums,
+                                    unsigned int const& EndBin,
+                                    float const&        FlashThreshold,
+                                    unsigned int&       Bin);
+
+    /// Flash that may make later flashes late light
+    struct LateLightSource {
+      double Time;
+      double PE;
+      double Width;
+    };
+
+    double fBinWidth;
+    float  fFlashThreshold;
+    float  fWidthTolerance;
+    float  fTrigCoinc;
+
+    bool   fStarted;    ///< Whether the stream has hits
+    double fMinTime;    ///< Time of the first hit: start of the bins
+    double fLastTime;   ///< Latest hit time so far
+    size_t fNHits;      ///< Hits added so far
+
+    double fPendingMinTime; ///< Earliest pending hit time
+
+    std::vector< recob::OpHit >       fPendingHits;
+    std::vector< int >                fPendingHitIndices;
+    std::vector< unsigned int >       fPendingBins1; ///< Accumulator 1 bins
+    std::vector< unsigned int >       fPendingBins2; ///< Accumulator 2 bins
+    BinSums                           fBinSums1;     ///< of the pending hits
+    BinSums                           fBinSums2;
+    std::vector< recob::OpFlash >     fPendingFlashes;
+    std::vector< std::vector< int > > fPendingAssoc;
+    std::vector< LateLightSource >    fSources;
+
+  };
+
+} // End opdet namespace
+
+#endif
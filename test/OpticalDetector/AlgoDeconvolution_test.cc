@@ -0,0 +1,168 @@
+#define BOOST_TEST_MODULE ( AlgoDeconvolution_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "fhiclcpp/ParameterSet.h"
+#include "fhiclcpp/make_ParameterSet.h"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoDeconvolution.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+const std::string Config =
+  "Name: \"Deconvolution\" NoiseRatio: 0.001 FilterSigma: 1.0"
+  " StartThreshold: 0.2 EndThreshold: 0.05";
+
+// SPE response with a slow tail: 20 ADC peak at tick 2
+std::vector<double> MakeTemplate()
+{
+  std::vector<double> spe(30);
+  for(size_t t=0; t<spe.size(); ++t) spe[t] = 20. * (t/2.) * std::exp(1. - t/2.);
+  return spe;
+}
+
+std::unique_ptr<pmtana::AlgoDeconvolution> MakeAlgo()
+{
+  fhicl::ParameterSet pset;
+  fhicl::make_ParameterSet(Config, pset);
+  auto algo = std::make_unique<pmtana::AlgoDeconvolution>(pset);
+  algo->SetSPETemplate(MakeTemplate());
+  return algo;
+}
+
+// Baseline of 1000 with npe photoelectrons at each of the given ticks
+std::vector<short> MakeWaveform(size_t length, const std::vector<size_t>& ticks, double npe = 1.)
+{
+  std::vector<double> wf(length, 1000.);
+  auto const spe = MakeTemplate();
+  for(auto const tick : ticks)
+    for(size_t t=0; t<spe.size() && tick+t<length; ++t) wf[tick+t] += npe * spe[t];
+  return std::vector<short>(wf.begin(), wf.end());
+}
+
+BOOST_AUTO_TEST_SUITE(AlgoDeconvolution_test)
+
+BOOST_AUTO_TEST_CASE(overlappingPulses_areResolved)
+{
+  auto algo = MakeAlgo();
+  auto const spe = MakeTemplate();
+  double spe_area = 0;
+  for(auto const v : spe) spe_area += v;
+
+  const auto wf = MakeWaveform(500, { 100, 108 });
+
+  pmtana::pulse_param_array pulses;
+  BOOST_CHECK(algo->Reconstruct(wf, 1000., 0., pulses));
+
+  BOOST_REQUIRE_EQUAL(pulses.size(), 2ul);
+  BOOST_CHECK_CLOSE(pulses[0].t_max, 100., 1e-6);
+  BOOST_CHECK_CLOSE(pulses[1].t_max, 108., 1e-6);
+  for(auto const& pulse : pulses) {
+    BOOST_CHECK_CLOSE(pulse.area / spe_area, 1., 10.);
+    BOOST_CHECK_CLOSE(pulse.peak / 20., 1., 10.);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(pedestalArrays_matchConstantPedestal)
+{
+  auto algo = MakeAlgo();
+
+  const auto wf = MakeWaveform(300, { 50, 200 }, 3.);
+
+  pmtana::pulse_param_array constant, arrays;
+  algo->Reconstruct(wf, 1000., 0.5, constant);
+  algo->Reconstruct(wf, pmtana::PedestalMean_t(wf.size(), 1000.),
+		   pmtana::PedestalSigma_t(wf.size(), 0.5), arrays);
+
+  BOOST_REQUIRE_EQUAL(constant.size(), 2ul);
+  BOOST_REQUIRE_EQUAL(arrays.size(), constant.size());
+  for(size_t i=0; i<constant.size(); ++i) {
+    BOOST_CHECK_EQUAL(arrays[i].t_start, constant[i].t_start);
+    BOOST_CHECK_EQUAL(arrays[i].t_end,   constant[i].t_end);
+    BOOST_CHECK_CLOSE(arrays[i].area,    constant[i].area, 1e-6);
+  }
+  BOOST_CHECK_CLOSE(constant[0].area, constant[1].area, 1.); // both 3 PE
+}
+
+BOOST_AUTO_TEST_CASE(noTemplate_throws)
+{
+  fhicl::ParameterSet pset;
+  fhicl::make_ParameterSet(Config, pset);
+  pmtana::AlgoDeconvolution algo(pset);
+
+  pmtana::pulse_param_array pulses;
+  BOOST_CHECK_THROW(algo.Reconstruct(MakeWaveform(100, {}), 1000., 0., pulses), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(thresholds_validated)
+{
+  for(std::string const thresholds : { " StartThreshold: 0.05 EndThreshold: 0.2",
+				       " StartThreshold: 0.1 EndThreshold: 0.1" }) {
+    fhicl::ParameterSet pset;
+    fhicl::make_ParameterSet("Name: \"Deconvolution\"" + thresholds, pset);
+    BOOST_CHECK_THROW(pmtana::AlgoDeconvolution algo(pset), std::exception);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lengthsSharingFFTSize_matchPadded)
+{
+  // 100 and 120 samples plus the template both pad to 256: same plan, same pulses
+  auto algo = MakeAlgo();
+  auto wf = MakeWaveform(120, { 40, 70 });
+
+  pmtana::pulse_param_array longer, shorter;
+  BOOST_CHECK(algo->Reconstruct(wf, 1000., 0., longer));
+  wf.resize(100);
+  BOOST_CHECK(algo->Reconstruct(wf, 1000., 0., shorter));
+
+  BOOST_REQUIRE_EQUAL(shorter.size(), 2ul);
+  BOOST_REQUIRE_EQUAL(longer.size(),  2ul);
+  BOOST_CHECK_EQUAL(shorter[0].t_max, longer[0].t_max);
+  BOOST_CHECK_EQUAL(shorter[1].t_max, longer[1].t_max);
+}
+
+BOOST_AUTO_TEST_CASE(scratch_matchesLocalBuffer)
+{
+  // One scratch for waveforms of several FFT lengths, longest first, gives the
+  // pulses of the calls without scratch
+  auto algo = MakeAlgo();
+  pmtana::RecoScratch scratch;
+
+  for(size_t const length : { 1000ul, 300ul, 100ul, 300ul }) {
+    const auto wf = MakeWaveform(length, { 20, 60 }, 2.);
+    pmtana::pulse_param_array expected, pulses;
+    algo->Reconstruct(wf, 1000., 0.5, expected);
+    BOOST_CHECK(algo->Reconstruct(wf, 1000., 0.5, pulses, scratch));
+
+    BOOST_REQUIRE_EQUAL(expected.size(), 2ul);
+    BOOST_REQUIRE_EQUAL(pulses.size(), expected.size());
+    for(size_t i=0; i<pulses.size(); ++i) {
+      BOOST_CHECK_EQUAL(pulses[i].t_max, expected[i].t_max);
+      BOOST_CHECK_EQUAL(pulses[i].area,  expected[i].area);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(newTemplate_dropsPlans)
+{
+  // The same response delayed by 5 ticks: the photon arrives 5 ticks earlier
+  auto algo = MakeAlgo();
+  const auto wf = MakeWaveform(300, { 50 }, 2.);
+
+  pmtana::pulse_param_array before, after;
+  algo->Reconstruct(wf, 1000., 0., before);
+
+  auto spe = MakeTemplate();
+  spe.insert(spe.begin(), 5, 0.);
+  algo->SetSPETemplate(spe);
+  algo->Reconstruct(wf, 1000., 0., after);
+
+  BOOST_REQUIRE_EQUAL(before.size(), 1ul);
+  BOOST_REQUIRE_EQUAL(after.size(),  1ul);
+  BOOST_CHECK_EQUAL(after[0].t_max, before[0].t_max - 5);
+  BOOST_CHECK_CLOSE(after[0].area,  before[0].area, 1.);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,256 @@
+#define BOOST_TEST_MODULE ( ChunkedPulseReco_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoSiPM.h"
+#include "larana/OpticalDetector/OpHitFinder/AlgoThreshold.h"
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoException.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoEdges.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+
+#include "PulseRecoTestUtils.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+void CheckChunkSizes(pmtana::PMTPulseRecoBase& pulse_algo)
+{
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  const auto wf = MakeWaveform();
+
+  pmtana::PulseRecoManager whole_mgr;
+  whole_mgr.AddRecoAlgo(&pulse_algo);
+  whole_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  pmtana::PulseRecoContext whole;
+  BOOST_CHECK(whole_mgr.Reconstruct(wf, whole));
+  BOOST_CHECK_EQUAL(whole.pulse_v[0].size(), 5ul);
+
+  for(size_t chunk_size : { 1ul, 3ul, 64ul, 251ul, 1000ul, 4096ul }) {
+
+    pmtana::PulseRecoManager chunked_mgr;
+    chunked_mgr.AddRecoAlgo(&pulse_algo);
+    chunked_mgr.SetDefaultPedAlgo(&ped_algo);
+    chunked_mgr.SetChunkSize(chunk_size);
+
+    pmtana::PulseRecoContext chunked;
+    BOOST_CHECK(chunked_mgr.Reconstruct(wf, chunked));
+    BOOST_CHECK(chunked.ped_constant);
+    BOOST_CHECK(chunked.ped_mean_v.empty());
+
+    CheckSamePulses(chunked.pulse_v[0], whole.pulse_v[0]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(ChunkedPulseReco_test)
+
+BOOST_AUTO_TEST_CASE(threshold_chunksMatchWholeWaveform)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  BOOST_CHECK(algo.SupportsChunks());
+  CheckChunkSizes(algo);
+}
+
+BOOST_AUTO_TEST_CASE(sipm_chunksMatchWholeWaveform)
+{
+  pmtana::AlgoSiPM algo(MakePSet("ADCThreshold: 20 MinWidth: 1 SecondThreshold: 5 Pedestal: 0"));
+  BOOST_CHECK(algo.SupportsChunks());
+  CheckChunkSizes(algo);
+}
+
+BOOST_AUTO_TEST_CASE(threshold_batchMatchesSingleWaveforms)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+  BOOST_CHECK(algo.SupportsBatch());
+
+  // More waveforms than lanes, with pulses at different ticks in each
+  std::vector<std::vector<short> > wfs;
+  for(size_t w=0; w<21; ++w) {
+    auto wf = MakeWaveform();
+    std::rotate(wf.begin() + 20, wf.begin() + 20 + 37*w % 900, wf.end() - 20);
+    if(w % 5 == 4) wf.assign(wf.size(), 2001);
+    wfs.push_back(wf);
+  }
+
+  pmtana::PulseRecoManager single_mgr;
+  single_mgr.AddRecoAlgo(&algo);
+  single_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  pmtana::PulseRecoManager batch_mgr;
+  batch_mgr.AddRecoAlgo(&algo);
+  batch_mgr.SetDefaultPedAlgo(&ped_algo);
+  batch_mgr.SetBatchMode(true);
+
+  std::vector<const pmtana::Waveform_t*> ptrs;
+  for(auto const& wf : wfs) ptrs.push_back(&wf);
+
+  pmtana::PulseRecoBatchContext batch;
+  BOOST_CHECK(batch_mgr.Reconstruct(ptrs, batch));
+  BOOST_REQUIRE_EQUAL(batch.contexts.size(), wfs.size());
+
+  for(size_t w=0; w<wfs.size(); ++w) {
+    pmtana::PulseRecoContext single;
+    BOOST_CHECK(single_mgr.Reconstruct(wfs[w], single));
+    CheckSamePulses(batch.contexts[w].pulse_v[0], single.pulse_v[0]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(threshold_batchOverlappingPulsesMatchSingleWaveforms)
+{
+  // Pulses open in several lanes at once, with lanes stepped past each other
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<size_t> tick(20, 499);
+  std::uniform_int_distribution<size_t> width(1, 60);
+  std::vector<std::vector<short> > wfs;
+  for(size_t w=0; w<40; ++w) {
+    std::vector<short> wf(500, 2000);
+    for(size_t p=0; p<8; ++p) {
+      const size_t start = tick(rng), len = width(rng);
+      for(size_t i=start; i<start+len && i<wf.size(); ++i) wf[i] = 2030;
+    }
+    if(w == 3) {
+      // Out-of-range sample within a pulse, after the lane was stepped past it
+      std::fill(wf.begin() + 280, wf.begin() + 320, 2030);
+      wf[300] = std::numeric_limits<short>::max();
+    }
+    wfs.push_back(wf);
+  }
+
+  pmtana::PulseRecoManager single_mgr;
+  single_mgr.AddRecoAlgo(&algo);
+  single_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  pmtana::PulseRecoManager batch_mgr;
+  batch_mgr.AddRecoAlgo(&algo);
+  batch_mgr.SetDefaultPedAlgo(&ped_algo);
+  batch_mgr.SetBatchMode(true);
+
+  std::vector<const pmtana::Waveform_t*> ptrs;
+  for(auto const& wf : wfs) ptrs.push_back(&wf);
+
+  pmtana::PulseRecoBatchContext batch;
+  BOOST_CHECK(batch_mgr.Reconstruct(ptrs, batch));
+  BOOST_REQUIRE_EQUAL(batch.contexts.size(), wfs.size());
+
+  for(size_t w=0; w<wfs.size(); ++w) {
+    pmtana::PulseRecoContext single;
+    BOOST_CHECK(single_mgr.Reconstruct(wfs[w], single));
+    BOOST_CHECK(!single.pulse_v[0].empty());
+    CheckSamePulses(batch.contexts[w].pulse_v[0], single.pulse_v[0]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(edges_chunkedPedestalMatchesConstant)
+{
+  pmtana::PedAlgoEdges head(MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+  BOOST_CHECK(head.SupportsChunks());
+
+  const auto wf = MakeWaveform();
+  double ped_mean = 0, ped_sigma = 0;
+  BOOST_CHECK(head.EvaluateConstant(wf, ped_mean, ped_sigma));
+
+  for(size_t chunk_size : { 1ul, 3ul, 9ul, 10ul, 11ul, 1000ul }) {
+    pmtana::PedestalChunkState state;
+    size_t begin = 0;
+    while(!head.EvaluateChunk(wf.data() + begin, chunk_size, state)) begin += chunk_size;
+    BOOST_CHECK_LT(begin, 10ul); // known with the 10th sample
+    BOOST_CHECK(state.ready);
+    BOOST_CHECK_EQUAL(state.ped_mean,  ped_mean);
+    BOOST_CHECK_EQUAL(state.ped_sigma, ped_sigma);
+  }
+
+  // The tail is only known at the end of the waveform
+  pmtana::PedAlgoEdges tail(MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 1"));
+  BOOST_CHECK(!tail.SupportsChunks());
+  pmtana::PedestalChunkState state;
+  BOOST_CHECK_THROW(tail.EvaluateChunk(wf.data(), wf.size(), state), pmtana::OpticalRecoException);
+}
+
+BOOST_AUTO_TEST_CASE(blocks_matchWholeWaveform)
+{
+  pmtana::AlgoThreshold threshold(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+					   " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::AlgoSiPM sipm(MakePSet("ADCThreshold: 20 MinWidth: 1 SecondThreshold: 5 Pedestal: 0"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  pmtana::PulseRecoManager mgr;
+  mgr.AddRecoAlgo(&threshold);
+  mgr.AddRecoAlgo(&sipm);
+  mgr.SetDefaultPedAlgo(&ped_algo);
+  BOOST_CHECK(mgr.SupportsBlocks());
+
+  const auto wf = MakeWaveform();
+
+  pmtana::PulseRecoContext whole;
+  BOOST_CHECK(mgr.Reconstruct(wf, whole));
+
+  // Blocks of one size, and of varying sizes; one context for all the waveforms
+  pmtana::PulseRecoContext blocks;
+  for(size_t block_size : { 1ul, 4ul, 9ul, 10ul, 11ul, 333ul, 1000ul, 0ul }) {
+
+    mgr.BeginWaveform(blocks);
+    for(size_t begin = 0, i = 0; begin < wf.size(); ++i) {
+      const size_t n = std::min(block_size ? block_size : 1 + (i * 7) % 23, wf.size() - begin);
+      BOOST_CHECK(mgr.ReconstructBlock(wf.data() + begin, n, blocks));
+      begin += n;
+    }
+    BOOST_CHECK(mgr.EndWaveform(blocks));
+
+    BOOST_CHECK(blocks.ped_constant);
+    BOOST_CHECK(blocks.pending.empty());
+    CheckSamePulses(blocks.pulse_v[0], whole.pulse_v[0]);
+    CheckSamePulses(blocks.pulse_v[1], whole.pulse_v[1]);
+  }
+
+  // Waveform shorter than the pedestal samples
+  mgr.BeginWaveform(blocks);
+  BOOST_CHECK(mgr.ReconstructBlock(wf.data(), 5, blocks));
+  BOOST_CHECK_THROW(mgr.EndWaveform(blocks), pmtana::OpticalRecoException);
+}
+
+BOOST_AUTO_TEST_CASE(blocks_needChunkedPedestal)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoEdges tail(MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 1"));
+
+  pmtana::PulseRecoManager mgr;
+  mgr.AddRecoAlgo(&algo);
+  mgr.SetDefaultPedAlgo(&tail);
+  BOOST_CHECK(!mgr.SupportsBlocks());
+
+  pmtana::PulseRecoContext ctx;
+  BOOST_CHECK_THROW(mgr.BeginWaveform(ctx), pmtana::OpticalRecoException);
+
+  // The chunked mode is refused rather than run on whole waveforms
+  BOOST_CHECK_THROW(mgr.SetChunkSize(64), pmtana::OpticalRecoException);
+  mgr.SetChunkSize(0);
+
+  // Same once the algorithms can run in blocks
+  pmtana::PedAlgoEdges head(MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+  pmtana::PulseRecoManager chunked_mgr;
+  chunked_mgr.AddRecoAlgo(&algo);
+  chunked_mgr.SetDefaultPedAlgo(&head);
+  chunked_mgr.SetChunkSize(64);
+
+  // A pulse algorithm added later with its own pedestal makes the waveforms throw
+  pmtana::AlgoThreshold other(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				       " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  chunked_mgr.AddRecoAlgo(&other, &tail);
+  BOOST_CHECK_THROW(chunked_mgr.Reconstruct(MakeWaveform(), ctx), pmtana::OpticalRecoException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,91 @@
+#define BOOST_TEST_MODULE ( CropWaveforms_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/OpHitAlg.h"
+#include "lardataobj/RawData/OpDetWaveform.h"
+
+#include <vector>
+
+const double TickPeriod = 0.5;
+
+// Samples numbered from first, so that each one can be traced back
+raw::OpDetWaveform MakeWaveform(double timeStamp, unsigned int channel,
+                                size_t nSamples, short first)
+{
+  raw::OpDetWaveform waveform(timeStamp, channel, nSamples);
+  for (size_t i = 0; i < nSamples; ++i) waveform[i] = first + i;
+  return waveform;
+}
+
+void CheckSegment(raw::OpDetWaveform const& segment,
+                  raw::OpDetWaveform const& waveform,
+                  size_t begin, size_t end)
+{
+  BOOST_CHECK_EQUAL(segment.ChannelNumber(), waveform.ChannelNumber());
+  BOOST_CHECK_EQUAL(segment.TimeStamp(), waveform.TimeStamp() + begin*TickPeriod);
+  BOOST_REQUIRE_EQUAL(segment.size(), end - begin);
+  for (size_t i = 0; i < segment.size(); ++i)
+    BOOST_CHECK_EQUAL(segment[i], waveform[begin + i]);
+}
+
+BOOST_AUTO_TEST_SUITE(CropWaveforms_test)
+
+BOOST_AUTO_TEST_CASE(noWindows_noSegments)
+{
+  auto const waveform = MakeWaveform(10., 3, 100, 0);
+  BOOST_CHECK(opdet::CropWaveforms({ &waveform }, {}, TickPeriod).empty());
+  BOOST_CHECK(opdet::CropWaveforms({ &waveform }, { { 10., 20. } }, 0.).empty());
+}
+
+BOOST_AUTO_TEST_CASE(window_startIncludedEndExcluded)
+{
+  // Samples at 10 + i/2 us; [15, 20) holds samples 10 to 19
+  auto const waveform = MakeWaveform(10., 3, 100, 1000);
+  auto const segments = opdet::CropWaveforms({ &waveform }, { { 15., 20. } }, TickPeriod);
+  BOOST_REQUIRE_EQUAL(segments.size(), 1ul);
+  CheckSegment(segments[0], waveform, 10, 20);
+
+  // Between samples: from the next sample on
+  auto const between = opdet::CropWaveforms({ &waveform }, { { 15.2, 19.9 } }, TickPeriod);
+  BOOST_REQUIRE_EQUAL(between.size(), 1ul);
+  CheckSegment(between[0], waveform, 11, 20);
+}
+
+BOOST_AUTO_TEST_CASE(windows_clippedMergedAndSorted)
+{
+  auto const waveform = MakeWaveform(10., 3, 100, 0); // 10 to 60 us
+
+  // Clipped to the waveform
+  auto segments = opdet::CropWaveforms({ &waveform }, { { 0., 12. }, { 55., 100. } },
+                                       TickPeriod);
+  BOOST_REQUIRE_EQUAL(segments.size(), 2ul);
+  CheckSegment(segments[0], waveform, 0, 4);
+  CheckSegment(segments[1], waveform, 90, 100);
+
+  // Overlapping and touching windows are merged, given in any order; empty
+  // and reversed windows are ignored
+  segments = opdet::CropWaveforms({ &waveform },
+                                  { { 40., 45. }, { 20., 25. }, { 22., 30. }, { 30., 32. },
+                                    { 35., 35. }, { 38., 36. } },
+                                  TickPeriod);
+  BOOST_REQUIRE_EQUAL(segments.size(), 2ul);
+  CheckSegment(segments[0], waveform, 20, 44);
+  CheckSegment(segments[1], waveform, 60, 70);
+}
+
+BOOST_AUTO_TEST_CASE(waveforms_keptInOrder)
+{
+  auto const early = MakeWaveform(0.,  1, 20, 0);    // 0 to 10 us
+  auto const late  = MakeWaveform(50., 2, 20, 100);  // 50 to 60 us
+  auto const other = MakeWaveform(48., 7, 40, 200);  // 48 to 68 us
+
+  auto const segments = opdet::CropWaveforms({ &late, &early, &other },
+                                             { { 52., 55. }, { 100., 110. } },
+                                             TickPeriod);
+  // The early waveform is outside all windows
+  BOOST_REQUIRE_EQUAL(segments.size(), 2ul);
+  CheckSegment(segments[0], late,  4, 10);
+  CheckSegment(segments[1], other, 8, 14);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+// Helpers shared by the flash finding tests
+#ifndef FLASHTESTUTILS_H
+#define FLASHTESTUTILS_H
+
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "lardataobj/RecoBase/OpFlash.h"
+#include "lardataobj/RecoBase/OpHit.h"
+
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+const double BinWidth       = 0.25;
+const float  FlashThreshold = 20;
+const float  WidthTolerance = 0.5;
+const float  TrigCoinc      = 2.5;
+const unsigned int NChannels = 30;
+
+// One optical detector per channel, the channels split evenly among the
+// cryostats; odd channels are in a TPC with one plane, even ones are not
+inline opdet::OpDetGeometryCache MakeCache(unsigned int NCryostats = 1)
+{
+  opdet::OpDetGeometryCache cache;
+  cache.Reset(NChannels - 1, NChannels, 1, NCryostats);
+  for (unsigned int ch = 0; ch != NChannels; ++ch) {
+    double const xyz[3] = { -10., 20.*(ch % 5), 50.*ch };
+    cache.SetOpDetCenter(ch, xyz);
+    cache.SetChannel(ch, xyz, ch*NCryostats/NChannels,
+                     ch % 2 ? std::vector< unsigned int >{ 10*ch }
+                            : std::vector< unsigned int >());
+  }
+  return cache;
+}
+
+inline recob::OpHit MakeHit(int channel, double time, double PE)
+{
+  return recob::OpHit(channel, time, time + 1000, 0, 0.05, PE, PE, PE, 0.5);
+}
+
+// Flashes of hits within 50 ns plus a tail, over single-PE noise; in time
+// order, or shuffled
+inline std::vector< recob::OpHit > MakeHits(unsigned int seed, size_t NFlashes,
+                                            size_t NNoise, double Span,
+                                            bool TimeOrder)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution< double > u(0, 1);
+  std::vector< recob::OpHit > hits;
+  for (size_t f = 0; f != NFlashes; ++f) {
+    double const t0 = Span*u(rng);
+    size_t const NHits = 5 + rng() % 40;
+    for (size_t i = 0; i != NHits; ++i) {
+      double const t = t0 + 0.05*u(rng) + (u(rng) < 0.2 ? 3*u(rng) : 0);
+      hits.push_back(MakeHit(rng() % NChannels, t, 20*u(rng)));
+    }
+  }
+  for (size_t i = 0; i != NNoise; ++i)
+    hits.push_back(MakeHit(rng() % NChannels, Span*u(rng), 1.));
+  if (TimeOrder)
+    std::sort(hits.begin(), hits.end(),
+              [](recob::OpHit const& a, recob::OpHit const& b)
+              { return a.PeakTime() < b.PeakTime(); });
+  else
+    std::shuffle(hits.begin(), hits.end(), rng);
+  return hits;
+}
+
+inline void CheckSameFlash(recob::OpFlash const& flash,
+                           recob::OpFlash const& expected)
+{
+  BOOST_CHECK_EQUAL(flash.Time(),      expected.Time());
+  BOOST_CHECK_EQUAL(flash.TimeWidth(), expected.TimeWidth());
+  BOOST_CHECK_EQUAL(flash.TotalPE(),   expected.TotalPE());
+  BOOST_CHECK_EQUAL(flash.YCenter(),   expected.YCenter());
+  BOOST_CHECK_EQUAL(flash.ZCenter(),   expected.ZCenter());
+  BOOST_CHECK(flash.WireCenters() == expected.WireCenters());
+}
+
+#endif
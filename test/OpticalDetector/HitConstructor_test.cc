@@ -0,0 +1,125 @@
+#define BOOST_TEST_MODULE ( HitConstructor_test )
+#include "cetlib/quiet_unit_test.hpp"
+#include "cetlib_except/exception.h"
+
+#include "larana/OpticalDetector/OpHitFinder/OpHitAlg.h"
+#include "lardataalg/DetectorInfo/ElecClock.h"
+#include "larreco/Calibrator/IPhotonCalibrator.h"
+
+#include <cmath>
+#include <vector>
+
+// PE = ADC / SPE size + shift, with a different SPE size per channel
+class AffineCalibrator : public calib::IPhotonCalibrator {
+public:
+  explicit AffineCalibrator(bool useArea) : fUseArea(useArea) {}
+  double PE(double adcs, int opchannel) const override
+  { return adcs/(20.3 + 0.7*opchannel) + 0.05; }
+  bool UseArea() const override { return fUseArea; }
+private:
+  bool fUseArea;
+};
+
+// Saturating response: not affine
+class SaturatingCalibrator : public calib::IPhotonCalibrator {
+public:
+  double PE(double adcs, int) const override { return 50.*std::tanh(adcs/1000.); }
+  bool UseArea() const override { return false; }
+};
+
+const size_t NChannels = 4;
+const double TriggerTime = 3.5;
+const float  HitThreshold = 5.;
+const detinfo::ElecClock OpticalClock(0., 1600., 64.);
+
+pmtana::pulse_param_array MakePulses()
+{
+  pmtana::pulse_param_array pulses;
+  for (size_t i = 0; i < 20; ++i) {
+    pmtana::pulse_param pulse;
+    pulse.t_start = 30.*i;
+    pulse.t_max   = 30.*i + 3;
+    pulse.t_end   = 30.*i + 12 + i % 4;
+    pulse.peak    = 2. + 7.5*i;      // first ones below the hit threshold
+    pulse.area    = 11.25*pulse.peak;
+    pulses.push_back(pulse);
+  }
+  return pulses;
+}
+
+// Hits of the pulses on every channel, against direct calibrator calls
+void CheckHits(calib::IPhotonCalibrator const& calibrator, bool affine, double tolerance)
+{
+  opdet::HitConstructor const hitConstructor(NChannels, OpticalClock, TriggerTime,
+                                             calibrator, affine);
+  BOOST_CHECK_EQUAL(hitConstructor.UseTable(), affine);
+
+  const auto pulses = MakePulses();
+  pmtana::pulse_table table;
+  table.assign(pulses);
+
+  for (size_t channel = 0; channel < NChannels; ++channel) {
+
+    const int ch = static_cast< int >(channel);
+    const double timeStamp = 1000.*channel + 0.25;
+
+    std::vector< recob::OpHit > hits, tableHits;
+    hitConstructor.ConstructHits(HitThreshold, ch, timeStamp, pulses, hits);
+    hitConstructor.ConstructHits(HitThreshold, ch, timeStamp, table, tableHits);
+
+    size_t iHit = 0;
+    for (auto const& pulse : pulses) {
+
+      if (pulse.peak < HitThreshold) continue;
+      BOOST_REQUIRE_LT(iHit, hits.size());
+      BOOST_REQUIRE_LT(iHit, tableHits.size());
+
+      const double adc = calibrator.UseArea() ? pulse.area : pulse.peak;
+      const double PE  = calibrator.PE(adc, ch);
+      const double absTime = timeStamp + pulse.t_max*OpticalClock.TickPeriod();
+
+      for (auto const* hit : { &hits[iHit], &tableHits[iHit] }) {
+        BOOST_CHECK_EQUAL(hit->OpChannel(), ch);
+        BOOST_CHECK_CLOSE(hit->PeakTimeAbs(), absTime, 1e-12);
+        BOOST_CHECK_CLOSE(hit->PeakTime(), absTime - TriggerTime, 1e-12);
+        BOOST_CHECK_EQUAL(hit->Frame(), OpticalClock.Frame(timeStamp));
+        BOOST_CHECK_CLOSE(hit->Width(),
+                          (pulse.t_end - pulse.t_start)*OpticalClock.TickPeriod(), 1e-12);
+        BOOST_CHECK_EQUAL(hit->Amplitude(), pulse.peak);
+        BOOST_CHECK_EQUAL(hit->Area(), pulse.area);
+        if (tolerance == 0) BOOST_CHECK_EQUAL(hit->PE(), PE);
+        else BOOST_CHECK_CLOSE(hit->PE(), PE, tolerance);
+      }
+      ++iHit;
+    }
+    BOOST_CHECK_EQUAL(hits.size(), iHit);
+    BOOST_CHECK_EQUAL(tableHits.size(), iHit);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(HitConstructor_test)
+
+BOOST_AUTO_TEST_CASE(undeclared_callsCalibrator)
+{
+  // Not declared affine: exactly the calibrator values, affine or not
+  CheckHits(AffineCalibrator(false), false, 0.);
+  CheckHits(AffineCalibrator(true),  false, 0.);
+  CheckHits(SaturatingCalibrator(),  false, 0.);
+}
+
+BOOST_AUTO_TEST_CASE(declaredAffine_tableMatchesCalibrator)
+{
+  // Up to rounding, in percent
+  CheckHits(AffineCalibrator(false), true, 1e-11);
+  CheckHits(AffineCalibrator(true),  true, 1e-11);
+}
+
+BOOST_AUTO_TEST_CASE(declaredAffine_throwsIfNot)
+{
+  SaturatingCalibrator const calibrator;
+  BOOST_CHECK_THROW(opdet::HitConstructor(NChannels, OpticalClock, TriggerTime,
+                                          calibrator, true),
+                    cet::exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#define BOOST_TEST_MODULE ( OpDetGeometryCache_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "cetlib_except/exception.h"
+#include "lardataalg/DetectorInfo/DetectorClocksStandard.h"
+
+#include "larana/OpticalDetector/FlashUtilities.h"
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
+#include "larana/OpticalDetector/OpFlashAlg.h"
+
+#include "FlashTestUtils.h"
+
+#include <vector>
+
+const double tolerance = 1e-6;
+
+// Unlike MakeCache, channels 0 to 5 (channel 3 missing), one per optical
+// detector along z; channel 4 is outside the TPC and channel 5 is beyond the
+// wires of plane 1
+opdet::OpDetGeometryCache MakeHandMadeCache()
+{
+  opdet::OpDetGeometryCache cache;
+  cache.Reset(5, 6, 2, 1);
+  for (unsigned int ch = 0; ch != 6; ++ch) {
+    double const xyz[3] = { -10., 5.*(ch % 2), 100.*ch };
+    cache.SetOpDetCenter(ch, xyz);
+    if (ch == 3) continue;
+    std::vector< unsigned int > wires;
+    if (ch == 5)      wires = { 50*ch, opdet::OpDetGeometryCache::InvalidWire };
+    else if (ch != 4) wires = { 50*ch, 60*ch };
+    cache.SetChannel(ch, xyz, 0, wires);
+  }
+  return cache;
+}
+
+BOOST_AUTO_TEST_SUITE(OpDetGeometryCache_test)
+
+BOOST_AUTO_TEST_CASE(HandMade_accessors)
+{
+  auto const cache = MakeHandMadeCache();
+
+  BOOST_CHECK(!cache.Empty());
+  BOOST_CHECK_EQUAL(cache.MaxOpChannel(), 5u);
+  BOOST_CHECK_EQUAL(cache.NOpDets(), 6u);
+  BOOST_CHECK_EQUAL(cache.Nplanes(), 2u);
+  BOOST_CHECK_EQUAL(cache.Ncryostats(), 1u);
+
+  BOOST_CHECK(cache.IsValidOpChannel(2));
+  BOOST_CHECK(!cache.IsValidOpChannel(3));
+  BOOST_CHECK(!cache.IsValidOpChannel(6));
+
+  BOOST_CHECK_CLOSE(cache.Center(2)[2], 200., tolerance);
+  BOOST_CHECK_CLOSE(cache.OpDetCenter(3)[1], 5., tolerance);
+  BOOST_CHECK(cache.InTPC(2));
+  BOOST_CHECK(!cache.InTPC(4));
+  BOOST_CHECK_EQUAL(cache.NearestWire(2, 1), 120u);
+  BOOST_CHECK_EQUAL(cache.NearestWire(5, 1),
+                    opdet::OpDetGeometryCache::InvalidWire);
+}
+
+BOOST_AUTO_TEST_CASE(HandMade_invalidInput)
+{
+  auto cache = MakeHandMadeCache();
+  double const xyz[3] = { 0., 0., 0. };
+  BOOST_CHECK_THROW(cache.SetChannel(6, xyz, 0, {}), cet::exception);
+  BOOST_CHECK_THROW(cache.SetChannel(3, xyz, 0, { 1 }), cet::exception);
+  BOOST_CHECK_THROW(cache.SetOpDetCenter(6, xyz), cet::exception);
+
+  // Reset leaves every channel invalid
+  cache.Reset(5, 6, 2, 1);
+  BOOST_CHECK(!cache.IsValidOpChannel(2));
+}
+
+BOOST_AUTO_TEST_CASE(GetPosition_matchesPositionVectors)
+{
+  auto const cache = MakeHandMadeCache();
+  std::vector< float > const PEs = { 1., 0., 20., 3.5, 0., 7. };
+  std::vector< float > posY, posZ;
+  for (size_t o = 0; o != cache.NOpDets(); ++o) {
+    posY.push_back(cache.OpDetCenter(o)[1]);
+    posZ.push_back(cache.OpDetCenter(o)[2]);
+  }
+
+  opdet::FlashUtilities util;
+  float mean = 0, rms = 0, expMean = 0, expRms = 0;
+  util.GetPosition(PEs, posY, expMean, expRms);
+  util.GetPosition(PEs, cache, 1, mean, rms);
+  BOOST_CHECK_EQUAL(mean, expMean);
+  BOOST_CHECK_EQUAL(rms,  expRms);
+
+  util.GetPosition(PEs, posZ, expMean, expRms);
+  util.GetPosition(PEs, cache, 2, mean, rms);
+  BOOST_CHECK_EQUAL(mean, expMean);
+  BOOST_CHECK_EQUAL(rms,  expRms);
+
+  BOOST_CHECK_THROW(util.GetPosition(PEs, cache, 3, mean, rms),
+                    std::runtime_error);
+  BOOST_CHECK_THROW(util.GetPosition(std::vector< float >(7, 1.), cache, 1,
+                                     mean, rms),
+                    std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ConstructFlash_cachedWires)
+{
+  auto const cache = MakeHandMadeCache();
+  detinfo::DetectorClocksStandard const clocks;
+
+  // Channel 4 is outside the TPC: it adds light but no wire position
+  std::vector< recob::OpHit > const hits =
+    { MakeHit(1, 1., 10.), MakeHit(2, 1., 30.), MakeHit(4, 1., 20.),
+      MakeHit(5, 1., 1.) };
+  std::vector< recob::OpFlash > flashes;
+
+  opdet::ConstructFlash({ 0, 1, 2 }, hits, flashes, cache, clocks, 0.);
+  BOOST_REQUIRE_EQUAL(flashes.size(), 1u);
+
+  auto const& flash = flashes.front();
+  BOOST_CHECK_CLOSE(flash.TotalPE(), 60., tolerance);
+  BOOST_CHECK_CLOSE(flash.PEs()[4], 20., tolerance);
+  BOOST_REQUIRE_EQUAL(flash.WireCenters().size(), 2u);
+  BOOST_CHECK_CLOSE(flash.WireCenters()[0], (10.*50 + 30.*100)/60., tolerance);
+  BOOST_CHECK_CLOSE(flash.WireCenters()[1], (10.*60 + 30.*120)/60., tolerance);
+  BOOST_CHECK_CLOSE(flash.ZCenter(), (10.*100 + 30.*200 + 20.*400)/60.,
+                    tolerance);
+
+  // The failed wire lookup of channel 5 is an error only once it is used
+  BOOST_CHECK_THROW(opdet::ConstructFlash({ 0, 3 }, hits, flashes, cache,
+                                          clocks, 0.),
+                    cet::exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
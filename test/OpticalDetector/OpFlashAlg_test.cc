@@ -3,6 +3,9 @@
 
 #include "larana/OpticalDetector/OpFlashAlg.h"
 
+#include <algorithm>
+#include <numeric>
+
 // const float HitThreshold = 3;
 const float FlashThreshold = 50;
 const double WidthTolerance = 0.5;
@@ -196,6 +199,61 @@ BOOST_AUTO_TEST_CASE(FillAccumulator_checkMultipleHits){
 
 }
 
+BOOST_AUTO_TEST_CASE(FillSparseAccumulator_matchesFillAccumulator)
+{
+  // Hits out of time order, two of them far away, crossing the threshold in
+  // a different order than their bins
+  std::vector<recob::OpHit> HitVector;
+  const std::vector<double> Times = { 3.1, 0.2, 2000.7, 3.4, 0.6, 0.4, 2000.1, 3.9 };
+  const std::vector<double> PEs   = { 30,  20,  60,     25,  15,  20,  5,      1   };
+  for(size_t i=0; i<Times.size(); i++)
+    HitVector.emplace_back(0,Times[i],0,0,0.1,0,0,PEs[i],0);
+
+  std::vector<int> HitsByTime(HitVector.size());
+  for(size_t i=0; i<HitsByTime.size(); i++) HitsByTime[i] = i;
+  std::sort(HitsByTime.begin(), HitsByTime.end(), [&](int i, int j)
+	    { return HitVector[i].PeakTime() < HitVector[j].PeakTime(); });
+
+  const double BinWidth = 1;
+  const double MinTime = 0.2;
+
+  for(double BinOffset : { 0., BinWidth/2 }) {
+
+    std::vector<double> Binned(4000);
+    std::vector< std::vector<int> > Contributors(4000);
+    std::vector<int> FlashesInAccumulator;
+    for(size_t i=0; i<HitVector.size(); i++)
+      opdet::FillAccumulator(opdet::GetAccumIndex(HitVector[i].PeakTime(),MinTime,
+						  BinWidth,BinOffset),
+			     i,HitVector[i].PE(),FlashThreshold,
+			     Binned,Contributors,FlashesInAccumulator);
+
+    opdet::SparseAccumulator Accumulator;
+    opdet::FillSparseAccumulator(HitVector,HitsByTime,MinTime,BinWidth,BinOffset,
+				 FlashThreshold,Accumulator);
+
+    BOOST_REQUIRE_EQUAL( Accumulator.Offsets.size() , Accumulator.Bins.size()+1 );
+    BOOST_CHECK_EQUAL( Accumulator.Offsets.back() , HitVector.size() );
+
+    size_t NOccupied = 0;
+    for(size_t bin=0; bin<Contributors.size(); bin++) {
+      if(Contributors[bin].empty()) continue;
+      size_t row = NOccupied++;
+      BOOST_REQUIRE( row < Accumulator.Bins.size() );
+      BOOST_CHECK_EQUAL( Accumulator.Bins[row] , bin );
+      BOOST_CHECK_EQUAL( Accumulator.BinnedPE[row] , Binned[bin] );
+      std::vector<int> RowHits(Accumulator.HitIndices.begin()+Accumulator.Offsets[row],
+			       Accumulator.HitIndices.begin()+Accumulator.Offsets[row+1]);
+      BOOST_CHECK( RowHits == Contributors[bin] );
+    }
+    BOOST_CHECK_EQUAL( Accumulator.Bins.size() , NOccupied );
+
+    BOOST_REQUIRE_EQUAL( Accumulator.FlashRows.size() , FlashesInAccumulator.size() );
+    for(size_t i=0; i<FlashesInAccumulator.size(); i++)
+      BOOST_CHECK_EQUAL( (int)Accumulator.Bins[Accumulator.FlashRows[i]] , FlashesInAccumulator[i] );
+  }
+}
+
 BOOST_AUTO_TEST_CASE(FillFlashesBySizeMap_checkNoFlash)
 {
   const size_t vector_size = 10;
@@ -980,6 +1038,69 @@ BOOST_AUTO_TEST_CASE(CheckAndStoreFlash_BelowThreshold_MultipleHits)
 
 }
 
+BOOST_AUTO_TEST_CASE(RefineHitsInFlash_TwoSeparateFlashes)
+{
+  std::vector<recob::OpHit> HitVector;
+  HitVector.emplace_back(0,0, 0,0,0.1,0,0,30,0);
+  HitVector.emplace_back(0,0, 0,0,0.1,0,0,30,0);
+  HitVector.emplace_back(0,10,0,0,0.1,0,0,40,0);
+  HitVector.emplace_back(0,10,0,0,0.1,0,0,20,0);
+
+  std::vector<int> HitsThisFlash = {0, 1, 2, 3};
+  std::vector< std::vector<int> > RefinedHitsPerFlash;
+
+  opdet::RefineHitsInFlash(HitsThisFlash,
+			   HitVector,
+			   RefinedHitsPerFlash,
+			   WidthTolerance,
+			   FlashThreshold);
+
+  // Biggest hit first
+  BOOST_CHECK_EQUAL( RefinedHitsPerFlash.size() , 2U );
+  BOOST_CHECK( RefinedHitsPerFlash.at(0) == std::vector<int>({2, 3}) );
+  BOOST_CHECK( RefinedHitsPerFlash.at(1) == std::vector<int>({0, 1}) );
+}
+
+BOOST_AUTO_TEST_CASE(RefineHitsInFlash_HitAddedInSecondPass)
+{
+  std::vector<recob::OpHit> HitVector;
+  HitVector.emplace_back(0,0,  0,0,2,0,0,100,0); // seed
+  HitVector.emplace_back(0,1.5,0,0,2,0,0,25, 0); // only after hit 2 widens the flash
+  HitVector.emplace_back(0,0.8,0,0,2,0,0,20, 0);
+  HitVector.emplace_back(0,50, 0,0,2,0,0,10, 0); // far away
+
+  std::vector<int> HitsThisFlash = {3, 2, 1, 0};
+  std::vector< std::vector<int> > RefinedHitsPerFlash;
+
+  opdet::RefineHitsInFlash(HitsThisFlash,
+			   HitVector,
+			   RefinedHitsPerFlash,
+			   WidthTolerance,
+			   FlashThreshold);
+
+  BOOST_CHECK_EQUAL( RefinedHitsPerFlash.size() , 1U );
+  BOOST_CHECK( RefinedHitsPerFlash.at(0) == std::vector<int>({0, 2, 1}) );
+}
+
+BOOST_AUTO_TEST_CASE(RefineHitsInFlash_BelowThreshold)
+{
+  std::vector<recob::OpHit> HitVector;
+  HitVector.emplace_back(0,0,   0,0,0.2,0,0,40,0);
+  HitVector.emplace_back(0,0.05,0,0,0.2,0,0,5, 0);
+  HitVector.emplace_back(0,0.3, 0,0,0.2,0,0,48,0);
+
+  std::vector<int> HitsThisFlash = {0, 1, 2};
+  std::vector< std::vector<int> > RefinedHitsPerFlash;
+
+  opdet::RefineHitsInFlash(HitsThisFlash,
+			   HitVector,
+			   RefinedHitsPerFlash,
+			   WidthTolerance,
+			   FlashThreshold);
+
+  BOOST_CHECK_EQUAL( RefinedHitsPerFlash.size() , 0U );
+}
+
 BOOST_AUTO_TEST_CASE(AddHitContribution_AddFirstHit)
 {
     double MaxTime = -1e9, MinTime = 1e9;
@@ -1503,4 +1624,61 @@ BOOST_AUTO_TEST_CASE(RemoveFlashesFromVectors_NoFlashes)
 }
 
 
+BOOST_AUTO_TEST_CASE(RemoveLateLight_MatchesAllPairs)
+{
+  // Bright flashes every 20 us with dimmer ones after them; not time ordered
+  size_t BeginFlash=1;
+
+  std::vector<double> WireCenters(3,0);
+  std::vector<double> WireWidths(3,0);
+
+  std::vector<recob::OpFlash> FlashVector;
+  std::vector< std::vector<int> > RefinedHitsPerFlash;
+  std::vector<double> Times;
+  for(size_t i=0; i<BeginFlash+300; ++i){
+    size_t k = (i*97) % 300;
+    std::vector<double> PEs(30,0);
+    PEs.at(k % 30) = (k % 3 == 0) ? 500 : 2 + (k*7) % 40;
+    double Time = 20.0*(k/3) + (k % 3)*(0.5 + 0.37*(k % 11));
+    double TimeWidth = (k % 13 == 0) ? 0 : 0.05 + 0.01*(k % 7);
+    Times.push_back(Time);
+    FlashVector.emplace_back(Time, TimeWidth, 0, 0, PEs,
+			     0, 0, 0, 0, 0, 0, 0,
+			     WireCenters, WireWidths);
+    if(i>=BeginFlash) RefinedHitsPerFlash.emplace_back(1, int(i));
+  }
+
+  // Expectation: time order, then compare all pairs
+  std::vector<size_t> Order(FlashVector.size()-BeginFlash);
+  std::iota(Order.begin(), Order.end(), BeginFlash);
+  std::sort(Order.begin(), Order.end(), [&](size_t a, size_t b)
+	    { return FlashVector[a].Time() < FlashVector[b].Time(); });
+  std::vector<int> Expected;
+  for(size_t j=0; j<Order.size(); ++j){
+    bool Late = false;
+    for(size_t i=0; i<j; ++i){
+      recob::OpFlash const& iFlash = FlashVector[Order[i]];
+      recob::OpFlash const& jFlash = FlashVector[Order[j]];
+      if(opdet::GetLikelihoodLateLight(iFlash.TotalPE(), iFlash.Time(),
+				       iFlash.TimeWidth(), jFlash.TotalPE(),
+				       jFlash.Time(), jFlash.TimeWidth()) < 3.0)
+	Late = true;
+    }
+    if(!Late) Expected.push_back(Order[j]);
+  }
+  BOOST_CHECK(Expected.size() > 100U);
+  BOOST_CHECK(Expected.size() < 300U);
+
+  opdet::RemoveLateLight(FlashVector, RefinedHitsPerFlash);
+
+  BOOST_REQUIRE_EQUAL( RefinedHitsPerFlash.size() , Expected.size() );
+  BOOST_REQUIRE_EQUAL( FlashVector.size() , BeginFlash + Expected.size() );
+  for(size_t i=0; i<Expected.size(); ++i){
+    BOOST_CHECK_EQUAL( RefinedHitsPerFlash[i].size() , 1U );
+    BOOST_CHECK_EQUAL( RefinedHitsPerFlash[i][0] , Expected[i] );
+    BOOST_CHECK_EQUAL( FlashVector[BeginFlash + i].Time() , Times[Expected[i]] );
+  }
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
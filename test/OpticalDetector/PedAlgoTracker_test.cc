@@ -0,0 +1,127 @@
+#define BOOST_TEST_MODULE ( PedAlgoTracker_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "fhiclcpp/ParameterSet.h"
+#include "fhiclcpp/make_ParameterSet.h"
+
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoTracker.h"
+
+#include <string>
+#include <vector>
+
+const std::string Config =
+  "Name: \"Tracker\" NumCheckSamples: 8 DriftThreshold: 2.0 MaxSigma: 1.0 Weight: 0.5"
+  " FullAlgoPset: { Name: \"Edges\" NumSampleFront: 3 NumSampleTail: 3 Method: 0 }";
+
+const double tolerance = 1e-6;
+
+pmtana::PedAlgoTracker MakeTracker()
+{
+  fhicl::ParameterSet pset;
+  fhicl::make_ParameterSet(Config, pset);
+  return pmtana::PedAlgoTracker(pset);
+}
+
+// Flat baseline alternating between base and base+1, with an optional pulse
+std::vector<short> MakeWaveform(short base, size_t pulse_at = 0)
+{
+  std::vector<short> wf(100);
+  for(size_t i=0; i<wf.size(); ++i) wf[i] = base + (i % 2);
+  if(pulse_at) for(size_t i=pulse_at; i<pulse_at+5 && i<wf.size(); ++i) wf[i] += 50;
+  return wf;
+}
+
+BOOST_AUTO_TEST_SUITE(PedAlgoTracker_test)
+
+BOOST_AUTO_TEST_CASE(unknownChannel_usesFullAlgo)
+{
+  auto tracker = MakeTracker();
+  pmtana::PedestalMean_t mean_v;
+  pmtana::PedestalSigma_t sigma_v;
+
+  for(int i=0; i<3; ++i) BOOST_CHECK(tracker.Evaluate(MakeWaveform(2000), mean_v, sigma_v));
+
+  BOOST_CHECK_EQUAL(tracker.NumFullEvaluations(), 3ul);
+  BOOST_CHECK_EQUAL(tracker.NumTracked(), 0ul);
+  BOOST_CHECK_CLOSE(mean_v[0], 2000. + 1./3., tolerance); // Edges: first 3 samples
+}
+
+BOOST_AUTO_TEST_CASE(steadyBaseline_isTracked)
+{
+  auto tracker = MakeTracker();
+  pmtana::PedestalMean_t mean_v;
+  pmtana::PedestalSigma_t sigma_v;
+
+  for(int i=0; i<4; ++i) BOOST_CHECK(tracker.Evaluate(MakeWaveform(2000, 50), 3, mean_v, sigma_v));
+
+  BOOST_CHECK_EQUAL(tracker.NumFullEvaluations(), 1ul);
+  BOOST_CHECK_EQUAL(tracker.NumTracked(), 3ul);
+  BOOST_CHECK_EQUAL(mean_v.size(), 100ul);
+  BOOST_CHECK_CLOSE(mean_v[0],  mean_v[99], tolerance);
+  BOOST_CHECK_CLOSE(mean_v[0],  2000.5, 0.01);
+  BOOST_CHECK_CLOSE(sigma_v[0], 0.5,    1.);
+
+  std::vector<float> tracked_mean, tracked_sigma;
+  tracker.TrackedBaselines(tracked_mean, tracked_sigma);
+  BOOST_CHECK_EQUAL(tracked_mean.size(), 4ul);
+  BOOST_CHECK_EQUAL(tracked_mean[0], -1.f);
+  BOOST_CHECK_CLOSE(tracked_mean[3], mean_v[0], 1e-4); // float
+}
+
+BOOST_AUTO_TEST_CASE(drift_reseedsFromFullAlgo)
+{
+  auto tracker = MakeTracker();
+  pmtana::PedestalMean_t mean_v;
+  pmtana::PedestalSigma_t sigma_v;
+
+  tracker.Evaluate(MakeWaveform(2000), 0, mean_v, sigma_v);
+  tracker.Evaluate(MakeWaveform(2010), 0, mean_v, sigma_v);
+  BOOST_CHECK_EQUAL(tracker.NumFullEvaluations(), 2ul);
+  BOOST_CHECK_CLOSE(mean_v[0], 2010. + 1./3., tolerance);
+
+  tracker.Evaluate(MakeWaveform(2010), 0, mean_v, sigma_v);
+  BOOST_CHECK_EQUAL(tracker.NumTracked(), 1ul);
+  BOOST_CHECK_CLOSE(mean_v[0], 2010.5, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(pulseAtEdge_usesFullAlgo)
+{
+  auto tracker = MakeTracker();
+  pmtana::PedestalMean_t mean_v;
+  pmtana::PedestalSigma_t sigma_v;
+
+  tracker.Evaluate(MakeWaveform(2000), 1, mean_v, sigma_v);
+  tracker.Evaluate(MakeWaveform(2000, 95), 1, mean_v, sigma_v);
+  BOOST_CHECK_EQUAL(tracker.NumFullEvaluations(), 2ul);
+
+  // The baseline is kept, not reseeded from the contaminated waveform
+  tracker.Evaluate(MakeWaveform(2000), 1, mean_v, sigma_v);
+  BOOST_CHECK_EQUAL(tracker.NumTracked(), 1ul);
+}
+
+BOOST_AUTO_TEST_CASE(reset_reproducesFirstPass)
+{
+  auto tracker = MakeTracker();
+  pmtana::PedestalMean_t mean_v;
+  pmtana::PedestalSigma_t sigma_v;
+  const std::vector<short> bases = { 2000, 2003, 2003, 2004 };
+
+  // The same waveforms after a reset give the same pedestals as the first time
+  std::vector<double> first_pass;
+  for(int pass=0; pass<2; ++pass) {
+    tracker.ResetBaselines();
+    std::vector<float> tracked_mean, tracked_sigma;
+    tracker.TrackedBaselines(tracked_mean, tracked_sigma);
+    BOOST_CHECK(tracked_mean.empty());
+
+    for(size_t i=0; i<bases.size(); ++i) {
+      tracker.Evaluate(MakeWaveform(bases[i]), 2, mean_v, sigma_v);
+      if(pass == 0) first_pass.push_back(mean_v[0]);
+      else BOOST_CHECK_EQUAL(mean_v[0], first_pass[i]);
+    }
+  }
+  BOOST_CHECK_EQUAL(tracker.NumFullEvaluations(), 4ul); // Two reseeds per pass
+  BOOST_CHECK_EQUAL(tracker.NumTracked(), 4ul);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,381 @@
+// PulseRecoBenchmark.cc
+//
+// Timing of every pedestal x pulse reconstruction algorithm pair used by
+// OpHitFinder, on synthetic waveform sets. For each pair, PulseRecoManager
+// mode (default, streaming, chunked, batch, pulse table, prefilter) and set it
+// reports the time per sample and the heap allocations per waveform of the
+// re-entrant PulseRecoManager::Reconstruct (the batched one in batch mode),
+// after one warm-up pass. Pulse counts are the same in all modes but
+// prefilter, which drops the waveforms without a PrefilterThreshold peak.
+//
+// Usage: PulseRecoBenchmark [repetitions] [SPE shape file]
+// The SPE shape defaults to OpticalDetector/toyWaveform.txt in FW_SEARCH_PATH;
+// the "toy" set is skipped if it cannot be found.
+
+#include "cetlib/search_path.h"
+#include "fhiclcpp/ParameterSet.h"
+#include "fhiclcpp/make_ParameterSet.h"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoDeconvolution.h"
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoException.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoAlgoFactory.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Allocation counting
+
+namespace {
+  std::atomic< size_t > nAllocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+  ++nAllocations;
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+// Not inlined, so that the compiler does not pair malloc'ed memory with free at call sites
+__attribute__((noinline)) void operator delete(void* ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+//------------------------------------------------------------------------------
+// Algorithm configurations (standard ones from opticaldetectormodules.fcl)
+
+namespace {
+
+  struct AlgoConfig {
+    std::string name;
+    std::string fhicl;
+  };
+
+  const std::vector< AlgoConfig > PedestalConfigs = {
+    { "Edges",
+      "Name: \"Edges\" NumSampleFront: 3 NumSampleTail: 3 Method: 0" },
+    { "RollingMean",
+      "Name: \"RollingMean\" SampleSize: 2 MaxSigma: 0.5 PedRangeMax: 2150 PedRangeMin: 100"
+      " Threshold: 4 DiffBetweenGapsThreshold: 2 DiffADCCounts: 2 NPrePostSamples: 5" },
+    { "UB",
+      "Name: \"UB\" BeamGateSamples: 1500 SampleSize: 2 MaxSigma: 0.5 PedRangeMax: 2150"
+      " PedRangeMin: 100 Threshold: 4 DiffBetweenGapsThreshold: 2 DiffADCCounts: 2"
+      " NPrePostSamples: 5 Verbose: false NWaveformsToFile: 0" },
+    { "RmsSlider",
+      "Name: \"RmsSlider\" SampleSize: 7 Threshold: 0.6 MaxSigma: 0.5 PedRangeMax: 2150"
+      " PedRangeMin: 100 Verbose: false NWaveformsToFile: 0" }
+  };
+
+  const std::vector< AlgoConfig > PulseConfigs = {
+    { "Threshold",
+      "Name: \"Threshold\" StartADCThreshold: 3 EndADCThreshold: 2"
+      " NSigmaThresholdStart: 5 NSigmaThresholdEnd: 3" },
+    { "SlidingWindow",
+      "Name: \"SlidingWindow\" NumPreSample: 3 ADCThreshold: 4 NSigmaThreshold: 4"
+      " EndADCThreshold: 2 EndNSigmaThreshold: 1 Verbosity: false" },
+    { "FixedWindow",
+      "Name: \"FixedWindow\" StartIndex: 0 EndIndex: 20" },
+    { "CFD",
+      "Name: \"CFD\" Fraction: 0.9 Delay: 2 PeakThresh: 7.5 StartThresh: 5.0 EndThresh: 1.5" },
+    { "SiPM",
+      "Name: \"SiPM\" ADCThreshold: 13 MinWidth: 60 SecondThreshold: 1 Pedestal: 1500" },
+    { "Deconvolution", // SPE template set in main()
+      "Name: \"Deconvolution\" NoiseRatio: 0.01 FilterSigma: 1.0"
+      " StartThreshold: 0.2 EndThreshold: 0.05" }
+  };
+
+  /// PulseRecoManager modes; batch mode uses the batched Reconstruct
+  struct RecoMode {
+    std::string name;
+    pmtana::PulseRecoConfig config;
+  };
+
+  const size_t ChunkSize          = 256;
+  const double PrefilterThreshold = 10.; // ADC: above the noise, below the pulses
+
+  pmtana::PulseRecoConfig MakeConfig(void (*set)(pmtana::PulseRecoConfig&))
+  {
+    pmtana::PulseRecoConfig config;
+    set(config);
+    return config;
+  }
+
+  const std::vector< RecoMode > RecoModes = {
+    { "default",   pmtana::PulseRecoConfig() },
+    { "stream",    MakeConfig([](pmtana::PulseRecoConfig& c) { c.streaming = true; }) },
+    { "chunk",     MakeConfig([](pmtana::PulseRecoConfig& c) { c.chunk_size = ChunkSize; }) },
+    { "batch",     MakeConfig([](pmtana::PulseRecoConfig& c) { c.batch = true; }) },
+    { "table",     MakeConfig([](pmtana::PulseRecoConfig& c) { c.table = true; }) },
+    { "prefilter", MakeConfig([](pmtana::PulseRecoConfig& c)
+                              { c.prefilter_threshold = PrefilterThreshold; }) }
+  };
+
+  fhicl::ParameterSet MakePset(std::string const& config)
+  {
+    fhicl::ParameterSet pset;
+    fhicl::make_ParameterSet(config, pset);
+    return pset;
+  }
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// Synthetic waveforms
+
+namespace {
+
+  const double Baseline = 2048.;
+  const double NoiseRMS = 1.;
+  const short  MaxADC   = 4095;
+
+  struct WaveformSet {
+    std::string name;
+    std::vector< pmtana::Waveform_t > waveforms;
+  };
+
+  /// Fast rise, slow decay pulse of unit amplitude
+  double PulseShape(size_t t)
+  { return std::exp(-(double)t/6.) * (1. - std::exp(-(double)t/1.5)) / 0.55; }
+
+  class WaveformGenerator {
+  public:
+
+    explicit WaveformGenerator(unsigned seed) : fEngine(seed), fNoise(0., NoiseRMS) {}
+
+    /// Baseline (with a linear drift) plus gaussian noise
+    std::vector< double > Noise(size_t n, double drift = 0.)
+    {
+      std::vector< double > wf(n);
+      for (size_t i = 0; i < n; ++i)
+        wf[i] = Baseline + drift * i / (double)n + fNoise(fEngine);
+      return wf;
+    }
+
+    /// Adds npulses copies of shape at random times, with random amplitudes up to amplitude
+    void AddPulses(std::vector< double >& wf, size_t npulses, double amplitude,
+                   std::vector< double > const& shape)
+    {
+      std::uniform_int_distribution< size_t > time(0, wf.size() - 1);
+      std::uniform_real_distribution< double > scale(0.2, 1.);
+      for (size_t p = 0; p < npulses; ++p) {
+        size_t const t0 = time(fEngine);
+        double const a  = amplitude * scale(fEngine);
+        for (size_t t = 0; t < shape.size() && t0 + t < wf.size(); ++t)
+          wf[t0 + t] += a * shape[t];
+      }
+    }
+
+    static pmtana::Waveform_t Digitize(std::vector< double > const& wf)
+    {
+      pmtana::Waveform_t adc(wf.size());
+      for (size_t i = 0; i < wf.size(); ++i)
+        adc[i] = (short)std::min(std::max(std::round(wf[i]), 0.), (double)MaxADC);
+      return adc;
+    }
+
+  private:
+    std::mt19937 fEngine;
+    std::normal_distribution< double > fNoise;
+  };
+
+  /// SPE shape from a text file with one value per line, normalized to unit amplitude
+  std::vector< double > ReadShape(std::string const& path)
+  {
+    std::vector< double > shape;
+    std::ifstream file(path);
+    double value;
+    while (file >> value) shape.push_back(value);
+    double const peak = shape.empty() ? 0. : *std::max_element(shape.begin(), shape.end());
+    if (peak <= 0.) return {};
+    for (auto& v : shape) v /= peak;
+    return shape;
+  }
+
+  std::vector< WaveformSet > MakeWaveformSets(std::vector< double > const& spe)
+  {
+    size_t const nWaveforms = 100;
+    size_t const nSamples   = 1500;
+
+    std::vector< double > shape(40);
+    for (size_t t = 0; t < shape.size(); ++t) shape[t] = PulseShape(t);
+
+    WaveformGenerator gen(12345);
+    std::vector< WaveformSet > sets = {
+      { "noise",     {} }, { "single", {} }, { "multi", {} }, { "drift", {} },
+      { "saturated", {} }, { "long",   {} }, { "toy",   {} }
+    };
+
+    for (size_t w = 0; w < nWaveforms; ++w) {
+      auto wf = gen.Noise(nSamples);
+      sets[0].waveforms.push_back(gen.Digitize(wf));
+
+      gen.AddPulses(wf, 1, 100., shape);
+      sets[1].waveforms.push_back(gen.Digitize(wf));
+
+      wf = gen.Noise(nSamples);
+      gen.AddPulses(wf, 10, 100., shape);
+      sets[2].waveforms.push_back(gen.Digitize(wf));
+
+      wf = gen.Noise(nSamples, 30.);
+      gen.AddPulses(wf, 3, 100., shape);
+      sets[3].waveforms.push_back(gen.Digitize(wf));
+
+      wf = gen.Noise(nSamples);
+      gen.AddPulses(wf, 3, 4000., shape);
+      sets[4].waveforms.push_back(gen.Digitize(wf));
+
+      if (w < nWaveforms / 10) {
+        wf = gen.Noise(20 * nSamples);
+        gen.AddPulses(wf, 100, 100., shape);
+        sets[5].waveforms.push_back(gen.Digitize(wf));
+      }
+
+      if (!spe.empty()) {
+        wf = gen.Noise(nSamples);
+        gen.AddPulses(wf, 5, 5. * 20., spe); // up to 5 PE of 20 ADC
+        sets[6].waveforms.push_back(gen.Digitize(wf));
+      }
+    }
+
+    if (spe.empty()) sets.pop_back();
+
+    return sets;
+  }
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// Reconstruction passes
+
+namespace {
+
+  struct RecoBuffers {
+    pmtana::PulseRecoContext context;
+    pmtana::PulseRecoBatchContext batch;
+    std::vector< const pmtana::Waveform_t* > waveforms;
+  };
+
+  /// Pulses found in a context (in pulse_v, or table_v in pulse table mode)
+  size_t NumPulses(pmtana::PulseRecoManager const& manager,
+                   pmtana::PulseRecoContext const& context)
+  {
+    return manager.PulseTableMode() ? context.table_v[0].size() : context.pulse_v[0].size();
+  }
+
+  /// Reconstructs every waveform of the set once; returns the number of pulses found
+  size_t RecoPass(pmtana::PulseRecoManager const& manager, RecoMode const& mode,
+                  WaveformSet const& set, RecoBuffers& buffers)
+  {
+    size_t nPulses = 0;
+    if (mode.config.batch) {
+      buffers.waveforms.clear();
+      for (auto const& wf : set.waveforms) buffers.waveforms.push_back(&wf);
+      manager.Reconstruct(buffers.waveforms, buffers.batch);
+      for (auto const& context : buffers.batch.contexts) nPulses += NumPulses(manager, context);
+    }
+    else {
+      for (auto const& wf : set.waveforms) {
+        manager.Reconstruct(wf, buffers.context);
+        nPulses += NumPulses(manager, buffers.context);
+      }
+    }
+    return nPulses;
+  }
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+  size_t const repetitions =
+    std::max< size_t >(1, argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10);
+
+  std::string spePath;
+  if (argc > 2) spePath = argv[2];
+  else {
+    cet::search_path sp("FW_SEARCH_PATH");
+    if (!sp.find_file("OpticalDetector/toyWaveform.txt", spePath)) spePath.clear();
+  }
+  auto const spe = spePath.empty() ? std::vector< double >() : ReadShape(spePath);
+  if (spe.empty())
+    std::printf("SPE shape not found: skipping the \"toy\" waveform set\n");
+
+  auto const sets = MakeWaveformSets(spe);
+
+  std::printf("%-12s %-14s %-10s %-10s %12s %14s %12s\n",
+              "pedestal", "pulse", "mode", "set", "ns/sample", "allocs/wf", "pulses/wf");
+
+  for (auto const& pedConfig : PedestalConfigs) {
+    for (auto const& pulseConfig : PulseConfigs) {
+
+      auto pedAlgo   = pmtana::MakePedestalAlgo (MakePset(pedConfig.fhicl));
+      auto pulseAlgo = pmtana::MakePulseRecoAlgo(MakePset(pulseConfig.fhicl));
+
+      // Deconvolution with the synthetic pulse shape as 20 ADC single PE
+      if (auto deconvAlgo = dynamic_cast< pmtana::AlgoDeconvolution* >(pulseAlgo.get())) {
+        std::vector< double > shape(40);
+        for (size_t t = 0; t < shape.size(); ++t) shape[t] = 20. * PulseShape(t);
+        deconvAlgo->SetSPETemplate(shape);
+      }
+
+      for (auto const& mode : RecoModes) {
+
+        pmtana::PulseRecoManager manager;
+        manager.AddRecoAlgo(pulseAlgo.get());
+        manager.SetDefaultPedAlgo(pedAlgo.get());
+
+        // e.g. chunks need algorithms which run in blocks
+        try {
+          manager.SetConfig(mode.config);
+        }
+        catch (pmtana::OpticalRecoException const&) {
+          std::printf("%-12s %-14s %-10s unsupported\n",
+                      pedConfig.name.c_str(), pulseConfig.name.c_str(), mode.name.c_str());
+          continue;
+        }
+
+        RecoBuffers buffers;
+
+        for (auto const& set : sets) {
+
+          size_t nSamples = 0;
+          for (auto const& wf : set.waveforms) nSamples += wf.size();
+
+          // Warm-up: buffers reach their steady-state capacity
+          size_t const nPulses = RecoPass(manager, mode, set, buffers);
+
+          size_t const allocsBefore = nAllocations;
+          auto const start = std::chrono::steady_clock::now();
+
+          for (size_t r = 0; r < repetitions; ++r) RecoPass(manager, mode, set, buffers);
+
+          auto const stop = std::chrono::steady_clock::now();
+          size_t const allocs = nAllocations - allocsBefore;
+
+          double const ns   = std::chrono::duration< double, std::nano >(stop - start).count();
+          double const nRun = (double)repetitions * set.waveforms.size();
+
+          std::printf("%-12s %-14s %-10s %-10s %12.3f %14.2f %12.2f\n",
+                      pedConfig.name.c_str(), pulseConfig.name.c_str(), mode.name.c_str(),
+                      set.name.c_str(),
+                      ns / (repetitions * (double)nSamples),
+                      allocs / nRun,
+                      nPulses / (double)set.waveforms.size());
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,157 @@
+#define BOOST_TEST_MODULE ( PulseRecoModes_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoSlidingWindow.h"
+#include "larana/OpticalDetector/OpHitFinder/AlgoThreshold.h"
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoException.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoEdges.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoRmsSlider.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+
+#include "PulseRecoTestUtils.h"
+
+#include <vector>
+
+// Waveforms with pulses, of two lengths, and quiet ones
+std::vector<std::vector<short> > MakeWaveforms()
+{
+  std::vector<std::vector<short> > wfs;
+  wfs.push_back(MakeWaveform());
+  wfs.push_back(MakeWaveform());
+  wfs.back().resize(300);
+  wfs.push_back(std::vector<short>(1000, 2001));
+  wfs.push_back(MakeWaveform());
+  for(auto& v : wfs.back()) v = 2000 + (v % 3);
+  return wfs;
+}
+
+// Mode combination number modes, one bit per mode
+pmtana::PulseRecoConfig MakeConfig(unsigned int modes)
+{
+  pmtana::PulseRecoConfig config;
+  config.streaming           = modes & 1;
+  config.chunk_size          = (modes & 2) ? 64 : 0;
+  config.batch               = modes & 4;
+  config.table               = modes & 8;
+  config.prefilter_threshold = (modes & 16) ? 10. : -1;
+  return config;
+}
+
+void CheckContext(const pmtana::PulseRecoContext& ctx, bool table,
+		  const pmtana::pulse_param_array& expected)
+{
+  if(table) {
+    BOOST_REQUIRE_EQUAL(ctx.table_v.size(), 1ul);
+    CheckSamePulses(ctx.table_v[0], expected);
+  }
+  else {
+    BOOST_CHECK(ctx.table_v.empty());
+    CheckSamePulses(ctx.pulse_v[0], expected);
+  }
+}
+
+// Every combination of the modes against the default one; returns the number of combinations
+// which SetConfig rejects
+unsigned int CheckAllModes(pmtana::PMTPulseRecoBase& pulse_algo,
+			   pmtana::PMTPedestalBase& ped_algo)
+{
+  const auto wfs = MakeWaveforms();
+
+  std::vector<const pmtana::Waveform_t*> wf_ptrs;
+  for(auto const& wf : wfs) wf_ptrs.push_back(&wf);
+
+  pmtana::PulseRecoManager default_mgr;
+  default_mgr.AddRecoAlgo(&pulse_algo);
+  default_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  std::vector<pmtana::PulseRecoContext> expected(wfs.size());
+  std::vector<bool> expected_status;
+  for(size_t i=0; i<wfs.size(); ++i)
+    expected_status.push_back(default_mgr.Reconstruct(wfs[i], expected[i]));
+
+  unsigned int rejected = 0;
+
+  for(unsigned int modes=0; modes<32; ++modes) {
+
+    const auto config = MakeConfig(modes);
+
+    pmtana::PulseRecoManager mgr;
+    mgr.AddRecoAlgo(&pulse_algo);
+    mgr.SetDefaultPedAlgo(&ped_algo);
+
+    // Chunks are the only mode which cannot fall back to the default
+    if(config.chunk_size && !mgr.SupportsBlocks()) {
+      BOOST_CHECK_THROW(mgr.SetConfig(config), pmtana::OpticalRecoException);
+      BOOST_CHECK_EQUAL(mgr.Config().chunk_size, 0ul);
+      ++rejected;
+      continue;
+    }
+
+    mgr.SetConfig(config);
+    BOOST_CHECK_EQUAL(mgr.BatchMode(), config.batch);
+    BOOST_CHECK_EQUAL(mgr.PulseTableMode(), config.table);
+
+    for(size_t i=0; i<wfs.size(); ++i) {
+      pmtana::PulseRecoContext ctx;
+      const size_t skipped = mgr.NumPrefilterSkipped();
+      const bool status = mgr.Reconstruct(wfs[i], ctx);
+      // A skipped waveform is a success, even where its pedestal would not be found
+      if(mgr.NumPrefilterSkipped() == skipped) BOOST_CHECK_EQUAL(status, expected_status[i]);
+      else BOOST_CHECK(status);
+      CheckContext(ctx, config.table, expected[i].pulse_v[0]);
+    }
+
+    pmtana::PulseRecoBatchContext batch;
+    mgr.Reconstruct(wf_ptrs, batch);
+    BOOST_REQUIRE_EQUAL(batch.contexts.size(), wfs.size());
+    for(size_t i=0; i<wfs.size(); ++i)
+      CheckContext(batch.contexts[i], config.table, expected[i].pulse_v[0]);
+  }
+
+  return rejected;
+}
+
+BOOST_AUTO_TEST_SUITE(PulseRecoModes_test)
+
+BOOST_AUTO_TEST_CASE(threshold_headPedestal_allModes)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+  BOOST_CHECK_EQUAL(CheckAllModes(algo, ped_algo), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(threshold_tailPedestal_noChunks)
+{
+  // Constant pedestal, but not known before the end of the waveform
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 1"));
+  BOOST_CHECK_EQUAL(CheckAllModes(algo, ped_algo), 16u);
+}
+
+BOOST_AUTO_TEST_CASE(threshold_slidingPedestal_noChunks)
+{
+  // Per-sample pedestal: every other mode falls back to the default path
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::PedAlgoRmsSlider ped_algo
+    (MakePSet("SampleSize: 7 Threshold: 0.6 MaxSigma: 0.5 PedRangeMax: 2150"
+	      " PedRangeMin: 100 Verbose: false NWaveformsToFile: 0"));
+  BOOST_CHECK_EQUAL(CheckAllModes(algo, ped_algo), 16u);
+}
+
+BOOST_AUTO_TEST_CASE(slidingWindow_headPedestal_noChunks)
+{
+  // Neither chunks nor batches of its own
+  pmtana::AlgoSlidingWindow algo(MakePSet("NumPreSample: 3 ADCThreshold: 4 NSigmaThreshold: 4"
+					  " EndADCThreshold: 2 EndNSigmaThreshold: 1"
+					  " Verbosity: false"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+  BOOST_CHECK_EQUAL(CheckAllModes(algo, ped_algo), 16u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,94 @@
+#define BOOST_TEST_MODULE ( PulseRecoPrefilter_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoFixedWindow.h"
+#include "larana/OpticalDetector/OpHitFinder/AlgoThreshold.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoEdges.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+
+#include "PulseRecoTestUtils.h"
+
+#include <vector>
+
+// Waveforms with pulses, quiet ones, and quiet ones below 0
+std::vector<std::vector<short> > MakeWaveforms()
+{
+  std::vector<std::vector<short> > wfs;
+  wfs.push_back(MakeWaveform());
+  wfs.push_back(std::vector<short>(1000, 2001));
+  wfs.push_back(MakeWaveform());
+  for(auto& v : wfs.back()) v = 2000 + (v % 3);
+  wfs.push_back(std::vector<short>(1000, -50));
+  return wfs;
+}
+
+// Same pulses with and without the prefilter; returns the number of skipped waveforms
+size_t CheckPrefilter(pmtana::PMTPulseRecoBase& pulse_algo, double min_peak, size_t& checked)
+{
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  pmtana::PulseRecoManager full_mgr;
+  full_mgr.AddRecoAlgo(&pulse_algo);
+  full_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  pmtana::PulseRecoManager filter_mgr;
+  filter_mgr.AddRecoAlgo(&pulse_algo);
+  filter_mgr.SetDefaultPedAlgo(&ped_algo);
+  filter_mgr.SetPrefilterThreshold(min_peak);
+
+  for(auto const& wf : MakeWaveforms()) {
+    pmtana::PulseRecoContext full, filtered;
+    BOOST_CHECK(full_mgr.Reconstruct(wf, full));
+    BOOST_CHECK(filter_mgr.Reconstruct(wf, filtered));
+    CheckSamePulses(filtered.pulse_v[0], full.pulse_v[0]);
+  }
+
+  BOOST_CHECK_EQUAL(full_mgr.NumPrefilterChecked(), 0ul);
+  checked = filter_mgr.NumPrefilterChecked();
+  return filter_mgr.NumPrefilterSkipped();
+}
+
+BOOST_AUTO_TEST_SUITE(PulseRecoPrefilter_test)
+
+BOOST_AUTO_TEST_CASE(threshold_skipsQuietWaveforms)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  size_t checked = 0;
+  BOOST_CHECK_EQUAL(CheckPrefilter(algo, 10., checked), 3ul);
+  BOOST_CHECK_EQUAL(checked, 4ul);
+}
+
+BOOST_AUTO_TEST_CASE(fixedWindow_notPrefiltered)
+{
+  // A pulse for every waveform, with a peak floored at 0 even below 0
+  pmtana::AlgoFixedWindow algo(MakePSet("StartIndex: 0 EndIndex: 0"));
+  BOOST_CHECK(!algo.PeakWithinSampleSpread());
+  size_t checked = 0;
+  BOOST_CHECK_EQUAL(CheckPrefilter(algo, 1000., checked), 0ul);
+  BOOST_CHECK_EQUAL(checked, 0ul);
+}
+
+BOOST_AUTO_TEST_CASE(mixedAlgorithms_notPrefiltered)
+{
+  pmtana::AlgoThreshold threshold(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+					   " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+  pmtana::AlgoFixedWindow window(MakePSet("StartIndex: 0 EndIndex: 0"));
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  pmtana::PulseRecoManager mgr;
+  mgr.AddRecoAlgo(&threshold);
+  mgr.AddRecoAlgo(&window);
+  mgr.SetDefaultPedAlgo(&ped_algo);
+  mgr.SetPrefilterThreshold(10.);
+
+  pmtana::PulseRecoContext ctx;
+  BOOST_CHECK(mgr.Reconstruct(std::vector<short>(1000, 2001), ctx));
+  BOOST_CHECK(ctx.pulse_v[0].empty());
+  BOOST_CHECK_EQUAL(ctx.pulse_v[1].size(), 1ul);
+  BOOST_CHECK_EQUAL(mgr.NumPrefilterChecked(), 0ul);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,63 @@
+// Helpers shared by the pulse reconstruction tests
+#ifndef PULSERECOTESTUTILS_H
+#define PULSERECOTESTUTILS_H
+
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "fhiclcpp/ParameterSet.h"
+#include "fhiclcpp/make_ParameterSet.h"
+
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoTypes.h"
+
+#include <string>
+#include <vector>
+
+inline fhicl::ParameterSet MakePSet(const std::string& config)
+{
+  fhicl::ParameterSet pset;
+  fhicl::make_ParameterSet(config, pset);
+  return pset;
+}
+
+// Flat baseline with pulses of different widths; the last one is still open at the end
+inline std::vector<short> MakeWaveform()
+{
+  std::vector<short> wf(1000);
+  for(size_t i=0; i<wf.size(); ++i) wf[i] = 2000 + (i % 3);
+  for(size_t start : { 100ul, 250ul, 262ul, 500ul, 995ul })
+    for(size_t i=0; i<(start % 7) + 4 && start+i<wf.size(); ++i) wf[start+i] += 40 - 5*i;
+  return wf;
+}
+
+inline void CheckSamePulses(const pmtana::pulse_param_array& pulses,
+			    const pmtana::pulse_param_array& expected)
+{
+  BOOST_REQUIRE_EQUAL(pulses.size(), expected.size());
+  for(size_t i=0; i<expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(pulses[i].t_start, expected[i].t_start);
+    BOOST_CHECK_EQUAL(pulses[i].t_max,   expected[i].t_max);
+    BOOST_CHECK_EQUAL(pulses[i].t_end,   expected[i].t_end);
+    BOOST_CHECK_EQUAL(pulses[i].peak,    expected[i].peak);
+    BOOST_CHECK_EQUAL(pulses[i].area,    expected[i].area);
+  }
+}
+
+// Same pulses, up to the single precision of the table amplitudes
+inline void CheckSamePulses(const pmtana::pulse_table& table,
+			    const pmtana::pulse_param_array& pulses)
+{
+  BOOST_REQUIRE_EQUAL(table.size(), pulses.size());
+  BOOST_REQUIRE_EQUAL(table.t_start.size(), pulses.size());
+  BOOST_REQUIRE_EQUAL(table.t_max.size(),   pulses.size());
+  BOOST_REQUIRE_EQUAL(table.t_end.size(),   pulses.size());
+  BOOST_REQUIRE_EQUAL(table.area.size(),    pulses.size());
+  for(size_t i=0; i<pulses.size(); ++i) {
+    BOOST_CHECK_EQUAL(table.t_start[i], pulses[i].t_start);
+    BOOST_CHECK_EQUAL(table.t_max[i],   pulses[i].t_max);
+    BOOST_CHECK_EQUAL(table.t_end[i],   pulses[i].t_end);
+    BOOST_CHECK_EQUAL(table.peak[i],    (float)pulses[i].peak);
+    BOOST_CHECK_EQUAL(table.area[i],    (float)pulses[i].area);
+  }
+}
+
+#endif
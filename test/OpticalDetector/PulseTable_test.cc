@@ -0,0 +1,98 @@
+#define BOOST_TEST_MODULE ( PulseTable_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/AlgoSiPM.h"
+#include "larana/OpticalDetector/OpHitFinder/AlgoThreshold.h"
+#include "larana/OpticalDetector/OpHitFinder/PedAlgoEdges.h"
+#include "larana/OpticalDetector/OpHitFinder/PulseRecoManager.h"
+
+#include "PulseRecoTestUtils.h"
+
+#include <vector>
+
+// Table mode of the manager against the pulse arrays of the default mode
+void CheckManager(pmtana::PMTPulseRecoBase& pulse_algo, size_t chunk_size)
+{
+  pmtana::PedAlgoEdges ped_algo
+    (MakePSet("NumSampleFront: 10 NumSampleTail: 10 Method: 0"));
+
+  const auto wf = MakeWaveform();
+
+  pmtana::PulseRecoManager array_mgr;
+  array_mgr.AddRecoAlgo(&pulse_algo);
+  array_mgr.SetDefaultPedAlgo(&ped_algo);
+
+  pmtana::PulseRecoContext arrays;
+  BOOST_CHECK(array_mgr.Reconstruct(wf, arrays));
+  BOOST_CHECK(arrays.table_v.empty());
+  BOOST_CHECK(!arrays.pulse_v[0].empty());
+
+  pmtana::PulseRecoManager table_mgr;
+  table_mgr.AddRecoAlgo(&pulse_algo);
+  table_mgr.SetDefaultPedAlgo(&ped_algo);
+  table_mgr.SetChunkSize(chunk_size);
+  table_mgr.SetPulseTableMode(true);
+  BOOST_CHECK(table_mgr.PulseTableMode());
+
+  pmtana::PulseRecoContext tables;
+  BOOST_CHECK(table_mgr.Reconstruct(wf, tables));
+  BOOST_CHECK(tables.ped_constant);
+  BOOST_REQUIRE_EQUAL(tables.table_v.size(), 1ul);
+
+  CheckSamePulses(tables.table_v[0], arrays.pulse_v[0]);
+}
+
+BOOST_AUTO_TEST_SUITE(PulseTable_test)
+
+BOOST_AUTO_TEST_CASE(table_pushBackAndAssign)
+{
+  pmtana::pulse_param_array pulses(3);
+  for(size_t i=0; i<pulses.size(); ++i) {
+    pulses[i].t_start = 10.*i;
+    pulses[i].t_max   = 10.*i + 2;
+    pulses[i].t_end   = 10.*i + 5;
+    pulses[i].peak    = 20.25 + i;
+    pulses[i].area    = 100.5 + i;
+  }
+
+  pmtana::pulse_table table;
+  table.push_back(pmtana::pulse_param());
+  BOOST_CHECK_EQUAL(table.t_max[0], -1);
+
+  table.assign(pulses);
+  CheckSamePulses(table, pulses);
+
+  table.clear();
+  BOOST_CHECK(table.empty());
+  BOOST_CHECK(table.t_start.empty());
+}
+
+BOOST_AUTO_TEST_CASE(threshold_tableMatchesArray)
+{
+  pmtana::AlgoThreshold algo(MakePSet("StartADCThreshold: 10 EndADCThreshold: 5"
+				      " NSigmaThresholdStart: 3 NSigmaThresholdEnd: 2"));
+
+  const auto wf = MakeWaveform();
+
+  pmtana::pulse_param_array pulses;
+  algo.Reconstruct(wf, 2001., 0.8, pulses);
+  BOOST_CHECK_EQUAL(pulses.size(), 5ul);
+
+  pmtana::pulse_table table;
+  table.push_back(pmtana::pulse_param());
+  BOOST_CHECK(algo.Reconstruct(wf, 2001., 0.8, table));
+  CheckSamePulses(table, pulses);
+
+  // Filled directly, or copied after a chunked reconstruction
+  CheckManager(algo, 0);
+  CheckManager(algo, 64);
+}
+
+BOOST_AUTO_TEST_CASE(sipm_tableMatchesArray)
+{
+  // No table implementation of its own: the pulse array is copied
+  pmtana::AlgoSiPM algo(MakePSet("ADCThreshold: 20 MinWidth: 1 SecondThreshold: 5 Pedestal: 0"));
+  CheckManager(algo, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
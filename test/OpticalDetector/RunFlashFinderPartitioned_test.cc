@@ -0,0 +1,153 @@
+#define BOOST_TEST_MODULE ( RunFlashFinderPartitioned_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "cetlib_except/exception.h"
+#include "lardataalg/DetectorInfo/DetectorClocksStandard.h"
+
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
+#include "larana/OpticalDetector/OpFlashAlg.h"
+
+#include "FlashTestUtils.h"
+
+#include <algorithm>
+#include <vector>
+
+std::vector< unsigned int > CryostatPartitions(
+                                      opdet::OpDetGeometryCache const& cache)
+{
+  std::vector< unsigned int > partitions(NChannels);
+  for (unsigned int ch = 0; ch != NChannels; ++ch)
+    partitions[ch] = cache.Cryostat(ch);
+  return partitions;
+}
+
+BOOST_AUTO_TEST_SUITE(RunFlashFinderPartitioned_test)
+
+BOOST_AUTO_TEST_CASE(OnePartition_matchesRunFlashFinder)
+{
+  auto const cache = MakeCache(2);
+  detinfo::DetectorClocksStandard const clocks;
+  auto const hits = MakeHits(1, 20, 1000, 200., false);
+
+  std::vector< recob::OpFlash >     expected, flashes;
+  std::vector< std::vector< int > > expectedAssoc, assoc;
+  opdet::RunFlashFinder(hits, expected, expectedAssoc, BinWidth, cache,
+                        FlashThreshold, WidthTolerance, clocks, TrigCoinc);
+  opdet::RunFlashFinderPartitioned(hits, flashes, assoc, BinWidth, cache,
+                                   FlashThreshold, WidthTolerance, clocks,
+                                   TrigCoinc,
+                                   std::vector< unsigned int >(NChannels, 0));
+
+  BOOST_REQUIRE(!expected.empty());
+  BOOST_REQUIRE_EQUAL(flashes.size(), expected.size());
+  for (size_t i = 0; i != expected.size(); ++i)
+    CheckSameFlash(flashes[i], expected[i]);
+  BOOST_CHECK(assoc == expectedAssoc);
+}
+
+BOOST_AUTO_TEST_CASE(Merge_timeOrderAndHitIndices)
+{
+  auto const cache = MakeCache(2);
+  detinfo::DetectorClocksStandard const clocks;
+
+  // Same time in both cryostats, then one flash in each; hits interleaved
+  std::vector< recob::OpHit > const hits =
+    { MakeHit(20, 10., 15.), MakeHit(1, 30., 25.), MakeHit(2, 10., 15.),
+      MakeHit(21, 10., 15.), MakeHit(3, 10., 15.), MakeHit(22, 20., 30.) };
+
+  std::vector< recob::OpFlash >     flashes;
+  std::vector< std::vector< int > > assoc;
+  opdet::RunFlashFinderPartitioned(hits, flashes, assoc, BinWidth, cache,
+                                   FlashThreshold, WidthTolerance, clocks,
+                                   TrigCoinc, CryostatPartitions(cache));
+
+  // Ties keep the partition order; indices are those of the full vector
+  BOOST_REQUIRE_EQUAL(flashes.size(), 4u);
+  BOOST_REQUIRE_EQUAL(assoc.size(), 4u);
+  for (auto& hitsThisFlash : assoc)
+    std::sort(hitsThisFlash.begin(), hitsThisFlash.end());
+  BOOST_CHECK(assoc[0] == std::vector< int >({ 2, 4 }));
+  BOOST_CHECK(assoc[1] == std::vector< int >({ 0, 3 }));
+  BOOST_CHECK(assoc[2] == std::vector< int >({ 5 }));
+  BOOST_CHECK(assoc[3] == std::vector< int >({ 1 }));
+  BOOST_CHECK_EQUAL(flashes[0].Time(), flashes[1].Time());
+  BOOST_CHECK_LT(flashes[1].Time(), flashes[2].Time());
+  BOOST_CHECK_LT(flashes[2].Time(), flashes[3].Time());
+  BOOST_CHECK_EQUAL(flashes[0].PEs()[20], 0.);
+  BOOST_CHECK_EQUAL(flashes[1].PEs()[20], 15.);
+}
+
+BOOST_AUTO_TEST_CASE(Partitions_matchRunFlashFinderPerPartition)
+{
+  auto const cache = MakeCache(2);
+  detinfo::DetectorClocksStandard const clocks;
+
+  // Cryostats, and three groups of channels with an unused partition
+  std::vector< unsigned int > groups(NChannels);
+  for (unsigned int ch = 0; ch != NChannels; ++ch) groups[ch] = 2*(ch % 3);
+
+  for (unsigned int seed = 0; seed != 4; ++seed) {
+    auto const hits = MakeHits(seed, 40, 2000, 500., false);
+
+    for (auto const& partitions : { CryostatPartitions(cache), groups }) {
+      std::vector< recob::OpFlash >     flashes;
+      std::vector< std::vector< int > > assoc;
+      opdet::RunFlashFinderPartitioned(hits, flashes, assoc, BinWidth, cache,
+                                       FlashThreshold, WidthTolerance, clocks,
+                                       TrigCoinc, partitions);
+      BOOST_REQUIRE_EQUAL(assoc.size(), flashes.size());
+      for (size_t i = 1; i < flashes.size(); ++i)
+        BOOST_CHECK_LE(flashes[i - 1].Time(), flashes[i].Time());
+
+      // The flashes of each partition, in order, are those of its hits
+      for (unsigned int p = 0; p != 6; ++p) {
+        std::vector< recob::OpHit > PartitionHits;
+        std::vector< int >          PartitionHitIndices;
+        for (size_t i = 0; i != hits.size(); ++i)
+          if (partitions[hits[i].OpChannel()] == p) {
+            PartitionHits.push_back(hits[i]);
+            PartitionHitIndices.push_back(i);
+          }
+
+        std::vector< recob::OpFlash >     expected;
+        std::vector< std::vector< int > > expectedAssoc;
+        if (!PartitionHits.empty())
+          opdet::RunFlashFinder(PartitionHits, expected, expectedAssoc,
+                                BinWidth, cache, FlashThreshold,
+                                WidthTolerance, clocks, TrigCoinc);
+
+        size_t NFound = 0;
+        for (size_t i = 0; i != flashes.size(); ++i) {
+          if (partitions[hits[assoc[i].front()].OpChannel()] != p) continue;
+          BOOST_REQUIRE_LT(NFound, expected.size());
+          CheckSameFlash(flashes[i], expected[NFound]);
+          BOOST_REQUIRE_EQUAL(assoc[i].size(), expectedAssoc[NFound].size());
+          for (size_t h = 0; h != assoc[i].size(); ++h)
+            BOOST_CHECK_EQUAL(assoc[i][h],
+                              PartitionHitIndices[expectedAssoc[NFound][h]]);
+          ++NFound;
+        }
+        BOOST_CHECK_EQUAL(NFound, expected.size());
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MissingChannel_throws)
+{
+  auto const cache = MakeCache(2);
+  detinfo::DetectorClocksStandard const clocks;
+  auto const partitions = CryostatPartitions(cache);
+
+  std::vector< recob::OpFlash >     flashes;
+  std::vector< std::vector< int > > assoc;
+  for (int channel : { -1, int(NChannels) })
+    BOOST_CHECK_THROW(opdet::RunFlashFinderPartitioned(
+                        { MakeHit(1, 10., 30.), MakeHit(channel, 10., 30.) },
+                        flashes, assoc, BinWidth, cache, FlashThreshold,
+                        WidthTolerance, clocks, TrigCoinc, partitions),
+                      cet::exception);
+  BOOST_CHECK(flashes.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
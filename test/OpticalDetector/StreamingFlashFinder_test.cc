@@ -0,0 +1,165 @@
+#define BOOST_TEST_MODULE ( StreamingFlashFinder_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "cetlib_except/exception.h"
+#include "lardataalg/DetectorInfo/DetectorClocksStandard.h"
+
+#include "larana/OpticalDetector/OpDetGeometryCache.h"
+#include "larana/OpticalDetector/OpFlashAlg.h"
+#include "larana/OpticalDetector/StreamingFlashFinder.h"
+
+#include "FlashTestUtils.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+void CheckSameFlashes(std::vector< recob::OpFlash > const&     flashes,
+                      std::vector< std::vector< int > > const& assoc,
+                      std::vector< recob::OpFlash > const&     expected,
+                      std::vector< std::vector< int > > const& expectedAssoc)
+{
+  BOOST_REQUIRE_EQUAL(flashes.size(), expected.size());
+  BOOST_REQUIRE_EQUAL(assoc.size(), expectedAssoc.size());
+  for (size_t i = 0; i != expected.size(); ++i) {
+    CheckSameFlash(flashes[i], expected[i]);
+    BOOST_CHECK(assoc[i] == expectedAssoc[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(StreamingFlashFinder_test)
+
+BOOST_AUTO_TEST_CASE(BatchSplitting_matchesRunFlashFinder)
+{
+  auto const cache = MakeCache();
+  detinfo::DetectorClocksStandard const clocks;
+  std::mt19937 rng(11);
+
+  for (unsigned int seed = 0; seed != 6; ++seed) {
+    auto const hits = seed % 2 ? MakeHits(seed, 30, 2000, 500., true)
+                               : MakeHits(seed, 5, 100, 20., true);
+
+    // One hit per batch, random batch sizes, all hits at once
+    for (size_t MaxBatch : { 1ul, 50ul, hits.size() }) {
+
+      opdet::StreamingFlashFinder finder(BinWidth, FlashThreshold,
+                                         WidthTolerance, TrigCoinc);
+      std::vector< recob::OpFlash >     flashes;
+      std::vector< std::vector< int > > assoc;
+
+      // Hits within a batch come in any order; the stream is the hits in the
+      // order they are added
+      std::vector< recob::OpHit > stream;
+      size_t first = 0;
+      while (first != hits.size()) {
+        size_t const n = std::min(1 + rng() % MaxBatch, hits.size() - first);
+        std::vector< recob::OpHit > batch(hits.begin() + first,
+                                          hits.begin() + first + n);
+        std::shuffle(batch.begin(), batch.end(), rng);
+        stream.insert(stream.end(), batch.begin(), batch.end());
+        finder.AddHits(batch, cache, clocks, flashes, assoc);
+        first += n;
+      }
+      finder.Flush(cache, clocks, flashes, assoc);
+      BOOST_CHECK_EQUAL(finder.NPendingHits(), 0u);
+      BOOST_CHECK_EQUAL(finder.NPendingFlashes(), 0u);
+
+      std::vector< recob::OpFlash >     expected;
+      std::vector< std::vector< int > > expectedAssoc;
+      opdet::RunFlashFinder(stream, expected, expectedAssoc, BinWidth, cache,
+                            FlashThreshold, WidthTolerance, clocks, TrigCoinc);
+      BOOST_REQUIRE(!expected.empty());
+      CheckSameFlashes(flashes, assoc, expected, expectedAssoc);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Emission_timeOrderBeforeFlush)
+{
+  auto const cache = MakeCache();
+  detinfo::DetectorClocksStandard const clocks;
+
+  opdet::StreamingFlashFinder finder(BinWidth, FlashThreshold,
+                                     WidthTolerance, TrigCoinc);
+  std::vector< recob::OpFlash >     flashes;
+  std::vector< std::vector< int > > assoc;
+
+  // Two flashes in the first batch: the earlier one is over, as no later
+  // hit can come before 20 us
+  finder.AddHits({ MakeHit(1, 20.0, 15.), MakeHit(2, 20.02, 15.),
+                   MakeHit(3, 10.0, 30.), MakeHit(4, 10.02, 5.) },
+                 cache, clocks, flashes, assoc);
+  BOOST_REQUIRE_EQUAL(flashes.size(), 1u);
+  BOOST_CHECK_EQUAL(finder.NPendingHits() + finder.NPendingFlashes(), 2u);
+
+  // A later hit ends the other one; the hits are those of the stream
+  finder.AddHits({ MakeHit(5, 40., 1.) }, cache, clocks, flashes, assoc);
+  BOOST_REQUIRE_EQUAL(flashes.size(), 2u);
+  BOOST_CHECK_LT(flashes[0].Time(), flashes[1].Time());
+  std::sort(assoc[0].begin(), assoc[0].end());
+  std::sort(assoc[1].begin(), assoc[1].end());
+  BOOST_CHECK(assoc[0] == std::vector< int >({ 2, 3 }));
+  BOOST_CHECK(assoc[1] == std::vector< int >({ 0, 1 }));
+
+  // Indices go on counting across batches
+  finder.AddHits({ MakeHit(6, 60., 25.) }, cache, clocks, flashes, assoc);
+  finder.Flush(cache, clocks, flashes, assoc);
+  BOOST_REQUIRE_EQUAL(flashes.size(), 3u);
+  BOOST_CHECK(assoc[2] == std::vector< int >({ 5 }));
+}
+
+BOOST_AUTO_TEST_CASE(AddHits_rejectsEarlierBatch)
+{
+  auto const cache = MakeCache();
+  detinfo::DetectorClocksStandard const clocks;
+
+  opdet::StreamingFlashFinder finder(BinWidth, FlashThreshold,
+                                     WidthTolerance, TrigCoinc);
+  std::vector< recob::OpFlash >     flashes;
+  std::vector< std::vector< int > > assoc;
+
+  finder.AddHits({ MakeHit(1, 10., 5.), MakeHit(2, 12., 5.) },
+                 cache, clocks, flashes, assoc);
+  // Equal times are fine, earlier ones are not
+  finder.AddHits({ MakeHit(3, 12., 5.) }, cache, clocks, flashes, assoc);
+  BOOST_CHECK_THROW(finder.AddHits({ MakeHit(4, 13., 5.), MakeHit(5, 11., 5.) },
+                                   cache, clocks, flashes, assoc),
+                    cet::exception);
+}
+
+BOOST_AUTO_TEST_CASE(Flush_restartsStream)
+{
+  auto const cache = MakeCache();
+  detinfo::DetectorClocksStandard const clocks;
+  auto const hits = MakeHits(3, 10, 300, 100., true);
+
+  std::vector< recob::OpFlash >     expected;
+  std::vector< std::vector< int > > expectedAssoc;
+  opdet::RunFlashFinder(hits, expected, expectedAssoc, BinWidth, cache,
+                        FlashThreshold, WidthTolerance, clocks, TrigCoinc);
+
+  opdet::StreamingFlashFinder finder(BinWidth, FlashThreshold,
+                                     WidthTolerance, TrigCoinc);
+
+  // A stream of earlier hits, then the same stream twice: after each
+  // Flush, the bins and the hit indices start over
+  std::vector< recob::OpFlash >     flashes;
+  std::vector< std::vector< int > > assoc;
+  finder.AddHits({ MakeHit(1, 500., 30.) }, cache, clocks, flashes, assoc);
+  finder.Flush(cache, clocks, flashes, assoc);
+  BOOST_CHECK_EQUAL(flashes.size(), 1u);
+
+  for (int pass = 0; pass != 2; ++pass) {
+    flashes.clear();
+    assoc.clear();
+    for (size_t first = 0; first < hits.size(); first += 7) {
+      std::vector< recob::OpHit > batch
+        (hits.begin() + first, hits.begin() + std::min(first + 7, hits.size()));
+      finder.AddHits(batch, cache, clocks, flashes, assoc);
+    }
+    finder.Flush(cache, clocks, flashes, assoc);
+    CheckSameFlashes(flashes, assoc, expected, expectedAssoc);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
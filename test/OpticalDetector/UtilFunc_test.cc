@@ -0,0 +1,88 @@
+#define BOOST_TEST_MODULE ( UtilFunc_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/UtilFunc.h"
+#include "larana/OpticalDetector/OpHitFinder/OpticalRecoException.h"
+
+#include <random>
+#include <vector>
+
+// Rolling means of window samples of a baseline with noise, as in PedAlgoRollingMean
+pmtana::PedestalMean_t MakeMeans(size_t n, size_t window, int baseline, int noise, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> adc(baseline - noise, baseline + noise);
+  std::vector<int> wf(n + window);
+  for(auto& v : wf) v = adc(rng);
+
+  pmtana::PedestalMean_t mean_v(n);
+  for(size_t i=0; i<n; ++i) {
+    long sum = 0;
+    for(size_t j=0; j<window; ++j) sum += wf[i+j];
+    mean_v[i] = (double)sum / window;
+  }
+  return mean_v;
+}
+
+BOOST_AUTO_TEST_SUITE(UtilFunc_test)
+
+BOOST_AUTO_TEST_CASE(BinnedMaxOccurrence_integerPathMatchesBinned)
+{
+  std::vector<size_t> ctr_v;
+  for(size_t window : { 1, 2, 3, 7, 8, 16 }) {
+    for(int noise : { 0, 1, 3, 20 }) {
+      for(unsigned seed=0; seed<10; ++seed) {
+	auto mean_v = MakeMeans(1500, window, 2048, noise, seed);
+	for(size_t nbins : { 1, 10, 1000 }) {
+	  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(mean_v, nbins, window, ctr_v),
+			    pmtana::BinnedMaxOccurrence(mean_v, nbins));
+	}
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(BinnedMaxOccurrence_fallbacksMatchBinned)
+{
+  std::vector<size_t> ctr_v;
+
+  // Not multiples of 1/quantum
+  auto mean_v = MakeMeans(500, 3, 2048, 5, 1);
+  for(auto& v : mean_v) v += 0.1;
+  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(mean_v, 1000, 3, ctr_v),
+		    pmtana::BinnedMaxOccurrence(mean_v, 1000));
+
+  // More distinct values than bins
+  mean_v = MakeMeans(500, 4, 2048, 2000, 2);
+  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(mean_v, 100, 4, ctr_v),
+		    pmtana::BinnedMaxOccurrence(mean_v, 100));
+
+  // Wrong quantum for the values
+  mean_v = MakeMeans(500, 8, 2048, 5, 3);
+  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(mean_v, 1000, 2, ctr_v),
+		    pmtana::BinnedMaxOccurrence(mean_v, 1000));
+}
+
+BOOST_AUTO_TEST_CASE(BinnedMaxOccurrence_bufferReuse)
+{
+  // A buffer left over from a larger histogram does not change the result
+  std::vector<size_t> ctr_v;
+  auto wide   = MakeMeans(1000, 5, 2048, 50, 4);
+  auto narrow = MakeMeans(1000, 5, 100, 2, 5);
+  const double expected = pmtana::BinnedMaxOccurrence(narrow, 1000);
+  pmtana::BinnedMaxOccurrence(wide, 1000, 5, ctr_v);
+  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(narrow, 1000, 5, ctr_v), expected);
+  BOOST_CHECK_EQUAL(pmtana::BinnedMaxOccurrence(narrow, 1000, 5, ctr_v), expected);
+}
+
+BOOST_AUTO_TEST_CASE(BinnedMaxOccurrence_invalidInput)
+{
+  std::vector<size_t> ctr_v;
+  pmtana::PedestalMean_t mean_v(10, 1.);
+  BOOST_CHECK_THROW(pmtana::BinnedMaxOccurrence(mean_v, 0, 1, ctr_v), pmtana::OpticalRecoException);
+  BOOST_CHECK_THROW(pmtana::BinnedMaxOccurrence(mean_v, 10, 0, ctr_v), pmtana::OpticalRecoException);
+  BOOST_CHECK_THROW(pmtana::BinnedMaxOccurrence(pmtana::PedestalMean_t(), 10, 1, ctr_v),
+		    pmtana::OpticalRecoException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
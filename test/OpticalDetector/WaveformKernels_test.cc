@@ -0,0 +1,185 @@
+#define BOOST_TEST_MODULE ( WaveformKernels_test )
+#include "cetlib/quiet_unit_test.hpp"
+
+#include "larana/OpticalDetector/OpHitFinder/WaveformKernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Waveform lengths around the vector widths, plus a long one
+const std::vector<size_t> Lengths = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 32, 33, 100, 1501 };
+
+std::vector<short> MakeWaveform(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> adc(-32768, 32767);
+  std::vector<short> wf(n);
+  for(auto& v : wf) v = (short)adc(rng);
+  return wf;
+}
+
+BOOST_AUTO_TEST_SUITE(WaveformKernels_test)
+
+BOOST_AUTO_TEST_CASE(ConvertToFloat_matchesCast)
+{
+  for(auto n : Lengths) {
+    auto wf = MakeWaveform(n, n);
+    std::vector<float> out(n);
+    pmtana::ConvertToFloat(wf.data(), n, out.data());
+    for(size_t i=0; i<n; ++i) BOOST_CHECK_EQUAL(out[i], (float)wf[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(WindowSums_exactForExtremeValues)
+{
+  for(auto n : Lengths) {
+    auto wf = MakeWaveform(n, n+1);
+    if(n) wf[0] = -32768;
+    if(n>1) wf[1] = -32768; // pair of squares overflows a signed 32 bit lane
+    int64_t sum = 0, sum2 = 0;
+    for(auto v : wf) { sum += v; sum2 += (int64_t)v*v; }
+    int64_t ksum = -1, ksum2 = -1;
+    pmtana::WindowSums(wf.data(), n, ksum, ksum2);
+    BOOST_CHECK_EQUAL(ksum,  sum);
+    BOOST_CHECK_EQUAL(ksum2, sum2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SubtractBaseline_matchesScalar)
+{
+  for(auto n : Lengths) {
+    auto wf = MakeWaveform(n, n+2);
+    std::vector<double> baseline(n), out(n), const_out(n);
+    for(size_t i=0; i<n; ++i) baseline[i] = 2048.3 + 0.01*i;
+    pmtana::SubtractBaseline(wf.data(), baseline.data(), n, out.data());
+    pmtana::SubtractBaseline(wf.data(), 2047.7, n, const_out.data());
+    for(size_t i=0; i<n; ++i) {
+      BOOST_CHECK_EQUAL(out[i],       (double)wf[i] - baseline[i]);
+      BOOST_CHECK_EQUAL(const_out[i], (double)wf[i] - 2047.7);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ConstantFraction_matchesScalar)
+{
+  for(auto n : Lengths) {
+    auto wf = MakeWaveform(n, n+3);
+    std::vector<double> baseline(n, 1999.25), out(n);
+    for(size_t delay : { 0, 2, 5, 40 }) {
+      pmtana::ConstantFraction(wf.data(), baseline.data(), n, -0.9, delay, out.data());
+      for(size_t i=0; i<n; ++i) {
+	double expected = -0.9 * ((double)wf[i] - baseline[i]);
+	if(i >= delay) expected += (double)wf[i-delay] - baseline[i];
+	BOOST_CHECK_EQUAL(out[i], expected);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ArgMaxArgMin_returnFirstExtremum)
+{
+  for(auto n : Lengths) {
+    std::vector<short> wf(n, 7);
+    BOOST_CHECK_EQUAL(pmtana::ArgMax(wf.data(), n), 0ul);
+    BOOST_CHECK_EQUAL(pmtana::ArgMin(wf.data(), n), 0ul);
+    if(n < 3) continue;
+    wf[n-1] = 9; wf[n/2] = 9;
+    wf[n-2] = 3; wf[1]   = 3;
+    BOOST_CHECK_EQUAL(pmtana::ArgMax(wf.data(), n), n/2 == 1 ? n-1 : n/2);
+    BOOST_CHECK_EQUAL(pmtana::ArgMin(wf.data(), n), 1ul);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MinMax_matchesScalar)
+{
+  for(auto n : Lengths) {
+    auto wf = MakeWaveform(n, n+4);
+    short min = 1, max = -1;
+    pmtana::MinMax(wf.data(), n, min, max);
+    if(!n) {
+      BOOST_CHECK_EQUAL(min, 0);
+      BOOST_CHECK_EQUAL(max, 0);
+      continue;
+    }
+    BOOST_CHECK_EQUAL(min, *std::min_element(wf.begin(), wf.end()));
+    BOOST_CHECK_EQUAL(max, *std::max_element(wf.begin(), wf.end()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FindFirstAtOrAbove_thresholds)
+{
+  std::vector<short> wf(100, 2048);
+  wf[37] = 2051;
+  wf[80] = 2060;
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), (short)2051), 37ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), (short)2052), 80ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), (short)2061), 100ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), (short)-32768), 0ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), 2050.2), 37ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), 2051.0), 37ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), 2051.5), 80ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), 1e9), 100ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstAtOrAbove(wf.data(), wf.size(), -1e9), 0ul);
+}
+
+BOOST_AUTO_TEST_CASE(InterleaveWaveforms_layout)
+{
+  const size_t n = 5, nwf = 3;
+  std::vector<std::vector<short> > wfs(nwf);
+  std::vector<const short*> ptrs;
+  for(size_t w=0; w<nwf; ++w) {
+    for(size_t i=0; i<n; ++i) wfs[w].push_back((short)(100*w + i));
+    ptrs.push_back(wfs[w].data());
+  }
+  std::vector<short> rows(n * pmtana::NumBatchLanes);
+  pmtana::InterleaveWaveforms(ptrs.data(), nwf, n, rows.data());
+  for(size_t i=0; i<n; ++i)
+    for(size_t lane=0; lane<pmtana::NumBatchLanes; ++lane)
+      BOOST_CHECK_EQUAL(rows[i*pmtana::NumBatchLanes + lane],
+			lane < nwf ? wfs[lane][i] : std::numeric_limits<short>::min());
+}
+
+BOOST_AUTO_TEST_CASE(FindFirstRowAtOrAbove_thresholds)
+{
+  const size_t nrows = 50;
+  std::vector<short> rows(nrows * pmtana::NumBatchLanes, 2048);
+  std::vector<short> thresholds(pmtana::NumBatchLanes, 2060);
+  thresholds[15] = std::numeric_limits<short>::max();
+  rows[21*pmtana::NumBatchLanes + 15] = 4000;   // Lane with unreachable threshold
+  rows[33*pmtana::NumBatchLanes + 9]  = 2060;
+  rows[40*pmtana::NumBatchLanes + 0]  = 3000;
+  BOOST_CHECK_EQUAL(pmtana::FindFirstRowAtOrAbove(rows.data(), nrows, thresholds.data()), 33ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstRowAtOrAbove(rows.data(), 33, thresholds.data()), 33ul);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstRowAtOrAbove(rows.data() + 34*pmtana::NumBatchLanes, nrows-34,
+						  thresholds.data()), 6ul);
+  thresholds[0] = 3001;
+  thresholds[9] = 2061;
+  BOOST_CHECK_EQUAL(pmtana::FindFirstRowAtOrAbove(rows.data(), nrows, thresholds.data()), nrows);
+  BOOST_CHECK_EQUAL(pmtana::FindFirstRowAtOrAbove(rows.data(), 0, thresholds.data()), 0ul);
+}
+
+BOOST_AUTO_TEST_CASE(RowLanesAtOrAbove_mask)
+{
+  std::vector<short> row(pmtana::NumBatchLanes, 2048);
+  std::vector<short> thresholds(pmtana::NumBatchLanes, 2060);
+  BOOST_CHECK_EQUAL(pmtana::RowLanesAtOrAbove(row.data(), thresholds.data()), 0u);
+  row[0]  = 2060;                                    // Equal to the threshold
+  row[7]  = 2059;                                    // Just below
+  row[8]  = 4000;
+  row[15] = std::numeric_limits<short>::max();
+  BOOST_CHECK_EQUAL(pmtana::RowLanesAtOrAbove(row.data(), thresholds.data()),
+		    (1u << 0) | (1u << 8) | (1u << 15));
+  thresholds[15] = std::numeric_limits<short>::max();
+  thresholds[3]  = std::numeric_limits<short>::min();  // Any value passes
+  row[3] = std::numeric_limits<short>::min();
+  BOOST_CHECK_EQUAL(pmtana::RowLanesAtOrAbove(row.data(), thresholds.data()),
+		    (1u << 0) | (1u << 3) | (1u << 8) | (1u << 15));
+  row[15] = std::numeric_limits<short>::max() - 1;
+  BOOST_CHECK_EQUAL(pmtana::RowLanesAtOrAbove(row.data(), thresholds.data()),
+		    (1u << 0) | (1u << 3) | (1u << 8));
+}
+
+BOOST_AUTO_TEST_SUITE_END()